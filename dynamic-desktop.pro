@@ -5,12 +5,17 @@ qtavlib.file = src/3rdparty/qtav/qtav-lite.pro
 utilslib.file = src/ddutils/ddutils.pro
 service.file = src/ddservice/ddservice.pro
 service.depends *= utilslib
+ctl.file = src/ddctl/ddctl.pro
 main.file = src/ddmain/ddmain.pro
 main.depends *= \
     qtavlib \
     utilslib
+# QtTest based, "make check" runs them.
+tests.file = src/tests/tests.pro
 SUBDIRS *= \
     qtavlib \
     utilslib \
     main \
-    service
+    service \
+    ctl \
+    tests
@@ -43,6 +43,7 @@
 #include <QCoreApplication>
 #include <QDataStream>
 #include <QTime>
+#include <QTimer>
 #include <QLocalServer>
 #include <QLocalSocket>
 
@@ -56,6 +57,8 @@ namespace QtLP_Private
 }
 
 const char* QtLocalPeer::ack = "ack";
+static const int idleTimeout = 5000;
+static const quint32 maxMessageSize = 16 * 1024 * 1024;
 
 QtLocalPeer::QtLocalPeer(QObject* parent, QString appId)
     : QObject(parent), id(std::move(appId))
@@ -79,6 +82,9 @@ QtLocalPeer::QtLocalPeer(QObject* parent, QString appId)
     socketName += QLatin1Char('-') + QString::number(sessionId, 16);
 
     server = new QLocalServer(this);
+    idleTimer = new QTimer(this);
+    idleTimer->setInterval(1000);
+    connect(idleTimer, &QTimer::timeout, this, &QtLocalPeer::dropIdleConnections);
     QString lockName = QDir(QDir::tempPath()).absolutePath()
                        + QLatin1Char('/') + socketName
                        + QStringLiteral("-lockfile");
@@ -104,6 +110,20 @@ bool QtLocalPeer::isClient()
 }
 
 
+bool QtLocalPeer::isLockedByOther()
+{
+    if (lockFile.isLocked())
+        return false;
+
+    // Unlike isClient(), do not keep the lock: the process may still be
+    // far from being able to serve the socket.
+    if (!lockFile.lock(QtLP_Private::QtLockedFile::WriteLock, false))
+        return true;
+    lockFile.unlock();
+    return false;
+}
+
+
 bool QtLocalPeer::sendMessage(const QString &message, int timeout)
 {
     if (!isClient())
@@ -138,42 +158,101 @@ bool QtLocalPeer::sendMessage(const QString &message, int timeout)
 
 void QtLocalPeer::receiveConnection()
 {
-    QLocalSocket* socket = server->nextPendingConnection();
-    if (!socket)
-        return;
+    while (QLocalSocket* socket = server->nextPendingConnection()) {
+        Connection connection;
+        connection.client = ++lastClient;
+        connections.insert(socket, connection);
+        clients.insert(connection.client, socket);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readFromSocket(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() { dropConnection(socket); });
+        if (!idleTimer->isActive())
+            idleTimer->start();
+        // The message may have arrived together with the connection.
+        readFromSocket(socket);
+    }
+}
 
+
+void QtLocalPeer::readFromSocket(QLocalSocket* socket)
+{
     while (true) {
-        if (socket->state() == QLocalSocket::UnconnectedState) {
-            qWarning("QtLocalPeer: Peer disconnected");
-            delete socket;
+        // Looked up again every round, a slot connected to
+        // messageReceived() may have changed the connections meanwhile.
+        auto it = connections.find(socket);
+        if (it == connections.end())
             return;
+        Connection& connection = it.value();
+        connection.idle.start();
+        if (!connection.haveLength) {
+            if (socket->bytesAvailable() < qint64(sizeof(quint32)))
+                return;
+            QDataStream ds(socket);
+            ds >> connection.length;
+            if (connection.length > maxMessageSize) {
+                qWarning("QtLocalPeer: Message of %u bytes rejected", connection.length);
+                socket->abort();
+                dropConnection(socket);
+                return;
+            }
+            connection.haveLength = true;
+            connection.message.clear();
+            connection.message.reserve(int(connection.length));
         }
-        if (socket->bytesAvailable() >= qint64(sizeof(quint32)))
-            break;
-        socket->waitForReadyRead();
+        connection.message += socket->read(qint64(connection.length) - connection.message.size());
+        if (connection.message.size() < int(connection.length))
+            return;
+        const QByteArray message = connection.message;
+        connection.haveLength = false;
+        connection.message.clear();
+        if (!framePrefix.isEmpty() && message.startsWith(framePrefix)) {
+            emit frameReceived(connection.client, message);
+            continue;
+        }
+        // The client disconnects once it has read the ack, which then
+        // deletes the socket.
+        socket->write(ack, qstrlen(ack));
+        emit messageReceived(QString::fromUtf8(message));
     }
+}
 
+
+bool QtLocalPeer::sendFrame(quint64 client, const QByteArray &frame)
+{
+    // The client may have gone away since its request arrived.
+    QLocalSocket* socket = clients.value(client);
+    if (!socket)
+        return false;
     QDataStream ds(socket);
-    QByteArray uMsg;
-    quint32 remaining;
-    ds >> remaining;
-    uMsg.resize(remaining);
-    int got = 0;
-    char* uMsgBuf = uMsg.data();
-    do {
-        got = ds.readRawData(uMsgBuf, remaining);
-        remaining -= got;
-        uMsgBuf += got;
-    } while (remaining && got >= 0 && socket->waitForReadyRead(2000));
-    if (got < 0) {
-        qWarning("QtLocalPeer: Message reception failed %s", socket->errorString().toLatin1().constData());
-        delete socket;
+    ds.writeBytes(frame.constData(), uint(frame.size()));
+    socket->flush();
+    return true;
+}
+
+
+void QtLocalPeer::dropConnection(QLocalSocket* socket)
+{
+    auto it = connections.find(socket);
+    if (it == connections.end())
         return;
+    const quint64 client = it.value().client;
+    connections.erase(it);
+    clients.remove(client);
+    socket->deleteLater();
+    if (connections.isEmpty())
+        idleTimer->stop();
+    emit clientDisconnected(client);
+}
+
+
+void QtLocalPeer::dropIdleConnections()
+{
+    // Clients that stop talking halfway are disconnected.
+    QList<QLocalSocket*> idleSockets;
+    for (auto it = connections.cbegin(); it != connections.cend(); ++it)
+        if (it.value().idle.hasExpired(idleTimeout))
+            idleSockets.append(it.key());
+    for (QLocalSocket* socket : qAsConst(idleSockets)) {
+        socket->abort();
+        dropConnection(socket);
     }
-    QString message(QString::fromUtf8(uMsg));
-    socket->write(ack, qstrlen(ack));
-    socket->waitForBytesWritten(1000);
-    socket->waitForDisconnected(1000); // make sure client reads ack
-    delete socket;
-    emit messageReceived(message); //### (might take a long time to return)
 }
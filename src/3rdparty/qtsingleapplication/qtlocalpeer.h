@@ -41,8 +41,12 @@
 #pragma once
 
 #include <QDir>
+#include <QElapsedTimer>
+#include <QHash>
 
 QT_FORWARD_DECLARE_CLASS(QLocalServer)
+QT_FORWARD_DECLARE_CLASS(QLocalSocket)
+QT_FORWARD_DECLARE_CLASS(QTimer)
 
 #include "qtlockedfile.h"
 
@@ -53,21 +57,54 @@ class QtLocalPeer : public QObject
 public:
     QtLocalPeer(QObject *parent = nullptr, QString appId = QString());
     bool isClient();
+    bool isLockedByOther();
     bool sendMessage(const QString &message, int timeout);
     QString applicationId() const
         { return id; }
+    QString serverName() const
+        { return socketName; }
+    void setFramePrefix(const QByteArray &prefix)
+        { framePrefix = prefix; }
+    bool sendFrame(quint64 client, const QByteArray &frame);
 
 Q_SIGNALS:
     void messageReceived(const QString &message);
+    // Messages starting with the frame prefix are binary, they are
+    // neither converted nor acknowledged. Client ids are never reused.
+    void frameReceived(quint64 client, const QByteArray &frame);
+    void clientDisconnected(quint64 client);
 
 protected Q_SLOTS:
     void receiveConnection();
 
+protected:
+    // Each client is served by its own small state machine driven by
+    // readyRead(), so slow or many clients never block the event loop.
+    struct Connection
+    {
+        quint64 client = 0;
+        bool haveLength = false;
+        quint32 length = 0;
+        QByteArray message;
+        QElapsedTimer idle;
+    };
+
+    void readFromSocket(QLocalSocket *socket);
+    void dropConnection(QLocalSocket *socket);
+    void dropIdleConnections();
+
 protected:
     QString id;
     QString socketName;
     QLocalServer* server = nullptr;
     QtLP_Private::QtLockedFile lockFile;
+    QHash<QLocalSocket *, Connection> connections;
+    // Sockets are deleted later and their addresses reused, replies are
+    // addressed by id.
+    QHash<quint64, QLocalSocket *> clients;
+    quint64 lastClient = 0;
+    QTimer* idleTimer = nullptr;
+    QByteArray framePrefix;
 
 private:
     static const char* ack;
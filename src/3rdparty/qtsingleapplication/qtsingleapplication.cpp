@@ -138,6 +138,9 @@ void QtSingleApplication::sysInit(const QString &appId)
     actWin = nullptr;
     peer = new QtLocalPeer(this, appId);
     connect(peer, &QtLocalPeer::messageReceived, this, &QtSingleApplication::messageReceived);
+    // Direct, so that frames are emitted on the thread serving the channel.
+    connect(peer, &QtLocalPeer::frameReceived, this, &QtSingleApplication::frameReceived, Qt::DirectConnection);
+    connect(peer, &QtLocalPeer::clientDisconnected, this, &QtSingleApplication::clientDisconnected, Qt::DirectConnection);
 }
 
 
@@ -170,6 +173,27 @@ QtSingleApplication::QtSingleApplication(const QString &appId, int &argc, char *
     sysInit(appId);
 }
 
+/*!
+    Sends \a message to the running instance with the application
+    identifier \a id. Returns false if there is no such instance or it
+    did not process the message within \a timeout milliseconds.
+
+    Unlike sendMessage(), this function does not need a
+    QtSingleApplication object, so a second instance can be detected
+    before the settings and the GUI are initialized. It never claims
+    the instance lock, construct the application afterwards and check
+    isRunning() as usual to settle simultaneous launches.
+*/
+
+bool QtSingleApplication::sendToRunningInstance(const QString &id, const QString &message, int timeout)
+{
+    QtLocalPeer peer(nullptr, id);
+    if (!peer.isLockedByOther())
+        return false;
+    return peer.sendMessage(message, timeout);
+}
+
+
 /*!
     Returns true if another instance of this application is running;
     otherwise false.
@@ -216,6 +240,55 @@ QString QtSingleApplication::id() const
 }
 
 
+/*!
+    Returns the name of the local socket the running instance listens
+    on, so that other programs can talk to it directly.
+*/
+QString QtSingleApplication::serverName() const
+{
+    return peer->serverName();
+}
+
+
+/*!
+    Messages starting with \a prefix are treated as binary frames: they
+    are emitted through frameReceived() instead of messageReceived() and
+    are not acknowledged, the receiver answers with sendFrame().
+    clientDisconnected() tells when a client's id goes out of use.
+*/
+void QtSingleApplication::setFramePrefix(const QByteArray &prefix)
+{
+    peer->setFramePrefix(prefix);
+}
+
+
+/*!
+    Serves the channel on \a thread: frameReceived() and
+    clientDisconnected() are emitted there and sendFrame() must be called
+    there. Messages are still delivered on the application's thread. Call
+    it on the thread currently serving the channel, moving it back to the
+    application's thread makes the application own it again.
+*/
+void QtSingleApplication::moveChannelToThread(QThread *thread)
+{
+    // Objects with a parent can't change threads.
+    peer->setParent(nullptr);
+    peer->moveToThread(thread);
+    if (thread == this->thread())
+        peer->setParent(this);
+}
+
+
+/*!
+    Sends the binary \a frame to the \a client a frame was received
+    from. Returns false if that client has disconnected.
+*/
+bool QtSingleApplication::sendFrame(quint64 client, const QByteArray &frame)
+{
+    return peer->sendFrame(client, frame);
+}
+
+
 /*!
   Sets the activation window of this application to \a aw. The
   activation window is the widget that will be activated by
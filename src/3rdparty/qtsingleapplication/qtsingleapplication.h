@@ -52,8 +52,13 @@ public:
     QtSingleApplication(int &argc, char **argv, bool GUIenabled = true);
     QtSingleApplication(const QString &id, int &argc, char **argv);
 
+    static bool sendToRunningInstance(const QString &id, const QString &message, int timeout = 5000);
+
     bool isRunning();
     QString id() const;
+    QString serverName() const;
+    void setFramePrefix(const QByteArray &prefix);
+    void moveChannelToThread(QThread *thread);
 
     void setActivationWindow(QWidget* aw, bool activateOnMessage = true);
     QWidget* activationWindow() const;
@@ -64,11 +69,14 @@ public:
 
 public Q_SLOTS:
     bool sendMessage(const QString &message, int timeout = 5000);
+    bool sendFrame(quint64 client, const QByteArray &frame);
     void activateWindow();
 
 
 Q_SIGNALS:
     void messageReceived(const QString &message);
+    void frameReceived(quint64 client, const QByteArray &frame);
+    void clientDisconnected(quint64 client);
 
 
 private:
@@ -0,0 +1,14 @@
+TARGET = DDCtl
+# Only QtCore and QtNetwork (for QLocalSocket), so sending a command
+# does not pay for loading the GUI libraries.
+QT = core network
+CONFIG *= console
+TEMPLATE = app
+include(../common.pri)
+LIBS *= -lPsapi
+INCLUDEPATH *= ../ddmain
+DEPENDPATH *= ../ddmain
+HEADERS *= ../ddmain/controlprotocol.h
+SOURCES *= \
+    main.cpp \
+    ../ddmain/controlprotocol.cpp
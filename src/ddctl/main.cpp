@@ -0,0 +1,351 @@
+#include "controlprotocol.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QTextStream>
+#include <QVector>
+
+#include <Windows.h>
+#include <Psapi.h>
+
+#include <algorithm>
+
+const int kTimeout = 5000;
+
+struct CommandInfo
+{
+    const char *name;
+    ControlProtocol::Command command;
+    bool hasArgument;
+};
+
+const CommandInfo kCommands[] =
+{
+    {"ping", ControlProtocol::Ping, false},
+    {"show", ControlProtocol::Show, false},
+    {"play", ControlProtocol::Play, false},
+    {"pause", ControlProtocol::Pause, false},
+    {"seek", ControlProtocol::Seek, true},
+    {"seturl", ControlProtocol::SetUrl, true},
+    {"next", ControlProtocol::Next, false},
+    {"stats", ControlProtocol::Stats, false},
+    {"metrics", ControlProtocol::Metrics, false},
+    {"stages", ControlProtocol::Stages, false},
+    {"overlay", ControlProtocol::DebugOverlay, true}
+};
+
+enum ExitCode
+{
+    Success,
+    RequestFailed,
+    NotRunning
+};
+
+static QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+static QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+static const CommandInfo *findCommand(const QString &name)
+{
+    for (const auto &info : kCommands)
+        if (name.compare(QLatin1String(info.name), Qt::CaseInsensitive) == 0)
+            return &info;
+    return nullptr;
+}
+
+// Turns "seek 1000 play" or the lines of a batch file into requests.
+static bool parseCommands(const QStringList &tokens, QVector<ControlProtocol::Message> *requests)
+{
+    for (int i = 0; i != tokens.count(); ++i)
+    {
+        const CommandInfo *info = findCommand(tokens.at(i));
+        if (info == nullptr)
+        {
+            err() << "Unknown command: " << tokens.at(i) << endl;
+            return false;
+        }
+        ControlProtocol::Message request;
+        request.command = info->command;
+        request.id = static_cast<quint32>(requests->count() + 1);
+        if (info->hasArgument)
+        {
+            if (++i == tokens.count())
+            {
+                err() << "Missing argument for: " << info->name << endl;
+                return false;
+            }
+            if (info->command == ControlProtocol::Seek)
+            {
+                bool ok = false;
+                request.value = tokens.at(i).toLongLong(&ok);
+                if (!ok)
+                {
+                    err() << "Not a position in milliseconds: " << tokens.at(i) << endl;
+                    return false;
+                }
+            }
+            else if (info->command == ControlProtocol::DebugOverlay)
+            {
+                const QString state = tokens.at(i).toLower();
+                if (state == QLatin1String("on"))
+                    request.value = true;
+                else if (state == QLatin1String("off"))
+                    request.value = false;
+                else if (state != QLatin1String("toggle"))
+                {
+                    err() << "Not one of on, off or toggle: " << tokens.at(i) << endl;
+                    return false;
+                }
+            }
+            else
+                request.value = tokens.at(i);
+        }
+        requests->append(request);
+    }
+    return true;
+}
+
+static bool readBatch(const QString &fileName, QVector<ControlProtocol::Message> *requests)
+{
+    QFile file(fileName);
+    bool opened = false;
+    if (fileName == QLatin1String("-"))
+        opened = file.open(stdin, QIODevice::ReadOnly | QIODevice::Text);
+    else
+        opened = file.open(QIODevice::ReadOnly | QIODevice::Text);
+    if (!opened)
+    {
+        err() << "Can't open batch file: " << fileName << endl;
+        return false;
+    }
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    QString line;
+    while (stream.readLineInto(&line))
+    {
+        line = line.trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')))
+            continue;
+        // Urls may contain spaces, so everything after the command is
+        // one argument.
+        const int space = line.indexOf(QLatin1Char(' '));
+        QStringList tokens(line.left(space));
+        if (space > 0)
+            tokens.append(line.mid(space + 1).trimmed());
+        if (!parseCommands(tokens, requests))
+            return false;
+    }
+    return true;
+}
+
+static bool connectToInstance(QLocalSocket *socket)
+{
+    socket->connectToServer(ControlProtocol::serverName());
+    if (socket->waitForConnected(kTimeout))
+        return true;
+    err() << "Dynamic Desktop is not running." << endl;
+    return false;
+}
+
+// Writes all requests at once and collects the responses afterwards, the
+// server answers them in order.
+static bool exchange(QLocalSocket *socket, const QVector<ControlProtocol::Message> &requests, QVector<ControlProtocol::Message> *responses)
+{
+    QByteArray data;
+    for (const auto &request : requests)
+        data += ControlProtocol::frame(ControlProtocol::encodeRequest(request));
+    socket->write(data);
+    QByteArray buffer, payload;
+    while (responses->count() < requests.count())
+    {
+        if (!ControlProtocol::takeFrame(&buffer, &payload))
+        {
+            if (!socket->waitForReadyRead(kTimeout))
+            {
+                err() << "No response from Dynamic Desktop: " << socket->errorString() << endl;
+                return false;
+            }
+            buffer += socket->readAll();
+            continue;
+        }
+        ControlProtocol::Message response;
+        if (!ControlProtocol::decodeResponse(payload, &response))
+        {
+            err() << "Malformed response." << endl;
+            return false;
+        }
+        responses->append(response);
+    }
+    return true;
+}
+
+static bool printResponse(const ControlProtocol::Message &response)
+{
+    switch (response.status)
+    {
+    case ControlProtocol::Ok:
+        break;
+    case ControlProtocol::UnknownCommand:
+        err() << "Request " << response.id << ": unknown command." << endl;
+        return false;
+    case ControlProtocol::UnsupportedVersion:
+        err() << "Request " << response.id << ": Dynamic Desktop only speaks protocol version " << response.value.toUInt() << '.' << endl;
+        return false;
+    default:
+        err() << "Request " << response.id << ": bad request." << endl;
+        return false;
+    }
+    if (response.value.type() == QVariant::Hash)
+    {
+        const QVariantHash values = response.value.toHash();
+        QStringList keys = values.keys();
+        keys.sort();
+        for (const auto &key : keys)
+            out() << key << ": " << values.value(key).toString() << endl;
+    }
+    else if (response.value.isValid())
+    {
+        // Multi-line answers like the metrics end with a line break already.
+        const QString text = response.value.toString();
+        out() << text;
+        if (!text.endsWith(QLatin1Char('\n')))
+            out() << endl;
+        else
+            out().flush();
+    }
+    return true;
+}
+
+static QString summary(QVector<qint64> samples, const char *unit, double scale)
+{
+    if (samples.isEmpty())
+        return QStringLiteral("no samples");
+    std::sort(samples.begin(), samples.end());
+    return QStringLiteral("min %0 %3, median %1 %3, max %2 %3")
+            .arg(samples.constFirst() / scale, 0, 'f', 2)
+            .arg(samples.at(samples.count() / 2) / scale, 0, 'f', 2)
+            .arg(samples.constLast() / scale, 0, 'f', 2)
+            .arg(QLatin1String(unit));
+}
+
+// Launches the program count times in a row and prints the wall time
+// until each process exited and the peak working set it reached.
+static void timeLaunches(const QString &name, const QString &program, const QString &arguments, int count)
+{
+    QVector<qint64> times, memory;
+    for (int i = 0; i != count; ++i)
+    {
+        QString commandLine = QLatin1Char('"') + QDir::toNativeSeparators(program) + QLatin1Char('"');
+        if (!arguments.isEmpty())
+            commandLine += QLatin1Char(' ') + arguments;
+        STARTUPINFOW startupInfo;
+        SecureZeroMemory(&startupInfo, sizeof(startupInfo));
+        startupInfo.cb = sizeof(startupInfo);
+        PROCESS_INFORMATION processInfo;
+        SecureZeroMemory(&processInfo, sizeof(processInfo));
+        QElapsedTimer timer;
+        timer.start();
+        if (CreateProcessW(nullptr, reinterpret_cast<LPWSTR>(commandLine.data()), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo) == FALSE)
+            break;
+        const bool exited = WaitForSingleObject(processInfo.hProcess, kTimeout * 2) == WAIT_OBJECT_0;
+        if (exited)
+        {
+            times.append(timer.nsecsElapsed() / 1000);
+            PROCESS_MEMORY_COUNTERS counters;
+            if (GetProcessMemoryInfo(processInfo.hProcess, &counters, sizeof(counters)) != FALSE)
+                memory.append(static_cast<qint64>(counters.PeakWorkingSetSize));
+        }
+        else
+            TerminateProcess(processInfo.hProcess, 1);
+        CloseHandle(processInfo.hThread);
+        CloseHandle(processInfo.hProcess);
+        if (!exited)
+            break;
+    }
+    out() << name << ": " << summary(times, "ms", 1000.0) << endl;
+    out() << name << " peak working set: " << summary(memory, "MiB", 1024.0 * 1024.0) << endl;
+}
+
+// Compares launching this client with the old way of talking to a
+// running instance: starting DDMain again, which hands its "show"
+// message over and exits. Both need a running instance, and every
+// DDMain launch brings up its options window.
+static int benchmark(int count)
+{
+    QLocalSocket socket;
+    if (!connectToInstance(&socket))
+        return NotRunning;
+    QVector<ControlProtocol::Message> requests, responses;
+    for (int i = 0; i != count; ++i)
+    {
+        ControlProtocol::Message request;
+        request.id = static_cast<quint32>(i + 1);
+        requests.append(request);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    if (!exchange(&socket, requests, &responses))
+        return RequestFailed;
+    const qint64 elapsed = qMax(timer.nsecsElapsed(), Q_INT64_C(1));
+    out() << count << " pipelined pings: " << elapsed / 1000000.0 << " ms, "
+          << qRound64(count * 1e9 / elapsed) << " commands/s" << endl;
+    socket.disconnectFromServer();
+    timeLaunches(QStringLiteral("DDCtl ping"), QCoreApplication::applicationFilePath(), QStringLiteral("ping"), count);
+    QString mainPath = QCoreApplication::applicationDirPath() + QStringLiteral("/DDMain");
+#ifdef _DEBUG
+    mainPath += QStringLiteral("d");
+#endif
+    mainPath += QStringLiteral(".exe");
+    if (QFileInfo::exists(mainPath))
+        timeLaunches(QStringLiteral("DDMain second instance"), mainPath, QString(), count);
+    else
+        err() << "Can't find " << QDir::toNativeSeparators(mainPath) << ", skipped the second instance launch." << endl;
+    return Success;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("DDCtl"));
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Controls a running Dynamic Desktop.\n\nCommands: ping, show, play, pause, seek <milliseconds>, seturl <url>, next, stats, metrics, stages, overlay <on|off|toggle>."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("commands"), QStringLiteral("The commands to send, in order."), QStringLiteral("[command [argument]]..."));
+    const QCommandLineOption batchOption(QStringLiteral("batch"), QStringLiteral("Read one command per line from <file>, \"-\" is the standard input."), QStringLiteral("file"));
+    parser.addOption(batchOption);
+    const QCommandLineOption benchmarkOption(QStringLiteral("benchmark"), QStringLiteral("Measure <count> pipelined requests and launches of this client and of DDMain."), QStringLiteral("count"));
+    parser.addOption(benchmarkOption);
+    parser.process(app);
+    if (parser.isSet(benchmarkOption))
+        return benchmark(qMax(parser.value(benchmarkOption).toInt(), 1));
+    QVector<ControlProtocol::Message> requests, responses;
+    if (parser.isSet(batchOption) && !readBatch(parser.value(batchOption), &requests))
+        return RequestFailed;
+    if (!parseCommands(parser.positionalArguments(), &requests))
+        return RequestFailed;
+    if (requests.isEmpty())
+        parser.showHelp(RequestFailed);
+    QLocalSocket socket;
+    if (!connectToInstance(&socket))
+        return NotRunning;
+    if (!exchange(&socket, requests, &responses))
+        return RequestFailed;
+    int exitCode = Success;
+    for (const auto &response : responses)
+        if (!printResponse(response))
+            exitCode = RequestFailed;
+    return exitCode;
+}
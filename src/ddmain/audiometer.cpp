@@ -0,0 +1,85 @@
+#include "audiometer.h"
+#include "utils.h"
+
+#include <Windows.h>
+
+AudioMeter::AudioMeter(QObject *parent) : QtAV::AudioFilter(parent)
+{
+    segmentClock.start();
+}
+
+void AudioMeter::setSuspended(bool suspended)
+{
+    QMutexLocker locker(&mutex);
+    if (this->suspended == suspended)
+        return;
+    closeSegment();
+    this->suspended = suspended;
+}
+
+qint64 AudioMeter::cpuSaved() const
+{
+    return statistics().value(QStringLiteral("audio.cpuSaved")).toLongLong();
+}
+
+QVariantHash AudioMeter::statistics() const
+{
+    QMutexLocker locker(&mutex);
+    qint64 active = activeTime, activeUsed = activeCpu;
+    qint64 suspendedFor = suspendedTime, suspendedUsed = suspendedCpu;
+    // Include the running segment without closing it.
+    const quint32 thread = threadId.load();
+    const qint64 cpu = thread != 0 ? Utils::getThreadCpuTime(thread) : 0;
+    const qint64 segmentUsed = qMax<qint64>(0, cpu - segmentCpu);
+    if (suspended)
+    {
+        suspendedFor += segmentClock.elapsed();
+        suspendedUsed += segmentUsed;
+    }
+    else
+    {
+        active += segmentClock.elapsed();
+        activeUsed += segmentUsed;
+    }
+    // Milliseconds of CPU time per second of running audio.
+    const qreal rate = active > 0 ? activeUsed * 1000.0 / active : 0.0;
+    QVariantHash stats;
+    stats[QStringLiteral("audio.suspended")] = suspended;
+    stats[QStringLiteral("audio.cpuPerSecond")] = rate;
+    stats[QStringLiteral("audio.suspendedTime")] = suspendedFor;
+    stats[QStringLiteral("audio.cpuSaved")] = qMax<qint64>(0, qRound64(rate * suspendedFor / 1000.0) - suspendedUsed);
+    return stats;
+}
+
+void AudioMeter::process(QtAV::Statistics *statistics, QtAV::AudioFrame *frame)
+{
+    Q_UNUSED(statistics)
+    Q_UNUSED(frame)
+    const quint32 thread = GetCurrentThreadId();
+    if (threadId.load() == thread)
+        return;
+    QMutexLocker locker(&mutex);
+    // A new audio thread starts counting from zero.
+    closeSegment();
+    threadId.store(thread);
+    segmentCpu = 0;
+}
+
+void AudioMeter::closeSegment()
+{
+    const qint64 elapsed = segmentClock.restart();
+    const quint32 thread = threadId.load();
+    const qint64 cpu = thread != 0 ? Utils::getThreadCpuTime(thread) : 0;
+    const qint64 used = qMax<qint64>(0, cpu - segmentCpu);
+    segmentCpu = cpu;
+    if (suspended)
+    {
+        suspendedTime += elapsed;
+        suspendedCpu += used;
+    }
+    else
+    {
+        activeTime += elapsed;
+        activeCpu += used;
+    }
+}
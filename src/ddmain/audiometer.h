@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QtAV/Filter.h>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVariantHash>
+
+// Measures what the audio pipeline costs and what suspending it saves.
+// The filter only learns the id of the audio thread, its CPU time is read
+// on the GUI thread. While the pipeline runs, its CPU time per second is
+// averaged; while it's suspended, that rate times the suspended time,
+// minus what the idle thread still used, is the CPU time saved.
+class AudioMeter : public QtAV::AudioFilter
+{
+    Q_OBJECT
+
+public:
+    explicit AudioMeter(QObject *parent = nullptr);
+
+public:
+    void setSuspended(bool suspended = true);
+    // Milliseconds.
+    qint64 cpuSaved() const;
+    QVariantHash statistics() const;
+
+protected:
+    void process(QtAV::Statistics *statistics, QtAV::AudioFrame *frame) override;
+
+private:
+    void closeSegment();
+
+private:
+    QAtomicInteger<quint32> threadId = 0;
+    mutable QMutex mutex;
+    QElapsedTimer segmentClock;
+    qint64 segmentCpu = 0;
+    bool suspended = false;
+    qint64 activeTime = 0, activeCpu = 0;
+    qint64 suspendedTime = 0, suspendedCpu = 0;
+
+private:
+    Q_DISABLE_COPY(AudioMeter)
+};
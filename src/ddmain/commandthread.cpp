@@ -0,0 +1,145 @@
+#include "commandthread.h"
+#include "histogram.h"
+
+#include <QAbstractEventDispatcher>
+#include <QElapsedTimer>
+
+const quint64 kIndexMask = 0xFFFFFFFFULL;
+const quint64 kTagIncrement = 0x100000000ULL;
+
+static qint64 now()
+{
+    static QElapsedTimer clock;
+    static const bool started = (clock.start(), true);
+    Q_UNUSED(started)
+    return clock.nsecsElapsed() / 1000;
+}
+
+CommandThread::CommandThread(QObject *parent) : QThread(parent)
+{
+    for (quint32 i = 0; i < kPoolSize; ++i)
+        pool[i].nextFree.store(i + 1 < kPoolSize ? i + 2 : 0);
+    freeList.store(1);
+    tail = allocate();
+    head.store(tail);
+    now();
+}
+
+CommandThread::~CommandThread()
+{
+    quit();
+    wait();
+    while (Node *next = tail->next.loadAcquire())
+    {
+        release(tail);
+        tail = next;
+    }
+    release(tail);
+}
+
+void CommandThread::post(Function function)
+{
+    Node *node = allocate();
+    node->function = std::move(function);
+    node->posted = now();
+    node->next.store(nullptr);
+    Node *previous = head.fetchAndStoreOrdered(node);
+    previous->next.storeRelease(node);
+    // Only after linking, otherwise drain() could miss the node.
+    if (wakePending.testAndSetOrdered(0, 1))
+    {
+        QAbstractEventDispatcher *eventDispatcher = dispatcher.loadAcquire();
+        if (eventDispatcher)
+            eventDispatcher->wakeUp();
+    }
+}
+
+void CommandThread::setLatencyHistogram(Histogram *histogram)
+{
+    latency = histogram;
+}
+
+quint64 CommandThread::executed() const
+{
+    return executedCount.load();
+}
+
+quint64 CommandThread::overflows() const
+{
+    return overflowCount.load();
+}
+
+void CommandThread::run()
+{
+    QAbstractEventDispatcher *eventDispatcher = QThread::eventDispatcher();
+    // Direct connections, both are emitted on this thread: awake() after
+    // every wake up, aboutToBlock() before the thread goes to sleep.
+    connect(eventDispatcher, &QAbstractEventDispatcher::awake, eventDispatcher, [this] { drain(); }, Qt::DirectConnection);
+    connect(eventDispatcher, &QAbstractEventDispatcher::aboutToBlock, eventDispatcher, [this] { drain(); }, Qt::DirectConnection);
+    dispatcher.storeRelease(eventDispatcher);
+    // What was posted before the thread started.
+    drain();
+    exec();
+    dispatcher.storeRelease(nullptr);
+    disconnect(eventDispatcher, nullptr, eventDispatcher, nullptr);
+}
+
+CommandThread::Node *CommandThread::allocate()
+{
+    quint64 top = freeList.loadAcquire();
+    while (true)
+    {
+        const quint32 index = static_cast<quint32>(top & kIndexMask);
+        if (index == 0)
+        {
+            overflowCount.fetchAndAddRelaxed(1);
+            return new Node();
+        }
+        Node *node = &pool[index - 1];
+        // If another producer takes the node meanwhile, the tag changes
+        // and the swap fails, a stale link is never installed.
+        const quint64 next = ((top & ~kIndexMask) + kTagIncrement) | node->nextFree.load();
+        if (freeList.testAndSetOrdered(top, next, top))
+            return node;
+    }
+}
+
+void CommandThread::release(Node *node)
+{
+    // Only ever called by the consumer.
+    node->function = nullptr;
+    if ((node < pool) || (node >= pool + kPoolSize))
+    {
+        delete node;
+        return;
+    }
+    const quint32 index = static_cast<quint32>(node - pool) + 1;
+    quint64 top = freeList.loadAcquire();
+    do
+        node->nextFree.store(static_cast<quint32>(top & kIndexMask));
+    while (!freeList.testAndSetOrdered(top, (top & ~kIndexMask) | index, top));
+}
+
+void CommandThread::drain()
+{
+    // A function running a nested event loop must not run the functions
+    // posted after it before it returned.
+    if (draining)
+        return;
+    draining = true;
+    // Reset before draining: a node posted from now on wakes the thread
+    // again, one posted before is seen by the loop below.
+    wakePending.fetchAndStoreOrdered(0);
+    while (Node *next = tail->next.loadAcquire())
+    {
+        release(tail);
+        tail = next;
+        if (latency)
+            latency->record(now() - next->posted);
+        next->function();
+        // It stays around as the tail, drop what the function holds.
+        next->function = nullptr;
+        executedCount.fetchAndAddRelaxed(1);
+    }
+    draining = false;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QThread>
+
+#include <functional>
+
+QT_FORWARD_DECLARE_CLASS(QAbstractEventDispatcher)
+
+class Histogram;
+
+// A thread that runs functions posted from any other thread, in the order
+// they were posted, between the events of its own event loop: objects
+// moved to it get their signals and timers as usual. Posting takes no
+// lock. The queue is a multi-producer single-consumer linked list whose
+// nodes come from a fixed pool and go back to it once they ran, only a
+// burst larger than the pool allocates. The thread is woken through its
+// event dispatcher, which unlike a queued call doesn't lock an event
+// queue and doesn't allocate an event. Only needs QtCore.
+class CommandThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    using Function = std::function<void()>;
+
+    explicit CommandThread(QObject *parent = nullptr);
+    // Functions that didn't run by the time the thread finished are
+    // dropped.
+    ~CommandThread() override;
+
+public:
+    // Can be called from any thread, functions posted before start() run
+    // once the thread is up.
+    void post(Function function);
+    // Records the time from post() until the function starts, in
+    // microseconds. Set it before start().
+    void setLatencyHistogram(Histogram *histogram);
+    quint64 executed() const;
+    // Functions that found the pool empty and got a node of their own.
+    quint64 overflows() const;
+
+protected:
+    void run() override;
+
+private:
+    struct Node
+    {
+        Function function;
+        qint64 posted = 0;
+        QAtomicPointer<Node> next = nullptr;
+        // The next free node of the pool, as index + 1.
+        QAtomicInteger<quint32> nextFree = 0;
+    };
+
+    Node *allocate();
+    void release(Node *node);
+    void drain();
+
+private:
+    static const quint32 kPoolSize = 256;
+    Node pool[kPoolSize];
+    // Index + 1 of the first free node in the low half, the number of
+    // nodes taken so far in the high half. A node that was taken and given
+    // back between reading the list and swapping it changes the count, so
+    // that the swap fails (the ABA problem).
+    QAtomicInteger<quint64> freeList = 0;
+    // Producers swap themselves in at the head, the consumer follows the
+    // links from the tail, which always is a node that already ran (or the
+    // initial one).
+    QAtomicPointer<Node> head = nullptr;
+    Node *tail = nullptr;
+    QAtomicInt wakePending = 0;
+    QAtomicPointer<QAbstractEventDispatcher> dispatcher = nullptr;
+    bool draining = false;
+    Histogram *latency = nullptr;
+    QAtomicInteger<quint64> executedCount = 0;
+    QAtomicInteger<quint64> overflowCount = 0;
+
+private:
+    Q_DISABLE_COPY(CommandThread)
+};
@@ -0,0 +1,122 @@
+#include "controlprotocol.h"
+
+#include <QDataStream>
+#include <QRegExp>
+#include <QtEndian>
+
+#include <Windows.h>
+
+const int kHeaderSize = 10;
+const int kResponseHeaderSize = kHeaderSize + 1;
+
+namespace ControlProtocol
+{
+
+static QByteArray encode(const Message &message, bool response)
+{
+    QByteArray payload = magic();
+    payload.reserve(64);
+    payload.append(static_cast<char>(message.version));
+    payload.append(static_cast<char>(message.command));
+    char id[4];
+    qToBigEndian(message.id, id);
+    payload.append(id, 4);
+    if (response)
+        payload.append(static_cast<char>(message.status));
+    if (message.value.isValid())
+    {
+        QDataStream stream(&payload, QIODevice::WriteOnly | QIODevice::Append);
+        stream.setVersion(QDataStream::Qt_5_6);
+        stream << message.value;
+    }
+    return payload;
+}
+
+static bool decode(const QByteArray &payload, Message *message, bool response)
+{
+    const int headerSize = response ? kResponseHeaderSize : kHeaderSize;
+    if (!message || (payload.size() < headerSize) || !payload.startsWith(magic()))
+        return false;
+    const auto data = reinterpret_cast<const uchar *>(payload.constData());
+    message->version = data[4];
+    message->command = data[5];
+    message->id = qFromBigEndian<quint32>(data + 6);
+    message->status = response ? data[10] : static_cast<quint8>(Ok);
+    message->value.clear();
+    if (message->version > kVersion)
+        return true;
+    if (payload.size() > headerSize)
+    {
+        QDataStream stream(payload.mid(headerSize));
+        stream.setVersion(QDataStream::Qt_5_6);
+        stream >> message->value;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+    }
+    return true;
+}
+
+QString applicationId()
+{
+    return QStringLiteral("wangwenx190.DynamicDesktop.Main.1000.AppMutex");
+}
+
+QString serverName(const QString &appId)
+{
+    // Keep in sync with the QtLocalPeer constructor.
+    QString prefix = appId;
+    prefix.remove(QRegExp(QStringLiteral("[^a-zA-Z]")));
+    prefix.truncate(6);
+    const QByteArray id = appId.toUtf8();
+    const quint16 idNum = qChecksum(id.constData(), static_cast<uint>(id.size()));
+    DWORD sessionId = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &sessionId);
+    return QStringLiteral("qtsingleapp-") + prefix + QLatin1Char('-') + QString::number(idNum, 16)
+            + QLatin1Char('-') + QString::number(sessionId, 16);
+}
+
+QByteArray magic()
+{
+    return QByteArrayLiteral("DDCP");
+}
+
+QByteArray encodeRequest(const Message &request)
+{
+    return encode(request, false);
+}
+
+QByteArray encodeResponse(const Message &response)
+{
+    return encode(response, true);
+}
+
+bool decodeRequest(const QByteArray &payload, Message *request)
+{
+    return decode(payload, request, false);
+}
+
+bool decodeResponse(const QByteArray &payload, Message *response)
+{
+    return decode(payload, response, true);
+}
+
+QByteArray frame(const QByteArray &payload)
+{
+    QByteArray data(4, Qt::Uninitialized);
+    qToBigEndian(static_cast<quint32>(payload.size()), data.data());
+    return data + payload;
+}
+
+bool takeFrame(QByteArray *buffer, QByteArray *payload)
+{
+    if (!buffer || !payload || (buffer->size() < 4))
+        return false;
+    const quint32 length = qFromBigEndian<quint32>(buffer->constData());
+    if (static_cast<quint32>(buffer->size() - 4) < length)
+        return false;
+    *payload = buffer->mid(4, static_cast<int>(length));
+    buffer->remove(0, static_cast<int>(length) + 4);
+    return true;
+}
+
+}
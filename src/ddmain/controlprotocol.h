@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+// Binary commands sent over the single instance channel. Every message
+// keeps the channel's framing (a 32-bit big-endian length and the
+// payload). A payload starts with "DDCP", a version byte, the command and
+// a request id, followed by one argument serialized with QDataStream.
+// The running instance answers every request with a response carrying
+// the same request id, in the order the requests arrived, so clients
+// may pipeline as many requests as they like. Only needs QtCore.
+namespace ControlProtocol
+{
+
+const quint8 kVersion = 1;
+
+enum Command : quint8
+{
+    Ping,
+    Show,
+    Play,
+    Pause,
+    Seek,
+    SetUrl,
+    Next,
+    Stats,
+    Metrics,
+    Stages,
+    // A boolean shows or hides the overlay, no argument toggles it.
+    DebugOverlay
+};
+
+enum Status : quint8
+{
+    Ok,
+    UnknownCommand,
+    BadRequest,
+    UnsupportedVersion
+};
+
+struct Message
+{
+    quint8 version = kVersion;
+    quint8 command = Ping;
+    quint32 id = 0;
+    quint8 status = Ok;
+    QVariant value;
+};
+
+QString applicationId();
+// The name of the local socket QtSingleApplication listens on for the
+// given id in the current session.
+QString serverName(const QString &appId = applicationId());
+QByteArray magic();
+QByteArray encodeRequest(const Message &request);
+QByteArray encodeResponse(const Message &response);
+// The version and header are decoded even for newer versions, so that
+// the answer can tell the client which version to use.
+bool decodeRequest(const QByteArray &payload, Message *request);
+bool decodeResponse(const QByteArray &payload, Message *response);
+// Framing for clients that talk to the socket directly.
+QByteArray frame(const QByteArray &payload);
+bool takeFrame(QByteArray *buffer, QByteArray *payload);
+
+}
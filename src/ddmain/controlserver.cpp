@@ -0,0 +1,205 @@
+#include "controlserver.h"
+#include "metrics.h"
+#include "playbackcontroller.h"
+#include "playerwindow.h"
+#include "stagetiming.h"
+#include "forms/preferencesdialog.h"
+
+#include <QTimer>
+#include <QtSingleApplication>
+
+ControlServer::ControlServer(QtSingleApplication *app, PlayerWindow *playerWindow, PreferencesDialog *preferencesDialog)
+    : QObject(nullptr), app(app), playerWindow(playerWindow), preferencesDialog(preferencesDialog),
+      controller(playerWindow ? playerWindow->playbackController() : nullptr)
+{
+    requests = MetricsRegistry::getInstance()->counter("dd_control_requests_total", "Requests received over the control protocol.");
+    failures = MetricsRegistry::getInstance()->counter("dd_control_failures_total", "Control requests that could not be executed.");
+    if (app == nullptr)
+        return;
+    app->setFramePrefix(ControlProtocol::magic());
+    connect(app, &QtSingleApplication::frameReceived, this, &ControlServer::handleFrame);
+    connect(app, &QtSingleApplication::clientDisconnected, this, &ControlServer::dropClient);
+    thread.setObjectName(QStringLiteral("ControlServer"));
+    app->moveChannelToThread(&thread);
+    moveToThread(&thread);
+    thread.start();
+}
+
+ControlServer::~ControlServer()
+{
+    if (!thread.isRunning())
+        return;
+    QMetaObject::invokeMethod(this, "shutdown", Qt::BlockingQueuedConnection);
+    thread.wait();
+}
+
+QVariantHash ControlServer::statistics() const
+{
+    QVariantHash stats;
+    stats.insert(QStringLiteral("control.requests"), requests->value());
+    stats.insert(QStringLiteral("control.failures"), failures->value());
+    return stats;
+}
+
+void ControlServer::handleFrame(quint64 client, const QByteArray &frame)
+{
+    requests->add();
+    ControlProtocol::Message request;
+    ControlProtocol::Message response;
+    if (!ControlProtocol::decodeRequest(frame, &request))
+    {
+        // Without a header there is no request id to answer to.
+        failures->add();
+        return;
+    }
+    const quint64 sequence = ++nextSequence;
+    PendingResponse pendingResponse;
+    pendingResponse.sequence = sequence;
+    pending[client].append(pendingResponse);
+    response.id = request.id;
+    response.command = request.command;
+    if (request.version != ControlProtocol::kVersion)
+    {
+        response.status = ControlProtocol::UnsupportedVersion;
+        response.value = ControlProtocol::kVersion;
+    }
+    else if (controller == nullptr)
+        response.status = ControlProtocol::BadRequest;
+    else
+    {
+        switch (request.command)
+        {
+        case ControlProtocol::Ping:
+            response.value = request.value;
+            break;
+        case ControlProtocol::Show:
+            emit showRequested();
+            break;
+        case ControlProtocol::Play:
+            controller->play();
+            break;
+        case ControlProtocol::Pause:
+            controller->pause(QStringLiteral("user"));
+            break;
+        case ControlProtocol::Seek:
+        {
+            // canConvert() holds for any string, which would seek to 0.
+            bool ok = false;
+            const qint64 position = request.value.toLongLong(&ok);
+            if (ok && (position >= 0))
+                controller->seek(position);
+            else
+                response.status = ControlProtocol::BadRequest;
+            break;
+        }
+#ifndef DD_NO_STAGE_TIMING
+        case ControlProtocol::Stages:
+            response.value = QString::fromUtf8(StageTiming::dump());
+            break;
+#endif
+        case ControlProtocol::SetUrl:
+        case ControlProtocol::Next:
+        case ControlProtocol::Stats:
+        case ControlProtocol::Metrics:
+        case ControlProtocol::DebugOverlay:
+            // The response comes back once the GUI thread got to it, later
+            // requests of the client wait for it.
+            QTimer::singleShot(0, app.data(), [=]
+            {
+                ControlProtocol::Message guiResponse = response;
+                handleOnGui(request, &guiResponse);
+                QTimer::singleShot(0, this, [=]
+                {
+                    respond(client, sequence, guiResponse);
+                });
+            });
+            return;
+        default:
+            response.status = ControlProtocol::UnknownCommand;
+            break;
+        }
+    }
+    respond(client, sequence, response);
+}
+
+void ControlServer::dropClient(quint64 client)
+{
+    // Responses still on their way from the GUI thread find no entry and
+    // are discarded.
+    pending.remove(client);
+}
+
+void ControlServer::shutdown()
+{
+    QThread *guiThread = app->thread();
+    app->moveChannelToThread(guiThread);
+    moveToThread(guiThread);
+    thread.quit();
+}
+
+void ControlServer::handleOnGui(const ControlProtocol::Message &request, ControlProtocol::Message *response)
+{
+    if (playerWindow.isNull() || preferencesDialog.isNull())
+    {
+        response->status = ControlProtocol::BadRequest;
+        return;
+    }
+    switch (request.command)
+    {
+    case ControlProtocol::SetUrl:
+        if (!request.value.toString().isEmpty())
+            preferencesDialog->openUrl(request.value.toString());
+        else
+            response->status = ControlProtocol::BadRequest;
+        break;
+    case ControlProtocol::Next:
+        preferencesDialog->playNextMedia();
+        break;
+    case ControlProtocol::Stats:
+    {
+        QVariantHash stats = playerWindow->statistics();
+        stats.unite(statistics());
+        response->value = stats;
+        break;
+    }
+    case ControlProtocol::Metrics:
+        response->value = QString::fromUtf8(MetricsRegistry::getInstance()->prometheusText());
+        break;
+    case ControlProtocol::DebugOverlay:
+        if (request.value.isNull())
+            playerWindow->setDebugOverlay(!playerWindow->isDebugOverlayVisible());
+        else if (request.value.type() == QVariant::Bool)
+            playerWindow->setDebugOverlay(request.value.toBool());
+        else
+            response->status = ControlProtocol::BadRequest;
+        response->value = playerWindow->isDebugOverlayVisible();
+        break;
+    default:
+        response->status = ControlProtocol::UnknownCommand;
+        break;
+    }
+}
+
+void ControlServer::respond(quint64 client, quint64 sequence, const ControlProtocol::Message &response)
+{
+    if (response.status != ControlProtocol::Ok)
+        failures->add();
+    auto it = pending.find(client);
+    if (it == pending.end())
+        return;
+    for (auto &entry : *it)
+        if (entry.sequence == sequence)
+        {
+            entry.frame = ControlProtocol::encodeResponse(response);
+            break;
+        }
+    // Everything up to the first request still waiting for the GUI thread.
+    while (!it->isEmpty() && !it->constFirst().frame.isEmpty())
+    {
+        const QByteArray responseFrame = it->takeFirst().frame;
+        if (!app.isNull())
+            app->sendFrame(client, responseFrame);
+    }
+    if (it->isEmpty())
+        pending.erase(it);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "controlprotocol.h"
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QThread>
+#include <QVariantHash>
+
+class QtSingleApplication;
+class MetricCounter;
+class PlaybackController;
+class PlayerWindow;
+class PreferencesDialog;
+
+// Answers the binary control protocol on the single instance channel.
+// The channel is served on a thread of its own: playback commands go
+// straight to the playback controller and are answered while the GUI
+// thread is busy. Only what lives on the GUI thread (playlists, the
+// overlay, statistics and metrics) is handed over to it. Every request
+// gets a response, including unknown commands, and each client gets its
+// responses in the order it sent the requests.
+class ControlServer : public QObject
+{
+    Q_OBJECT
+
+signals:
+    // Emitted on the server's thread.
+    void showRequested();
+
+public:
+    explicit ControlServer(QtSingleApplication *app, PlayerWindow *playerWindow, PreferencesDialog *preferencesDialog);
+    // Gives the channel back to the GUI thread.
+    ~ControlServer() override;
+
+public:
+    QVariantHash statistics() const;
+
+private slots:
+    void handleFrame(quint64 client, const QByteArray &frame);
+    void dropClient(quint64 client);
+    void shutdown();
+
+private:
+    struct PendingResponse
+    {
+        quint64 sequence = 0;
+        QByteArray frame;
+    };
+
+    // Runs on the GUI thread.
+    void handleOnGui(const ControlProtocol::Message &request, ControlProtocol::Message *response);
+    void respond(quint64 client, quint64 sequence, const ControlProtocol::Message &response);
+
+private:
+    QThread thread;
+    QPointer<QtSingleApplication> app;
+    // Only dereferenced on the GUI thread.
+    QPointer<PlayerWindow> playerWindow;
+    QPointer<PreferencesDialog> preferencesDialog;
+    PlaybackController *controller = nullptr;
+    // Responses by client id, in the order of the client's requests.
+    QHash<quint64, QList<PendingResponse>> pending;
+    quint64 nextSequence = 0;
+    MetricCounter *requests = nullptr;
+    MetricCounter *failures = nullptr;
+
+private:
+    Q_DISABLE_COPY(ControlServer)
+};
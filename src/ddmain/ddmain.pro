@@ -21,10 +21,14 @@ CONFIG(static, static|shared) {
             -llibswresample -llibswscale -llibpostproc
     }
 }
+# libavformat is used directly to read the HDR metadata of video streams,
+# libswscale to downscale decoded frames.
+!CONFIG(static, static|shared)|!CONFIG(static_ffmpeg): LIBS *= -lavformat -lavutil -lswscale
 QT *= \
     widgets \
     network \
-    opengl
+    opengl \
+    concurrent
 !qtHaveModule(svg)|CONFIG(no_svg) {
     DEFINES *= DD_NO_SVG
     QT -= svg
@@ -92,9 +96,23 @@ QT *= \
 }
 versionAtLeast(QT_VERSION, 5.12.0):!qtConfig(commandlineparser): DEFINES *= DD_NO_COMMANDLINE_PARSER
 CONFIG(enable_libass): DEFINES *= DD_USE_LIBASS
+CONFIG(no_stage_timing) {
+    DEFINES *= DD_NO_STAGE_TIMING
+} else {
+    HEADERS *= stagetiming.h
+    SOURCES *= stagetiming.cpp
+}
+CONFIG(no_logging) {
+    DEFINES *= DD_NO_LOGGING
+} else {
+    HEADERS *= logger.h
+    SOURCES *= logger.cpp
+}
 LIBS *= \
     -lUser32 \
     -lDwmapi \
+    -lWinmm \
+    -lPsapi \
     -lShell32
 include(../ddutils/ddutils.pri)
 include(../3rdparty/qtniceframelesswindow/qtniceframelesswindow.pri)
@@ -105,19 +123,71 @@ include(../3rdparty/qtav/avwidgets.pri)
 HEADERS += \
     forms/preferencesdialog.h \
     forms/aboutdialog.h \
+    audiometer.h \
+    commandthread.h \
+    controlprotocol.h \
+    controlserver.h \
+    debugoverlay.h \
+    decodeprofile.h \
+    framepacer.h \
+    framescaler.h \
+    framesinkrenderer.h \
+    histogram.h \
+    mappedfileio.h \
+    metrics.h \
+    metricsserver.h \
+    pbouploader.h \
+    playbackcontroller.h \
     playerwindow.h \
+    qualitycontroller.h \
+    rendererwarmup.h \
     settingsmanager.h \
+    shadercache.h \
     slider.h \
+    softwarerenderer.h \
+    stallmonitor.h \
+    streamcache.h \
+    telemetry.h \
+    thumbnailmanager.h \
+    tonemapping.h \
     utils.h \
+    videoeffects.h \
+    yuvconverter.h \
     forms/playlistdialog.h
 SOURCES += \
     main.cpp \
     forms/preferencesdialog.cpp \
     forms/aboutdialog.cpp \
+    audiometer.cpp \
+    commandthread.cpp \
+    controlprotocol.cpp \
+    controlserver.cpp \
+    debugoverlay.cpp \
+    decodeprofile.cpp \
+    framepacer.cpp \
+    framescaler.cpp \
+    framesinkrenderer.cpp \
+    histogram.cpp \
+    mappedfileio.cpp \
+    metrics.cpp \
+    metricsserver.cpp \
+    pbouploader.cpp \
+    playbackcontroller.cpp \
     playerwindow.cpp \
+    qualitycontroller.cpp \
+    rendererwarmup.cpp \
     settingsmanager.cpp \
+    shadercache.cpp \
     slider.cpp \
+    softwarerenderer.cpp \
+    stallmonitor.cpp \
+    streamcache.cpp \
+    telemetry.cpp \
+    thumbnailmanager.cpp \
+    tonemapping.cpp \
     utils.cpp \
+    videoeffects.cpp \
+    yuvconverter.cpp \
     forms/playlistdialog.cpp
 FORMS += \
     forms/preferencesdialog.ui \
@@ -0,0 +1,105 @@
+#include "debugoverlay.h"
+#include "stagetiming.h"
+
+#include <QtAV/FilterContext.h>
+#include <QFontMetrics>
+#include <QPainter>
+
+const int kMargin = 16;
+const int kPadding = 8;
+
+static QString milliseconds(const QVariant &microseconds)
+{
+    return QString::number(microseconds.toReal() / 1000.0, 'f', 2);
+}
+
+DebugOverlay::DebugOverlay(QObject *parent) : QtAV::VideoFilter(parent)
+{
+}
+
+bool DebugOverlay::isSupported(QtAV::VideoFilterContext::Type type) const
+{
+    return (type == QtAV::VideoFilterContext::QtPainter) || (type == QtAV::VideoFilterContext::OpenGL);
+}
+
+void DebugOverlay::update(const QVariantHash &stats, const QSize &area)
+{
+    const qreal frameRate = stats.value(QStringLiteral("video.fps")).toReal();
+    const qreal displayFrameRate = stats.value(QStringLiteral("video.displayFps")).toReal();
+    const qreal dropped = frameRate > 0.0 ? qBound(0.0, 1.0 - displayFrameRate / frameRate, 1.0) : 0.0;
+    QStringList lines;
+    lines << QStringLiteral("fps %1 / %2  dropped %3%")
+             .arg(displayFrameRate, 0, 'f', 1).arg(frameRate, 0, 'f', 1).arg(dropped * 100.0, 0, 'f', 1);
+    if (stats.contains(QStringLiteral("pacing.late")))
+        lines << QStringLiteral("late %1  superseded %2  repeated %3  jitter p99 %4 ms")
+                 .arg(stats.value(QStringLiteral("pacing.late")).toULongLong())
+                 .arg(stats.value(QStringLiteral("pacing.superseded")).toULongLong())
+                 .arg(stats.value(QStringLiteral("pacing.repeated")).toULongLong())
+                 .arg(milliseconds(stats.value(QStringLiteral("pacing.jitterP99"))));
+    lines << QStringLiteral("decoder %1%2  copy %3")
+             .arg(stats.value(QStringLiteral("video.decoder")).toString(),
+                  stats.value(QStringLiteral("video.ecoDecoding")).toBool() ? QStringLiteral(" (eco)") : QString(),
+                  stats.value(QStringLiteral("video.copyMode")).toString());
+    lines << QStringLiteral("%1x%2 at %3%  renderer %4  quality %5")
+             .arg(stats.value(QStringLiteral("video.width")).toInt())
+             .arg(stats.value(QStringLiteral("video.height")).toInt())
+             .arg(qRound(stats.value(QStringLiteral("video.scaleFactor")).toReal() * 100.0))
+             .arg(stats.value(QStringLiteral("renderer.id")).toInt())
+             .arg(stats.value(QStringLiteral("quality.level")).toInt());
+#ifndef DD_NO_STAGE_TIMING
+    lines << QStringLiteral("stage         p50     p99     max (ms)");
+    for (int i = 0; i != StageTiming::StageCount; ++i)
+    {
+        const QString prefix = QStringLiteral("stage.") + QLatin1String(StageTiming::name(static_cast<StageTiming::Stage>(i)));
+        if (!stats.contains(prefix + QStringLiteral("P50")))
+            continue;
+        lines << QLatin1String(StageTiming::name(static_cast<StageTiming::Stage>(i))).leftJustified(10)
+                 + milliseconds(stats.value(prefix + QStringLiteral("P50"))).rightJustified(7)
+                 + milliseconds(stats.value(prefix + QStringLiteral("P99"))).rightJustified(8)
+                 + milliseconds(stats.value(prefix + QStringLiteral("Max"))).rightJustified(8);
+    }
+#endif
+    lines << QStringLiteral("gui stall p99 %1 ms  memory %2 MB")
+             .arg(milliseconds(stats.value(QStringLiteral("gui.stallP99"))))
+             .arg(stats.value(QStringLiteral("process.workingSet")).toULongLong() / (1024 * 1024));
+
+    QFont font(QStringLiteral("Consolas"));
+    font.setStyleHint(QFont::Monospace);
+    font.setPixelSize(14);
+    const QFontMetrics metrics(font);
+    int width = 0;
+    for (const QString &line : lines)
+        width = qMax(width, metrics.boundingRect(line).width());
+    const QSize size(width + 2 * kPadding, lines.count() * metrics.lineSpacing() + 2 * kPadding);
+    // A new image gets a new cacheKey, so the texture is uploaded once
+    // per update and reused by every frame in between.
+    image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(QColor(0, 0, 0, 160));
+    QPainter painter(&image);
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+    int y = kPadding + metrics.ascent();
+    for (const QString &line : lines)
+    {
+        painter.drawText(kPadding, y, line);
+        y += metrics.lineSpacing();
+    }
+    painter.end();
+    // Top right, the desktop icons usually take the left side.
+    position = QPoint(qMax(kMargin, area.width() - size.width() - kMargin), kMargin);
+}
+
+void DebugOverlay::clear()
+{
+    image = QImage();
+}
+
+void DebugOverlay::process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame)
+{
+    Q_UNUSED(statistics)
+    Q_UNUSED(frame)
+    QtAV::VideoFilterContext *filterContext = context();
+    if (!filterContext || image.isNull())
+        return;
+    filterContext->drawImage(position, image);
+}
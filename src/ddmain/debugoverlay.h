@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QtAV/Filter.h>
+#include <QImage>
+#include <QVariantHash>
+
+// Pipeline statistics drawn on top of the video by the renderer itself,
+// to see stutter on the machine it happens on. The text is rendered into
+// an image only when update() is called, a few times per second. Between
+// two updates every frame draws the very same image, which the OpenGL
+// paint engine keeps as a texture (its cache is keyed by the image's
+// cacheKey()), so a visible overlay costs one textured quad per frame.
+// A disabled filter is skipped by the renderer.
+class DebugOverlay : public QtAV::VideoFilter
+{
+    Q_OBJECT
+
+public:
+    explicit DebugOverlay(QObject *parent = nullptr);
+
+public:
+    bool isSupported(QtAV::VideoFilterContext::Type type) const override;
+    // Both are called on the GUI thread, which is where the renderer
+    // applies its filters.
+    void update(const QVariantHash &stats, const QSize &area);
+    void clear();
+
+protected:
+    void process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame) override;
+
+private:
+    QImage image;
+    QPoint position;
+
+private:
+    Q_DISABLE_COPY(DebugOverlay)
+};
@@ -0,0 +1,34 @@
+#include "decodeprofile.h"
+
+#include <QtAV/VideoDecoder.h>
+
+// Same values as FFmpeg's AVDiscard.
+const int kDiscardDefault = 0;
+const int kDiscardNonRef = 8;
+const int kDiscardAll = 48;
+
+namespace DecodeProfile
+{
+
+void addOptions(QVariantHash *options, bool eco)
+{
+    if (!options || !eco)
+        return;
+    QVariantHash ffmpeg_opt;
+    ffmpeg_opt[QStringLiteral("skip_loop_filter")] = kDiscardAll;
+    ffmpeg_opt[QStringLiteral("skip_frame")] = kDiscardNonRef;
+    (*options)[QStringLiteral("FFmpeg")] = ffmpeg_opt;
+    QVariantHash avcodec_opt;
+    avcodec_opt[QStringLiteral("flags2")] = QStringLiteral("+fast");
+    (*options)[QStringLiteral("avcodec")] = avcodec_opt;
+}
+
+void apply(QtAV::VideoDecoder *decoder, bool eco)
+{
+    if (!decoder || (decoder->name() != QLatin1String("FFmpeg")))
+        return;
+    decoder->setProperty("skip_loop_filter", eco ? kDiscardAll : kDiscardDefault);
+    decoder->setProperty("skip_frame", eco ? kDiscardNonRef : kDiscardDefault);
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QVariantHash>
+
+namespace QtAV
+{
+    QT_FORWARD_DECLARE_CLASS(VideoDecoder)
+}
+
+// Wallpapers don't need a bit exact picture. The eco profile has the
+// FFmpeg decoder skip the deblocking filter and non-reference frames and
+// allows non spec compliant speedups. Codecs ignore the options they
+// don't support.
+namespace DecodeProfile
+{
+
+// Adds the options of the profile to those passed to
+// AVPlayer::setOptionsForVideoCodec() or VideoDecoder::setOptions().
+void addOptions(QVariantHash *options, bool eco);
+// The skip options of a running FFmpeg decoder can be changed on the
+// fly, the fast flag needs the decoder to be reopened.
+void apply(QtAV::VideoDecoder *decoder, bool eco);
+
+}
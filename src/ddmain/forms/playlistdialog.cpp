@@ -1,6 +1,7 @@
 #include "playlistdialog.h"
 #include "ui_playlistdialog.h"
 #include "settingsmanager.h"
+#include "thumbnailmanager.h"
 #include "utils.h"
 
 #include <QInputDialog>
@@ -20,6 +21,8 @@ PlaylistDialog::PlaylistDialog(QWidget *parent) : CFramelessWindow(parent)
     addIgnoreWidget(ui->label_windowTitle);
     initIcons();
     Utils::enableBlurBehindWindow(this);
+    ui->listWidget_file->setIconSize(ThumbnailManager::getInstance()->thumbnailSize());
+    connect(ThumbnailManager::getInstance(), &ThumbnailManager::thumbnailReady, this, &PlaylistDialog::setThumbnail);
     connect(ui->pushButton_minimize, &QPushButton::clicked, this, &PlaylistDialog::showMinimized);
     connect(ui->pushButton_close, &QPushButton::clicked, this, &PlaylistDialog::close);
     currentPlaylist = SettingsManager::getInstance()->getCurrentPlaylistName();
@@ -102,6 +105,7 @@ PlaylistDialog::PlaylistDialog(QWidget *parent) : CFramelessWindow(parent)
             }
         if (changed)
         {
+            loadThumbnails();
             SettingsManager::getInstance()->setPlaylistFiles(currentPlaylist, getAllItems(ui->listWidget_file));
             emit this->dataRefreshed();
         }
@@ -123,6 +127,7 @@ PlaylistDialog::PlaylistDialog(QWidget *parent) : CFramelessWindow(parent)
                 setCurrentItem(ui->listWidget_file, input);
                 if (changed)
                 {
+                    loadThumbnails();
                     SettingsManager::getInstance()->setPlaylistFiles(currentPlaylist, getAllItems(ui->listWidget_file));
                     emit this->dataRefreshed();
                 }
@@ -189,6 +194,7 @@ void PlaylistDialog::populateFiles(const QString &name)
         ui->listWidget_file->clear();
     ui->listWidget_file->addItems(SettingsManager::getInstance()->getAllFilesFromPlaylist(name));
     setCurrentItem(ui->listWidget_file, SettingsManager::getInstance()->getLastFile());
+    loadThumbnails();
 }
 
 QStringList PlaylistDialog::getAllItems(QListWidget *listWidget)
@@ -310,3 +316,28 @@ void PlaylistDialog::initIcons()
     ui->pushButton_close->setIcon(QIcon(QStringLiteral(":/icons/close.png")));
 #endif
 }
+
+void PlaylistDialog::loadThumbnails()
+{
+    for (int i = 0; i != ui->listWidget_file->count(); ++i)
+    {
+        QListWidgetItem *item = ui->listWidget_file->item(i);
+        if (!item->icon().isNull())
+            continue;
+        const QImage image = ThumbnailManager::getInstance()->thumbnail(item->text());
+        if (image.isNull())
+            ThumbnailManager::getInstance()->requestThumbnail(item->text());
+        else
+            item->setIcon(QIcon(QPixmap::fromImage(image)));
+    }
+}
+
+void PlaylistDialog::setThumbnail(const QString &url, const QImage &image)
+{
+    if (url.isEmpty() || image.isNull())
+        return;
+    const int index = findItem(ui->listWidget_file, url);
+    if (index < 0)
+        return;
+    ui->listWidget_file->item(index)->setIcon(QIcon(QPixmap::fromImage(image)));
+}
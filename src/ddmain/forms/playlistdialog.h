@@ -40,6 +40,8 @@ private slots:
     void removePlaylist(const QString &name);
     void renamePlaylist(const QString &oldName, const QString &newName);
     void initIcons();
+    void loadThumbnails();
+    void setThumbnail(const QString &url, const QImage &image);
 
 private:
     Ui::PlaylistDialog *ui = nullptr;
@@ -130,19 +130,16 @@ void PreferencesDialog::setAudioAreaEnabled(bool available)
     ui->groupBox_audio->setEnabled(audioAvailable);
 }
 
-void PreferencesDialog::setVideoTracks(const QVariantList& videoTracks)
+void PreferencesDialog::setVideoTracks(const MediaTracks &videoTracks)
 {
     if (!videoTracks.isEmpty())
     {
         ui->comboBox_video_track->clear();
         for (const auto& track : videoTracks)
         {
-            QVariantMap trackData = track.toMap();
-            quint32 id = trackData[QStringLiteral("id")].toUInt();
-            QString lang = trackData[QStringLiteral("language")].toString();
-            QString title = trackData[QStringLiteral("title")].toString();
+            quint32 id = track.id.toUInt();
             QString txt = DD_TR("ID: %0 | Title: %1 | Language: %2")
-                    .arg(id).arg(title).arg(lang);
+                    .arg(id).arg(track.title).arg(track.language);
             ui->comboBox_video_track->addItem(txt, id);
         }
     }
@@ -152,7 +149,7 @@ void PreferencesDialog::setVideoTracks(const QVariantList& videoTracks)
         ui->comboBox_video_track->setEnabled(false);
 }
 
-void PreferencesDialog::setAudioTracks(const QVariantList& audioTracks, bool add)
+void PreferencesDialog::setAudioTracks(const MediaTracks &audioTracks, bool add)
 {
     if (!audioTracks.isEmpty())
     {
@@ -160,12 +157,9 @@ void PreferencesDialog::setAudioTracks(const QVariantList& audioTracks, bool add
             ui->comboBox_audio_track->clear();
         for (const auto& track : audioTracks)
         {
-            QVariantMap trackData = track.toMap();
-            quint32 id = trackData[QStringLiteral("id")].toUInt();
-            QString lang = trackData[QStringLiteral("language")].toString();
-            QString title = trackData[QStringLiteral("title")].toString();
+            quint32 id = track.id.toUInt();
             QString txt = DD_TR("ID: %0 | Title: %1 | Language: %2")
-                    .arg(id).arg(title).arg(lang);
+                    .arg(id).arg(track.title).arg(track.language);
             ui->comboBox_audio_track->addItem(txt, id);
         }
     }
@@ -175,7 +169,7 @@ void PreferencesDialog::setAudioTracks(const QVariantList& audioTracks, bool add
         ui->comboBox_audio_track->setEnabled(false);
 }
 
-void PreferencesDialog::setSubtitleTracks(const QVariantList& subtitleTracks, bool add)
+void PreferencesDialog::setSubtitleTracks(const MediaTracks &subtitleTracks, bool add)
 {
     if (!subtitleTracks.isEmpty())
     {
@@ -183,21 +177,17 @@ void PreferencesDialog::setSubtitleTracks(const QVariantList& subtitleTracks, bo
             ui->comboBox_subtitle_track->clear();
         for (const auto& track : subtitleTracks)
         {
-            QVariantMap trackData = track.toMap();
             if (!add)
             {
-                quint32 id = trackData[QStringLiteral("id")].toUInt();
-                QString lang = trackData[QStringLiteral("language")].toString();
-                QString title = trackData[QStringLiteral("title")].toString();
+                quint32 id = track.id.toUInt();
                 QString txt = DD_TR("ID: %0 | Title: %1 | Language: %2")
-                        .arg(id).arg(title).arg(lang);
+                        .arg(id).arg(track.title).arg(track.language);
                 ui->comboBox_subtitle_track->addItem(txt, id);
             }
             else
             {
-                QString file = trackData[QStringLiteral("file")].toString();
-                QString txt = DD_TR("File: %0").arg(QFileInfo(file).fileName());
-                ui->comboBox_subtitle_track->addItem(txt, file);
+                QString txt = DD_TR("File: %0").arg(QFileInfo(track.file).fileName());
+                ui->comboBox_subtitle_track->addItem(txt, track.file);
             }
         }
     }
@@ -207,14 +197,22 @@ void PreferencesDialog::setSubtitleTracks(const QVariantList& subtitleTracks, bo
         ui->comboBox_subtitle_track->setEnabled(false);
 }
 
-void PreferencesDialog::setVideoPositionText(const QString &text)
+void PreferencesDialog::setTelemetry(const PlaybackTelemetry &telemetry)
 {
-    ui->label_video_position->setText(text);
-}
-
-void PreferencesDialog::setVideoDurationText(const QString &text)
-{
-    ui->label_video_duration->setText(text);
+    // The play state comes through setPlaying(), also while hidden.
+    setMediaSliderPosition(telemetry.position);
+    const qint64 position = telemetry.position / 1000;
+    if (position != shownPosition)
+    {
+        shownPosition = position;
+        ui->label_video_position->setText(QTime(0, 0, 0).addSecs(static_cast<int>(position)).toString(QStringLiteral("HH:mm:ss")));
+    }
+    const qint64 duration = telemetry.duration / 1000;
+    if (duration != shownDuration)
+    {
+        shownDuration = duration;
+        ui->label_video_duration->setText(QTime(0, 0, 0).addSecs(static_cast<int>(duration)).toString(QStringLiteral("HH:mm:ss")));
+    }
 }
 
 void PreferencesDialog::playNextMedia()
@@ -264,6 +262,22 @@ void PreferencesDialog::switchFile(const QString &url)
     switchToItem(ui->comboBox_url, url);
 }
 
+void PreferencesDialog::openUrl(const QString &url)
+{
+    if (url.isEmpty())
+        return;
+    if (ui->comboBox_url->findText(url) < 0)
+        ui->comboBox_url->insertItem(ui->comboBox_url->currentIndex() + 1, url);
+    if (ui->comboBox_url->currentText() != url)
+    {
+        ui->comboBox_url->setCurrentText(url);
+        QStringList files;
+        for (int i = 0; i != ui->comboBox_url->count(); ++i)
+            files.append(ui->comboBox_url->itemText(i));
+        SettingsManager::getInstance()->setPlaylistFiles(SettingsManager::getInstance()->getCurrentPlaylistName(), files);
+    }
+}
+
 void PreferencesDialog::mediaEndReached()
 {
     const SettingsManager::PlaybackMode mode = SettingsManager::getInstance()->getPlaybackMode();
@@ -422,16 +436,7 @@ void PreferencesDialog::dropEvent(QDropEvent *event)
         path = QDir::toNativeSeparators(QDir::cleanPath(url.toLocalFile()));
     else
         path = url.url();
-    if (ui->comboBox_url->findText(path) < 0)
-        ui->comboBox_url->insertItem(ui->comboBox_url->currentIndex() + 1, path);
-    if (ui->comboBox_url->currentText() != path)
-    {
-        ui->comboBox_url->setCurrentText(path);
-        QStringList files;
-        for (int i = 0; i != ui->comboBox_url->count(); ++i)
-            files.append(ui->comboBox_url->itemText(i));
-        SettingsManager::getInstance()->setPlaylistFiles(SettingsManager::getInstance()->getCurrentPlaylistName(), files);
-    }
+    openUrl(path);
 }
 #endif
 
@@ -467,11 +472,22 @@ void PreferencesDialog::initUI()
     ui->comboBox_image_quality->addItem(DD_TR("Best"), QStringLiteral("best"));
     ui->comboBox_image_quality->addItem(DD_TR("Fastest"), QStringLiteral("fastest"));
     ui->comboBox_image_quality->addItem(DD_TR("Default"), QStringLiteral("default"));
+    ui->comboBox_decode_profile->addItem(DD_TR("Default"), QStringLiteral("default"));
+    ui->comboBox_decode_profile->addItem(DD_TR("Eco (lower CPU usage, slightly lower quality)"), QStringLiteral("eco"));
+    ui->comboBox_quality_budget->addItem(DD_TR("Disabled"), 0);
+    ui->comboBox_quality_budget->addItem(DD_TR("Keep CPU usage below %0%").arg(5), 5);
+    ui->comboBox_quality_budget->addItem(DD_TR("Keep CPU usage below %0%").arg(10), 10);
+    ui->comboBox_quality_budget->addItem(DD_TR("Keep CPU usage below %0%").arg(25), 25);
+    ui->comboBox_readability->addItem(DD_TR("Disabled"), QVariantList{0, 0, 0});
+    ui->comboBox_readability->addItem(DD_TR("Darken"), QVariantList{35, 0, 0});
+    ui->comboBox_readability->addItem(DD_TR("Darken and blur"), QVariantList{35, 60, 0});
+    ui->comboBox_readability->addItem(DD_TR("Darken, blur and vignette"), QVariantList{35, 60, 50});
     ui->comboBox_video_renderer->addItem(QStringLiteral("OpenGLWidget"), Utils::getVideoRendererId(Utils::VideoRendererId::OpenGLWidget));
     ui->comboBox_video_renderer->addItem(QStringLiteral("QGLWidget2 (recommended)"), Utils::getVideoRendererId(Utils::VideoRendererId::GLWidget2));
     ui->comboBox_video_renderer->addItem(QStringLiteral("Widget"), Utils::getVideoRendererId(Utils::VideoRendererId::Widget));
     ui->comboBox_video_renderer->addItem(QStringLiteral("GDI"), Utils::getVideoRendererId(Utils::VideoRendererId::GDI));
     ui->comboBox_video_renderer->addItem(QStringLiteral("Direct2D"), Utils::getVideoRendererId(Utils::VideoRendererId::Direct2D));
+    ui->comboBox_video_renderer->addItem(DD_TR("Software (no GPU)"), Utils::getVideoRendererId(Utils::VideoRendererId::Software));
 #ifndef DD_NO_CSS
     ui->comboBox_skin->addItem(DD_TR("<None>"), QStringLiteral("none"));
     populateSkins(QStringLiteral(":/skins"));
@@ -536,6 +552,20 @@ void PreferencesDialog::initUI()
     ui->comboBox_video_renderer->setCurrentIndex(i > -1 ? i : 0);
     i = ui->comboBox_image_quality->findData(SettingsManager::getInstance()->getImageQuality());
     ui->comboBox_image_quality->setCurrentIndex(i > -1 ? i : 0);
+    i = ui->comboBox_decode_profile->findData(SettingsManager::getInstance()->getDecodeProfile());
+    ui->comboBox_decode_profile->setCurrentIndex(i > -1 ? i : 0);
+    i = ui->comboBox_quality_budget->findData(SettingsManager::getInstance()->getQualityBudget());
+    ui->comboBox_quality_budget->setCurrentIndex(i > -1 ? i : 0);
+    const QVariantList readability{SettingsManager::getInstance()->getOverlayDim(),
+                SettingsManager::getInstance()->getOverlayBlur(), SettingsManager::getInstance()->getOverlayVignette()};
+    i = ui->comboBox_readability->findData(readability);
+    // Keep values edited in the settings file instead of resetting them.
+    if (i < 0)
+    {
+        ui->comboBox_readability->addItem(DD_TR("Custom"), readability);
+        i = ui->comboBox_readability->count() - 1;
+    }
+    ui->comboBox_readability->setCurrentIndex(i);
 }
 
 void PreferencesDialog::initConnections()
@@ -712,6 +742,36 @@ void PreferencesDialog::initConnections()
             emit this->imageQualityChanged(SettingsManager::getInstance()->getImageQuality());
         }
     });
+    connect(ui->comboBox_decode_profile, qOverload<int>(&QComboBox::currentIndexChanged), this, [=](int index)
+    {
+        Q_UNUSED(index)
+        if (ui->comboBox_decode_profile->currentData().toString() != SettingsManager::getInstance()->getDecodeProfile())
+        {
+            SettingsManager::getInstance()->setDecodeProfile(ui->comboBox_decode_profile->currentData().toString());
+            emit this->decodeProfileChanged(SettingsManager::getInstance()->getDecodeProfile());
+        }
+    });
+    connect(ui->comboBox_quality_budget, qOverload<int>(&QComboBox::currentIndexChanged), this, [=](int index)
+    {
+        Q_UNUSED(index)
+        if (ui->comboBox_quality_budget->currentData().toUInt() != SettingsManager::getInstance()->getQualityBudget())
+        {
+            SettingsManager::getInstance()->setQualityBudget(ui->comboBox_quality_budget->currentData().toUInt());
+            emit this->qualityBudgetChanged(SettingsManager::getInstance()->getQualityBudget());
+        }
+    });
+    connect(ui->comboBox_readability, qOverload<int>(&QComboBox::currentIndexChanged), this, [=](int index)
+    {
+        Q_UNUSED(index)
+        const QVariantList readability = ui->comboBox_readability->currentData().toList();
+        if (readability.count() != 3)
+            return;
+        SettingsManager::getInstance()->setOverlayDim(readability.at(0).toUInt());
+        SettingsManager::getInstance()->setOverlayBlur(readability.at(1).toUInt());
+        SettingsManager::getInstance()->setOverlayVignette(readability.at(2).toUInt());
+        emit this->readabilityOverlayChanged(SettingsManager::getInstance()->getOverlayDim(),
+                                             SettingsManager::getInstance()->getOverlayBlur(), SettingsManager::getInstance()->getOverlayVignette());
+    });
     connect(ui->comboBox_url, &QComboBox::currentTextChanged, this, [=](const QString &text)
     {
         if (!refreshingData && !text.isEmpty() && (text != SettingsManager::getInstance()->getLastFile()))
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "telemetry.h"
+
 #include <QtNiceFramelessWindow>
 
 #ifndef DD_NO_WIN_EXTRAS
@@ -35,6 +37,9 @@ signals:
     void subtitleTrackChanged(const QVariant &);
     void rendererChanged(int);
     void imageQualityChanged(const QString &);
+    void decodeProfileChanged(const QString &);
+    void qualityBudgetChanged(quint32);
+    void readabilityOverlayChanged(quint32, quint32, quint32);
     void charsetChanged(const QString &);
     void subtitleAutoLoadChanged(bool);
     void subtitleEnableChanged(bool);
@@ -60,11 +65,10 @@ public slots:
     void setMediaSliderRange(qint64 duration);
     void setSeekAreaEnabled(bool enabled = true);
     void setAudioAreaEnabled(bool available = true);
-    void setVideoTracks(const QVariantList &videoTracks);
-    void setAudioTracks(const QVariantList &audioTracks, bool add = false);
-    void setSubtitleTracks(const QVariantList &subtitleTracks, bool add = false);
-    void setVideoPositionText(const QString &text);
-    void setVideoDurationText(const QString &text);
+    void setVideoTracks(const MediaTracks &videoTracks);
+    void setAudioTracks(const MediaTracks &audioTracks, bool add = false);
+    void setSubtitleTracks(const MediaTracks &subtitleTracks, bool add = false);
+    void setTelemetry(const PlaybackTelemetry &telemetry);
     void playNextMedia();
     void playNextPlaylist();
     void playPreviousMedia();
@@ -72,6 +76,7 @@ public slots:
     void refreshPlaylistsAndFiles();
     void switchPlaylist(const QString &name);
     void switchFile(const QString &url);
+    void openUrl(const QString &url);
     void mediaEndReached();
     void playRandomFileFromAllPlaylistsFiles();
 
@@ -112,6 +117,8 @@ private:
     Ui::PreferencesDialog *ui = nullptr;
     bool audioAvailable = true, isPlaying = false, refreshingData = false;
     quint32 sliderUnit = 1000;
+    // In seconds, the labels don't show anything finer.
+    qint64 shownPosition = -1, shownDuration = -1;
 #ifndef DD_NO_WIN_EXTRAS
     QWinTaskbarButton *taskbarButton = nullptr;
     QWinTaskbarProgress *taskbarProgress = nullptr;
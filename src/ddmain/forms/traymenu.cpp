@@ -10,6 +10,7 @@ TrayMenu::TrayMenu(QWidget *parent) : QMenu(parent)
     ui->setupUi(this);
     initIcons();
     connect(ui->toolButton_options, &QToolButton::clicked, this, &TrayMenu::onOptionsClicked);
+    connect(ui->toolButton_debug_overlay, &QToolButton::toggled, this, &TrayMenu::onDebugOverlayToggled);
     connect(ui->toolButton_about, &QToolButton::clicked, this, &TrayMenu::onAboutClicked);
     connect(ui->toolButton_mute, &QToolButton::clicked, this, &TrayMenu::onMuteClicked);
     connect(ui->pushButton_next, &QPushButton::clicked, this, &TrayMenu::onNextClicked);
@@ -77,6 +78,13 @@ void TrayMenu::setPlaying(bool playing)
 #endif
 }
 
+void TrayMenu::setDebugOverlay(bool visible)
+{
+    // The overlay can be toggled through the control channel as well.
+    const QSignalBlocker blocker(ui->toolButton_debug_overlay);
+    ui->toolButton_debug_overlay->setChecked(visible);
+}
+
 void TrayMenu::showEvent(QShowEvent *event)
 {
     move(geometry().left(), geometry().top() - height());
@@ -93,6 +101,7 @@ void TrayMenu::initIcons()
     ui->toolButton_playback_mode->setIcon(QIcon(QStringLiteral(":/icons/circle-light.svg")));
     ui->toolButton_mute->setIcon(QIcon(QStringLiteral(":/icons/mute-light.svg")));
     ui->toolButton_options->setIcon(QIcon(QStringLiteral(":/icons/options-light.svg")));
+    ui->toolButton_debug_overlay->setIcon(QIcon(QStringLiteral(":/icons/info.svg")));
     ui->toolButton_about->setIcon(QIcon(QStringLiteral(":/icons/info.svg")));
     ui->toolButton_exit->setIcon(QIcon(QStringLiteral(":/icons/exit-light.svg")));
 #else
@@ -103,6 +112,7 @@ void TrayMenu::initIcons()
     ui->toolButton_playback_mode->setIcon(QIcon(QStringLiteral(":/icons/circle-light.png")));
     ui->toolButton_mute->setIcon(QIcon(QStringLiteral(":/icons/mute-light.png")));
     ui->toolButton_options->setIcon(QIcon(QStringLiteral(":/icons/options-light.png")));
+    ui->toolButton_debug_overlay->setIcon(QIcon(QStringLiteral(":/icons/info.png")));
     ui->toolButton_about->setIcon(QIcon(QStringLiteral(":/icons/info.png")));
     ui->toolButton_exit->setIcon(QIcon(QStringLiteral(":/icons/exit-light.png")));
 #endif
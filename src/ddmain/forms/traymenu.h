@@ -21,6 +21,7 @@ signals:
     void onPreviousClicked();
     void onMuteClicked();
     void onAboutClicked();
+    void onDebugOverlayToggled(bool);
 
 public:
     explicit TrayMenu(QWidget *parent = nullptr);
@@ -32,6 +33,7 @@ public slots:
 #endif
     void setMute(bool mute = true);
     void setPlaying(bool playing = true);
+    void setDebugOverlay(bool visible = true);
 
 protected:
     void showEvent(QShowEvent *event) override;
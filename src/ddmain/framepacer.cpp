@@ -0,0 +1,230 @@
+#include "framepacer.h"
+#include "metrics.h"
+#include "stagetiming.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+#include <QtAV/VideoFrame.h>
+#include <Windows.h>
+#include <dwmapi.h>
+#include <mmsystem.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Timestamps further apart than this are a seek or a new file.
+const qint64 kMaxTimestampGap = 1000000000;
+// Re-anchor when the media clock and the display drifted apart by more
+// than this many refresh intervals (pause, audio clock drift, mode switch).
+const qint64 kMaxDriftIntervals = 2;
+const qint64 kDefaultRefreshInterval = 1000000000 / 60;
+// The end of a wait is spun through. High resolution timers fire within
+// half a millisecond, the periodic timer only within a tick of 1 ms.
+const qint64 kHighResolutionSpin = 500000;
+const qint64 kLowResolutionSpin = 2000000;
+
+class DwmRefreshClock : public RefreshClock
+{
+public:
+    DwmRefreshClock()
+    {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        frequency = value.QuadPart;
+        // Windows 10 1803 and newer.
+        timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        highResolution = timer != nullptr;
+        if (!highResolution)
+            timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    }
+
+    ~DwmRefreshClock() override
+    {
+        if (timer)
+            CloseHandle(timer);
+    }
+
+    qint64 now() const override
+    {
+        LARGE_INTEGER value;
+        QueryPerformanceCounter(&value);
+        return toNanoseconds(value.QuadPart);
+    }
+
+    qint64 refreshInterval() const override
+    {
+        DWM_TIMING_INFO info;
+        if (timingInfo(&info) && (info.qpcRefreshPeriod > 0))
+            return toNanoseconds(static_cast<qint64>(info.qpcRefreshPeriod));
+        const QScreen *screen = QGuiApplication::primaryScreen();
+        if (screen && (screen->refreshRate() > 1.0))
+            return static_cast<qint64>(1000000000.0 / screen->refreshRate());
+        return kDefaultRefreshInterval;
+    }
+
+    qint64 lastVsync() const override
+    {
+        // The DWM reports its vblank on the QueryPerformanceCounter time
+        // base, the same one now() uses.
+        DWM_TIMING_INFO info;
+        if (timingInfo(&info) && (info.qpcVBlank > 0))
+            return toNanoseconds(static_cast<qint64>(info.qpcVBlank));
+        return now();
+    }
+
+    void sleepUntil(qint64 time) override
+    {
+        // A plain sleep ends on the next tick of the system timer, up to
+        // 15.6 ms late, which misses the refresh it waited for.
+        const qint64 remaining = time - (highResolution ? kHighResolutionSpin : kLowResolutionSpin) - now();
+        if ((remaining > 0) && timer)
+        {
+            // Only raised for the wait, a finer periodic timer costs power
+            // system wide.
+            const bool periodRaised = !highResolution && (timeBeginPeriod(1) == TIMERR_NOERROR);
+            LARGE_INTEGER dueTime;
+            // Relative, in units of 100 ns.
+            dueTime.QuadPart = -(remaining / 100);
+            if (SetWaitableTimer(timer, &dueTime, 0, nullptr, nullptr, FALSE))
+                WaitForSingleObject(timer, INFINITE);
+            if (periodRaised)
+                timeEndPeriod(1);
+        }
+        while (now() < time)
+            YieldProcessor();
+    }
+
+private:
+    static bool timingInfo(DWM_TIMING_INFO *info)
+    {
+        ZeroMemory(info, sizeof(DWM_TIMING_INFO));
+        info->cbSize = sizeof(DWM_TIMING_INFO);
+        return SUCCEEDED(DwmGetCompositionTimingInfo(nullptr, info));
+    }
+
+    qint64 toNanoseconds(qint64 counter) const
+    {
+        return (counter / frequency) * 1000000000 + (counter % frequency) * 1000000000 / frequency;
+    }
+
+private:
+    qint64 frequency = 1;
+    HANDLE timer = nullptr;
+    bool highResolution = false;
+};
+
+FramePacer::FramePacer(RefreshClock *clock, QObject *parent) : QtAV::VideoFilter(parent), clock(clock)
+{
+    jitter = MetricsRegistry::getInstance()->summary("dd_present_jitter_seconds", "Deviation of the time between presented frames from the time between their refresh slots.");
+    if (!this->clock)
+        this->clock = new DwmRefreshClock();
+}
+
+FramePacer::~FramePacer()
+{
+    delete clock;
+}
+
+FramePacer::Decision FramePacer::pace(qreal timestamp)
+{
+    const qint64 now = clock->now();
+    const qint64 pts = qRound64(timestamp * 1000000000.0);
+    if (!anchored || (pts < lastPts) || ((pts - lastPts) > kMaxTimestampGap))
+        anchor(pts, now);
+    lastPts = pts;
+    // Every frame is mapped to the refresh slot its timestamp falls into,
+    // independent of when it arrives, so the cadence is deterministic:
+    // 24 fps on 60 Hz always alternates 3 and 2 refreshes per frame.
+    qint64 slot = (pts - anchorPts + interval / 2) / interval;
+    if (slot <= lastSlot)
+    {
+        // Another frame already owns this refresh, this one would replace
+        // it before it is scanned out.
+        superseded.fetchAndAddRelaxed(1);
+        return Superseded;
+    }
+    if ((lastSlot >= 0) && (slot > (lastSlot + 1)))
+        repeated.fetchAndAddRelaxed(static_cast<quint64>(slot - lastSlot - 1));
+    qint64 target = anchorTime + slot * interval;
+    if (qAbs(now - target) > (kMaxDriftIntervals * interval))
+    {
+        anchor(pts, now);
+        slot = 0;
+        target = anchorTime;
+    }
+    lastSlot = slot;
+    // Late on arrival, sleeping can't make up for it.
+    if ((now - target) > interval)
+        late.fetchAndAddRelaxed(1);
+    if (now < target)
+        clock->sleepUntil(target);
+    if (lastTarget >= 0)
+        pendingSlotTime.fetchAndAddOrdered(target - lastTarget);
+    lastTarget = target;
+    presentedFrames.fetchAndAddRelaxed(1);
+    return Presented;
+}
+
+void FramePacer::presented()
+{
+    const qint64 now = clock->now();
+    if (presentReset.fetchAndStoreOrdered(0) != 0)
+    {
+        pendingSlotTime.fetchAndStoreOrdered(0);
+        lastPresented = now;
+        return;
+    }
+    // Repaints without a new frame.
+    const qint64 slotTime = pendingSlotTime.fetchAndStoreOrdered(0);
+    if ((slotTime <= 0) || (lastPresented < 0))
+        return;
+    // Relative to the previous frame, a constant delay of the renderer or
+    // the compositor is no jitter.
+    jitter->record(qAbs(now - lastPresented - slotTime) / 1000);
+    lastPresented = now;
+}
+
+QVariantHash FramePacer::statistics() const
+{
+    QVariantHash stats;
+    const qint64 period = refreshPeriod.load();
+    stats[QStringLiteral("pacing.refreshRate")] = period > 0 ? 1000000000.0 / period : 0.0;
+    stats[QStringLiteral("pacing.presented")] = presentedFrames.load();
+    stats[QStringLiteral("pacing.superseded")] = superseded.load();
+    stats[QStringLiteral("pacing.repeated")] = repeated.load();
+    stats[QStringLiteral("pacing.late")] = late.load();
+    stats[QStringLiteral("pacing.anchors")] = anchors.load();
+    stats[QStringLiteral("pacing.jitterP50")] = jitter->percentile(0.5);
+    stats[QStringLiteral("pacing.jitterP99")] = jitter->percentile(0.99);
+    stats[QStringLiteral("pacing.jitterMax")] = jitter->max();
+    return stats;
+}
+
+void FramePacer::process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame)
+{
+    Q_UNUSED(statistics)
+    if (!frame || !frame->isValid())
+        return;
+    DD_STAGE_SCOPE(Pace);
+    // The video thread doesn't hand invalid frames to the renderers, the
+    // frame that owns the refresh stays on screen.
+    if (pace(frame->timestamp()) == Superseded)
+        *frame = QtAV::VideoFrame();
+}
+
+void FramePacer::anchor(qint64 pts, qint64 now)
+{
+    interval = qMax(static_cast<qint64>(1000000), clock->refreshInterval());
+    refreshPeriod.store(interval);
+    // Slot 0 starts at the next vblank, presenting right after a vblank
+    // leaves the renderer a whole refresh interval to draw the frame.
+    const qint64 vsync = clock->lastVsync();
+    anchorTime = now + (vsync <= now ? (interval - (now - vsync) % interval) % interval : vsync - now);
+    anchorPts = pts;
+    lastSlot = -1;
+    lastTarget = -1;
+    presentReset.store(1);
+    anchored = true;
+    anchors.fetchAndAddRelaxed(1);
+}
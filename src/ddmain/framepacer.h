@@ -0,0 +1,71 @@
+#pragma once
+
+#include "histogram.h"
+
+#include <QtAV/Filter.h>
+#include <QVariantHash>
+
+// Time source of the frame pacer. All values are nanoseconds on one
+// monotonic time base. Tests can provide a simulated display here.
+class RefreshClock
+{
+public:
+    virtual ~RefreshClock() = default;
+
+public:
+    virtual qint64 now() const = 0;
+    virtual qint64 refreshInterval() const = 0;
+    virtual qint64 lastVsync() const = 0;
+    virtual void sleepUntil(qint64 time) = 0;
+};
+
+class FramePacer : public QtAV::VideoFilter
+{
+    Q_OBJECT
+
+public:
+    enum Decision
+    {
+        Presented,
+        Superseded
+    };
+
+    // Takes ownership of the clock, the display's vsync clock is used if none is given.
+    // Superseded frames are dropped, the renderers never see them.
+    explicit FramePacer(RefreshClock *clock = nullptr, QObject *parent = nullptr);
+    ~FramePacer() override;
+
+public:
+    Decision pace(qreal timestamp);
+    // Called on the GUI thread once the renderer drew a frame. Jitter is
+    // how far the time between two presented frames is off from the
+    // time between their refresh slots.
+    void presented();
+    QVariantHash statistics() const;
+
+protected:
+    void process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame) override;
+
+private:
+    void anchor(qint64 pts, qint64 now);
+
+private:
+    RefreshClock *clock = nullptr;
+    bool anchored = false;
+    qint64 interval = 0;
+    qint64 anchorPts = 0, anchorTime = 0;
+    qint64 lastPts = 0, lastSlot = -1, lastTarget = -1;
+    // Handed from the video thread to the GUI thread: the slot time that
+    // passed since the last presented frame, and whether the pacer was
+    // anchored again in between.
+    QAtomicInteger<qint64> pendingSlotTime = 0;
+    QAtomicInt presentReset = 1;
+    // Only used on the GUI thread.
+    qint64 lastPresented = -1;
+    QAtomicInteger<qint64> refreshPeriod = 0;
+    QAtomicInteger<quint64> presentedFrames = 0, superseded = 0, repeated = 0, late = 0, anchors = 0;
+    Histogram *jitter = nullptr;
+
+private:
+    Q_DISABLE_COPY(FramePacer)
+};
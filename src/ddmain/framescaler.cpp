@@ -0,0 +1,160 @@
+#include "framescaler.h"
+#include "logger.h"
+#include "stagetiming.h"
+
+#include <Windows.h>
+
+extern "C"
+{
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+// Of the planes and their lines, what the SIMD paths of swscale expect.
+const int kAlignment = 32;
+
+FrameScaler::FrameScaler(QObject *parent) : QtAV::VideoFilter(parent)
+{
+}
+
+FrameScaler::~FrameScaler()
+{
+    sws_freeContext(context);
+}
+
+QSize FrameScaler::targetSize() const
+{
+    const quint64 size = target.load();
+    return QSize(static_cast<int>(size >> 32), static_cast<int>(size & 0xFFFFFFFF));
+}
+
+void FrameScaler::setTargetSize(const QSize &size)
+{
+    target.store((static_cast<quint64>(qMax(0, size.width())) << 32) | static_cast<quint32>(qMax(0, size.height())));
+}
+
+Qt::AspectRatioMode FrameScaler::aspectRatioMode() const
+{
+    return static_cast<Qt::AspectRatioMode>(aspectMode.load());
+}
+
+void FrameScaler::setAspectRatioMode(Qt::AspectRatioMode mode)
+{
+    aspectMode.store(mode);
+}
+
+qreal FrameScaler::scaleFactor() const
+{
+    return scalePercent.load() / 100.0;
+}
+
+void FrameScaler::setScaleFactor(qreal factor)
+{
+    scalePercent.store(qBound(1, qRound(factor * 100.0), 100));
+}
+
+QtAV::VideoFrame FrameScaler::lastFrame() const
+{
+    QMutexLocker locker(&frameMutex);
+    return currentFrame;
+}
+
+quint32 FrameScaler::videoThreadId() const
+{
+    return threadId.load();
+}
+
+quint64 FrameScaler::frameCount() const
+{
+    return frames.load();
+}
+
+quint64 FrameScaler::scalerSetups() const
+{
+    return setups.load();
+}
+
+void FrameScaler::requestLogBenchmark()
+{
+    logBenchmarkRequested.store(1);
+}
+
+void FrameScaler::process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame)
+{
+    Q_UNUSED(statistics)
+    if (!frame || !frame->isValid())
+        return;
+    threadId.store(GetCurrentThreadId());
+    frames.fetchAndAddRelaxed(1);
+#ifndef DD_NO_LOGGING
+    if (logBenchmarkRequested.testAndSetRelaxed(1, 0))
+        Log::benchmark();
+#endif
+    // Frames of zero-copy hardware decoders live in GPU memory, they
+    // are scaled by the renderer without any upload. They are not kept
+    // either, holding one would pin a surface of the decoder's pool.
+    if (!frame->constBits(0))
+        return;
+    const QSize target = targetSize() * scaleFactor();
+    // With the aspect ratio mode of the renderer the frame comes out at
+    // exactly the size it is displayed at, so the renderer draws it 1:1.
+    const QSize size = frame->size().scaled(target, aspectRatioMode());
+    if (!target.isEmpty() && (size.width() < frame->width()) && (size.height() < frame->height()))
+    {
+        DD_STAGE_SCOPE(Scale);
+        const QtAV::VideoFrame scaledFrame = scale(*frame, size);
+        if (scaledFrame.isValid())
+            *frame = scaledFrame;
+    }
+    // Video frames are implicitly shared, keeping the last one is cheap.
+    QMutexLocker locker(&frameMutex);
+    currentFrame = *frame;
+}
+
+QtAV::VideoFrame FrameScaler::scale(const QtAV::VideoFrame &frame, const QSize &size)
+{
+    // VideoFrame::to() sets up a new swscale context for every frame, its
+    // filter tables cost more than scaling a small frame. This one is only
+    // set up again when the input or the output changes.
+    const int format = frame.pixelFormatFFmpeg();
+    if (!context || (format != contextFormat) || (frame.size() != contextInput) || (size != contextOutput))
+    {
+        sws_freeContext(context);
+        context = sws_getContext(frame.width(), frame.height(), static_cast<AVPixelFormat>(format),
+                                 size.width(), size.height(), static_cast<AVPixelFormat>(format),
+                                 SWS_BILINEAR, nullptr, nullptr, nullptr);
+        contextFormat = format;
+        contextInput = frame.size();
+        contextOutput = size;
+        setups.fetchAndAddRelaxed(1);
+        if (!context)
+            return QtAV::VideoFrame();
+    }
+    const int bufferSize = av_image_get_buffer_size(static_cast<AVPixelFormat>(format), size.width(), size.height(), kAlignment);
+    if (bufferSize <= 0)
+        return QtAV::VideoFrame();
+    // The frame keeps the buffer alive for as long as anybody holds it.
+    QByteArray buffer(bufferSize + kAlignment, Qt::Uninitialized);
+    uchar *data = reinterpret_cast<uchar *>(buffer.data());
+    data += (kAlignment - reinterpret_cast<quintptr>(data) % kAlignment) % kAlignment;
+    uint8_t *planes[4] = {};
+    int lineSizes[4] = {};
+    av_image_fill_arrays(planes, lineSizes, data, static_cast<AVPixelFormat>(format), size.width(), size.height(), kAlignment);
+    const uint8_t *source[4] = {};
+    int sourceLineSizes[4] = {};
+    for (int plane = 0; plane < qMin(frame.planeCount(), 4); ++plane)
+    {
+        source[plane] = frame.constBits(plane);
+        sourceLineSizes[plane] = frame.bytesPerLine(plane);
+    }
+    if (sws_scale(context, source, sourceLineSizes, 0, frame.height(), planes, lineSizes) <= 0)
+        return QtAV::VideoFrame();
+    QtAV::VideoFrame scaledFrame(size.width(), size.height(), frame.format(), buffer);
+    scaledFrame.setBits(planes);
+    scaledFrame.setBytesPerLine(lineSizes);
+    scaledFrame.setTimestamp(frame.timestamp());
+    scaledFrame.setColorSpace(frame.colorSpace());
+    scaledFrame.setColorRange(frame.colorRange());
+    scaledFrame.setDisplayAspectRatio(frame.displayAspectRatio());
+    return scaledFrame;
+}
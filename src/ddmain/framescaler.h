@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QtAV/Filter.h>
+#include <QtAV/VideoFrame.h>
+#include <QMutex>
+
+struct SwsContext;
+
+class FrameScaler : public QtAV::VideoFilter
+{
+    Q_OBJECT
+
+public:
+    explicit FrameScaler(QObject *parent = nullptr);
+    ~FrameScaler() override;
+
+public:
+    QSize targetSize() const;
+    void setTargetSize(const QSize &size);
+    Qt::AspectRatioMode aspectRatioMode() const;
+    void setAspectRatioMode(Qt::AspectRatioMode mode = Qt::KeepAspectRatioByExpanding);
+    qreal scaleFactor() const;
+    void setScaleFactor(qreal factor = 1.0);
+    QtAV::VideoFrame lastFrame() const;
+    // The filter is the first one to see each decoded frame, on the
+    // video thread.
+    quint32 videoThreadId() const;
+    quint64 frameCount() const;
+    // How often the scaling context was set up, once per change of the
+    // input or the output.
+    quint64 scalerSetups() const;
+    // Runs Log::benchmark() on the video thread with the next frame.
+    void requestLogBenchmark();
+
+protected:
+    void process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame) override;
+
+private:
+    QtAV::VideoFrame scale(const QtAV::VideoFrame &frame, const QSize &size);
+
+private:
+    // Width in the upper, height in the lower half, so that the video
+    // thread never sees the width of one size with the height of another.
+    QAtomicInteger<quint64> target = 0;
+    QAtomicInt aspectMode = Qt::KeepAspectRatioByExpanding;
+    QAtomicInt scalePercent = 100;
+    QAtomicInteger<quint32> threadId = 0;
+    QAtomicInteger<quint64> frames = 0;
+    QAtomicInt logBenchmarkRequested = 0;
+    QAtomicInteger<quint64> setups = 0;
+    // Only used on the video thread.
+    SwsContext *context = nullptr;
+    int contextFormat = -1;
+    QSize contextInput, contextOutput;
+    mutable QMutex frameMutex;
+    QtAV::VideoFrame currentFrame;
+
+private:
+    Q_DISABLE_COPY(FrameScaler)
+};
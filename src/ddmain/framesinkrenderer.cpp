@@ -0,0 +1,128 @@
+#include "framesinkrenderer.h"
+
+#include <QCryptographicHash>
+#include <QtAV/VideoFrame.h>
+
+// The log is written out at least this often, in milliseconds.
+const qint64 kFlushInterval = 1000;
+
+const QtAV::VideoRendererId FrameSinkRenderer::rendererId = ('D' << 24) | ('D' << 16) | ('N' << 8) | 'L';
+
+FrameSinkRecorder::FrameSinkRecorder(QObject *parent) : QtAV::VideoFilter(parent)
+{
+}
+
+FrameSinkRecorder::~FrameSinkRecorder()
+{
+    close();
+}
+
+bool FrameSinkRecorder::open(const QString &fileName)
+{
+    close();
+    QMutexLocker locker(&mutex);
+    file.setFileName(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text))
+        return false;
+    stream.setDevice(&file);
+    stream << "frame,timestamp,received_ms,hash\n";
+    stream.flush();
+    frames = 0;
+    lastFlush = 0;
+    clock.start();
+    return true;
+}
+
+void FrameSinkRecorder::close()
+{
+    QMutexLocker locker(&mutex);
+    if (!file.isOpen())
+        return;
+    stream.flush();
+    stream.setDevice(nullptr);
+    file.close();
+}
+
+bool FrameSinkRecorder::hashing() const
+{
+    return hashEnabled.load() != 0;
+}
+
+void FrameSinkRecorder::setHashing(bool enabled)
+{
+    hashEnabled.store(enabled ? 1 : 0);
+}
+
+quint64 FrameSinkRecorder::frameCount() const
+{
+    QMutexLocker locker(&mutex);
+    return frames;
+}
+
+QByteArray FrameSinkRecorder::hashFrame(const QtAV::VideoFrame &frame)
+{
+    // Frames of zero-copy hardware decoders have no host memory to hash.
+    if (!frame.isValid() || !frame.constBits(0))
+        return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    for (int plane = 0; plane < frame.planeCount(); ++plane)
+    {
+        const int lineBytes = frame.format().bytesPerLine(frame.width(), plane);
+        const int stride = frame.bytesPerLine(plane);
+        const uchar *bits = frame.constBits(plane);
+        for (int line = 0; line < frame.planeHeight(plane); ++line)
+            hash.addData(reinterpret_cast<const char *>(bits + line * stride), lineBytes);
+    }
+    return hash.result();
+}
+
+void FrameSinkRecorder::process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame)
+{
+    Q_UNUSED(statistics)
+    if (!frame || !frame->isValid())
+        return;
+    const QByteArray hash = hashing() ? hashFrame(*frame) : QByteArray();
+    QMutexLocker locker(&mutex);
+    if (!file.isOpen())
+        return;
+    const qint64 receivedAt = clock.nsecsElapsed();
+    stream << frames++ << ',' << QString::number(frame->timestamp(), 'f', 6) << ','
+           << QString::number(receivedAt / 1000000.0, 'f', 3) << ','
+           << QString::fromLatin1(hash.toHex()) << '\n';
+    if ((receivedAt / 1000000 - lastFlush) >= kFlushInterval)
+    {
+        stream.flush();
+        lastFlush = receivedAt / 1000000;
+    }
+}
+
+FrameSinkRenderer::FrameSinkRenderer() : QtAV::VideoRenderer()
+{
+}
+
+QtAV::VideoRendererId FrameSinkRenderer::id() const
+{
+    return rendererId;
+}
+
+bool FrameSinkRenderer::isSupported(QtAV::VideoFormat::PixelFormat pixfmt) const
+{
+    return pixfmt != QtAV::VideoFormat::Format_Invalid;
+}
+
+quint64 FrameSinkRenderer::frameCount() const
+{
+    return frames.load();
+}
+
+bool FrameSinkRenderer::receiveFrame(const QtAV::VideoFrame &frame)
+{
+    Q_UNUSED(frame)
+    frames.fetchAndAddRelaxed(1);
+    return true;
+}
+
+void FrameSinkRenderer::drawFrame()
+{
+    // Nothing is presented.
+}
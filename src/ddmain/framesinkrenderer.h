@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QtAV/Filter.h>
+#include <QtAV/VideoRenderer.h>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+
+// Writes the timestamp, the arrival time and optionally a hash of every
+// decoded frame to a CSV log. Installed on the player ahead of every other
+// filter, so it sees the frames as the decoder made them, before they are
+// scaled, tone mapped or paced. Records are written as they come and the
+// log is flushed regularly, a run that is killed keeps what it logged.
+class FrameSinkRecorder : public QtAV::VideoFilter
+{
+    Q_OBJECT
+
+public:
+    explicit FrameSinkRecorder(QObject *parent = nullptr);
+    ~FrameSinkRecorder() override;
+
+public:
+    // Starts a new log, any previous one is closed.
+    bool open(const QString &fileName);
+    void close();
+    bool hashing() const;
+    void setHashing(bool enabled = true);
+    quint64 frameCount() const;
+    // Of the visible plane data, the padding of the lines differs between
+    // decoders and runs.
+    static QByteArray hashFrame(const QtAV::VideoFrame &frame);
+
+protected:
+    void process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame) override;
+
+private:
+    mutable QMutex mutex;
+    QFile file;
+    QTextStream stream;
+    QElapsedTimer clock;
+    qint64 lastFlush = 0;
+    quint64 frames = 0;
+    QAtomicInt hashEnabled = 0;
+
+private:
+    Q_DISABLE_COPY(FrameSinkRecorder)
+};
+
+// Consumes frames without presenting them. It has no widget and no
+// graphics context, so it runs without a display. It accepts every pixel
+// format, QtAV never converts a frame for it.
+class FrameSinkRenderer : public QtAV::VideoRenderer
+{
+public:
+    static const QtAV::VideoRendererId rendererId;
+
+    FrameSinkRenderer();
+
+public:
+    QtAV::VideoRendererId id() const override;
+    bool isSupported(QtAV::VideoFormat::PixelFormat pixfmt) const override;
+    quint64 frameCount() const;
+
+protected:
+    bool receiveFrame(const QtAV::VideoFrame &frame) override;
+    void drawFrame() override;
+
+private:
+    QAtomicInteger<quint64> frames = 0;
+
+private:
+    Q_DISABLE_COPY(FrameSinkRenderer)
+};
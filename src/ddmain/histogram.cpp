@@ -0,0 +1,89 @@
+#include "histogram.h"
+
+#include <QtMath>
+
+Histogram::Histogram()
+{
+    reset();
+}
+
+void Histogram::record(qint64 value)
+{
+    if (value < 0)
+        value = 0;
+    counts[bucketIndex(value)].fetchAndAddRelaxed(1);
+    total.fetchAndAddRelaxed(1);
+    valueSum.fetchAndAddRelaxed(value);
+    qint64 largest = valueMax.load();
+    while ((value > largest) && !valueMax.testAndSetRelaxed(largest, value, largest))
+        ;
+}
+
+void Histogram::reset()
+{
+    for (QAtomicInteger<quint64> &bucket : counts)
+        bucket.store(0);
+    total.store(0);
+    valueSum.store(0);
+    valueMax.store(0);
+}
+
+quint64 Histogram::count() const
+{
+    return total.load();
+}
+
+qint64 Histogram::sum() const
+{
+    return valueSum.load();
+}
+
+qint64 Histogram::max() const
+{
+    return valueMax.load();
+}
+
+qint64 Histogram::percentile(qreal fraction) const
+{
+    const quint64 samples = count();
+    if (samples == 0)
+        return 0;
+    const quint64 rank = qMax(static_cast<quint64>(1), static_cast<quint64>(qCeil(qBound(0.0, fraction, 1.0) * samples)));
+    quint64 seen = 0;
+    for (int i = 0; i < kBucketCount; ++i)
+    {
+        seen += counts[i].load();
+        if (seen >= rank)
+            return bucketUpperBound(i);
+    }
+    return bucketUpperBound(kBucketCount - 1);
+}
+
+QVector<quint64> Histogram::buckets() const
+{
+    QVector<quint64> result(kBucketCount);
+    for (int i = 0; i < kBucketCount; ++i)
+        result[i] = counts[i].load();
+    return result;
+}
+
+qint64 Histogram::bucketUpperBound(int bucket)
+{
+    if (bucket < kSubBucketCount)
+        return bucket + 1;
+    const int shift = (bucket - kSubBucketCount) / kSubBucketCount;
+    const int subBucket = (bucket - kSubBucketCount) % kSubBucketCount;
+    return static_cast<qint64>(kSubBucketCount + subBucket + 1) << shift;
+}
+
+int Histogram::bucketIndex(qint64 value)
+{
+    if (value < kSubBucketCount)
+        return static_cast<int>(value);
+    int exponent = 0;
+    for (quint64 v = static_cast<quint64>(value); v > 1; v >>= 1)
+        ++exponent;
+    const int shift = exponent - kSubBucketBits;
+    const int subBucket = static_cast<int>((value >> shift) & (kSubBucketCount - 1));
+    return qMin(kSubBucketCount + shift * kSubBucketCount + subBucket, kBucketCount - 1);
+}
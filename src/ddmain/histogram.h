@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QAtomicInteger>
+#include <QVector>
+
+// Lock-free latency histogram in the spirit of HdrHistogram. Buckets grow
+// exponentially with sixteen linear sub-buckets per power of two, so any
+// percentile, p99.9 included, is accurate to within 6.25% from a
+// microsecond up to several days. Values are microseconds.
+class Histogram
+{
+public:
+    static const int kSubBucketBits = 4;
+    static const int kSubBucketCount = 1 << kSubBucketBits;
+    static const int kBucketCount = kSubBucketCount * 38;
+
+    Histogram();
+
+public:
+    void record(qint64 value);
+    void reset();
+    quint64 count() const;
+    qint64 sum() const;
+    // The largest value recorded, exact rather than a bucket's bound.
+    qint64 max() const;
+    qint64 percentile(qreal fraction) const;
+    QVector<quint64> buckets() const;
+    static qint64 bucketUpperBound(int bucket);
+
+private:
+    static int bucketIndex(qint64 value);
+
+private:
+    QAtomicInteger<quint64> counts[kBucketCount];
+    QAtomicInteger<quint64> total;
+    QAtomicInteger<qint64> valueSum;
+    QAtomicInteger<qint64> valueMax;
+
+private:
+    Q_DISABLE_COPY(Histogram)
+};
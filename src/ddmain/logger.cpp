@@ -0,0 +1,429 @@
+#include "logger.h"
+#include "metrics.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+// Records per thread. A ring is drained every flush interval, so this is
+// how many records a thread may write in between.
+const quint32 kRingSize = 512;
+const unsigned long kFlushInterval = 250;
+const qint64 kMaxFileSize = 4 * 1024 * 1024;
+// Rotated files kept next to the current one, as name.1.log and up.
+const int kMaxRotatedFiles = 3;
+// Fits into a ring that is drained in time, so all of them are stored.
+const int kBenchmarkCalls = 256;
+
+const char kSeverityLetters[] = {'D', 'I', 'W', 'E'};
+const char *const kCategoryNames[Log::CategoryCount] = {"general", "playback", "decoder", "renderer", "input", "control"};
+
+namespace Log
+{
+
+QAtomicInt thresholds[CategoryCount] = {Off, Off, Off, Off, Off, Off};
+
+struct ThreadBuffer
+{
+    Record records[kRingSize];
+    // Written by the owning thread only.
+    QAtomicInteger<quint32> head = 0;
+    // Written by the flusher only.
+    QAtomicInteger<quint32> tail = 0;
+    QAtomicInt owned = 1;
+    ThreadBuffer *next = nullptr;
+};
+
+// Gives the ring back when its thread exits, the next new thread takes
+// it over. QtAV starts threads for every media it opens.
+struct BufferOwner
+{
+    ThreadBuffer *buffer = nullptr;
+    quint32 threadId = 0;
+    ~BufferOwner()
+    {
+        if (buffer)
+            buffer->owned.storeRelease(0);
+    }
+};
+
+struct PendingMessage
+{
+    qint64 time;
+    quint32 threadId;
+    Severity severity;
+    QString text;
+};
+
+struct Line
+{
+    qint64 time;
+    QByteArray text;
+};
+
+class Flusher : public QThread
+{
+public:
+    explicit Flusher(const QString &fileName) : fileName(fileName) {}
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    void flush();
+    void writeLines(QVector<Line> &lines);
+    void rotate();
+
+private:
+    const QString fileName;
+    QFile file;
+    QMutex mutex;
+    QWaitCondition wakeUp;
+    bool stopping = false;
+};
+
+static QAtomicPointer<ThreadBuffer> buffers = nullptr;
+static thread_local BufferOwner bufferOwner;
+static QElapsedTimer logClock;
+static QDateTime clockStart;
+static Flusher *flusher = nullptr;
+static QtMessageHandler previousHandler = nullptr;
+// Qt's messages are rare and arrive formatted already, they take a lock.
+static QMutex pendingMutex;
+static QVector<PendingMessage> pendingMessages;
+static MetricCounter *writtenCounter = nullptr;
+static MetricCounter *droppedCounter = nullptr;
+static QAtomicInteger<qint64> benchmarkNanoseconds = 0;
+static QAtomicInteger<quint32> benchmarkThread = 0;
+
+static qint64 now()
+{
+    return logClock.nsecsElapsed() / 1000;
+}
+
+static ThreadBuffer *currentBuffer()
+{
+    if (bufferOwner.buffer)
+        return bufferOwner.buffer;
+    for (ThreadBuffer *buffer = buffers.loadAcquire(); buffer; buffer = buffer->next)
+        if (buffer->owned.testAndSetAcquire(0, 1))
+        {
+            bufferOwner.buffer = buffer;
+            break;
+        }
+    if (!bufferOwner.buffer)
+    {
+        auto buffer = new ThreadBuffer();
+        ThreadBuffer *first = nullptr;
+        do
+        {
+            first = buffers.loadAcquire();
+            buffer->next = first;
+        }
+        while (!buffers.testAndSetRelease(first, buffer));
+        bufferOwner.buffer = buffer;
+    }
+    bufferOwner.threadId = GetCurrentThreadId();
+    return bufferOwner.buffer;
+}
+
+Record *beginRecord(Severity severity, Category category, const char *format)
+{
+    ThreadBuffer *buffer = currentBuffer();
+    const quint32 head = buffer->head.load();
+    if (head - buffer->tail.loadAcquire() == kRingSize)
+    {
+        droppedCounter->add();
+        return nullptr;
+    }
+    Record *record = &buffer->records[head % kRingSize];
+    record->time = now();
+    record->format = format;
+    record->threadId = bufferOwner.threadId;
+    record->severity = severity;
+    record->category = category;
+    record->argumentCount = 0;
+    record->textSize = 0;
+    return record;
+}
+
+void commitRecord()
+{
+    ThreadBuffer *buffer = bufferOwner.buffer;
+    buffer->head.storeRelease(buffer->head.load() + 1);
+}
+
+void setArgument(Record *record, int index, const QString &text)
+{
+    Argument &argument = record->arguments[index];
+    argument.type = Argument::Text;
+    argument.textOffset = record->textSize;
+    argument.textSize = static_cast<quint8>(qMin(text.size(), kTextCapacity - record->textSize));
+    std::memcpy(record->text + argument.textOffset, text.utf16(), argument.textSize * sizeof(ushort));
+    record->textSize += argument.textSize;
+}
+
+static QString formatArgument(const Record &record, const Argument &argument)
+{
+    switch (argument.type)
+    {
+    case Argument::Int:
+        return QString::number(argument.i);
+    case Argument::UInt:
+        return QString::number(argument.u);
+    case Argument::Real:
+        return QString::number(argument.d, 'g', 6);
+    case Argument::Literal:
+        return QString::fromUtf8(argument.literal);
+    case Argument::Text:
+        return QString::fromUtf16(record.text + argument.textOffset, argument.textSize);
+    }
+    return QString();
+}
+
+static QByteArray formatLine(qint64 time, quint32 threadId, Severity severity, Category category, const QString &message)
+{
+    QByteArray line = clockStart.addMSecs(time / 1000).toString(QStringLiteral("yyyy-MM-dd hh:mm:ss.zzz")).toLatin1();
+    line += ' ';
+    line += kSeverityLetters[severity];
+    line += ' ';
+    line += QByteArray(kCategoryNames[category]).leftJustified(9);
+    line += QByteArray::number(threadId).rightJustified(6);
+    line += "  ";
+    line += message.toUtf8();
+    line += '\n';
+    return line;
+}
+
+// Replaces %1 to %6 in one pass, so that arguments containing a percent
+// sign are left alone.
+static QByteArray formatRecord(const Record &record)
+{
+    const QString format = QString::fromUtf8(record.format);
+    QString message;
+    message.reserve(format.size() + record.textSize + 16);
+    for (int i = 0; i != format.size(); ++i)
+    {
+        const int index = (i + 1 < format.size()) ? format.at(i + 1).digitValue() : -1;
+        if ((format.at(i) == QLatin1Char('%')) && (index >= 1) && (index <= record.argumentCount))
+        {
+            message += formatArgument(record, record.arguments[index - 1]);
+            ++i;
+        }
+        else
+            message += format.at(i);
+    }
+    return formatLine(record.time, record.threadId, record.severity, record.category, message);
+}
+
+static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &text)
+{
+    Severity severity = Debug;
+    switch (type)
+    {
+    case QtInfoMsg:
+        severity = Info;
+        break;
+    case QtWarningMsg:
+        severity = Warning;
+        break;
+    case QtCriticalMsg:
+    case QtFatalMsg:
+        severity = Error;
+        break;
+    default:
+        break;
+    }
+    if (isEnabled(severity, General))
+    {
+        QMutexLocker locker(&pendingMutex);
+        pendingMessages.append({now(), static_cast<quint32>(GetCurrentThreadId()), severity, text});
+    }
+    if (previousHandler)
+        previousHandler(type, context, text);
+}
+
+void Flusher::stop()
+{
+    QMutexLocker locker(&mutex);
+    stopping = true;
+    wakeUp.wakeOne();
+}
+
+void Flusher::run()
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    file.setFileName(fileName);
+    file.open(QIODevice::WriteOnly | QIODevice::Append);
+    QMutexLocker locker(&mutex);
+    while (!stopping)
+    {
+        locker.unlock();
+        flush();
+        locker.relock();
+        if (!stopping)
+            wakeUp.wait(&mutex, kFlushInterval);
+    }
+    locker.unlock();
+    flush();
+    file.close();
+}
+
+void Flusher::flush()
+{
+    QVector<Line> lines;
+    for (ThreadBuffer *buffer = buffers.loadAcquire(); buffer; buffer = buffer->next)
+    {
+        const quint32 head = buffer->head.loadAcquire();
+        quint32 tail = buffer->tail.load();
+        for (; tail != head; ++tail)
+        {
+            const Record &record = buffer->records[tail % kRingSize];
+            lines.append({record.time, formatRecord(record)});
+        }
+        buffer->tail.storeRelease(tail);
+    }
+    writtenCounter->add(static_cast<quint64>(lines.count()));
+    QVector<PendingMessage> messages;
+    {
+        QMutexLocker locker(&pendingMutex);
+        messages.swap(pendingMessages);
+    }
+    for (const PendingMessage &message : qAsConst(messages))
+        lines.append({message.time, formatLine(message.time, message.threadId, message.severity, General, message.text)});
+    if (!lines.isEmpty())
+        writeLines(lines);
+}
+
+void Flusher::writeLines(QVector<Line> &lines)
+{
+    // Every ring is in order already, this interleaves the threads.
+    std::stable_sort(lines.begin(), lines.end(), [](const Line &left, const Line &right)
+    {
+        return left.time < right.time;
+    });
+    for (const Line &line : qAsConst(lines))
+    {
+        if (file.size() >= kMaxFileSize)
+            rotate();
+        file.write(line.text);
+    }
+    file.flush();
+}
+
+void Flusher::rotate()
+{
+    file.close();
+    const QFileInfo info(fileName);
+    const QString base = info.absolutePath() + QLatin1Char('/') + info.completeBaseName();
+    const QString suffix = info.suffix().isEmpty() ? QString() : QLatin1Char('.') + info.suffix();
+    QFile::remove(base + QStringLiteral(".%1").arg(kMaxRotatedFiles) + suffix);
+    for (int i = kMaxRotatedFiles - 1; i >= 1; --i)
+        QFile::rename(base + QStringLiteral(".%1").arg(i) + suffix, base + QStringLiteral(".%1").arg(i + 1) + suffix);
+    QFile::rename(fileName, base + QStringLiteral(".1") + suffix);
+    file.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+static Severity parseSeverity(const QString &name)
+{
+    const QString severity = name.trimmed().toLower();
+    if (severity == QLatin1String("debug"))
+        return Debug;
+    if (severity == QLatin1String("info"))
+        return Info;
+    if (severity == QLatin1String("warning"))
+        return Warning;
+    if (severity == QLatin1String("error"))
+        return Error;
+    return Off;
+}
+
+void start(const QString &fileName, const QString &rules)
+{
+    if (flusher)
+        return;
+    MetricsRegistry *registry = MetricsRegistry::getInstance();
+    writtenCounter = registry->counter("dd_log_records_total", "Records written to the log file.");
+    droppedCounter = registry->counter("dd_log_dropped_total", "Records dropped because the ring of their thread was full.");
+    logClock.start();
+    clockStart = QDateTime::currentDateTime();
+    flusher = new Flusher(fileName);
+    flusher->start(QThread::LowPriority);
+    previousHandler = qInstallMessageHandler(messageHandler);
+    setFilter(rules);
+}
+
+void stop()
+{
+    if (!flusher)
+        return;
+    qInstallMessageHandler(previousHandler);
+    flusher->stop();
+    flusher->wait();
+    delete flusher;
+    flusher = nullptr;
+    for (auto &threshold : thresholds)
+        threshold.store(Off);
+}
+
+void setFilter(const QString &rules)
+{
+    const QStringList parts = rules.split(QLatin1Char(','), QString::SkipEmptyParts);
+    Severity severities[CategoryCount];
+    std::fill(std::begin(severities), std::end(severities), parts.isEmpty() ? Info : parseSeverity(parts.constFirst()));
+    for (int i = 1; i < parts.count(); ++i)
+    {
+        const QString category = parts.at(i).section(QLatin1Char('='), 0, 0).trimmed();
+        for (int j = 0; j != CategoryCount; ++j)
+            if (category.compare(QLatin1String(kCategoryNames[j]), Qt::CaseInsensitive) == 0)
+                severities[j] = parseSeverity(parts.at(i).section(QLatin1Char('='), 1));
+    }
+    // Nothing is recorded while the flusher isn't running.
+    for (int i = 0; i != CategoryCount; ++i)
+        thresholds[i].store(flusher ? severities[i] : Off);
+}
+
+QVariantHash statistics()
+{
+    QVariantHash stats;
+    if (!flusher)
+        return stats;
+    stats[QStringLiteral("log.written")] = writtenCounter->value();
+    stats[QStringLiteral("log.dropped")] = droppedCounter->value();
+    if (benchmarkThread.load() != 0)
+    {
+        stats[QStringLiteral("log.benchmarkThread")] = benchmarkThread.load();
+        stats[QStringLiteral("log.benchmarkCallNs")] = benchmarkNanoseconds.load();
+    }
+    return stats;
+}
+
+void benchmark()
+{
+    if (!flusher)
+        return;
+    // Straight to write(), the filter would skip the records otherwise.
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i != kBenchmarkCalls; ++i)
+        write(Debug, General, "Log benchmark call %1 of %2, %3 ms", i + 1, kBenchmarkCalls, 16.667);
+    const qint64 nanoseconds = timer.nsecsElapsed() / kBenchmarkCalls;
+    benchmarkNanoseconds.store(nanoseconds);
+    benchmarkThread.store(static_cast<quint32>(GetCurrentThreadId()));
+    DD_LOG_INFO(General, "A log call takes %1 ns on this thread", nanoseconds);
+}
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+// Diagnostics log of the player. A log call doesn't format anything: it
+// copies the format string's address, the raw arguments and a timestamp
+// into a ring buffer owned by the calling thread, without locks or
+// allocations. A flusher thread formats the records of all threads every
+// so often and appends them to a log file that is rotated when it gets
+// big. A full ring drops the record and counts it, so a log call never
+// waits for the disk. Qt's own messages (qDebug() and friends, QtAV and
+// the 3rdparty code included) end up in the same file. Building with
+// CONFIG+=no_logging defines DD_NO_LOGGING, which turns the macros below
+// into nothing and leaves logger.cpp out of the build.
+
+#ifndef DD_NO_LOGGING
+
+#include <QAtomicInt>
+#include <QString>
+#include <QVariantHash>
+
+#include <initializer_list>
+#include <type_traits>
+
+namespace Log
+{
+
+enum Severity : quint8
+{
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off
+};
+
+enum Category : quint8
+{
+    General,
+    Playback,
+    Decoder,
+    Renderer,
+    Input,
+    Control,
+    CategoryCount
+};
+
+const int kMaxArguments = 6;
+// UTF-16 code units of string arguments a record can hold, longer
+// strings are cut.
+const int kTextCapacity = 96;
+
+struct Argument
+{
+    enum Type : quint8
+    {
+        Int,
+        UInt,
+        Real,
+        Literal,
+        Text
+    };
+    Type type;
+    quint8 textOffset, textSize;
+    union
+    {
+        qint64 i;
+        quint64 u;
+        double d;
+        const char *literal;
+    };
+};
+
+struct Record
+{
+    qint64 time;
+    const char *format;
+    quint32 threadId;
+    Severity severity;
+    Category category;
+    quint8 argumentCount, textSize;
+    Argument arguments[kMaxArguments];
+    ushort text[kTextCapacity];
+};
+
+// Lowest severity that is logged, per category. Everything is off until
+// start() is called.
+extern QAtomicInt thresholds[CategoryCount];
+
+inline bool isEnabled(Severity severity, Category category)
+{
+    return severity >= thresholds[category].load();
+}
+
+// Starts the flusher and takes over Qt's message handler. The rules are
+// a default severity optionally followed by severities per category,
+// like "info,decoder=debug,renderer=off".
+void start(const QString &fileName, const QString &rules = QStringLiteral("info"));
+void stop();
+void setFilter(const QString &rules);
+QVariantHash statistics();
+// Measures the cost of log calls on the calling thread, the result is
+// logged and shows up in the statistics.
+void benchmark();
+
+// Returns nullptr if the ring of the calling thread is full.
+Record *beginRecord(Severity severity, Category category, const char *format);
+void commitRecord();
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type setArgument(Record *record, int index, T value)
+{
+    record->arguments[index].type = Argument::Int;
+    record->arguments[index].i = value;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type setArgument(Record *record, int index, T value)
+{
+    record->arguments[index].type = Argument::UInt;
+    record->arguments[index].u = value;
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type setArgument(Record *record, int index, T value)
+{
+    record->arguments[index].type = Argument::Real;
+    record->arguments[index].d = value;
+}
+
+// Only for string literals, the flusher reads them much later.
+inline void setArgument(Record *record, int index, const char *literal)
+{
+    record->arguments[index].type = Argument::Literal;
+    record->arguments[index].literal = literal;
+}
+
+void setArgument(Record *record, int index, const QString &text);
+
+template <typename... Arguments>
+void write(Severity severity, Category category, const char *format, const Arguments &... arguments)
+{
+    static_assert(sizeof...(Arguments) <= kMaxArguments, "Too many arguments for a log record");
+    Record *record = beginRecord(severity, category, format);
+    if (record == nullptr)
+        return;
+    int index = 0;
+    (void)std::initializer_list<int>{(setArgument(record, index++, arguments), 0)...};
+    Q_UNUSED(index)
+    record->argumentCount = static_cast<quint8>(sizeof...(Arguments));
+    commitRecord();
+}
+
+}
+
+// Placeholders in the format are %1 to %6, like QString::arg().
+#define DD_LOG(severity, category, ...) \
+    do { if (Log::isEnabled(Log::severity, Log::category)) Log::write(Log::severity, Log::category, __VA_ARGS__); } while (false)
+#else
+#define DD_LOG(severity, category, ...) do {} while (false)
+#endif
+
+#define DD_LOG_DEBUG(category, ...) DD_LOG(Debug, category, __VA_ARGS__)
+#define DD_LOG_INFO(category, ...) DD_LOG(Info, category, __VA_ARGS__)
+#define DD_LOG_WARNING(category, ...) DD_LOG(Warning, category, __VA_ARGS__)
+#define DD_LOG_ERROR(category, ...) DD_LOG(Error, category, __VA_ARGS__)
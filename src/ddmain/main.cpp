@@ -10,6 +10,10 @@
 #include "forms/traymenu.h"
 #endif
 #include "playerwindow.h"
+#include "controlprotocol.h"
+#include "controlserver.h"
+#include "logger.h"
+#include "metricsserver.h"
 #include <QtSingleApplication>
 #include "forms/playlistdialog.h"
 
@@ -70,6 +74,10 @@ void installTranslation(const QString &lang, const QTranslator &translator)
 
 int main(int argc, char *argv[])
 {
+    // Hand over to a running instance before the settings and the GUI
+    // plugins are loaded, duplicate launches at login should be cheap.
+    if (QtSingleApplication::sendToRunningInstance(ControlProtocol::applicationId(), QStringLiteral("show")))
+        return 0;
     QtSingleApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QtSingleApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
     const QString openglType = SettingsManager::getInstance()->getOpenGLType();
@@ -79,18 +87,28 @@ int main(int argc, char *argv[])
         QtSingleApplication::setAttribute(Qt::AA_UseOpenGLES);
     else if (openglType == QLatin1String("sw"))
         QtSingleApplication::setAttribute(Qt::AA_UseSoftwareOpenGL);
-    QtSingleApplication app(QStringLiteral("wangwenx190.DynamicDesktop.Main.1000.AppMutex"), argc, argv);
+    // Puts every renderer's context into one share group, so that the
+    // upload buffers and textures of the old renderer stay usable by the
+    // new one while they are retired (see PboUploader::setGLWidget()).
+    // Shader programs still belong to each renderer, ShaderCache loads
+    // them from disk instead of compiling them again.
+    QtSingleApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+    QtSingleApplication app(ControlProtocol::applicationId(), argc, argv);
     QtSingleApplication::setApplicationName(QStringLiteral("Dynamic Desktop"));
     QtSingleApplication::setApplicationDisplayName(QStringLiteral("Dynamic Desktop"));
     QtSingleApplication::setOrganizationName(QStringLiteral("wangwenx190"));
     QtSingleApplication::setOrganizationDomain(QStringLiteral("wangwenx190.github.io"));
     if (app.sendMessage(QStringLiteral("show")))
         return 0;
+#ifndef DD_NO_LOGGING
+    Log::start(QtSingleApplication::applicationDirPath() + QStringLiteral("/logs/ddmain.log"), SettingsManager::getInstance()->getLogFilter());
+#endif
 #ifndef DD_NO_TRANSLATIONS
     QTranslator ddTranslator;
     installTranslation(SettingsManager::getInstance()->getLanguage(), ddTranslator);
 #endif
-    bool windowMode = false;
+    bool windowMode = false, logBenchmark = false;
+    QString frameSinkLog;
 #ifndef DD_NO_COMMANDLINE_PARSER
     QCommandLineParser parser;
     parser.setApplicationDescription(DD_OBJ_TR("A tool that make your desktop alive."));
@@ -113,16 +131,33 @@ int main(int argc, char *argv[])
                                           DD_APP_TR("main", "Set the quality of the output image. It can be default/best/fastest. Default is best. Case insensitive."),
                                           DD_APP_TR("main", "Image quality"));
     parser.addOption(imageQualityOption);
+    QCommandLineOption decodeProfileOption(QStringLiteral("decode"),
+                                           DD_APP_TR("main", "Set decoding profile. It can be default/eco. Default is default. Case insensitive."),
+                                           DD_APP_TR("main", "Decoding profile"));
+    parser.addOption(decodeProfileOption);
     QCommandLineOption rendererOption(QStringLiteral("renderer"),
-                                      DD_APP_TR("main", "Set rendering engine. It can be opengl/gl/qt/gdi/d2d. Default is gl. Case insensitive."),
+                                      DD_APP_TR("main", "Set rendering engine. It can be opengl/gl/qt/gdi/d2d/sw. Default is gl. Case insensitive."),
                                       DD_APP_TR("main", "renderer"));
     parser.addOption(rendererOption);
     QCommandLineOption volumeOption(QStringLiteral("volume"),
                                     DD_APP_TR("main", "Set volume. It must be a positive integer between 0 and 99. Default is 9."),
                                     DD_APP_TR("main", "volume"));
     parser.addOption(volumeOption);
+    QCommandLineOption frameSinkOption(QStringLiteral("frame-sink"),
+                                       DD_APP_TR("main", "Decode without displaying anything and write the timestamp and hash of every frame to the given file. For benchmarks and regression tests."),
+                                       DD_APP_TR("main", "file"));
+    parser.addOption(frameSinkOption);
+#ifndef DD_NO_LOGGING
+    QCommandLineOption logBenchmarkOption(QStringLiteral("log-benchmark"),
+                                          DD_APP_TR("main", "Measure the cost of a log call on the video thread whenever a file starts playing. The result is written to the log and the statistics."));
+    parser.addOption(logBenchmarkOption);
+#endif
     parser.process(app);
     windowMode = parser.isSet(windowModeOption);
+#ifndef DD_NO_LOGGING
+    logBenchmark = parser.isSet(logBenchmarkOption);
+#endif
+    frameSinkLog = parser.value(frameSinkOption);
 #ifndef DD_NO_CSS
     QString skinOptionValue = parser.value(skinOption);
     if (!skinOptionValue.isEmpty())
@@ -140,6 +175,12 @@ int main(int argc, char *argv[])
              (imageQualityOptionValue == QLatin1String("fastest"))) &&
                 (imageQualityOptionValue != SettingsManager::getInstance()->getImageQuality()))
             SettingsManager::getInstance()->setImageQuality(imageQualityOptionValue);
+    QString decodeProfileOptionValue = parser.value(decodeProfileOption).toLower();
+    if (!decodeProfileOptionValue.isEmpty())
+        if (((decodeProfileOptionValue == QLatin1String("default")) ||
+             (decodeProfileOptionValue == QLatin1String("eco"))) &&
+                (decodeProfileOptionValue != SettingsManager::getInstance()->getDecodeProfile()))
+            SettingsManager::getInstance()->setDecodeProfile(decodeProfileOptionValue);
     QString rendererOptionValue = parser.value(rendererOption).toLower();
     if (!rendererOptionValue.isEmpty())
         if ((rendererOptionValue == QLatin1String("opengl")) &&
@@ -157,6 +198,9 @@ int main(int argc, char *argv[])
         else if ((rendererOptionValue == QLatin1String("d2d")) &&
                  (SettingsManager::getInstance()->getRenderer() != Utils::getVideoRendererId(Utils::VideoRendererId::Direct2D)))
             SettingsManager::getInstance()->setRenderer(Utils::getVideoRendererId(Utils::VideoRendererId::Direct2D));
+        else if ((rendererOptionValue == QLatin1String("sw")) &&
+                 (SettingsManager::getInstance()->getRenderer() != Utils::getVideoRendererId(Utils::VideoRendererId::Software)))
+            SettingsManager::getInstance()->setRenderer(Utils::getVideoRendererId(Utils::VideoRendererId::Software));
     QString volumeOptionValue = parser.value(volumeOption);
     if (!volumeOptionValue.isEmpty())
     {
@@ -179,6 +223,9 @@ int main(int argc, char *argv[])
 #endif
     QSystemTrayIcon trayIcon;
     playerWindow.setWindowMode(windowMode);
+    if (!frameSinkLog.isEmpty())
+        playerWindow.setFrameSink(frameSinkLog);
+    playerWindow.setLogBenchmark(logBenchmark);
 #ifndef DD_NO_SVG
     trayIcon.setIcon(QIcon(QStringLiteral(":/icons/color_palette.svg")));
 #else
@@ -197,6 +244,8 @@ int main(int argc, char *argv[])
     QObject::connect(&preferencesDialog, &PreferencesDialog::muteChanged, &trayMenu, &TrayMenu::setMute);
     QObject::connect(&preferencesDialog, &PreferencesDialog::about, &trayMenu, &TrayMenu::onAboutClicked);
     QObject::connect(&playerWindow, &PlayerWindow::playStateChanged, &trayMenu, &TrayMenu::setPlaying);
+    QObject::connect(&playerWindow, &PlayerWindow::debugOverlayChanged, &trayMenu, &TrayMenu::setDebugOverlay);
+    QObject::connect(&trayMenu, &TrayMenu::onDebugOverlayToggled, &playerWindow, &PlayerWindow::setDebugOverlay);
     QObject::connect(&trayMenu, &TrayMenu::onOptionsClicked, [=, &preferencesDialog]
     {
         Utils::activateWindow(&preferencesDialog);
@@ -272,12 +321,16 @@ int main(int argc, char *argv[])
     QObject::connect(&preferencesDialog, &PreferencesDialog::audioFileChanged, &playerWindow, &PlayerWindow::setAudio);
     QObject::connect(&preferencesDialog, &PreferencesDialog::subtitleFileChanged, &playerWindow, &PlayerWindow::setSubtitle);
     QObject::connect(&preferencesDialog, &PreferencesDialog::volumeChanged, &playerWindow, &PlayerWindow::setVolume);
+    QObject::connect(&preferencesDialog, &PreferencesDialog::muteChanged, &playerWindow, &PlayerWindow::setMute);
     QObject::connect(&preferencesDialog, &PreferencesDialog::seek, &playerWindow, &PlayerWindow::seek);
     QObject::connect(&preferencesDialog, &PreferencesDialog::videoTrackChanged, &playerWindow, &PlayerWindow::setVideoTrack);
     QObject::connect(&preferencesDialog, &PreferencesDialog::audioTrackChanged, &playerWindow, &PlayerWindow::setAudioTrack);
     QObject::connect(&preferencesDialog, &PreferencesDialog::subtitleTrackChanged, &playerWindow, &PlayerWindow::setSubtitleTrack);
     QObject::connect(&preferencesDialog, &PreferencesDialog::rendererChanged, &playerWindow, &PlayerWindow::setRenderer);
     QObject::connect(&preferencesDialog, &PreferencesDialog::imageQualityChanged, &playerWindow, &PlayerWindow::setImageQuality);
+    QObject::connect(&preferencesDialog, &PreferencesDialog::decodeProfileChanged, &playerWindow, &PlayerWindow::setDecodeProfile);
+    QObject::connect(&preferencesDialog, &PreferencesDialog::qualityBudgetChanged, &playerWindow, &PlayerWindow::setQualityBudget);
+    QObject::connect(&preferencesDialog, &PreferencesDialog::readabilityOverlayChanged, &playerWindow, &PlayerWindow::setReadabilityOverlay);
     QObject::connect(&preferencesDialog, &PreferencesDialog::charsetChanged, &playerWindow, &PlayerWindow::setCharset);
     QObject::connect(&preferencesDialog, &PreferencesDialog::subtitleAutoLoadChanged, &playerWindow, &PlayerWindow::setSubtitleAutoLoad);
     QObject::connect(&preferencesDialog, &PreferencesDialog::subtitleEnableChanged, &playerWindow, &PlayerWindow::setSubtitleEnabled);
@@ -285,8 +338,8 @@ int main(int argc, char *argv[])
     QObject::connect(&preferencesDialog, &PreferencesDialog::repeatCurrentFile, &playerWindow, &PlayerWindow::setRepeatCurrentFile);
     QObject::connect(&playerWindow, &PlayerWindow::playStateChanged, &preferencesDialog, &PreferencesDialog::setPlaying);
     QObject::connect(&playerWindow, &PlayerWindow::mediaEndReached, &preferencesDialog, &PreferencesDialog::mediaEndReached);
-    QObject::connect(&playerWindow, &PlayerWindow::mediaPositionChanged, &preferencesDialog, &PreferencesDialog::setMediaSliderPosition);
-    QObject::connect(&playerWindow, &PlayerWindow::videoPositionTextChanged, &preferencesDialog, &PreferencesDialog::setVideoPositionText);
+    QObject::connect(&playerWindow, &PlayerWindow::telemetryChanged, &preferencesDialog, &PreferencesDialog::setTelemetry);
+    playerWindow.addTelemetryView(&preferencesDialog);
     QObject::connect(&playerWindow, &PlayerWindow::audioAreaEnableChanged, &preferencesDialog, &PreferencesDialog::setAudioAreaEnabled);
     QObject::connect(&playerWindow, &PlayerWindow::clearAllTracks, &preferencesDialog, &PreferencesDialog::clearAllTracks);
     QObject::connect(&playerWindow, &PlayerWindow::mediaSliderUnitChanged, &preferencesDialog, &PreferencesDialog::setMediaSliderUnit);
@@ -295,12 +348,23 @@ int main(int argc, char *argv[])
     QObject::connect(&playerWindow, &PlayerWindow::videoTracksChanged, &preferencesDialog, &PreferencesDialog::setVideoTracks);
     QObject::connect(&playerWindow, &PlayerWindow::audioTracksChanged, &preferencesDialog, &PreferencesDialog::setAudioTracks);
     QObject::connect(&playerWindow, &PlayerWindow::subtitleTracksChanged, &preferencesDialog, &PreferencesDialog::setSubtitleTracks);
-    QObject::connect(&playerWindow, &PlayerWindow::videoDurationTextChanged, &preferencesDialog, &PreferencesDialog::setVideoDurationText);
     QObject::connect(&playlistDialog, &PlaylistDialog::dataRefreshed, &preferencesDialog, &PreferencesDialog::refreshPlaylistsAndFiles);
     QObject::connect(&playlistDialog, &PlaylistDialog::switchPlaylist, &preferencesDialog, &PreferencesDialog::switchPlaylist);
     QObject::connect(&playlistDialog, &PlaylistDialog::playFile, &preferencesDialog, &PreferencesDialog::switchFile);
-    QObject::connect(qApp, &QtSingleApplication::aboutToQuit, [=]
+    ControlServer controlServer(&app, &playerWindow, &preferencesDialog);
+    // The server answers on a thread of its own.
+    QObject::connect(&controlServer, &ControlServer::showRequested, &app, [=, &app]
     {
+        emit app.messageReceived(QStringLiteral("show"));
+    });
+    MetricsServer metricsServer;
+    metricsServer.listen(static_cast<quint16>(SettingsManager::getInstance()->getMetricsPort()));
+    QObject::connect(qApp, &QtSingleApplication::aboutToQuit, [=, &playerWindow]
+    {
+        // Ends up next to the frame sink's records in benchmark runs.
+        const QVariantHash stats = playerWindow.statistics();
+        DD_LOG_INFO(Playback, "Audio pipeline suspended for %1 ms, %2 ms of CPU time saved",
+                    stats.value(QStringLiteral("audio.suspendedTime")).toLongLong(), stats.value(QStringLiteral("audio.cpuSaved")).toLongLong());
         Wallpaper::hideWallpaper();
     });
     trayIcon.show();
@@ -344,5 +408,9 @@ int main(int argc, char *argv[])
         trayIcon.setToolTip(QStringLiteral("Dynamic Desktop: %0").arg(url));
 #endif
     }
-    return QtSingleApplication::exec();
+    const int exitCode = QtSingleApplication::exec();
+#ifndef DD_NO_LOGGING
+    Log::stop();
+#endif
+    return exitCode;
 }
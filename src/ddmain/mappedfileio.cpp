@@ -0,0 +1,235 @@
+#include "mappedfileio.h"
+#include "logger.h"
+#include "stagetiming.h"
+#include "utils.h"
+
+#include <QAtomicInteger>
+#include <QDir>
+#include <QFileInfo>
+
+#include <Windows.h>
+
+// How far ahead of the read position the first pass prefetches.
+const qint64 kPrefetchWindow = 32 * 1024 * 1024;
+
+namespace
+{
+
+QAtomicInteger<quint64> bytesRead = 0;
+QAtomicInteger<quint64> readCalls = 0;
+QAtomicInteger<quint64> pageFaults = 0;
+QAtomicInteger<quint64> prefetchCalls = 0;
+QAtomicInteger<quint64> mappedFiles = 0;
+QAtomicInteger<quint64> mapFailures = 0;
+QAtomicInteger<quint64> unfixedFiles = 0;
+QAtomicInteger<quint64> readErrors = 0;
+
+// Only declared for Windows 8 and newer, resolved at runtime.
+struct MemoryRangeEntry
+{
+    PVOID virtualAddress;
+    SIZE_T numberOfBytes;
+};
+typedef BOOL (WINAPI *PrefetchVirtualMemoryProc)(HANDLE process, ULONG_PTR numberOfEntries, MemoryRangeEntry *entries, ULONG flags);
+
+PrefetchVirtualMemoryProc prefetchVirtualMemory()
+{
+    static const auto proc = reinterpret_cast<PrefetchVirtualMemoryProc>(
+                GetProcAddress(GetModuleHandleW(L"Kernel32.dll"), "PrefetchVirtualMemory"));
+    return proc;
+}
+
+// Files on removable and network drives can go away while they are
+// mapped, which a read through the mapping can't report.
+bool isOnFixedVolume(const QString &path)
+{
+    const QString nativePath = QDir::toNativeSeparators(QFileInfo(path).absoluteFilePath());
+    wchar_t root[MAX_PATH];
+    if (!GetVolumePathNameW(reinterpret_cast<const wchar_t *>(nativePath.utf16()), root, MAX_PATH))
+        return false;
+    return GetDriveTypeW(root) == DRIVE_FIXED;
+}
+
+// A page that can't be read from disk raises EXCEPTION_IN_PAGE_ERROR on
+// access. Kept apart from everything with a destructor, which can't
+// share a function with __try.
+bool copyMapped(char *destination, const uchar *source, qint64 length)
+{
+#ifdef _MSC_VER
+    __try
+    {
+        memcpy(destination, source, static_cast<size_t>(length));
+    }
+    __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+    {
+        return false;
+    }
+#else
+    memcpy(destination, source, static_cast<size_t>(length));
+#endif
+    return true;
+}
+
+}
+
+MappedFileIO::MappedFileIO(QObject *parent) : QtAV::MediaIO(parent)
+{
+}
+
+MappedFileIO::~MappedFileIO()
+{
+    unmap();
+}
+
+QString MappedFileIO::name() const
+{
+    return QStringLiteral("DDMappedFile");
+}
+
+bool MappedFileIO::isSeekable() const
+{
+    return true;
+}
+
+qint64 MappedFileIO::read(char *data, qint64 maxSize)
+{
+    DD_STAGE_SCOPE(Demux);
+    if (!this->data || (maxSize <= 0))
+        return -1;
+    const qint64 length = qMin(maxSize, fileSize - readPosition);
+    if (length <= 0)
+        return 0;
+    const qint64 end = readPosition + length;
+    const bool firstPass = end > touchedEnd;
+    // First pass, the pages may still have to be read from disk.
+    if (firstPass && (prefetchedEnd < fileSize) && (end > prefetchedEnd - kPrefetchWindow / 2))
+    {
+        countPageFaults();
+        prefetch(end + kPrefetchWindow);
+    }
+    if (!copyMapped(data, this->data + readPosition, length))
+    {
+        readErrors.fetchAndAddRelaxed(1);
+        DD_LOG_WARNING(Input, "Reading %1 bytes at %2 of the mapped file failed", length, readPosition);
+        return -1;
+    }
+    if (firstPass)
+    {
+        touchedEnd = end;
+        if (touchedEnd == fileSize)
+            countPageFaults();
+    }
+    readPosition = end;
+    bytesRead.fetchAndAddRelaxed(length);
+    readCalls.fetchAndAddRelaxed(1);
+    return length;
+}
+
+bool MappedFileIO::seek(qint64 offset, int from)
+{
+    qint64 position = offset;
+    if (from == SEEK_CUR)
+        position += readPosition;
+    else if (from == SEEK_END)
+        position += fileSize;
+    if ((position < 0) || (position > fileSize))
+        return false;
+    readPosition = position;
+    return true;
+}
+
+qint64 MappedFileIO::position() const
+{
+    return readPosition;
+}
+
+qint64 MappedFileIO::size() const
+{
+    return fileSize;
+}
+
+bool MappedFileIO::isMapped() const
+{
+    return data != nullptr;
+}
+
+QVariantHash MappedFileIO::statistics()
+{
+    QVariantHash stats;
+    stats[QStringLiteral("io.bytesRead")] = bytesRead.load();
+    stats[QStringLiteral("io.reads")] = readCalls.load();
+    stats[QStringLiteral("io.pageFaults")] = pageFaults.load();
+    stats[QStringLiteral("io.prefetches")] = prefetchCalls.load();
+    stats[QStringLiteral("io.mappedFiles")] = mappedFiles.load();
+    stats[QStringLiteral("io.mapFailures")] = mapFailures.load();
+    stats[QStringLiteral("io.unfixedFiles")] = unfixedFiles.load();
+    stats[QStringLiteral("io.readErrors")] = readErrors.load();
+    return stats;
+}
+
+void MappedFileIO::onUrlChanged()
+{
+    unmap();
+    const QString path = url();
+    if (path.isEmpty())
+        return;
+    // Left to FFmpeg's file protocol, whose reads fail with an error
+    // code instead.
+    if (!isOnFixedVolume(path))
+    {
+        unfixedFiles.fetchAndAddRelaxed(1);
+        return;
+    }
+    file.setFileName(path);
+    if (!file.open(QFile::ReadOnly))
+        return;
+    fileSize = file.size();
+    // Fails for files larger than the address space of 32-bit builds,
+    // the caller then falls back to FFmpeg's file protocol.
+    data = fileSize > 0 ? file.map(0, fileSize) : nullptr;
+    if (!data)
+    {
+        mapFailures.fetchAndAddRelaxed(1);
+        file.close();
+        fileSize = 0;
+        return;
+    }
+    mappedFiles.fetchAndAddRelaxed(1);
+    faultsSampled = Utils::getProcessPageFaults();
+    prefetch(kPrefetchWindow);
+}
+
+void MappedFileIO::unmap()
+{
+    if (data)
+        file.unmap(data);
+    data = nullptr;
+    if (file.isOpen())
+        file.close();
+    fileSize = readPosition = touchedEnd = prefetchedEnd = 0;
+}
+
+void MappedFileIO::countPageFaults()
+{
+    // Sampled once per prefetch window, the counter costs a system call.
+    // It is the one of the process, during the first pass most of the
+    // faults are those of the copies above.
+    const quint64 faults = Utils::getProcessPageFaults();
+    pageFaults.fetchAndAddRelaxed(faults - faultsSampled);
+    faultsSampled = faults;
+}
+
+void MappedFileIO::prefetch(qint64 end)
+{
+    end = qMin(end, fileSize);
+    if (!data || (end <= prefetchedEnd))
+        return;
+    const PrefetchVirtualMemoryProc proc = prefetchVirtualMemory();
+    if (proc)
+    {
+        MemoryRangeEntry range = {data + prefetchedEnd, static_cast<SIZE_T>(end - prefetchedEnd)};
+        proc(GetCurrentProcess(), 1, &range, 0);
+        prefetchCalls.fetchAndAddRelaxed(1);
+    }
+    prefetchedEnd = end;
+}
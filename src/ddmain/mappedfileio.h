@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QtAV/MediaIO.h>
+#include <QFile>
+#include <QVariantHash>
+
+// Demuxer input for local files that maps the whole file into memory.
+// Packets are plain memory copies, so loop playback is served from the
+// page cache without a single system call. The first pass prefetches
+// ahead of the read position, which is the Windows counterpart of
+// POSIX_FADV_WILLNEED. Only files on fixed drives are mapped.
+class MappedFileIO : public QtAV::MediaIO
+{
+    Q_OBJECT
+
+public:
+    explicit MappedFileIO(QObject *parent = nullptr);
+    ~MappedFileIO() override;
+
+public:
+    QString name() const override;
+    bool isSeekable() const override;
+    qint64 read(char *data, qint64 maxSize) override;
+    bool seek(qint64 offset, int from = SEEK_SET) override;
+    qint64 position() const override;
+    qint64 size() const override;
+    bool isMapped() const;
+    // Counters of all instances.
+    static QVariantHash statistics();
+
+protected:
+    void onUrlChanged() override;
+
+private:
+    void unmap();
+    void countPageFaults();
+    void prefetch(qint64 end);
+
+private:
+    QFile file;
+    uchar *data = nullptr;
+    qint64 fileSize = 0, readPosition = 0;
+    // Everything below has been read at least once and is resident.
+    qint64 touchedEnd = 0, prefetchedEnd = 0;
+    quint64 faultsSampled = 0;
+
+private:
+    Q_DISABLE_COPY(MappedFileIO)
+};
@@ -0,0 +1,190 @@
+#include "metrics.h"
+#include "logger.h"
+#include "utils.h"
+
+#include <cstring>
+
+const qreal kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+static QByteArray formatValue(qreal value)
+{
+    return QByteArray::number(value, 'g', 12);
+}
+
+static QByteArray escapeLabel(const QString &value)
+{
+    QByteArray escaped = value.toUtf8();
+    escaped.replace('\\', "\\\\");
+    escaped.replace('"', "\\\"");
+    escaped.replace('\n', "\\n");
+    return escaped;
+}
+
+void MetricGauge::set(qreal value)
+{
+    quint64 data = 0;
+    std::memcpy(&data, &value, sizeof(data));
+    bits.store(data);
+}
+
+qreal MetricGauge::value() const
+{
+    const quint64 data = bits.load();
+    qreal value = 0.0;
+    std::memcpy(&value, &data, sizeof(value));
+    return value;
+}
+
+MetricsRegistry *MetricsRegistry::getInstance()
+{
+    static MetricsRegistry metricsRegistry;
+    return &metricsRegistry;
+}
+
+MetricsRegistry::MetricsRegistry(QObject *parent) : QObject(parent)
+{
+    counter("dd_process_cpu_seconds_total", "CPU time of the whole process.");
+    gauge("dd_process_resident_memory_bytes", "Working set of the process.");
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+    for (int i = 0; i != entryCount.load(); ++i)
+        switch (entries[i].type)
+        {
+        case Counter:
+            delete static_cast<MetricCounter *>(entries[i].metric);
+            break;
+        case Gauge:
+            delete static_cast<MetricGauge *>(entries[i].metric);
+            break;
+        case Summary:
+            delete static_cast<Histogram *>(entries[i].metric);
+            break;
+        }
+}
+
+MetricCounter *MetricsRegistry::counter(const char *name, const char *help)
+{
+    return static_cast<MetricCounter *>(find(Counter, name, help));
+}
+
+MetricGauge *MetricsRegistry::gauge(const char *name, const char *help)
+{
+    return static_cast<MetricGauge *>(find(Gauge, name, help));
+}
+
+Histogram *MetricsRegistry::summary(const char *name, const char *help)
+{
+    return static_cast<Histogram *>(find(Summary, name, help));
+}
+
+void *MetricsRegistry::find(Type type, const char *name, const char *help)
+{
+    QMutexLocker locker(&registrationMutex);
+    const int count = entryCount.load();
+    for (int i = 0; i != count; ++i)
+        if (entries[i].name == name)
+            return entries[i].type == type ? entries[i].metric : unregistered(type, name, "its name is taken by a metric of another type");
+    if (count == kMaxEntries)
+        return unregistered(type, name, "the registry is full");
+    Entry &entry = entries[count];
+    entry.type = type;
+    entry.name = name;
+    entry.help = help;
+    switch (type)
+    {
+    case Counter:
+        entry.metric = new MetricCounter;
+        break;
+    case Gauge:
+        entry.metric = new MetricGauge;
+        break;
+    case Summary:
+        entry.metric = new Histogram;
+        break;
+    }
+    // Scrapes only look at entries below the published count.
+    entryCount.storeRelease(count + 1);
+    return entry.metric;
+}
+
+void *MetricsRegistry::unregistered(Type type, const char *name, const char *problem)
+{
+    DD_LOG_WARNING(General, "Metric %1 is not exported: %2", name, problem);
+    switch (type)
+    {
+    case Counter:
+        return &unregisteredCounter;
+    case Gauge:
+        return &unregisteredGauge;
+    case Summary:
+        return &unregisteredSummary;
+    }
+    return nullptr;
+}
+
+void MetricsRegistry::setInfo(const char *name, const char *help, const Labels &labels)
+{
+    Info &info = infos[name];
+    info.help = help;
+    info.labels = labels;
+}
+
+QByteArray MetricsRegistry::prometheusText()
+{
+    counter("dd_process_cpu_seconds_total", "")->set(static_cast<quint64>(Utils::getProcessCpuTime()));
+    gauge("dd_process_resident_memory_bytes", "")->set(Utils::getProcessWorkingSet());
+    emit aboutToCollect();
+    QByteArray text;
+    text.reserve(8192);
+    const int count = entryCount.loadAcquire();
+    for (int i = 0; i != count; ++i)
+    {
+        const Entry &entry = entries[i];
+        text += "# HELP " + entry.name + ' ' + entry.help + '\n';
+        switch (entry.type)
+        {
+        case Counter:
+        {
+            const quint64 value = static_cast<const MetricCounter *>(entry.metric)->value();
+            text += "# TYPE " + entry.name + " counter\n";
+            // Time counters are kept in milliseconds.
+            if (entry.name.endsWith("_seconds_total"))
+                text += entry.name + ' ' + formatValue(value / 1000.0) + '\n';
+            else
+                text += entry.name + ' ' + QByteArray::number(value) + '\n';
+            break;
+        }
+        case Gauge:
+            text += "# TYPE " + entry.name + " gauge\n";
+            text += entry.name + ' ' + formatValue(static_cast<const MetricGauge *>(entry.metric)->value()) + '\n';
+            break;
+        case Summary:
+        {
+            const auto histogram = static_cast<const Histogram *>(entry.metric);
+            text += "# TYPE " + entry.name + " summary\n";
+            for (qreal quantile : kQuantiles)
+                text += entry.name + "{quantile=\"" + formatValue(quantile) + "\"} "
+                        + formatValue(histogram->percentile(quantile) / 1000000.0) + '\n';
+            text += entry.name + "_sum " + formatValue(histogram->sum() / 1000000.0) + '\n';
+            text += entry.name + "_count " + QByteArray::number(histogram->count()) + '\n';
+            break;
+        }
+        }
+    }
+    for (auto it = infos.constBegin(); it != infos.constEnd(); ++it)
+    {
+        text += "# HELP " + it.key() + ' ' + it.value().help + '\n';
+        text += "# TYPE " + it.key() + " gauge\n";
+        text += it.key() + '{';
+        for (int i = 0; i != it.value().labels.count(); ++i)
+        {
+            if (i > 0)
+                text += ',';
+            text += it.value().labels.at(i).first + "=\"" + escapeLabel(it.value().labels.at(i).second) + '"';
+        }
+        text += "} 1\n";
+    }
+    return text;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "histogram.h"
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QVector>
+
+class MetricCounter
+{
+public:
+    void add(quint64 value = 1) { count.fetchAndAddRelaxed(value); }
+    // For counters that are kept elsewhere and mirrored when collecting.
+    void set(quint64 value) { count.store(value); }
+    quint64 value() const { return count.load(); }
+
+private:
+    QAtomicInteger<quint64> count = 0;
+};
+
+class MetricGauge
+{
+public:
+    void set(qreal value);
+    qreal value() const;
+
+private:
+    QAtomicInteger<quint64> bits = 0;
+};
+
+// Process wide metrics, scraped in the Prometheus text format. Metrics are
+// created once and live until the process exits, so recording a value is
+// a single relaxed atomic operation and reading them never takes a lock.
+// Summaries are histograms of microseconds and counters whose name ends
+// in "_seconds_total" count milliseconds, both are exported in seconds.
+// Info metrics carry strings in their labels, they and prometheusText()
+// belong to the GUI thread.
+class MetricsRegistry : public QObject
+{
+    Q_OBJECT
+
+signals:
+    // Emitted before every scrape, for values that are cheaper to pull
+    // than to push.
+    void aboutToCollect();
+
+public:
+    using Labels = QVector<QPair<QByteArray, QString>>;
+    static MetricsRegistry *getInstance();
+
+public:
+    // Returns the existing metric if the name is taken already.
+    MetricCounter *counter(const char *name, const char *help);
+    MetricGauge *gauge(const char *name, const char *help);
+    Histogram *summary(const char *name, const char *help);
+    void setInfo(const char *name, const char *help, const Labels &labels);
+    QByteArray prometheusText();
+
+private:
+    enum Type
+    {
+        Counter,
+        Gauge,
+        Summary
+    };
+    struct Entry
+    {
+        Type type;
+        QByteArray name, help;
+        void *metric;
+    };
+    struct Info
+    {
+        QByteArray help;
+        Labels labels;
+    };
+    static const int kMaxEntries = 128;
+
+    explicit MetricsRegistry(QObject *parent = nullptr);
+    ~MetricsRegistry() override;
+    void *find(Type type, const char *name, const char *help);
+    void *unregistered(Type type, const char *name, const char *problem);
+
+private:
+    QMutex registrationMutex;
+    Entry entries[kMaxEntries];
+    QAtomicInt entryCount = 0;
+    // Handed out when a metric can't be registered, it records like any
+    // other but is never exported.
+    MetricCounter unregisteredCounter;
+    MetricGauge unregisteredGauge;
+    Histogram unregisteredSummary;
+    QMap<QByteArray, Info> infos;
+
+private:
+    Q_DISABLE_COPY(MetricsRegistry)
+};
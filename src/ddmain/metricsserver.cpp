@@ -0,0 +1,98 @@
+#include "metricsserver.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+const int kMaxRequestSize = 8192;
+// Clients that connect and don't finish their request within this time
+// are disconnected, like those of QtLocalPeer.
+const qint64 kIdleTimeout = 5000;
+
+MetricsServer::MetricsServer(QObject *parent) : QObject(parent)
+{
+    server = new QTcpServer(this);
+    connect(server, &QTcpServer::newConnection, this, &MetricsServer::acceptConnections);
+    idleTimer = new QTimer(this);
+    idleTimer->setInterval(1000);
+    connect(idleTimer, &QTimer::timeout, this, &MetricsServer::dropIdleConnections);
+}
+
+bool MetricsServer::listen(quint16 port)
+{
+    close();
+    if (port == 0)
+        return false;
+    if (!server->listen(QHostAddress::LocalHost, port))
+    {
+        DD_LOG_WARNING(Control, "Metrics server can't listen on port %1: %2", port, server->errorString());
+        return false;
+    }
+    return true;
+}
+
+void MetricsServer::close()
+{
+    if (server->isListening())
+        server->close();
+}
+
+void MetricsServer::acceptConnections()
+{
+    while (QTcpSocket *socket = server->nextPendingConnection())
+    {
+        connections[socket].start();
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        connect(socket, &QTcpSocket::disconnected, this, [=]
+        {
+            dropConnection(socket);
+        });
+        connect(socket, &QTcpSocket::readyRead, this, [=]
+        {
+            readRequest(socket);
+        });
+        if (!idleTimer->isActive())
+            idleTimer->start();
+    }
+}
+
+void MetricsServer::readRequest(QTcpSocket *socket)
+{
+    connections[socket].start();
+    // The request itself does not matter, only wait for its end.
+    if (!socket->peek(kMaxRequestSize).contains("\r\n\r\n") && (socket->bytesAvailable() < kMaxRequestSize))
+        return;
+    socket->readAll();
+    socket->disconnect(this);
+    // Left to finish writing the response on its own.
+    dropConnection(socket);
+    const QByteArray body = MetricsRegistry::getInstance()->prometheusText();
+    QByteArray response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: ";
+    response += QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+void MetricsServer::dropConnection(QTcpSocket *socket)
+{
+    connections.remove(socket);
+    if (connections.isEmpty())
+        idleTimer->stop();
+}
+
+void MetricsServer::dropIdleConnections()
+{
+    QList<QTcpSocket *> idleSockets;
+    for (auto it = connections.cbegin(); it != connections.cend(); ++it)
+        if (it.value().hasExpired(kIdleTimeout))
+            idleSockets.append(it.key());
+    for (QTcpSocket *socket : qAsConst(idleSockets))
+    {
+        dropConnection(socket);
+        socket->abort();
+        socket->deleteLater();
+    }
+}
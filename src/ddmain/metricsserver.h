@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+
+QT_FORWARD_DECLARE_CLASS(QTcpServer)
+QT_FORWARD_DECLARE_CLASS(QTcpSocket)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+// Serves MetricsRegistry::prometheusText() over HTTP on the loopback
+// interface, so a local Prometheus agent can scrape it. Every request
+// gets the metrics, whatever its path is.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(QObject *parent = nullptr);
+
+public:
+    bool listen(quint16 port);
+    void close();
+
+private slots:
+    void acceptConnections();
+    void readRequest(QTcpSocket *socket);
+    void dropConnection(QTcpSocket *socket);
+    void dropIdleConnections();
+
+private:
+    QTcpServer *server = nullptr;
+    // Time since each client last sent something.
+    QHash<QTcpSocket *, QElapsedTimer> connections;
+    QTimer *idleTimer = nullptr;
+
+private:
+    Q_DISABLE_COPY(MetricsServer)
+};
@@ -0,0 +1,452 @@
+#include "pbouploader.h"
+#include "metrics.h"
+#include "stagetiming.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QGLWidget>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLWidget>
+#include <QtAV/SurfaceInterop.h>
+#include <QtAV/VideoFrame.h>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (QOPENGLF_APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+// Three buffers: one being filled by the decoder, one being transferred
+// and one being displayed.
+const int kRingSize = 3;
+const int kPlaneCount = 3;
+
+class PboRing
+{
+public:
+    enum SlotState
+    {
+        Free,
+        Writing,
+        Ready,
+        Uploaded,
+        InFlight
+    };
+
+    explicit PboRing(int width, int height, Histogram *uploadTime, QObject *owner)
+        : width(width), height(height), uploadTime(uploadTime), owner(owner)
+    {
+        const int chromaWidth = (width + 1) / 2;
+        const int chromaHeight = (height + 1) / 2;
+        planeWidth[0] = width;
+        planeHeight[0] = height;
+        planeWidth[1] = planeWidth[2] = chromaWidth;
+        planeHeight[1] = planeHeight[2] = chromaHeight;
+        planeOffset[0] = 0;
+        planeOffset[1] = width * height;
+        planeOffset[2] = planeOffset[1] + chromaWidth * chromaHeight;
+        bufferSize = planeOffset[2] + chromaWidth * chromaHeight;
+    }
+
+    bool matches(int frameWidth, int frameHeight) const
+    {
+        return valid.load() && !retired.load() && (frameWidth == width) && (frameHeight == height);
+    }
+
+    bool create()
+    {
+        QOpenGLContext *context = QOpenGLContext::currentContext();
+        if (!context || (context->format().majorVersion() < 3))
+            return false;
+        const bool bufferStorage = context->hasExtension(QByteArrayLiteral("GL_ARB_buffer_storage"))
+                || context->hasExtension(QByteArrayLiteral("GL_EXT_buffer_storage"))
+                || (!context->isOpenGLES() && (context->format().version() >= qMakePair(4, 4)));
+        if (!bufferStorage)
+            return false;
+        auto glBufferStorage = reinterpret_cast<BufferStorageProc>(context->getProcAddress(QByteArrayLiteral("glBufferStorage")));
+        if (!glBufferStorage)
+            glBufferStorage = reinterpret_cast<BufferStorageProc>(context->getProcAddress(QByteArrayLiteral("glBufferStorageEXT")));
+        if (!glBufferStorage)
+            return false;
+        QOpenGLExtraFunctions *f = context->extraFunctions();
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        f->glGenBuffers(kRingSize, buffers);
+        f->glGenTextures(kRingSize * kPlaneCount, &textures[0][0]);
+        for (int slot = 0; slot < kRingSize; ++slot)
+        {
+            f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[slot]);
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bufferSize, nullptr, flags);
+            data[slot] = static_cast<uchar *>(f->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize, flags));
+            for (int plane = 0; plane < kPlaneCount; ++plane)
+            {
+                f->glBindTexture(GL_TEXTURE_2D, textures[slot][plane]);
+                f->glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, planeWidth[plane], planeHeight[plane], 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+                f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            }
+        }
+        f->glBindTexture(GL_TEXTURE_2D, 0);
+        f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        // Not published yet, destroy() cleans up what was created.
+        valid.store(1);
+        for (int slot = 0; slot < kRingSize; ++slot)
+            if (!data[slot])
+            {
+                destroy();
+                return false;
+            }
+        return true;
+    }
+
+    // GUI thread. Frames that are still around keep their slots, their
+    // buffers and textures stay until they are gone.
+    void retire()
+    {
+        retired.store(1);
+    }
+
+    // GUI thread, with a context of the ring's share group current. Unless
+    // forced, nothing happens while the decode thread writes into the ring
+    // or a frame still refers to one of its slots.
+    bool destroy(bool force = true)
+    {
+        QMutexLocker locker(&mappingMutex);
+        if (!valid.load())
+            return true;
+        if (!force)
+            for (int slot = 0; slot < kRingSize; ++slot)
+            {
+                const int state = states[slot].load();
+                if ((state == Writing) || (state == Ready) || (state == Uploaded))
+                    return false;
+            }
+        QOpenGLContext *context = QOpenGLContext::currentContext();
+        if (!context)
+            return false;
+        valid.store(0);
+        QOpenGLExtraFunctions *f = context->extraFunctions();
+        for (int slot = 0; slot < kRingSize; ++slot)
+        {
+            if (fences[slot])
+                f->glDeleteSync(fences[slot]);
+            fences[slot] = nullptr;
+            if (data[slot])
+            {
+                f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[slot]);
+                f->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                data[slot] = nullptr;
+            }
+        }
+        f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        f->glDeleteBuffers(kRingSize, buffers);
+        f->glDeleteTextures(kRingSize * kPlaneCount, &textures[0][0]);
+        return true;
+    }
+
+    // Decode thread. Copies the frame into a free slot and returns it, or
+    // -1 if there is none or the ring was retired meanwhile. The lock keeps
+    // the buffers mapped until the copy is done.
+    int write(const QtAV::VideoFrame &frame)
+    {
+        QMutexLocker locker(&mappingMutex);
+        if (!valid.load() || retired.load())
+            return -1;
+        int slot = 0;
+        while ((slot < kRingSize) && !states[slot].testAndSetAcquire(Free, Writing))
+            ++slot;
+        if (slot == kRingSize)
+            return -1;
+        for (int plane = 0; plane < kPlaneCount; ++plane)
+        {
+            const uchar *source = frame.constBits(plane);
+            const int stride = frame.bytesPerLine(plane);
+            uchar *destination = data[slot] + planeOffset[plane];
+            for (int line = 0; line < planeHeight[plane]; ++line)
+                memcpy(destination + line * planeWidth[plane], source + line * stride, planeWidth[plane]);
+        }
+        states[slot].storeRelease(Ready);
+        return slot;
+    }
+
+    // Any thread, when the last reference to the frame is gone.
+    void release(int slot)
+    {
+        if (!states[slot].testAndSetOrdered(Ready, Free))
+            states[slot].testAndSetOrdered(Uploaded, InFlight);
+        // The last frame of a retired ring lets it go.
+        if (retired.load() && owner)
+            QMetaObject::invokeMethod(owner, "collectRetiredRings", Qt::QueuedConnection);
+    }
+
+    // GUI thread, with the renderer's context current.
+    GLuint upload(int slot, int plane)
+    {
+        QOpenGLContext *context = QOpenGLContext::currentContext();
+        if (!valid.load() || !context)
+            return 0;
+        QOpenGLExtraFunctions *f = context->extraFunctions();
+        recycle(f);
+        // QtAV asks for the planes one by one, all of them are transferred
+        // with the first request.
+        if ((plane == 0) && (states[slot].load() == Ready))
+        {
+            QElapsedTimer timer;
+            timer.start();
+            f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[slot]);
+            f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (int i = 0; i < kPlaneCount; ++i)
+            {
+                f->glBindTexture(GL_TEXTURE_2D, textures[slot][i]);
+                f->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, planeWidth[i], planeHeight[i], GL_RED, GL_UNSIGNED_BYTE,
+                                   reinterpret_cast<const void *>(static_cast<quintptr>(planeOffset[i])));
+            }
+            f->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            // The buffer may be refilled once the GPU has consumed it.
+            fences[slot] = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            states[slot].testAndSetOrdered(Ready, Uploaded);
+            uploadTime->record(timer.nsecsElapsed() / 1000);
+            DD_STAGE_RECORD(Upload, timer.nsecsElapsed() / 1000);
+        }
+        return textures[slot][plane];
+    }
+
+    int planeStride(int plane) const
+    {
+        return planeWidth[plane];
+    }
+
+private:
+    void recycle(QOpenGLExtraFunctions *f)
+    {
+        for (int slot = 0; slot < kRingSize; ++slot)
+        {
+            if ((states[slot].load() != InFlight) || !fences[slot])
+                continue;
+            const GLenum status = f->glClientWaitSync(fences[slot], 0, 0);
+            if ((status == GL_ALREADY_SIGNALED) || (status == GL_CONDITION_SATISFIED))
+            {
+                f->glDeleteSync(fences[slot]);
+                fences[slot] = nullptr;
+                states[slot].storeRelease(Free);
+            }
+        }
+    }
+
+private:
+    int width = 0, height = 0;
+    int planeWidth[kPlaneCount], planeHeight[kPlaneCount], planeOffset[kPlaneCount];
+    int bufferSize = 0;
+    GLuint buffers[kRingSize] = {};
+    GLuint textures[kRingSize][kPlaneCount] = {};
+    uchar *data[kRingSize] = {};
+    GLsync fences[kRingSize] = {};
+    QAtomicInt states[kRingSize];
+    QAtomicInt valid = 0, retired = 0;
+    QMutex mappingMutex;
+    Histogram *uploadTime = nullptr;
+    QPointer<QObject> owner;
+};
+
+class PboSlotInterop : public QtAV::VideoSurfaceInterop
+{
+public:
+    explicit PboSlotInterop(const QSharedPointer<PboRing> &ring, int slot) : ring(ring), slot(slot)
+    {
+    }
+
+    ~PboSlotInterop() override
+    {
+        ring->release(slot);
+    }
+
+    void *map(SurfaceType type, const QtAV::VideoFormat &format, void *handle, int plane) override
+    {
+        Q_UNUSED(format)
+        if ((type != GLTextureSurface) || !handle)
+            return nullptr;
+        const GLuint texture = ring->upload(slot, plane);
+        if (!texture)
+            return nullptr;
+        // QtAV draws our texture instead of its own one.
+        *static_cast<GLuint *>(handle) = texture;
+        return handle;
+    }
+
+private:
+    QSharedPointer<PboRing> ring;
+    int slot = 0;
+};
+
+PboUploader::PboUploader(QObject *parent) : QtAV::VideoFilter(parent)
+{
+    uploadTime = MetricsRegistry::getInstance()->summary("dd_upload_seconds", "Time the GUI thread spends starting a frame upload.");
+}
+
+PboUploader::~PboUploader()
+{
+    setGLWidget(nullptr);
+}
+
+void PboUploader::setGLWidget(QWidget *widget)
+{
+    if (glWidget == widget)
+        return;
+    // With shared contexts the new renderer can still draw the frames that
+    // were copied into the old ring, it goes once they are gone. Otherwise
+    // the buffers and textures belong to the old renderer's context.
+    const bool shared = widget && QCoreApplication::testAttribute(Qt::AA_ShareOpenGLContexts);
+    if (makeCurrent())
+    {
+        releaseRing(!shared);
+        if (!shared)
+            destroyRetiredRings(true);
+        doneCurrent();
+    }
+    glWidget = widget;
+    unsupported.store(0);
+}
+
+QVariantHash PboUploader::statistics() const
+{
+    QVariantHash stats;
+    stats[QStringLiteral("upload.pboFrames")] = ringFrames.load();
+    stats[QStringLiteral("upload.directFrames")] = directFrames.load();
+    stats[QStringLiteral("upload.timeP50")] = uploadTime->percentile(0.5);
+    stats[QStringLiteral("upload.timeP99")] = uploadTime->percentile(0.99);
+    return stats;
+}
+
+void PboUploader::process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame)
+{
+    Q_UNUSED(statistics)
+    if (!frame || !frame->isValid() || !frame->constBits(0) || (frame->pixelFormat() != QtAV::VideoFormat::Format_YUV420P))
+        return;
+    QSharedPointer<PboRing> currentRing;
+    {
+        QMutexLocker locker(&ringMutex);
+        currentRing = ring;
+    }
+    if (!currentRing || !currentRing->matches(frame->width(), frame->height()))
+    {
+        // Buffers can only be created with the renderer's context, which
+        // lives on the GUI thread.
+        if (!unsupported.load())
+        {
+            wantedWidth.store(frame->width());
+            wantedHeight.store(frame->height());
+            if (preparing.testAndSetOrdered(0, 1))
+                QMetaObject::invokeMethod(this, "prepareRing", Qt::QueuedConnection);
+        }
+        directFrames.fetchAndAddRelaxed(1);
+        return;
+    }
+    int slot = -1;
+    {
+        DD_STAGE_SCOPE(Copy);
+        slot = currentRing->write(*frame);
+    }
+    if (slot < 0)
+    {
+        directFrames.fetchAndAddRelaxed(1);
+        return;
+    }
+    QtAV::VideoFrame ringFrame(frame->width(), frame->height(), QtAV::VideoFormat(QtAV::VideoFormat::Format_YUV420P));
+    for (int plane = 0; plane < kPlaneCount; ++plane)
+        ringFrame.setBytesPerLine(currentRing->planeStride(plane), plane);
+    ringFrame.setTimestamp(frame->timestamp());
+    ringFrame.setDisplayAspectRatio(frame->displayAspectRatio());
+    ringFrame.setColorSpace(frame->colorSpace());
+    ringFrame.setColorRange(frame->colorRange());
+    ringFrame.setMetaData(QStringLiteral("surface_interop"), QVariant::fromValue(QtAV::VideoSurfaceInteropPtr(new PboSlotInterop(currentRing, slot))));
+    *frame = ringFrame;
+    ringFrames.fetchAndAddRelaxed(1);
+}
+
+void PboUploader::prepareRing()
+{
+    preparing.store(0);
+    if (!makeCurrent())
+        return;
+    // The renderer has not been shown yet, try again with the next frame.
+    if (!QOpenGLContext::currentContext())
+        return;
+    // Same context, frames already in the old ring are still drawn.
+    releaseRing(false);
+    destroyRetiredRings(false);
+    QSharedPointer<PboRing> newRing(new PboRing(wantedWidth.load(), wantedHeight.load(), uploadTime, this));
+    if (newRing->create())
+    {
+        QMutexLocker locker(&ringMutex);
+        ring = newRing;
+    }
+    else
+        unsupported.store(1);
+    doneCurrent();
+}
+
+void PboUploader::collectRetiredRings()
+{
+    if (retiredRings.isEmpty() || !makeCurrent())
+        return;
+    destroyRetiredRings(false);
+    doneCurrent();
+}
+
+bool PboUploader::makeCurrent()
+{
+    if (auto widget = qobject_cast<QOpenGLWidget *>(glWidget))
+    {
+        widget->makeCurrent();
+        return true;
+    }
+    if (auto widget = qobject_cast<QGLWidget *>(glWidget))
+    {
+        widget->makeCurrent();
+        return true;
+    }
+    return false;
+}
+
+void PboUploader::doneCurrent()
+{
+    if (auto widget = qobject_cast<QOpenGLWidget *>(glWidget))
+        widget->doneCurrent();
+    else if (auto widget = qobject_cast<QGLWidget *>(glWidget))
+        widget->doneCurrent();
+}
+
+void PboUploader::releaseRing(bool destroy)
+{
+    QSharedPointer<PboRing> oldRing;
+    {
+        QMutexLocker locker(&ringMutex);
+        oldRing.swap(ring);
+    }
+    if (!oldRing)
+        return;
+    // The decode thread may still hold the old ring, it stops writing into
+    // it right away and waits for a copy in progress to finish.
+    oldRing->retire();
+    if (destroy)
+        oldRing->destroy();
+    else
+        retiredRings.append(oldRing);
+}
+
+void PboUploader::destroyRetiredRings(bool force)
+{
+    for (auto it = retiredRings.begin(); it != retiredRings.end();)
+    {
+        if ((*it)->destroy(force))
+            it = retiredRings.erase(it);
+        else
+            ++it;
+    }
+}
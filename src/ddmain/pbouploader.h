@@ -0,0 +1,59 @@
+#pragma once
+
+#include "histogram.h"
+
+#include <QtAV/Filter.h>
+#include <QList>
+#include <QMutex>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QVariantHash>
+
+class PboRing;
+
+// Uploads YUV420P frames of software decoders through a ring of persistently
+// mapped pixel buffer objects. The decode thread copies each frame into a
+// free buffer and hands QtAV a "hardware" frame instead, so the GUI thread
+// only starts an asynchronous buffer to texture transfer when the OpenGL
+// renderer draws it. Needs OpenGL 4.4 or ARB/EXT_buffer_storage, frames
+// pass through untouched otherwise.
+class PboUploader : public QtAV::VideoFilter
+{
+    Q_OBJECT
+
+public:
+    explicit PboUploader(QObject *parent = nullptr);
+    ~PboUploader() override;
+
+public:
+    void setGLWidget(QWidget *widget);
+    QVariantHash statistics() const;
+
+protected:
+    void process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame) override;
+
+private slots:
+    void prepareRing();
+    void collectRetiredRings();
+
+private:
+    bool makeCurrent();
+    void doneCurrent();
+    void releaseRing(bool destroy);
+    void destroyRetiredRings(bool force);
+
+private:
+    QPointer<QWidget> glWidget;
+    mutable QMutex ringMutex;
+    QSharedPointer<PboRing> ring;
+    // Replaced rings whose frames are still queued or on screen, GUI
+    // thread only.
+    QList<QSharedPointer<PboRing>> retiredRings;
+    QAtomicInt wantedWidth = 0, wantedHeight = 0;
+    QAtomicInt preparing = 0, unsupported = 0;
+    QAtomicInteger<quint64> ringFrames = 0, directFrames = 0;
+    Histogram *uploadTime = nullptr;
+
+private:
+    Q_DISABLE_COPY(PboUploader)
+};
@@ -0,0 +1,331 @@
+#include "playbackcontroller.h"
+#include "histogram.h"
+#include "logger.h"
+#include "metrics.h"
+#include "utils.h"
+
+#include <QPointer>
+#include <QWidget>
+#include <QtAV>
+
+PlaybackController::PlaybackController(QtAV::AVPlayer *player)
+    : QObject(nullptr), player(player), audioOutput(player->audio() != nullptr)
+{
+    MetricsRegistry *registry = MetricsRegistry::getInstance();
+    latency = registry->summary("dd_command_latency_seconds", "Time from queueing a playback command until it runs.");
+    commands = registry->counter("dd_commands_total", "Playback commands run by the playback controller.");
+    thread.setLatencyHistogram(latency);
+    // Direct, the controller's thread may be busy with a command.
+    connect(registry, &MetricsRegistry::aboutToCollect, this, [=]
+    {
+        commands->set(thread.executed());
+    }, Qt::DirectConnection);
+    connect(player, &QtAV::AVPlayer::stateChanged, this, &PlaybackController::updateSnapshot);
+    connect(player, &QtAV::AVPlayer::positionChanged, this, &PlaybackController::updateSnapshot);
+    connect(player, &QtAV::AVPlayer::loaded, this, &PlaybackController::onLoaded);
+    connect(player, &QtAV::AVPlayer::mediaStatusChanged, this, &PlaybackController::onMediaStatusChanged);
+    connect(player, &QtAV::AVPlayer::mediaEndReached, this, &PlaybackController::mediaEndReached);
+    connect(player, &QtAV::AVPlayer::error, this, [](const QtAV::AVError &error)
+    {
+        DD_LOG_ERROR(Playback, "Player error %1: %2", static_cast<int>(error.error()), error.string());
+    });
+    thread.setObjectName(QStringLiteral("PlaybackController"));
+    player->moveToThread(&thread);
+    moveToThread(&thread);
+    thread.start();
+}
+
+PlaybackController::~PlaybackController()
+{
+    QThread *ownerThread = QThread::currentThread();
+    post([=]
+    {
+        for (QObject *object : qAsConst(adopted))
+            object->moveToThread(ownerThread);
+        player->moveToThread(ownerThread);
+        moveToThread(ownerThread);
+        thread.quit();
+    });
+    thread.wait();
+}
+
+bool PlaybackController::hasAudioOutput() const
+{
+    return audioOutput;
+}
+
+void PlaybackController::play()
+{
+    post([=]
+    {
+        // Pictures are shown, not played.
+        if (Utils::isPicture(currentUrl))
+            return;
+        if (player->isPaused())
+            player->pause(false);
+    });
+}
+
+void PlaybackController::pause(const QString &reason)
+{
+    post([=]
+    {
+        if (!player->isPlaying())
+            return;
+        pendingPauseReason = reason;
+        player->pause();
+    });
+}
+
+void PlaybackController::stop()
+{
+    post([=]
+    {
+        if (player->isLoaded())
+            player->stop();
+    });
+}
+
+void PlaybackController::seek(qint64 position)
+{
+    post([=]
+    {
+        if (player->isLoaded() && player->isSeekable())
+            player->seek(position);
+    });
+}
+
+void PlaybackController::open(const QString &url, QtAV::MediaIO *input)
+{
+    post([=]
+    {
+        currentUrl = url;
+        // The player is stopped by now, the previous input isn't read
+        // anymore. It belongs to the thread that created it.
+        if (input != currentInput)
+        {
+            if (currentInput)
+                currentInput->deleteLater();
+            currentInput = input;
+        }
+        if (currentInput)
+        {
+            player->setInput(currentInput);
+            player->play();
+        }
+        else
+            player->play(url);
+    });
+}
+
+void PlaybackController::setAudioSuspended(bool suspended)
+{
+    post([=]
+    {
+        if (audioSuspended == suspended)
+            return;
+        audioSuspended = suspended;
+        if (audioSuspended)
+        {
+            audioTrack = player->currentAudioStream();
+            if (player->isLoaded())
+                player->setAudioStream(-1);
+            if (player->audio())
+                player->audio()->close();
+        }
+        // Selecting the track again reopens the device and resyncs the
+        // audio to the video clock, the video decoder keeps running.
+        else if (player->isLoaded())
+            player->setAudioStream(audioTrack < 0 ? 0 : audioTrack);
+    });
+}
+
+void PlaybackController::setAudioTrack(int track)
+{
+    post([=]
+    {
+        if (audioSuspended)
+            audioTrack = track;
+        else if (player->isLoaded() && (track != player->currentAudioStream()))
+            player->setAudioStream(track);
+    });
+}
+
+void PlaybackController::loadExternalAudio(const QStringList &files)
+{
+    post([=]
+    {
+        bool externalAudioLoaded = false;
+        for (const QString &audioFilePath : files)
+            if (player->setExternalAudio(audioFilePath))
+            {
+                externalAudioLoaded = true;
+                break;
+            }
+        if (!externalAudioLoaded)
+            player->setExternalAudio(QString());
+        // Loading audio selects a track and opens the device again.
+        if (audioSuspended)
+        {
+            player->setAudioStream(-1);
+            if (player->audio())
+                player->audio()->close();
+        }
+    });
+}
+
+void PlaybackController::setRenderer(QtAV::VideoRenderer *renderer, QWidget *oldRendererWidget, const QList<QtAV::VideoFilter *> &rendererFilters)
+{
+    const QPointer<QWidget> oldWidget = oldRendererWidget;
+    post([=]
+    {
+        // Only the output is exchanged, the demuxer and decoder keep
+        // running.
+        for (QtAV::VideoFilter *filter : rendererFilters)
+            filter->uninstall();
+        player->setRenderer(renderer);
+        for (QtAV::VideoFilter *filter : rendererFilters)
+            filter->installTo(renderer);
+        // The player doesn't hand it frames anymore.
+        if (oldWidget)
+            oldWidget->deleteLater();
+    });
+}
+
+void PlaybackController::post(CommandThread::Function function)
+{
+    thread.post(std::move(function));
+}
+
+void PlaybackController::adopt(QObject *object)
+{
+    object->moveToThread(&thread);
+    post([=]
+    {
+        adopted.append(object);
+    });
+}
+
+PlaybackController::Snapshot PlaybackController::snapshot() const
+{
+    QMutexLocker locker(&snapshotMutex);
+    return currentSnapshot;
+}
+
+PlaybackController::Snapshot PlaybackController::takeSnapshot()
+{
+    publishPending.fetchAndStoreOrdered(0);
+    deliveries.fetchAndAddRelaxed(1);
+    return snapshot();
+}
+
+PlaybackController::MediaInfo PlaybackController::mediaInfo() const
+{
+    QMutexLocker locker(&snapshotMutex);
+    return currentMediaInfo;
+}
+
+QVariantHash PlaybackController::statistics() const
+{
+    QVariantHash stats;
+    stats[QStringLiteral("controller.commands")] = thread.executed();
+    stats[QStringLiteral("controller.overflows")] = thread.overflows();
+    stats[QStringLiteral("controller.latencyP50")] = latency->percentile(0.5);
+    stats[QStringLiteral("controller.latencyP99")] = latency->percentile(0.99);
+    stats[QStringLiteral("controller.latencyMax")] = latency->max();
+    stats[QStringLiteral("controller.snapshots")] = snapshots.loadAcquire();
+    stats[QStringLiteral("controller.deliveries")] = deliveries.load();
+    return stats;
+}
+
+void PlaybackController::updateSnapshot()
+{
+    const QtAV::AVPlayer::State state = player->state();
+    const QtAV::Statistics &playerStats = player->statistics();
+    bool stateChanged = false;
+    QString pauseReason;
+    {
+        QMutexLocker locker(&snapshotMutex);
+        stateChanged = currentSnapshot.state != state;
+        if (stateChanged)
+        {
+            if (state == QtAV::AVPlayer::PlayingState)
+                currentSnapshot.pauseReason.clear();
+            else if (!pendingPauseReason.isEmpty())
+                currentSnapshot.pauseReason = pendingPauseReason;
+            else
+                currentSnapshot.pauseReason = state == QtAV::AVPlayer::StoppedState ? QStringLiteral("stopped") : QStringLiteral("player");
+            pauseReason = currentSnapshot.pauseReason;
+        }
+        currentSnapshot.state = state;
+        currentSnapshot.loaded = player->isLoaded();
+        currentSnapshot.position = player->position();
+        currentSnapshot.frameRate = playerStats.video.frame_rate;
+        currentSnapshot.displayFrameRate = playerStats.video_only.currentDisplayFPS();
+        currentSnapshot.decoder = playerStats.video.decoder;
+        currentSnapshot.width = playerStats.video_only.width;
+        currentSnapshot.height = playerStats.video_only.height;
+        snapshots.storeRelease(++currentSnapshot.sequence);
+    }
+    if (stateChanged)
+    {
+        pendingPauseReason.clear();
+        if (state == QtAV::AVPlayer::PlayingState)
+            DD_LOG_INFO(Playback, "Playback running");
+        else
+            DD_LOG_INFO(Playback, "Playback %1: %2", state == QtAV::AVPlayer::StoppedState ? "stopped" : "paused", pauseReason);
+    }
+    if (publishPending.testAndSetOrdered(0, 1))
+        emit snapshotChanged();
+}
+
+void PlaybackController::onLoaded()
+{
+    MediaInfo info;
+    info.file = currentUrl;
+    info.duration = player->duration();
+    info.stopPosition = player->mediaStopPosition();
+    info.notifyInterval = player->notifyInterval();
+    info.seekable = player->isSeekable();
+    info.subtitleStreamCount = player->subtitleStreamCount();
+    info.decoder = player->videoDecoder() ? player->videoDecoder()->name() : QStringLiteral("none");
+    info.videoTracks = player->internalVideoTracks();
+    info.audioTracks = player->internalAudioTracks();
+    info.externalAudioTracks = player->externalAudioTracks();
+    info.subtitleTracks = player->internalSubtitleTracks();
+    // The track the new file starts with is the one to resume with.
+    if (audioSuspended)
+        audioTrack = player->currentAudioStream();
+    {
+        QMutexLocker locker(&snapshotMutex);
+        currentMediaInfo = info;
+    }
+    DD_LOG_INFO(Playback, "Loaded %1, %2 ms, decoder %3", info.file, info.duration, info.decoder);
+    updateSnapshot();
+    emit mediaLoaded();
+}
+
+void PlaybackController::onMediaStatusChanged(QtAV::MediaStatus status)
+{
+    if (status != QtAV::MediaStatus::EndOfMedia)
+        return;
+    setPauseReason(QStringLiteral("end of media"));
+    emit mediaEndReached();
+}
+
+void PlaybackController::setPauseReason(const QString &reason)
+{
+    // Takes effect with the next state change, or right away if playback
+    // stopped already.
+    if (player->state() == QtAV::AVPlayer::PlayingState)
+    {
+        pendingPauseReason = reason;
+        return;
+    }
+    {
+        QMutexLocker locker(&snapshotMutex);
+        currentSnapshot.pauseReason = reason;
+    }
+    if (publishPending.testAndSetOrdered(0, 1))
+        emit snapshotChanged();
+}
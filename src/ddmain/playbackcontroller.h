@@ -0,0 +1,144 @@
+#pragma once
+
+#include "commandthread.h"
+
+#include <QtAV/AVPlayer.h>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
+#include <QVariantHash>
+#include <QVariantList>
+
+class Histogram;
+class MetricCounter;
+
+QT_FORWARD_DECLARE_CLASS(QWidget)
+
+namespace QtAV
+{
+    QT_FORWARD_DECLARE_CLASS(MediaIO)
+    QT_FORWARD_DECLARE_CLASS(VideoFilter)
+    QT_FORWARD_DECLARE_CLASS(VideoRenderer)
+}
+
+// Owns the player and runs it on a thread of its own, so that seeking,
+// pausing or opening a file never waits for the GUI thread while it
+// restyles, lays out or fills dialogs. Everything that touches the player
+// is a command queued through a CommandThread, from any thread. What the
+// other threads need to know about the player comes back as a snapshot of
+// the playback state and as the media info captured when a file was
+// loaded: no matter how often the state changes, the GUI thread gets one
+// snapshotChanged() per batch and reads the latest state. Nothing outside
+// the controller's thread calls the player directly.
+class PlaybackController : public QObject
+{
+    Q_OBJECT
+
+signals:
+    // Coalesced, read takeSnapshot() for the state.
+    void snapshotChanged();
+    // Read mediaInfo() for the new media.
+    void mediaLoaded();
+    void mediaEndReached();
+
+public:
+    struct Snapshot
+    {
+        QtAV::AVPlayer::State state = QtAV::AVPlayer::StoppedState;
+        bool loaded = false;
+        qint64 position = 0;
+        // Why playback isn't running, empty while it is.
+        QString pauseReason;
+        qreal frameRate = 0.0;
+        qreal displayFrameRate = 0.0;
+        QString decoder;
+        int width = 0, height = 0;
+        // Updates since the start, the GUI thread sees fewer of them.
+        quint64 sequence = 0;
+    };
+
+    struct MediaInfo
+    {
+        QString file;
+        qint64 duration = 0;
+        qint64 stopPosition = 0;
+        int notifyInterval = 0;
+        bool seekable = false;
+        int subtitleStreamCount = 0;
+        QString decoder;
+        QVariantList videoTracks;
+        QVariantList audioTracks;
+        QVariantList externalAudioTracks;
+        QVariantList subtitleTracks;
+    };
+
+    // Moves the player and the controller to the controller's thread,
+    // install the player's filters before. Deleting the controller gives
+    // the player and the adopted objects back to the calling thread.
+    explicit PlaybackController(QtAV::AVPlayer *player);
+    ~PlaybackController() override;
+
+public:
+    // All of these can be called from any thread.
+    bool hasAudioOutput() const;
+    void play();
+    // The reason ends up in the snapshot and in the log.
+    void pause(const QString &reason);
+    void stop();
+    void seek(qint64 position);
+    // The previous input is deleted once the player let go of it, the
+    // caller deletes the last one after the player.
+    void open(const QString &url, QtAV::MediaIO *input = nullptr);
+    // While suspended, no audio track is selected and the output device is
+    // closed, selecting a track only takes effect once resumed.
+    void setAudioSuspended(bool suspended);
+    void setAudioTrack(int track);
+    // Tries the files in order and keeps the first one that loads.
+    void loadExternalAudio(const QStringList &files);
+    // The old renderer's widget is deleted once the player let go of it.
+    // The filters are moved over to the new renderer in the given order.
+    void setRenderer(QtAV::VideoRenderer *renderer, QWidget *oldRendererWidget, const QList<QtAV::VideoFilter *> &rendererFilters);
+    // Runs a function on the controller's thread, after everything that
+    // was queued before.
+    void post(CommandThread::Function function);
+    // Objects that talk to the player directly (subtitle filters) live on
+    // the controller's thread too. Call it from the object's thread.
+    void adopt(QObject *object);
+    Snapshot snapshot() const;
+    // Also rearms snapshotChanged(), call it from the connected slot.
+    Snapshot takeSnapshot();
+    MediaInfo mediaInfo() const;
+    QVariantHash statistics() const;
+
+private slots:
+    void updateSnapshot();
+    void onLoaded();
+    void onMediaStatusChanged(QtAV::MediaStatus status);
+
+private:
+    void setPauseReason(const QString &reason);
+
+private:
+    CommandThread thread;
+    QtAV::AVPlayer *player = nullptr;
+    const bool audioOutput;
+    QList<QObject *> adopted;
+    // Only used on the controller's thread.
+    QtAV::MediaIO *currentInput = nullptr;
+    QString currentUrl;
+    QString pendingPauseReason;
+    bool audioSuspended = false;
+    int audioTrack = 0;
+    QAtomicInt publishPending = 0;
+    mutable QMutex snapshotMutex;
+    Snapshot currentSnapshot;
+    MediaInfo currentMediaInfo;
+    // Count of snapshots, for statistics() to read without the mutex.
+    QAtomicInteger<quint64> snapshots = 0;
+    QAtomicInteger<quint64> deliveries = 0;
+    Histogram *latency = nullptr;
+    MetricCounter *commands = nullptr;
+
+private:
+    Q_DISABLE_COPY(PlaybackController)
+};
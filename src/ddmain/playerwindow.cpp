@@ -1,15 +1,43 @@
 #include "playerwindow.h"
+#include "audiometer.h"
+#include "debugoverlay.h"
+#include "decodeprofile.h"
+#include "framepacer.h"
+#include "framescaler.h"
+#include "framesinkrenderer.h"
+#include "histogram.h"
+#include "logger.h"
+#include "mappedfileio.h"
+#include "metrics.h"
+#include "pbouploader.h"
+#include "playbackcontroller.h"
+#include "qualitycontroller.h"
+#include "rendererwarmup.h"
 #include "settingsmanager.h"
+#include "shadercache.h"
+#include "stagetiming.h"
+#include "streamcache.h"
+#include "stallmonitor.h"
+#include "thumbnailmanager.h"
+#include "tonemapping.h"
 #include "utils.h"
+#include "videoeffects.h"
 #include <Wallpaper>
 
+#include <QElapsedTimer>
 #include <QMessageBox>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QFileInfo>
+#include <QFutureWatcher>
+#include <QUrl>
+#include <QtConcurrent>
 #include <QtAV>
 #include <QtAVWidgets>
 
 const qreal kVolumeInterval = 0.04;
+// The overlay is for reading, not for watching numbers flicker.
+const int kDebugOverlayInterval = 500;
 
 PlayerWindow::PlayerWindow(QWidget *parent) : QWidget(parent)
 {
@@ -21,101 +49,264 @@ PlayerWindow::PlayerWindow(QWidget *parent) : QWidget(parent)
 
 PlayerWindow::~PlayerWindow()
 {
+    // Hands the player and the subtitles back to this thread.
+    delete controller;
     delete subtitle;
+    delete debugOverlay;
     delete renderer;
     delete player;
+    delete mediaInput;
+    delete frameRecorder;
+    delete frameScaler;
+    delete toneMapFilter;
+    delete pboUploader;
+    delete framePacer;
+    delete audioMeter;
+#ifndef DD_NO_STAGE_TIMING
+    delete stageHead;
+    delete stageTail;
+#endif
     delete mainLayout;
 }
 
-void PlayerWindow::setVolume(quint32 volume)
+QVariantHash PlayerWindow::statistics() const
 {
-    QtAV::AudioOutput *ao = player ? player->audio() : nullptr;
-    if (ao)
+    QVariantHash stats = qualityController->statistics();
+    const PlaybackController::Snapshot &snapshot = lastSnapshot;
+    if (snapshot.loaded)
     {
-        qreal newVolume = static_cast<qreal>(volume) * kVolumeInterval;
-        if (ao->volume() != newVolume)
-            if (qAbs(static_cast<int>(ao->volume() / kVolumeInterval) - static_cast<int>(volume)) >= static_cast<int>(0.1 / kVolumeInterval))
-                ao->setVolume(newVolume);
+        stats[QStringLiteral("video.fps")] = snapshot.frameRate;
+        stats[QStringLiteral("video.displayFps")] = snapshot.displayFrameRate;
+        stats[QStringLiteral("video.decoder")] = snapshot.decoder;
+        stats[QStringLiteral("video.width")] = snapshot.width;
+        stats[QStringLiteral("video.height")] = snapshot.height;
+        // Hardware decoders are configured in videoCodecOptions(), software
+        // decoded frames are either uploaded through the pixel buffers or
+        // directly by the renderer.
+        QString copyMode = videoCodecOptions().value(snapshot.decoder).toHash().value(QStringLiteral("copyMode")).toString();
+        if (copyMode.isEmpty())
+            copyMode = pboUploader->isEnabled() ? QStringLiteral("PBO") : QStringLiteral("Direct");
+        stats[QStringLiteral("video.copyMode")] = copyMode;
     }
+    stats[QStringLiteral("video.scaleFactor")] = frameScaler->scaleFactor();
+    stats[QStringLiteral("video.scalerSetups")] = frameScaler->scalerSetups();
+    stats[QStringLiteral("video.ecoDecoding")] = ecoDecoderActive;
+    stats[QStringLiteral("renderer.id")] = renderer ? static_cast<int>(renderer->id()) : 0;
+    stats[QStringLiteral("renderer.swapTime")] = rendererSwapTime;
+    const auto frameSink = dynamic_cast<FrameSinkRenderer *>(renderer);
+    if (frameSink)
+        stats[QStringLiteral("renderer.sinkFrames")] = frameSink->frameCount();
+    if (frameRecorder->isEnabled())
+        stats[QStringLiteral("renderer.sinkRecorded")] = frameRecorder->frameCount();
+    if (pboUploader->isEnabled())
+        stats.unite(pboUploader->statistics());
+    if (framePacer->isEnabled())
+        stats.unite(framePacer->statistics());
+    stallMonitor->touch();
+    stats.unite(stallMonitor->statistics());
+    stats.unite(MappedFileIO::statistics());
+    stats.unite(StreamCacheIO::statistics());
+    stats.unite(videoEffects->statistics());
+    stats.unite(ShaderCache::statistics());
+    stats.unite(audioMeter->statistics());
+    stats.unite(controller->statistics());
+    stats.unite(telemetry->statistics());
+    stats[QStringLiteral("process.workingSet")] = Utils::getProcessWorkingSet();
+#ifndef DD_NO_STAGE_TIMING
+    stats.unite(StageTiming::statistics());
+#endif
+#ifndef DD_NO_LOGGING
+    stats.unite(Log::statistics());
+#endif
+    return stats;
+}
+
+bool PlayerWindow::isDebugOverlayVisible() const
+{
+    return debugOverlay->isEnabled();
+}
+
+PlaybackController *PlayerWindow::playbackController() const
+{
+    return controller;
+}
+
+void PlayerWindow::addTelemetryView(QWidget *view)
+{
+    telemetry->addView(view);
+}
+
+void PlayerWindow::collectMetrics()
+{
+    MetricsRegistry *registry = MetricsRegistry::getInstance();
+    stallMonitor->touch();
+    const PlaybackController::Snapshot &snapshot = lastSnapshot;
+    const qreal frameRate = snapshot.loaded ? snapshot.frameRate : 0.0;
+    const qreal displayFrameRate = snapshot.loaded ? snapshot.displayFrameRate : 0.0;
+    const QString decoder = snapshot.loaded ? snapshot.decoder : QString();
+    registry->gauge("dd_video_fps", "Frame rate of the video stream.")->set(frameRate);
+    registry->gauge("dd_video_display_fps", "Frames displayed per second.")->set(displayFrameRate);
+    registry->gauge("dd_video_dropped_ratio", "Share of the stream's frames that are not displayed.")
+            ->set(frameRate > 0.0 ? qBound(0.0, 1.0 - displayFrameRate / frameRate, 1.0) : 0.0);
+    registry->gauge("dd_video_scale_factor", "Resolution the video is decoded at, relative to the window.")->set(frameScaler->scaleFactor());
+    registry->counter("dd_video_frames_decoded_total", "Frames that came out of the video decoder.")->set(frameScaler->frameCount());
+    // Read from here instead of the video thread, sampling it there would
+    // cost a system call per frame.
+    if (frameScaler->videoThreadId() != 0)
+        registry->counter("dd_video_thread_cpu_seconds_total", "CPU time of the video thread, decoding and frame filters.")
+                ->set(static_cast<quint64>(Utils::getThreadCpuTime(frameScaler->videoThreadId())));
+    registry->counter("dd_audio_cpu_saved_seconds_total", "CPU time the suspended audio pipeline would have used.")
+            ->set(static_cast<quint64>(audioMeter->cpuSaved()));
+    const QVariantHash pacing = framePacer->statistics();
+    registry->counter("dd_frames_superseded_total", "Frames the pacer dropped because a newer one was due.")
+            ->set(pacing.value(QStringLiteral("pacing.superseded")).toULongLong());
+    registry->counter("dd_frames_late_total", "Frames presented more than a refresh interval late.")
+            ->set(pacing.value(QStringLiteral("pacing.late")).toULongLong());
+    const QVariantHash quality = qualityController->statistics();
+    registry->gauge("dd_quality_level", "Level of the adaptive quality controller.")->set(quality.value(QStringLiteral("quality.level")).toInt());
+    registry->setInfo("dd_media_info", "The media that is playing.", {{"url", currentFile()}});
+    QString state = QStringLiteral("stopped");
+    if (snapshot.state == QtAV::AVPlayer::PausedState)
+        state = QStringLiteral("paused");
+    else if (snapshot.state == QtAV::AVPlayer::PlayingState)
+        state = QStringLiteral("playing");
+    registry->setInfo("dd_player_info", "Playback state and why playback is not running.",
+                      {{"state", state}, {"pause_reason", snapshot.pauseReason}});
+    registry->setInfo("dd_decoder_info", "Video decoder and renderer in use.",
+                      {{"decoder", decoder}, {"renderer", QString::number(renderer ? static_cast<int>(renderer->id()) : 0)},
+                       {"eco", ecoDecoderActive ? QStringLiteral("1") : QStringLiteral("0")}});
+    const SettingsManager *settings = SettingsManager::getInstance();
+    registry->setInfo("dd_settings_info", "Playback related settings.",
+                      {{"hwdec", settings->getHwdec() ? QStringLiteral("1") : QStringLiteral("0")},
+                       {"decoders", settings->getDecoders().join(QLatin1Char(','))},
+                       {"decode_profile", settings->getDecodeProfile()},
+                       {"image_quality", settings->getImageQuality()},
+                       {"opengl", settings->getOpenGLType()},
+                       {"quality_budget", QString::number(settings->getQualityBudget())}});
+}
+
+void PlayerWindow::setVolume(quint32 volume)
+{
+    volumeLevel = volume;
+    if (!player)
+        return;
+    controller->post([=]
+    {
+        QtAV::AudioOutput *ao = player->audio();
+        if (ao)
+        {
+            qreal newVolume = static_cast<qreal>(volume) * kVolumeInterval;
+            if (ao->volume() != newVolume)
+                if (qAbs(static_cast<int>(ao->volume() / kVolumeInterval) - static_cast<int>(volume)) >= static_cast<int>(0.1 / kVolumeInterval))
+                    ao->setVolume(newVolume);
+        }
+    });
+    updateAudioPipeline();
 }
 
 void PlayerWindow::setMute(bool mute)
 {
-    if (player->audio())
-        if (player->audio()->isMute() != mute)
-            player->audio()->setMute(mute);
+    muted = mute;
+    controller->post([=]
+    {
+        if (player->audio())
+            if (player->audio()->isMute() != mute)
+                player->audio()->setMute(mute);
+    });
+    updateAudioPipeline();
 }
 
 void PlayerWindow::seek(qint64 value)
 {
-    if (player->isLoaded() && player->isSeekable())
-        player->seek(value);
+    controller->seek(value);
 }
 
 void PlayerWindow::setVideoTrack(quint32 id)
 {
-    if (player->isLoaded())
-        if (id != player->currentVideoStream())
-            player->setVideoStream(id);
+    controller->post([=]
+    {
+        if (player->isLoaded())
+            if (id != player->currentVideoStream())
+                player->setVideoStream(id);
+    });
 }
 
 void PlayerWindow::setAudioTrack(quint32 id)
 {
-    if (player->isLoaded())
-        if (id != player->currentAudioStream())
-            player->setAudioStream(id);
+    controller->setAudioTrack(static_cast<int>(id));
 }
 
 void PlayerWindow::setSubtitleTrack(const QVariant& param)
 {
-    if (player->isLoaded())
+    const QString newSubFile = param.toString();
+    const bool isFile = QFileInfo::exists(newSubFile);
+    controller->post([=]
     {
-        const QString newSubFile = param.toString();
-        if (QFileInfo::exists(newSubFile) && subtitle->file() != newSubFile)
-            subtitle->setFile(newSubFile);
-        else
+        if (!player->isLoaded())
+            return;
+        if (isFile)
         {
-            quint32 id = param.toUInt();
-            if (id != player->currentSubtitleStream())
-            {
-                if (!subtitle->file().isEmpty())
-                    subtitle->setFile(QString());
-                player->setSubtitleStream(id);
-            }
+            if (subtitle->file() != newSubFile)
+                subtitle->setFile(newSubFile);
+            return;
         }
-    }
+        const quint32 id = param.toUInt();
+        if (id != player->currentSubtitleStream())
+        {
+            if (!subtitle->file().isEmpty())
+                subtitle->setFile(QString());
+            player->setSubtitleStream(id);
+        }
+    });
 }
 
 void PlayerWindow::setSubtitle(const QString& subPath)
 {
-    if (player->isLoaded())
-        if (subtitle->file() != subPath)
-            subtitle->setFile(subPath);
+    controller->post([=]
+    {
+        if (player->isLoaded())
+            if (subtitle->file() != subPath)
+                subtitle->setFile(subPath);
+    });
 }
 
 void PlayerWindow::setAudio(const QString& audioPath)
 {
-    if (player->isLoaded() && player->audio())
-        player->setExternalAudio(audioPath);
+    controller->post([=]
+    {
+        if (player->isLoaded() && player->audio())
+            player->setExternalAudio(audioPath);
+    });
 }
 
 void PlayerWindow::setCharset(const QString& charset)
 {
-    if (SettingsManager::getInstance()->getSubtitle())
-        if (subtitle->codec() != charset.toLatin1())
-            subtitle->setCodec(charset.toLatin1());
+    if (!SettingsManager::getInstance()->getSubtitle())
+        return;
+    const QByteArray codec = charset.toLatin1();
+    controller->post([=]
+    {
+        if (subtitle->codec() != codec)
+            subtitle->setCodec(codec);
+    });
 }
 
 void PlayerWindow::setSubtitleAutoLoad(bool autoload)
 {
-    if (subtitle->autoLoad() != autoload)
-        subtitle->setAutoLoad(autoload);
+    controller->post([=]
+    {
+        if (subtitle->autoLoad() != autoload)
+            subtitle->setAutoLoad(autoload);
+    });
 }
 
 void PlayerWindow::setSubtitleEnabled(bool enabled)
 {
-    if (subtitle->isEnabled() != enabled)
-        subtitle->setEnabled(enabled);
+    controller->post([=]
+    {
+        if (subtitle->isEnabled() != enabled)
+            subtitle->setEnabled(enabled);
+    });
 }
 
 void PlayerWindow::initUI()
@@ -140,41 +331,110 @@ void PlayerWindow::initPlayer()
 #endif
     subtitle->setAutoLoad(SettingsManager::getInstance()->getSubtitleAutoLoad());
     subtitle->setEnabled(SettingsManager::getInstance()->getSubtitle());
+    debugOverlay = new DebugOverlay();
+    debugOverlay->setEnabled(false);
+    debugOverlayTimer = new QTimer(this);
+    debugOverlayTimer->setInterval(kDebugOverlayInterval);
+    connect(debugOverlayTimer, &QTimer::timeout, this, &PlayerWindow::updateDebugOverlay);
+    // First, so that a frame sink run logs what the decoder made.
+    frameRecorder = new FrameSinkRecorder();
+    frameRecorder->setEnabled(false);
+    player->installFilter(frameRecorder);
+#ifndef DD_NO_STAGE_TIMING
+    stageHead = new StageTiming::Marker(StageTiming::Marker::Head);
+    player->installFilter(stageHead);
+#endif
+    frameScaler = new FrameScaler();
+    player->installFilter(frameScaler);
+    toneMapFilter = new ToneMapFilter();
+    player->installFilter(toneMapFilter);
+    // After scaling, so that the buffers hold the frames as displayed.
+    pboUploader = new PboUploader();
+    pboUploader->setEnabled(SettingsManager::getInstance()->getPboUpload());
+    player->installFilter(pboUploader);
+    // Installed last, so that frames are handed to the renderer right
+    // after pacing without any other work in between.
+    framePacer = new FramePacer();
+    framePacer->setEnabled(SettingsManager::getInstance()->getFramePacing());
+    player->installFilter(framePacer);
+#ifndef DD_NO_STAGE_TIMING
+    stageTail = new StageTiming::Marker(StageTiming::Marker::Tail);
+    player->installFilter(stageTail);
+#endif
+    audioMeter = new AudioMeter();
+    player->installFilter(audioMeter);
+    // From here on, everything that touches the player or the subtitles
+    // goes through the controller.
+    controller = new PlaybackController(player);
+    controller->adopt(subtitle);
+    qualityController = new QualityController(this);
+    qualityController->setSampler([this]
+    {
+        QualityController::Sample sample;
+        const PlaybackController::Snapshot &snapshot = lastSnapshot;
+        sample.playing = snapshot.state == QtAV::AVPlayer::PlayingState;
+        sample.frameRate = snapshot.frameRate;
+        sample.displayFrameRate = snapshot.displayFrameRate;
+        sample.frames = frameScaler->frameCount();
+        if (frameScaler->videoThreadId() != 0)
+            sample.decodeTime = Utils::getThreadCpuTime(frameScaler->videoThreadId()) * 1000;
+#ifndef DD_NO_STAGE_TIMING
+        // Only the OpenGL renderers time their drawing, the others count
+        // as free.
+        const Histogram *render = StageTiming::histogram(StageTiming::Render);
+        sample.renders = render->count();
+        sample.renderTime = render->sum();
+#endif
+        sample.processCpuTime = Utils::getProcessCpuTime();
+        return sample;
+    });
+    connect(qualityController, &QualityController::levelChanged, this, &PlayerWindow::applyQualityLevel);
+    stallMonitor = new StallMonitor(this);
+    telemetry = new TelemetryPublisher(this);
+    connect(telemetry, &TelemetryPublisher::telemetryChanged, this, &PlayerWindow::telemetryChanged);
+    videoEffects = new VideoEffects(this);
+    setReadabilityOverlay(SettingsManager::getInstance()->getOverlayDim(), SettingsManager::getInstance()->getOverlayBlur(),
+                          SettingsManager::getInstance()->getOverlayVignette());
     setRenderer(SettingsManager::getInstance()->getRenderer());
     setImageQuality(SettingsManager::getInstance()->getImageQuality());
+    setDecodeProfile(SettingsManager::getInstance()->getDecodeProfile());
+    setQualityBudget(SettingsManager::getInstance()->getQualityBudget());
     setImageRatio(SettingsManager::getInstance()->getFitDesktop());
 }
 
 void PlayerWindow::initConnections()
 {
-    connect(player, &QtAV::AVPlayer::loaded, this, &PlayerWindow::onStartPlay);
-    connect(player, &QtAV::AVPlayer::positionChanged, this, [=](qint64 pos)
-    {
-        emit this->mediaPositionChanged(pos);
-        emit this->videoPositionTextChanged(QTime(0, 0, 0).addMSecs(pos).toString(QStringLiteral("HH:mm:ss")));
-    });
-    connect(player, &QtAV::AVPlayer::stateChanged, this, [=](QtAV::AVPlayer::State state)
-    {
-        if ((state == QtAV::AVPlayer::StoppedState) || (state == QtAV::AVPlayer::PausedState))
-            emit this->playStateChanged(false);
-        else if (state == QtAV::AVPlayer::PlayingState)
-            emit this->playStateChanged(true);
-    });
-    connect(player, &QtAV::AVPlayer::mediaStatusChanged, this, [=](QtAV::MediaStatus status)
-    {
-        if ((status == QtAV::MediaStatus::EndOfMedia) && (SettingsManager::getInstance()->getPlaybackMode() != SettingsManager::PlaybackMode::RepeatCurrentFile))
-            emit this->mediaEndReached();
-    });
-    connect(player, &QtAV::AVPlayer::mediaEndReached, this, [=]
+    connect(MetricsRegistry::getInstance(), &MetricsRegistry::aboutToCollect, this, &PlayerWindow::collectMetrics);
+    // Position and state changes come in batches from the controller's
+    // thread, the media info once a file is loaded.
+    connect(controller, &PlaybackController::snapshotChanged, this, &PlayerWindow::applySnapshot);
+    connect(controller, &PlaybackController::mediaLoaded, this, &PlayerWindow::onStartPlay);
+    connect(controller, &PlaybackController::mediaEndReached, this, [=]
     {
         if (SettingsManager::getInstance()->getPlaybackMode() != SettingsManager::PlaybackMode::RepeatCurrentFile)
             emit this->mediaEndReached();
     });
 }
 
+void PlayerWindow::applySnapshot()
+{
+    const PlaybackController::Snapshot snapshot = controller->takeSnapshot();
+    // Every update of the controller was a notification of the player.
+    telemetry->setPosition(snapshot.position, snapshot.sequence - lastSnapshot.sequence);
+    lastSnapshot = snapshot;
+    // Several state changes may have been folded into this snapshot, only
+    // the last one counts.
+    const bool nowPlaying = snapshot.state == QtAV::AVPlayer::PlayingState;
+    if (nowPlaying == playing)
+        return;
+    playing = nowPlaying;
+    telemetry->setPlaying(playing);
+    emit playStateChanged(playing);
+}
+
 void PlayerWindow::initAudio()
 {
-    if (player->audio())
+    if (controller->hasAudioOutput())
     {
         setVolume(SettingsManager::getInstance()->getVolume());
         setMute(SettingsManager::getInstance()->getMute());
@@ -183,6 +443,20 @@ void PlayerWindow::initAudio()
        emit this->audioAreaEnableChanged(false);
 }
 
+void PlayerWindow::updateAudioPipeline()
+{
+    if (!controller || !controller->hasAudioOutput())
+        return;
+    const bool silent = muted || (volumeLevel == 0);
+    if (silent == audioSuspended)
+        return;
+    audioSuspended = silent;
+    audioMeter->setSuspended(audioSuspended);
+    // Nobody can hear it, so don't demux, decode and resample the audio
+    // stream at all and release the output device until it's audible again.
+    controller->setAudioSuspended(audioSuspended);
+}
+
 bool PlayerWindow::setRenderer(int id)
 {
     if (!player || !subtitle)
@@ -190,59 +464,134 @@ bool PlayerWindow::setRenderer(int id)
     const QtAV::VideoRendererId rendererId = id <= 0 ? QtAV::VideoRendererId_GLWidget2 : static_cast<QtAV::VideoRendererId>(id);
     if ((renderer != nullptr) && (rendererId == renderer->id()))
         return false;
-    QtAV::VideoRenderer *videoRenderer = QtAV::VideoRenderer::create(rendererId);
-    if (!videoRenderer || !videoRenderer->isAvailable() || !videoRenderer->widget())
+    QElapsedTimer swapTimer;
+    swapTimer.start();
+    QtAV::VideoRenderer *videoRenderer = Utils::createVideoRenderer(rendererId);
+    // The frame sink is the only renderer that doesn't draw into a widget.
+    if (!videoRenderer || !videoRenderer->isAvailable()
+            || (!videoRenderer->widget() && (videoRenderer->id() != FrameSinkRenderer::rendererId)))
     {
         QMessageBox::critical(nullptr, QStringLiteral("Dynamic Desktop"), DD_TR("Current renderer is not available on your platform!"));
         return false;
     }
-    subtitle->uninstall();
-    player->setRenderer(videoRenderer);
-    QWidget *oldRendererWidget = nullptr;
-    if (renderer)
-        oldRendererWidget = renderer->widget();
+    QtAV::VideoRenderer *oldRenderer = renderer;
+    QWidget *oldRendererWidget = oldRenderer ? oldRenderer->widget() : nullptr;
+    QWidget *rendererWidget = videoRenderer->widget();
+    // The OpenGL renderers upload planar and semi-planar YUV (including
+    // high bit depth) as it is and convert it in their fragment shader.
+    // Forcing their preferred format would put a swscale pass on the
+    // decode thread for every frame that isn't already YUV420P. Formats a
+    // renderer can't display are still converted by QtAV automatically.
+    // This changes what 10-bit video looks like: it used to be truncated
+    // to 8 bits by swscale before the color conversion, now the shader
+    // converts the full precision samples and only the result is rounded,
+    // so gradients band less but frames no longer match old captures.
+    videoRenderer->forcePreferredPixelFormat(false);
+    // Before anything is drawn, so that the warm up below already loads
+    // its programs from the cache.
+    ShaderCache::install(videoRenderer->opengl());
+    renderer = videoRenderer;
+    setImageQuality(imageQuality);
+    setImageRatio(SettingsManager::getInstance()->getFitDesktop());
+    if (rendererWidget && oldRendererWidget && oldRendererWidget->isVisible())
+    {
+        // While paused the new renderer gets no other frame until playback
+        // goes on, so it is shown either way.
+        const QtAV::VideoFrame picture = RendererWarmUp::currentPicture(frameScaler->lastFrame(), oldRendererWidget, {subtitle, debugOverlay});
+        RendererWarmUp::warmUp(videoRenderer, oldRendererWidget, picture);
+    }
+    setUpdatesEnabled(false);
+    // The debug overlay after the subtitles, so that it is drawn on top of
+    // them. The old widget stays alive until the player let go of it.
+    controller->setRenderer(videoRenderer, oldRendererWidget, {subtitle, debugOverlay});
+    // Must happen while the old renderer's context still exists.
+    const bool isGL = (rendererId == QtAV::VideoRendererId_OpenGLWidget) || (rendererId == QtAV::VideoRendererId_GLWidget2)
+            || (rendererId == QtAV::VideoRendererId_GLWidget);
+    pboUploader->setGLWidget(isGL ? rendererWidget : nullptr);
+    videoEffects->setOpenGLVideo(videoRenderer->opengl());
+    if (videoRenderer->opengl())
+        connect(videoRenderer->opengl(), &QtAV::OpenGLVideo::afterRendering, framePacer, &FramePacer::presented, Qt::DirectConnection);
+#ifndef DD_NO_STAGE_TIMING
+    if (videoRenderer->opengl())
+    {
+        connect(videoRenderer->opengl(), &QtAV::OpenGLVideo::beforeRendering, &StageTiming::renderStarted);
+        connect(videoRenderer->opengl(), &QtAV::OpenGLVideo::afterRendering, &StageTiming::renderFinished);
+    }
+#endif
     if (oldRendererWidget)
     {
         mainLayout->removeWidget(oldRendererWidget);
-        if (oldRendererWidget->testAttribute(Qt::WA_DeleteOnClose))
-            oldRendererWidget->close();
-        else
-        {
-            oldRendererWidget->close();
-            delete oldRendererWidget;
-        }
+        oldRendererWidget->hide();
         oldRendererWidget = nullptr;
     }
-    renderer = videoRenderer;
-    mainLayout->addWidget(renderer->widget());
-    const QtAV::VideoRendererId vid = renderer->id();
-    if (vid == QtAV::VideoRendererId_GLWidget
-            || vid == QtAV::VideoRendererId_GLWidget2
-            || vid == QtAV::VideoRendererId_OpenGLWidget)
-        renderer->forcePreferredPixelFormat(true);
-    else
-        renderer->forcePreferredPixelFormat(false);
-    subtitle->installTo(renderer);
+    if (rendererWidget)
+        mainLayout->addWidget(rendererWidget);
+    setUpdatesEnabled(true);
+    if (oldRenderer)
+    {
+        rendererSwapTime = swapTimer.nsecsElapsed() / 1000;
+        DD_LOG_INFO(Renderer, "Renderer switched to %1 in %2 us", static_cast<int>(videoRenderer->id()), rendererSwapTime);
+    }
     return true;
 }
 
 void PlayerWindow::setImageQuality(const QString& quality)
 {
+    imageQuality = quality;
     if (!renderer)
         return;
-    if ((quality == QLatin1String("default")) &&
+    // The adaptive quality controller may override the user's choice
+    // while the wallpaper exceeds its budget.
+    const QString effectiveQuality = qualityController->level() >= QualityController::FastRendering
+            ? QStringLiteral("fastest") : quality;
+    if ((effectiveQuality == QLatin1String("default")) &&
             (renderer->quality() != QtAV::VideoRenderer::QualityDefault))
         renderer->setQuality(QtAV::VideoRenderer::QualityDefault);
-    else if ((quality == QLatin1String("best")) &&
+    else if ((effectiveQuality == QLatin1String("best")) &&
              (renderer->quality() != QtAV::VideoRenderer::QualityBest))
         renderer->setQuality(QtAV::VideoRenderer::QualityBest);
-    else if ((quality == QLatin1String("fastest")) &&
+    else if ((effectiveQuality == QLatin1String("fastest")) &&
              (renderer->quality() != QtAV::VideoRenderer::QualityFastest))
         renderer->setQuality(QtAV::VideoRenderer::QualityFastest);
 }
 
+void PlayerWindow::setDecodeProfile(const QString &profile)
+{
+    ecoDecoding = profile == QLatin1String("eco");
+    updateDecoder();
+}
+
+void PlayerWindow::setQualityBudget(quint32 percent)
+{
+    qualityController->setBudget(percent);
+}
+
+void PlayerWindow::setReadabilityOverlay(quint32 dim, quint32 blur, quint32 vignette)
+{
+    videoEffects->setReadability(dim, blur, vignette);
+    updateScaleFactor();
+}
+
+void PlayerWindow::setFrameSink(const QString &logFile)
+{
+    // Not saved to the settings, this is meant for a single benchmark or
+    // regression test run. Frames are consumed as fast as they are
+    // decoded, pacing them to the display would only slow the run down.
+    framePacer->setEnabled(false);
+    setRenderer(Utils::getVideoRendererId(Utils::VideoRendererId::FrameSink));
+    if (logFile.isEmpty())
+        return;
+    frameRecorder->setHashing(true);
+    if (frameRecorder->open(logFile))
+        frameRecorder->setEnabled(true);
+    else
+        DD_LOG_WARNING(Renderer, "Can't write the frame log %1", logFile);
+}
+
 void PlayerWindow::setImageRatio(bool fit)
 {
+    if (frameScaler)
+        frameScaler->setAspectRatioMode(fit ? Qt::IgnoreAspectRatio : Qt::KeepAspectRatio);
     if (!renderer)
         return;
     if (fit && (renderer->outAspectRatioMode() != QtAV::VideoRenderer::RendererAspectRatio))
@@ -251,6 +600,11 @@ void PlayerWindow::setImageRatio(bool fit)
         renderer->setOutAspectRatioMode(QtAV::VideoRenderer::VideoAspectRatio);
 }
 
+void PlayerWindow::setLogBenchmark(bool enabled)
+{
+    logBenchmark = enabled;
+}
+
 void PlayerWindow::setWindowMode(bool enabled)
 {
     if (windowMode != enabled)
@@ -261,108 +615,286 @@ void PlayerWindow::setRepeatCurrentFile(bool enabled)
 {
     if (player == nullptr)
         return;
-    player->setRepeat(enabled ? -1 : 0);
+    controller->post([=]
+    {
+        player->setRepeat(enabled ? -1 : 0);
+    });
+}
+
+void PlayerWindow::setDebugOverlay(bool visible)
+{
+    if (debugOverlay->isEnabled() == visible)
+        return;
+    debugOverlay->setEnabled(visible);
+    stallMonitor->setWatched(visible);
+    if (visible)
+    {
+        updateDebugOverlay();
+        debugOverlayTimer->start();
+    }
+    else
+    {
+        debugOverlayTimer->stop();
+        debugOverlay->clear();
+        if (renderer && renderer->widget())
+            renderer->widget()->update();
+    }
+    emit debugOverlayChanged(visible);
+}
+
+void PlayerWindow::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    // Decode output is downscaled to what the screen can actually show,
+    // so the renderer uploads and samples less data every frame.
+    if (frameScaler)
+        frameScaler->setTargetSize(size() * devicePixelRatioF());
+}
+
+void PlayerWindow::updateDebugOverlay()
+{
+    if (!renderer || !renderer->widget())
+        return;
+    debugOverlay->update(statistics(), renderer->widget()->size());
+    // Playing video repaints on every frame anyway, a still picture has
+    // to be repainted for the new numbers to show up.
+    if (!playing)
+        renderer->widget()->update();
+}
+
+void PlayerWindow::applyQualityLevel(int level)
+{
+    Q_UNUSED(level)
+    setImageQuality(imageQuality);
+    updateDecoder();
+    updateScaleFactor();
+}
+
+void PlayerWindow::updateScaleFactor()
+{
+    const qreal qualityFactor = qualityController->level() >= QualityController::ReducedResolution ? 0.5 : 1.0;
+    // A blurred wallpaper loses nothing when decoded at a lower resolution.
+    frameScaler->setScaleFactor(qMin(qualityFactor, videoEffects->preferredScaleFactor()));
+}
+
+void PlayerWindow::probeStreamColor(const QString &url)
+{
+    // Until the probe finishes the new file is shown as SDR.
+    toneMapFilter->setStreamColor(ToneMapping::StreamColor());
+    videoEffects->setStreamColor(ToneMapping::StreamColor());
+    if (!Utils::isVideo(url))
+        return;
+    auto watcher = new QFutureWatcher<ToneMapping::StreamColor>(this);
+    connect(watcher, &QFutureWatcher<ToneMapping::StreamColor>::finished, this, [=]
+    {
+        watcher->deleteLater();
+        if (!player || (currentFile() != url))
+            return;
+        const ToneMapping::StreamColor color = watcher->result();
+        if (color.transfer == ToneMapping::SDR)
+            return;
+        DD_LOG_INFO(Renderer, "Tone mapping %1 content, peak %2 nits", color.transfer == ToneMapping::PQ ? "PQ" : "HLG", color.peakLuminance);
+        toneMapFilter->setStreamColor(color);
+        videoEffects->setStreamColor(color);
+    });
+    watcher->setFuture(QtConcurrent::run(ToneMapping::probe, url));
+}
+
+void PlayerWindow::loadPosterFrame(const QString &url)
+{
+    // The decoder needs some time to open the file and produce its first
+    // frame, the cached poster frame fills the gap. Decoding a screen
+    // sized JPEG is too slow for the GUI thread.
+    posterUrl = url;
+    posterImage = QImage();
+    posterStopAcknowledged = false;
+    auto watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [=]
+    {
+        watcher->deleteLater();
+        if (posterUrl != url)
+            return;
+        posterImage = watcher->result();
+        if (posterImage.isNull())
+        {
+            posterUrl.clear();
+            ThumbnailManager::getInstance()->requestThumbnail(url);
+            return;
+        }
+        showPosterFrame();
+    });
+    watcher->setFuture(QtConcurrent::run(ThumbnailManager::getInstance(), &ThumbnailManager::posterFrame, url));
+}
+
+void PlayerWindow::onStopAcknowledged(const QString &url)
+{
+    if (posterUrl != url)
+        return;
+    posterStopAcknowledged = true;
+    posterFrameCount = frameScaler->frameCount();
+    showPosterFrame();
+}
+
+void PlayerWindow::showPosterFrame()
+{
+    if (!posterStopAcknowledged || posterImage.isNull())
+        return;
+    // Opening the file may have failed or another one was chosen since.
+    // Once the new file produced a frame, the poster would only hide it.
+    if (renderer && (posterUrl == currentFile()) && (frameScaler->frameCount() == posterFrameCount))
+        renderer->receive(QtAV::VideoFrame(posterImage));
+    posterUrl.clear();
+    posterImage = QImage();
+}
+
+void PlayerWindow::updateDecoder()
+{
+    const bool eco = ecoDecoding || (qualityController->level() >= QualityController::EcoDecoding);
+    if (ecoDecoderActive == eco)
+        return;
+    ecoDecoderActive = eco;
+    DD_LOG_INFO(Decoder, "Eco decoding %1", ecoDecoderActive ? "on" : "off");
+    if (!player)
+        return;
+    const QVariantHash codecOptions = videoCodecOptions();
+    controller->post([=]
+    {
+        player->setOptionsForVideoCodec(codecOptions);
+        DecodeProfile::apply(player->videoDecoder(), eco);
+    });
 }
 
 void PlayerWindow::onStartPlay()
 {
     if (!player || !subtitle)
         return;
+    const PlaybackController::MediaInfo media = controller->mediaInfo();
+#ifndef DD_NO_LOGGING
+    if (logBenchmark)
+        frameScaler->requestLogBenchmark();
+#endif
     emit this->clearAllTracks();
-    emit this->mediaSliderUnitChanged(player->notifyInterval());
-    emit this->mediaSliderRangeChanged(player->duration());
-    emit this->mediaPositionChanged(player->position());
-    emit this->seekAreaEnableChanged(player->isSeekable());
-    emit this->audioAreaEnableChanged(player->audio() ? true : false);
-    emit this->videoTracksChanged(player->internalVideoTracks());
-    emit this->audioTracksChanged(player->internalAudioTracks(), false);
-    emit this->videoDurationTextChanged(QTime(0, 0, 0).addMSecs(player->mediaStopPosition()).toString(QStringLiteral("HH:mm:ss")));
-    bool externalAudioLoaded = false;
+    emit this->mediaSliderUnitChanged(static_cast<quint32>(media.notifyInterval));
+    emit this->mediaSliderRangeChanged(media.duration);
+    emit this->seekAreaEnableChanged(media.seekable);
+    emit this->audioAreaEnableChanged(controller->hasAudioOutput());
+    telemetry->setDuration(media.stopPosition);
+    telemetry->setPosition(controller->snapshot().position, 0);
+    emit this->videoTracksChanged(toMediaTracks(media.videoTracks));
+    emit this->audioTracksChanged(toMediaTracks(media.audioTracks), false);
+    QStringList externalAudioFiles;
     if (SettingsManager::getInstance()->getAudioAutoLoad())
     {
-        QVariantList externalAudioTracks = player->externalAudioTracks();
-        if (!externalAudioTracks.isEmpty())
+        if (!media.externalAudioTracks.isEmpty())
         {
-            emit this->audioTracksChanged(player->externalAudioTracks(), true);
-            for (const auto& track : externalAudioTracks)
+            emit this->audioTracksChanged(toMediaTracks(media.externalAudioTracks), true);
+            for (const auto& track : media.externalAudioTracks)
             {
                 QVariantMap trackData = track.toMap();
                 const QString audioFilePath = trackData[QStringLiteral("file")].toString();
                 if (!audioFilePath.isEmpty())
-                    if (player->setExternalAudio(audioFilePath))
-                    {
-                        externalAudioLoaded = true;
-                        break;
-                    }
-                    else
-                        continue;
+                    externalAudioFiles.append(audioFilePath);
             }
         }
     }
-    if (!externalAudioLoaded)
-        player->setExternalAudio(QString());
-    emit this->subtitleTracksChanged(player->internalSubtitleTracks(), false);
+    controller->loadExternalAudio(externalAudioFiles);
+    emit this->subtitleTracksChanged(toMediaTracks(media.subtitleTracks), false);
+    QStringList externalSubtitles;
     if (SettingsManager::getInstance()->getSubtitleAutoLoad())
     {
-        QVariantList externalSubtitleTracks;
-        QStringList externalSubtitlePaths = Utils::externalFilesToLoad(QFileInfo(player->file()), QStringLiteral("sub"));
-        if (!externalSubtitlePaths.isEmpty())
+        externalSubtitles = Utils::externalFilesToLoad(QFileInfo(media.file), QStringLiteral("sub"));
+        if (!externalSubtitles.isEmpty())
         {
-            for (const auto& subPath : externalSubtitlePaths)
+            MediaTracks externalSubtitleTracks;
+            for (const auto& subPath : qAsConst(externalSubtitles))
             {
-                QVariantMap externalSubtitle;
-                externalSubtitle[QStringLiteral("file")] = subPath;
+                MediaTrack externalSubtitle;
+                externalSubtitle.id = subPath;
+                externalSubtitle.file = subPath;
                 externalSubtitleTracks.append(externalSubtitle);
             }
             emit this->subtitleTracksChanged(externalSubtitleTracks, true);
         }
     }
-    if (!subtitle->file().isEmpty())
-        subtitle->setFile(QString());
-    subtitle->setEnabled(false);
-    if (SettingsManager::getInstance()->getSubtitle())
+    const bool subtitlesEnabled = SettingsManager::getInstance()->getSubtitle();
+    const bool internalSubtitles = media.subtitleStreamCount > 0;
+    controller->post([=]
     {
-        if (player->subtitleStreamCount() > 0)
+        if (!subtitle->file().isEmpty())
+            subtitle->setFile(QString());
+        subtitle->setEnabled(false);
+        if (!subtitlesEnabled)
+            return;
+        if (internalSubtitles)
         {
             subtitle->setEnabled(true);
             player->setSubtitleStream(0);
         }
-        else if (SettingsManager::getInstance()->getSubtitleAutoLoad())
+        else if (!externalSubtitles.isEmpty())
         {
-            QStringList externalSubtitles = Utils::externalFilesToLoad(QFileInfo(player->file()), QStringLiteral("sub"));
-            if (!externalSubtitles.isEmpty())
-            {
-                subtitle->setEnabled(true);
-                subtitle->setFile(externalSubtitles.constFirst());
-            }
+            subtitle->setEnabled(true);
+            subtitle->setFile(externalSubtitles.constFirst());
+        }
+    });
+}
+
+QVariantHash PlayerWindow::videoCodecOptions() const
+{
+    QVariantHash opt;
+    if (SettingsManager::getInstance()->getHwdec())
+    {
+        const QStringList decoders = SettingsManager::getInstance()->getDecoders();
+        if (decoders.contains(QStringLiteral("CUDA")))
+        {
+            QVariantHash cuda_opt;
+            cuda_opt[QStringLiteral("surfaces")] = 0;
+            cuda_opt[QStringLiteral("copyMode")] = QStringLiteral("ZeroCopy");
+            opt[QStringLiteral("CUDA")] = cuda_opt;
+        }
+        if (decoders.contains(QStringLiteral("D3D11")))
+        {
+            QVariantHash d3d11_opt;
+            //d3d11_opt[QStringLiteral("???")] = ???;
+            d3d11_opt[QStringLiteral("copyMode")] = QStringLiteral("ZeroCopy");
+            opt[QStringLiteral("D3D11")] = d3d11_opt;
+        }
+        if (decoders.contains(QStringLiteral("DXVA")))
+        {
+            QVariantHash dxva_opt;
+            //dxva_opt[QStringLiteral("???")] = ???;
+            dxva_opt[QStringLiteral("copyMode")] = QStringLiteral("ZeroCopy");
+            opt[QStringLiteral("DXVA")] = dxva_opt;
         }
     }
+    DecodeProfile::addOptions(&opt, ecoDecoderActive);
+    return opt;
+}
+
+QString PlayerWindow::currentFile() const
+{
+    // The file last opened, the player may still be loading it.
+    return currentUrl;
 }
 
 void PlayerWindow::play()
 {
     if (!player)
         return;
-    if (Utils::isPicture(player->file()))
-        return;
-    if (player->isPaused())
-        player->pause(false);
+    controller->play();
 }
 
 void PlayerWindow::pause()
 {
     if (!player)
         return;
-    if (player->isPlaying())
-        player->pause();
+    controller->pause(QStringLiteral("user"));
 }
 
 void PlayerWindow::stop()
 {
     if (!player)
         return;
-    if (player->isLoaded())
-        player->stop();
+    controller->stop();
 }
 
 void PlayerWindow::setUrl(const QString& url)
@@ -371,58 +903,67 @@ void PlayerWindow::setUrl(const QString& url)
         return;
     if (!url.isEmpty())
     {
-        if (url == player->file())
+        if (url == currentFile())
         {
             if (!Utils::isPicture(url))
                 play();
             return;
         }
-        player->stop();
+        QStringList decoders = QStringList() << QStringLiteral("FFmpeg");
         if (SettingsManager::getInstance()->getHwdec())
         {
-            QStringList decoders = SettingsManager::getInstance()->getDecoders();
+            decoders = SettingsManager::getInstance()->getDecoders();
             if (!decoders.contains(QStringLiteral("FFmpeg")))
                 decoders << QStringLiteral("FFmpeg");
+        }
+        const QVariantHash codecOptions = videoCodecOptions();
+        controller->post([=]
+        {
+            player->stop();
             if (player->videoDecoderPriority() != decoders)
                 player->setVideoDecoderPriority(decoders);
-            if (decoders.contains(QStringLiteral("CUDA")))
-            {
-                QVariantHash cuda_opt;
-                cuda_opt[QStringLiteral("surfaces")] = 0;
-                cuda_opt[QStringLiteral("copyMode")] = QStringLiteral("ZeroCopy");
-                QVariantHash opt;
-                opt[QStringLiteral("CUDA")] = cuda_opt;
-                player->setOptionsForVideoCodec(opt);
-            }
-            if (decoders.contains(QStringLiteral("D3D11")))
-            {
-                QVariantHash d3d11_opt;
-                //d3d11_opt[QStringLiteral("???")] = ???;
-                d3d11_opt[QStringLiteral("copyMode")] = QStringLiteral("ZeroCopy");
-                QVariantHash opt;
-                opt[QStringLiteral("D3D11")] = d3d11_opt;
-                player->setOptionsForVideoCodec(opt);
-            }
-            if (decoders.contains(QStringLiteral("DXVA")))
-            {
-                QVariantHash dxva_opt;
-                //dxva_opt[QStringLiteral("???")] = ???;
-                dxva_opt[QStringLiteral("copyMode")] = QStringLiteral("ZeroCopy");
-                QVariantHash opt;
-                opt[QStringLiteral("DXVA")] = dxva_opt;
-                player->setOptionsForVideoCodec(opt);
-            }
+            // setOptionsForVideoCodec() replaces all previous options, so
+            // everything has to be passed in one go.
+            player->setOptionsForVideoCodec(codecOptions);
+            // No frame of the previous file reaches the renderer any more.
+            QMetaObject::invokeMethod(this, "onStopAcknowledged", Qt::QueuedConnection, Q_ARG(QString, url));
+        });
+        if (renderer && Utils::isVideo(url))
+            loadPosterFrame(url);
+        else
+            posterUrl.clear();
+        probeStreamColor(url);
+        // The controller deletes the previous input once the player is done
+        // with it.
+        mediaInput = nullptr;
+        const QString scheme = QUrl(url).scheme().toLower();
+        if (SettingsManager::getInstance()->getMappedFileIO() && Utils::isVideo(url) && QFileInfo(url).isFile())
+        {
+            const auto mappedFile = new MappedFileIO();
+            mappedFile->setUrl(url);
+            if (mappedFile->isMapped())
+                mediaInput = mappedFile;
+            else
+                delete mappedFile;
+        }
+        else if (SettingsManager::getInstance()->getStreamCache() && !Utils::isPicture(url)
+                 && ((scheme == QLatin1String("http")) || (scheme == QLatin1String("https"))))
+        {
+            // Web wallpapers are downloaded once and looped from disk.
+            StreamCacheIO::setCacheLimit(static_cast<qint64>(SettingsManager::getInstance()->getStreamCacheLimit()) * 1024 * 1024);
+            mediaInput = new StreamCacheIO();
+            mediaInput->setUrl(url);
         }
-        else if (player->videoDecoderPriority() != (QStringList() << QStringLiteral("FFmpeg")))
-            player->setVideoDecoderPriority(QStringList() << QStringLiteral("FFmpeg"));
-        player->play(url);
+        DD_LOG_INFO(Playback, "Opening %1 through %2", url, mediaInput ? mediaInput->name() : QStringLiteral("FFmpeg"));
+        currentUrl = url;
+        controller->open(url, mediaInput);
         setWindowTitle(QFileInfo(url).fileName());
     }
-    else if (!player->file().isEmpty() && !Utils::isPicture(player->file()))
+    else if (!currentFile().isEmpty() && !Utils::isPicture(currentFile()))
         play();
-    if (!Utils::isPicture(player->file()))
+    if (!Utils::isPicture(currentFile()))
         setRepeatCurrentFile(SettingsManager::getInstance()->getPlaybackMode() == SettingsManager::PlaybackMode::RepeatCurrentFile);
-    if (!player->file().isEmpty() && (Utils::isVideo(player->file()) || Utils::isPicture(player->file())))
+    if (!currentFile().isEmpty() && (Utils::isVideo(currentFile()) || Utils::isPicture(currentFile())))
     {
         if (!windowMode)
             if (Wallpaper::isWallpaperHidden())
@@ -1,13 +1,31 @@
 #pragma once
 
+#include "playbackcontroller.h"
+#include "telemetry.h"
+
+#include <QImage>
 #include <QWidget>
 
+QT_FORWARD_DECLARE_CLASS(QTimer)
 QT_FORWARD_DECLARE_CLASS(QVBoxLayout)
 
+class AudioMeter;
+class DebugOverlay;
+class FramePacer;
+class FrameScaler;
+class FrameSinkRecorder;
+class PboUploader;
+class QualityController;
+class StallMonitor;
+class ToneMapFilter;
+class VideoEffects;
+
 namespace QtAV
 {
     QT_FORWARD_DECLARE_CLASS(AVPlayer)
+    QT_FORWARD_DECLARE_CLASS(MediaIO)
     QT_FORWARD_DECLARE_CLASS(SubtitleFilter)
+    QT_FORWARD_DECLARE_CLASS(VideoFilter)
     QT_FORWARD_DECLARE_CLASS(VideoRenderer)
 }
 
@@ -17,23 +35,31 @@ class PlayerWindow : public QWidget
 
 signals:
     void playStateChanged(bool);
-    void mediaPositionChanged(qint64);
-    void videoPositionTextChanged(const QString &);
     void audioAreaEnableChanged(bool);
     void clearAllTracks();
     void mediaSliderUnitChanged(quint32);
     void mediaSliderRangeChanged(qint64);
     void seekAreaEnableChanged(bool);
-    void videoTracksChanged(const QVariantList &);
-    void audioTracksChanged(const QVariantList &, bool);
-    void videoDurationTextChanged(const QString &);
-    void subtitleTracksChanged(const QVariantList &, bool);
+    void videoTracksChanged(const MediaTracks &);
+    void audioTracksChanged(const MediaTracks &, bool);
+    void subtitleTracksChanged(const MediaTracks &, bool);
+    // Coalesced, and only while a view added with addTelemetryView() is
+    // visible.
+    void telemetryChanged(const PlaybackTelemetry &);
     void mediaEndReached();
+    void debugOverlayChanged(bool);
 
 public:
     explicit PlayerWindow(QWidget *parent = nullptr);
     ~PlayerWindow() override;
 
+public:
+    QVariantHash statistics() const;
+    bool isDebugOverlayVisible() const;
+    // Everything that changes the player goes through it, from any thread.
+    PlaybackController *playbackController() const;
+    void addTelemetryView(QWidget *view);
+
 public slots:
     void setVolume(quint32 volume = 9);
     void setMute(bool mute = true);
@@ -52,23 +78,78 @@ public slots:
     void setUrl(const QString &url);
     bool setRenderer(int id);
     void setImageQuality(const QString &quality = QStringLiteral("best"));
+    void setDecodeProfile(const QString &profile = QStringLiteral("default"));
+    void setQualityBudget(quint32 percent = 0);
+    void setReadabilityOverlay(quint32 dim = 0, quint32 blur = 0, quint32 vignette = 0);
+    void setFrameSink(const QString &logFile = QString());
+    void setLogBenchmark(bool enabled = true);
     void setImageRatio(bool fit = true);
     void setWindowMode(bool enabled = true);
     void setRepeatCurrentFile(bool enabled = true);
+    void setDebugOverlay(bool visible = true);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
 
 private slots:
     void initUI();
     void initConnections();
     void initPlayer();
     void initAudio();
+    void updateAudioPipeline();
+    void applyQualityLevel(int level);
+    void updateScaleFactor();
+    void probeStreamColor(const QString &url);
+    void loadPosterFrame(const QString &url);
+    void onStopAcknowledged(const QString &url);
+    void showPosterFrame();
+    void updateDecoder();
     void onStartPlay();
+    void collectMetrics();
+    void applySnapshot();
+    void updateDebugOverlay();
+    QVariantHash videoCodecOptions() const;
+    QString currentFile() const;
 
 private:
     QtAV::AVPlayer *player = nullptr;
+    PlaybackController *controller = nullptr;
     QtAV::VideoRenderer *renderer = nullptr;
     QtAV::SubtitleFilter *subtitle = nullptr;
+    DebugOverlay *debugOverlay = nullptr;
+    QTimer *debugOverlayTimer = nullptr;
+    QtAV::MediaIO *mediaInput = nullptr;
+    FrameSinkRecorder *frameRecorder = nullptr;
+    FrameScaler *frameScaler = nullptr;
+    ToneMapFilter *toneMapFilter = nullptr;
+    PboUploader *pboUploader = nullptr;
+    FramePacer *framePacer = nullptr;
+    AudioMeter *audioMeter = nullptr;
+#ifndef DD_NO_STAGE_TIMING
+    QtAV::VideoFilter *stageHead = nullptr;
+    QtAV::VideoFilter *stageTail = nullptr;
+#endif
+    QualityController *qualityController = nullptr;
+    StallMonitor *stallMonitor = nullptr;
+    TelemetryPublisher *telemetry = nullptr;
+    VideoEffects *videoEffects = nullptr;
     QVBoxLayout *mainLayout = nullptr;
-    bool windowMode = false;
+    bool windowMode = false, ecoDecoding = false, ecoDecoderActive = false, logBenchmark = false;
+    QString imageQuality = QStringLiteral("best");
+    bool muted = false, audioSuspended = false;
+    quint32 volumeLevel = 9;
+    qint64 rendererSwapTime = -1;
+    QString currentUrl;
+    // The poster of the file being opened, shown once it is loaded and
+    // the player let go of the previous file.
+    QString posterUrl;
+    QImage posterImage;
+    bool posterStopAcknowledged = false;
+    quint64 posterFrameCount = 0;
+    bool playing = false;
+    // The last state the controller delivered. Scrapes and statistics
+    // read this copy, they never wait for the controller's thread.
+    PlaybackController::Snapshot lastSnapshot;
 
 private:
     Q_DISABLE_COPY(PlayerWindow)
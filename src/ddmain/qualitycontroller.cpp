@@ -0,0 +1,170 @@
+#include "qualitycontroller.h"
+#include "logger.h"
+
+#include <QThread>
+#include <QTimer>
+
+const int kSampleInterval = 1000;
+// Step down quickly, step up reluctantly: a level is only raised again
+// after the load stayed well below the budget for a while, otherwise the
+// controller would oscillate around the budget.
+const int kDowngradeSamples = 3;
+const int kUpgradeSamples = 10;
+const qreal kUpgradeHeadroom = 0.6;
+// Share of a frame's interval that decoding and drawing it may take. The
+// rest is left to the demuxer, the compositor and the jitter of both; a
+// player that needs all of it drops the next frame that is a little
+// harder to decode.
+const qreal kMaxFrameLoad = 0.8;
+
+QualityController::QualityController(QObject *parent) : QObject(parent)
+{
+    timer = new QTimer(this);
+    timer->setInterval(kSampleInterval);
+    connect(timer, &QTimer::timeout, this, &QualityController::sample);
+    wallClock.start();
+}
+
+int QualityController::level() const
+{
+    return currentLevel;
+}
+
+quint32 QualityController::budget() const
+{
+    return cpuBudget;
+}
+
+void QualityController::setBudget(quint32 percent)
+{
+    cpuBudget = qMin(percent, static_cast<quint32>(100));
+    reset();
+    if (cpuBudget > 0)
+    {
+        if (sampler)
+            timer->start();
+    }
+    else
+    {
+        timer->stop();
+        setLevel(FullQuality, QStringLiteral("adaptive quality disabled"));
+    }
+}
+
+void QualityController::setSampler(const Sampler &newSampler)
+{
+    sampler = newSampler;
+    setBudget(cpuBudget);
+}
+
+QVariantHash QualityController::statistics() const
+{
+    QVariantHash stats;
+    stats[QStringLiteral("quality.budget")] = cpuBudget;
+    stats[QStringLiteral("quality.level")] = currentLevel;
+    stats[QStringLiteral("quality.cpu")] = cpuUsage;
+    stats[QStringLiteral("quality.frameCost")] = frameCost;
+    stats[QStringLiteral("quality.frameLoad")] = frameLoad;
+    stats[QStringLiteral("quality.dropped")] = droppedRatio;
+    stats[QStringLiteral("quality.decisions")] = decisions;
+    stats[QStringLiteral("quality.lastDecision")] = lastDecision;
+    return stats;
+}
+
+void QualityController::update(const Sample &current)
+{
+    if (!current.playing)
+    {
+        // Nothing is decoded while paused, the next sample must not
+        // average over the idle period.
+        reset();
+        return;
+    }
+    if (!haveLastSample)
+    {
+        lastSample = current;
+        haveLastSample = true;
+        return;
+    }
+    const qint64 elapsed = current.time - lastSample.time;
+    if (elapsed <= 0)
+        return;
+    const Sample last = lastSample;
+    lastSample = current;
+    // The budget the user sets is one of the whole machine, only the
+    // process CPU time can be held against it.
+    cpuUsage = static_cast<qreal>(current.processCpuTime - last.processCpuTime) * 100.0
+            / (elapsed * qMax(1, QThread::idealThreadCount()));
+    droppedRatio = current.frameRate > 0.0 ? qBound(0.0, 1.0 - current.displayFrameRate / current.frameRate, 1.0) : 0.0;
+    // Whether the player keeps up is a matter of each frame fitting into
+    // its interval, which the CPU share of the process can't tell on a
+    // machine with many cores or a busy GPU.
+    const quint64 frames = current.frames - last.frames;
+    const quint64 renders = current.renders - last.renders;
+    frameCost = 0.0;
+    frameLoad = 0.0;
+    if ((frames > 0) && (current.frameRate > 0.0))
+    {
+        frameCost = static_cast<qreal>(current.decodeTime - last.decodeTime) / frames;
+        if (renders > 0)
+            frameCost += static_cast<qreal>(current.renderTime - last.renderTime) / renders;
+        qreal frameInterval = 1000000.0 / current.frameRate;
+        // Eco decoding leaves frames out on purpose, the ones that are
+        // decoded have the time of those that aren't.
+        if (currentLevel >= EcoDecoding)
+            frameInterval = qMax(frameInterval, elapsed * 1000.0 / frames);
+        frameLoad = frameCost / frameInterval;
+    }
+    const bool behind = frameLoad > kMaxFrameLoad;
+    if (behind || (cpuUsage > cpuBudget))
+    {
+        underloadedSamples = 0;
+        if ((++overloadedSamples >= kDowngradeSamples) && (currentLevel < ReducedResolution))
+        {
+            overloadedSamples = 0;
+            setLevel(currentLevel + 1, behind
+                     ? QStringLiteral("frame %0 ms > %1% of its interval").arg(frameCost / 1000.0, 0, 'f', 1).arg(kMaxFrameLoad * 100.0)
+                     : QStringLiteral("CPU %0% > budget %1%").arg(cpuUsage, 0, 'f', 1).arg(cpuBudget));
+        }
+    }
+    else if ((cpuUsage < cpuBudget * kUpgradeHeadroom) && (frameLoad < kMaxFrameLoad * kUpgradeHeadroom))
+    {
+        overloadedSamples = 0;
+        if ((++underloadedSamples >= kUpgradeSamples) && (currentLevel > FullQuality))
+        {
+            underloadedSamples = 0;
+            setLevel(currentLevel - 1, QStringLiteral("CPU %0%, frame %1 ms < %2% of budget %3%")
+                     .arg(cpuUsage, 0, 'f', 1).arg(frameCost / 1000.0, 0, 'f', 1).arg(kUpgradeHeadroom * 100.0).arg(cpuBudget));
+        }
+    }
+    else
+    {
+        overloadedSamples = 0;
+        underloadedSamples = 0;
+    }
+}
+
+void QualityController::sample()
+{
+    Sample current = sampler();
+    current.time = wallClock.elapsed();
+    update(current);
+}
+
+void QualityController::reset()
+{
+    overloadedSamples = 0;
+    underloadedSamples = 0;
+    haveLastSample = false;
+}
+
+void QualityController::setLevel(int newLevel, const QString &reason)
+{
+    if (newLevel == currentLevel)
+        return;
+    lastDecision = QStringLiteral("%0 -> %1: %2").arg(currentLevel).arg(newLevel).arg(reason);
+    ++decisions;
+    DD_LOG_INFO(Playback, "Adaptive quality: %1", lastDecision);
+    currentLevel = newLevel;
+    emit levelChanged(currentLevel);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QVariantHash>
+
+#include <functional>
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+class QualityController : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void levelChanged(int);
+
+public:
+    enum Level
+    {
+        FullQuality,
+        FastRendering,
+        EcoDecoding,
+        ReducedResolution
+    };
+
+    // What the player did so far. Times and counts are running totals, the
+    // controller works with the difference between two samples.
+    struct Sample
+    {
+        bool playing = false;
+        qreal frameRate = 0.0;
+        qreal displayFrameRate = 0.0;
+        // Frames out of the decoder and CPU time of the video thread, in
+        // microseconds.
+        quint64 frames = 0;
+        qint64 decodeTime = 0;
+        // Draws of the renderer and their CPU time, in microseconds.
+        quint64 renders = 0;
+        qint64 renderTime = 0;
+        // Milliseconds, like Utils::getProcessCpuTime().
+        qint64 processCpuTime = 0;
+        // Milliseconds of a monotonic clock.
+        qint64 time = 0;
+    };
+    using Sampler = std::function<Sample()>;
+
+    explicit QualityController(QObject *parent = nullptr);
+
+public:
+    int level() const;
+    quint32 budget() const;
+    void setBudget(quint32 percent = 0);
+    void setSampler(const Sampler &newSampler);
+    QVariantHash statistics() const;
+    // Called once a second by the timer, public for the tests.
+    void update(const Sample &current);
+
+private slots:
+    void sample();
+
+private:
+    void reset();
+    void setLevel(int newLevel, const QString &reason);
+
+private:
+    Sampler sampler;
+    QTimer *timer = nullptr;
+    QElapsedTimer wallClock;
+    quint32 cpuBudget = 0;
+    int currentLevel = FullQuality;
+    int overloadedSamples = 0, underloadedSamples = 0;
+    Sample lastSample;
+    bool haveLastSample = false;
+    qreal cpuUsage = 0.0, droppedRatio = 0.0;
+    qreal frameCost = 0.0, frameLoad = 0.0;
+    quint32 decisions = 0;
+    QString lastDecision;
+
+private:
+    Q_DISABLE_COPY(QualityController)
+};
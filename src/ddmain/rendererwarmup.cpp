@@ -0,0 +1,56 @@
+#include "rendererwarmup.h"
+
+#include <QGLWidget>
+#include <QImage>
+#include <QtAV/Filter.h>
+#include <QtAV/VideoRenderer.h>
+
+namespace RendererWarmUp
+{
+
+static QImage grabWidget(QWidget *widget)
+{
+    // QWidget::grab() can't read back the native window of a QGLWidget,
+    // QOpenGLWidget and the raster renderers are fine with it.
+    const auto glWidget = qobject_cast<QGLWidget *>(widget);
+    if (glWidget)
+        return glWidget->grabFrameBuffer();
+    return widget->grab().toImage();
+}
+
+QtAV::VideoFrame currentPicture(const QtAV::VideoFrame &lastFrame, QWidget *oldWidget, const QList<QtAV::VideoFilter *> &overlays)
+{
+    if (lastFrame.isValid())
+        return lastFrame;
+    if (!oldWidget || !oldWidget->isVisible())
+        return QtAV::VideoFrame();
+    QList<QtAV::VideoFilter *> disabled;
+    for (QtAV::VideoFilter *overlay : overlays)
+        if (overlay && overlay->isEnabled())
+        {
+            overlay->setEnabled(false);
+            disabled.append(overlay);
+        }
+    const QImage image = grabWidget(oldWidget).convertToFormat(QImage::Format_RGB32);
+    for (QtAV::VideoFilter *overlay : qAsConst(disabled))
+        overlay->setEnabled(true);
+    if (image.isNull())
+        return QtAV::VideoFrame();
+    return QtAV::VideoFrame(image);
+}
+
+void warmUp(QtAV::VideoRenderer *renderer, QWidget *oldWidget, const QtAV::VideoFrame &picture)
+{
+    QWidget *widget = renderer ? renderer->widget() : nullptr;
+    if (!widget || !oldWidget)
+        return;
+    widget->setParent(oldWidget->parentWidget());
+    widget->setGeometry(oldWidget->geometry());
+    widget->stackUnder(oldWidget);
+    widget->show();
+    if (picture.isValid())
+        renderer->receive(picture);
+    widget->repaint();
+}
+
+}
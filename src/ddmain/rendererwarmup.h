@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QList>
+#include <QtAV/VideoFrame.h>
+
+QT_FORWARD_DECLARE_CLASS(QWidget)
+
+namespace QtAV
+{
+    QT_FORWARD_DECLARE_CLASS(VideoFilter)
+    QT_FORWARD_DECLARE_CLASS(VideoRenderer)
+}
+
+// Prepares a new renderer behind the one it replaces, so that switching
+// renderers never shows a black frame, whether the video plays or not.
+namespace RendererWarmUp
+{
+
+// What the old renderer shows. That is "lastFrame" when the last decoded
+// frame is in host memory. Frames of zero-copy hardware decoders never
+// are, then the old renderer's widget is grabbed instead, with the
+// "overlays" turned off because the new renderer draws them itself.
+QtAV::VideoFrame currentPicture(const QtAV::VideoFrame &lastFrame, QWidget *oldWidget, const QList<QtAV::VideoFilter *> &overlays);
+// Shows the new renderer's widget right under "oldWidget" and paints
+// "picture" into it. It creates its native window and graphics context
+// while the old renderer is still on screen.
+void warmUp(QtAV::VideoRenderer *renderer, QWidget *oldWidget, const QtAV::VideoFrame &picture);
+
+}
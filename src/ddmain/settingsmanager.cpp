@@ -204,6 +204,66 @@ QString SettingsManager::getImageQuality() const
     return settings->value(QStringLiteral("quality"), QStringLiteral("best")).toString().toLower();
 }
 
+QString SettingsManager::getDecodeProfile() const
+{
+    return settings->value(QStringLiteral("decodeprofile"), QStringLiteral("default")).toString().toLower();
+}
+
+quint32 SettingsManager::getQualityBudget() const
+{
+    return qMin(settings->value(QStringLiteral("qualitybudget"), 0).toUInt(), static_cast<quint32>(100));
+}
+
+quint32 SettingsManager::getOverlayDim() const
+{
+    return qMin(settings->value(QStringLiteral("overlaydim"), 0).toUInt(), static_cast<quint32>(100));
+}
+
+quint32 SettingsManager::getOverlayBlur() const
+{
+    return qMin(settings->value(QStringLiteral("overlayblur"), 0).toUInt(), static_cast<quint32>(100));
+}
+
+quint32 SettingsManager::getOverlayVignette() const
+{
+    return qMin(settings->value(QStringLiteral("overlayvignette"), 0).toUInt(), static_cast<quint32>(100));
+}
+
+bool SettingsManager::getFramePacing() const
+{
+    return settings->value(QStringLiteral("framepacing"), true).toBool();
+}
+
+bool SettingsManager::getPboUpload() const
+{
+    return settings->value(QStringLiteral("pboupload"), true).toBool();
+}
+
+bool SettingsManager::getMappedFileIO() const
+{
+    return settings->value(QStringLiteral("mappedio"), true).toBool();
+}
+
+bool SettingsManager::getStreamCache() const
+{
+    return settings->value(QStringLiteral("streamcache"), true).toBool();
+}
+
+quint32 SettingsManager::getStreamCacheLimit() const
+{
+    return settings->value(QStringLiteral("streamcachelimit"), 2048).toUInt();
+}
+
+quint32 SettingsManager::getMetricsPort() const
+{
+    return qMin(settings->value(QStringLiteral("metricsport"), 0).toUInt(), static_cast<quint32>(65535));
+}
+
+QString SettingsManager::getLogFilter() const
+{
+    return settings->value(QStringLiteral("logfilter"), QStringLiteral("info")).toString();
+}
+
 bool SettingsManager::getAutoCheckUpdate() const
 {
     return settings->value(QStringLiteral("autoupdate"), false).toBool();
@@ -338,6 +398,70 @@ void SettingsManager::setImageQuality(const QString &quality)
     settings->setValue(QStringLiteral("quality"), quality);
 }
 
+void SettingsManager::setDecodeProfile(const QString &profile)
+{
+    if (profile.isEmpty())
+        return;
+    settings->setValue(QStringLiteral("decodeprofile"), profile.toLower());
+}
+
+void SettingsManager::setQualityBudget(quint32 percent)
+{
+    settings->setValue(QStringLiteral("qualitybudget"), qMin(percent, static_cast<quint32>(100)));
+}
+
+void SettingsManager::setOverlayDim(quint32 percent)
+{
+    settings->setValue(QStringLiteral("overlaydim"), qMin(percent, static_cast<quint32>(100)));
+}
+
+void SettingsManager::setOverlayBlur(quint32 percent)
+{
+    settings->setValue(QStringLiteral("overlayblur"), qMin(percent, static_cast<quint32>(100)));
+}
+
+void SettingsManager::setOverlayVignette(quint32 percent)
+{
+    settings->setValue(QStringLiteral("overlayvignette"), qMin(percent, static_cast<quint32>(100)));
+}
+
+void SettingsManager::setFramePacing(bool enabled)
+{
+    settings->setValue(QStringLiteral("framepacing"), enabled);
+}
+
+void SettingsManager::setPboUpload(bool enabled)
+{
+    settings->setValue(QStringLiteral("pboupload"), enabled);
+}
+
+void SettingsManager::setMappedFileIO(bool enabled)
+{
+    settings->setValue(QStringLiteral("mappedio"), enabled);
+}
+
+void SettingsManager::setStreamCache(bool enabled)
+{
+    settings->setValue(QStringLiteral("streamcache"), enabled);
+}
+
+void SettingsManager::setStreamCacheLimit(quint32 megabytes)
+{
+    settings->setValue(QStringLiteral("streamcachelimit"), megabytes);
+}
+
+void SettingsManager::setMetricsPort(quint32 port)
+{
+    settings->setValue(QStringLiteral("metricsport"), qMin(port, static_cast<quint32>(65535)));
+}
+
+void SettingsManager::setLogFilter(const QString &rules)
+{
+    if (rules.isEmpty())
+        return;
+    settings->setValue(QStringLiteral("logfilter"), rules.toLower());
+}
+
 void SettingsManager::setAutoCheckUpdate(bool enabled)
 {
     settings->setValue(QStringLiteral("autoupdate"), enabled);
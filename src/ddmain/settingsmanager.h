@@ -43,6 +43,19 @@ public:
 #endif
     int getRenderer() const;
     QString getImageQuality() const;
+    QString getDecodeProfile() const;
+    quint32 getQualityBudget() const;
+    quint32 getOverlayDim() const;
+    quint32 getOverlayBlur() const;
+    quint32 getOverlayVignette() const;
+    bool getFramePacing() const;
+    bool getPboUpload() const;
+    bool getMappedFileIO() const;
+    bool getStreamCache() const;
+    // Megabytes the stream cache may take on disk.
+    quint32 getStreamCacheLimit() const;
+    quint32 getMetricsPort() const;
+    QString getLogFilter() const;
     bool getAutoCheckUpdate() const;
     PlaybackMode getPlaybackMode() const;
     QString getCurrentPlaylistName() const;
@@ -68,6 +81,18 @@ public:
 #endif
     void setRenderer(int vid);
     void setImageQuality(const QString &quality = QStringLiteral("best"));
+    void setDecodeProfile(const QString &profile = QStringLiteral("default"));
+    void setQualityBudget(quint32 percent = 0);
+    void setOverlayDim(quint32 percent = 0);
+    void setOverlayBlur(quint32 percent = 0);
+    void setOverlayVignette(quint32 percent = 0);
+    void setFramePacing(bool enabled = true);
+    void setPboUpload(bool enabled = true);
+    void setMappedFileIO(bool enabled = true);
+    void setStreamCache(bool enabled = true);
+    void setStreamCacheLimit(quint32 megabytes = 2048);
+    void setMetricsPort(quint32 port = 0);
+    void setLogFilter(const QString &rules = QStringLiteral("info"));
     void setAutoCheckUpdate(bool enabled = true);
     void setPlaybackMode(PlaybackMode playbackMode = PlaybackMode::RepeatCurrentFile);
     void setCurrentPlaylistName(const QString &name);
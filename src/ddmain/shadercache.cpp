@@ -0,0 +1,213 @@
+#include "shadercache.h"
+#include "logger.h"
+
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QSaveFile>
+#include <QtAV/OpenGLVideo.h>
+#include <QtEndian>
+
+#include <cstring>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// A cache file is the magic, the binary format as little endian 32-bit
+// value and the binary.
+const QByteArray kMagic = QByteArrayLiteral("DDPB");
+const int kHeaderSize = 8;
+
+namespace
+{
+
+QAtomicInteger<quint64> cacheHits = 0;
+QAtomicInteger<quint64> cacheMisses = 0;
+QAtomicInteger<quint64> rejectedBinaries = 0;
+QAtomicInteger<quint64> linkFailures = 0;
+// Microseconds, from the start of link() until the program is usable.
+// Writing a new binary isn't part of it.
+QAtomicInteger<quint64> loadTime = 0;
+QAtomicInteger<quint64> buildTime = 0;
+
+QString cacheFileName(QOpenGLContext *context, const QByteArray &vertexShader, const QByteArray &fragmentShader,
+                      char const *const *attributes)
+{
+    QOpenGLFunctions *functions = context->functions();
+    QCryptographicHash key(QCryptographicHash::Sha1);
+    for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        key.addData(QByteArray(reinterpret_cast<const char *>(functions->glGetString(name))));
+        key.addData("\n", 1);
+    }
+    key.addData(vertexShader);
+    key.addData("\n", 1);
+    key.addData(fragmentShader);
+    for (int i = 0; attributes && attributes[i]; ++i)
+    {
+        key.addData("\n", 1);
+        key.addData(QByteArray(attributes[i]));
+    }
+    return ShaderCache::cacheDirectory() + QDir::separator() + QString::fromLatin1(key.result().toHex()) + QStringLiteral(".bin");
+}
+
+bool loadBinary(QOpenGLShaderProgram *program, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+    const QByteArray data = file.readAll();
+    file.close();
+    if ((data.size() > kHeaderSize) && data.startsWith(kMagic))
+    {
+        const GLenum format = qFromLittleEndian<quint32>(data.constData() + kMagic.size());
+        program->removeAllShaders();
+        QOpenGLContext::currentContext()->extraFunctions()->glProgramBinary(program->programId(), format, data.constData() + kHeaderSize,
+                                                                            data.size() - kHeaderSize);
+        // Without any shaders added, link() only checks whether the
+        // binary linked.
+        if (program->link())
+            return true;
+    }
+    rejectedBinaries.ref();
+    DD_LOG_INFO(Renderer, "Shader binary %1 rejected by the driver", QFileInfo(fileName).fileName());
+    QFile::remove(fileName);
+    return false;
+}
+
+void saveBinary(QOpenGLShaderProgram *program, const QString &fileName)
+{
+    QOpenGLExtraFunctions *functions = QOpenGLContext::currentContext()->extraFunctions();
+    GLint length = 0;
+    functions->glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    QByteArray data(kHeaderSize + length, Qt::Uninitialized);
+    GLenum format = 0;
+    functions->glGetProgramBinary(program->programId(), length, &length, &format, data.data() + kHeaderSize);
+    if (length <= 0)
+        return;
+    data.resize(kHeaderSize + length);
+    memcpy(data.data(), kMagic.constData(), static_cast<size_t>(kMagic.size()));
+    qToLittleEndian<quint32>(format, data.data() + kMagic.size());
+    QDir().mkpath(ShaderCache::cacheDirectory());
+    // Renderers of several processes may write the same program at once.
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly) || (file.write(data) != data.size()) || !file.commit())
+        DD_LOG_WARNING(Renderer, "Could not write shader binary %1", QDir::toNativeSeparators(fileName));
+}
+
+}
+
+void CachedVideoShader::initialize(QOpenGLShaderProgram *shaderProgram)
+{
+    // QtAV only compiles and links the program when it isn't linked yet.
+    QOpenGLShaderProgram *target = shaderProgram ? shaderProgram : program();
+    if (!target->isLinked() && (textureLocationCount() > 0))
+        ShaderCache::link(target, vertexShader(), fragmentShader(), attributeNames());
+    QtAV::VideoShader::initialize(shaderProgram);
+}
+
+namespace ShaderCache
+{
+
+QString cacheDirectory()
+{
+    return QDir::toNativeSeparators(QDir::cleanPath(QCoreApplication::applicationDirPath() + QStringLiteral("/shaders")));
+}
+
+bool isAvailable()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context)
+        return false;
+    if (context->isOpenGLES() ? (context->format().majorVersion() < 3)
+            : ((context->format().version() < qMakePair(4, 1)) && !context->hasExtension(QByteArrayLiteral("GL_ARB_get_program_binary"))))
+        return false;
+    // Mesa reports none when its own shader cache is turned off.
+    GLint formats = 0;
+    context->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+void install(QtAV::OpenGLVideo *video)
+{
+    if (!video)
+        return;
+    // OpenGLVideo doesn't own its user shader.
+    CachedVideoShader *shader = new CachedVideoShader();
+    video->setUserShader(shader);
+    QObject::connect(video, &QObject::destroyed, [shader]
+    {
+        delete shader;
+    });
+}
+
+bool link(QOpenGLShaderProgram *program, const QByteArray &vertexShader, const QByteArray &fragmentShader,
+          char const *const *attributes)
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!program || !context)
+        return false;
+    QElapsedTimer timer;
+    timer.start();
+    const bool binaries = isAvailable();
+    const QString fileName = binaries ? cacheFileName(context, vertexShader, fragmentShader, attributes) : QString();
+    if (binaries && QFile::exists(fileName) && loadBinary(program, fileName))
+    {
+        cacheHits.ref();
+        loadTime.fetchAndAddRelaxed(static_cast<quint64>(timer.nsecsElapsed() / 1000));
+        return true;
+    }
+    program->removeAllShaders();
+    bool linked = program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader)
+            && program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader);
+    if (linked)
+    {
+        for (int i = 0; attributes && attributes[i]; ++i)
+            program->bindAttributeLocation(attributes[i], i);
+        if (binaries)
+            context->extraFunctions()->glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        linked = program->link();
+    }
+    if (!linked)
+    {
+        linkFailures.ref();
+        DD_LOG_WARNING(Renderer, "Shader program failed to link: %1", program->log());
+        program->removeAllShaders();
+        return false;
+    }
+    cacheMisses.ref();
+    buildTime.fetchAndAddRelaxed(static_cast<quint64>(timer.nsecsElapsed() / 1000));
+    if (binaries)
+        saveBinary(program, fileName);
+    return true;
+}
+
+QVariantHash statistics()
+{
+    QVariantHash stats;
+    stats[QStringLiteral("shaders.cacheHits")] = cacheHits.load();
+    stats[QStringLiteral("shaders.cacheMisses")] = cacheMisses.load();
+    stats[QStringLiteral("shaders.rejectedBinaries")] = rejectedBinaries.load();
+    stats[QStringLiteral("shaders.linkFailures")] = linkFailures.load();
+    stats[QStringLiteral("shaders.loadTime")] = loadTime.load();
+    stats[QStringLiteral("shaders.buildTime")] = buildTime.load();
+    return stats;
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QVariantHash>
+#include <QtAV/VideoShader.h>
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLShaderProgram)
+
+namespace QtAV
+{
+    QT_FORWARD_DECLARE_CLASS(OpenGLVideo)
+}
+
+// QtAV's video shader, with its program linked through ShaderCache
+// instead of being compiled and linked from source by every renderer.
+class CachedVideoShader : public QtAV::VideoShader
+{
+public:
+    CachedVideoShader() = default;
+
+public:
+    void initialize(QOpenGLShaderProgram *shaderProgram = nullptr) override;
+
+private:
+    Q_DISABLE_COPY(CachedVideoShader)
+};
+
+// Keeps the linked shader programs of the OpenGL renderers on disk, so
+// that a new renderer loads them with glProgramBinary() instead of
+// compiling and linking them again. A binary is keyed by GL_VENDOR,
+// GL_RENDERER and GL_VERSION and by the program's source, which QtAV
+// generates per pixel format and texture type. A binary the driver
+// rejects, after an update for example, is replaced by a fresh one.
+// Drivers that can't hand out binaries link from source as before.
+namespace ShaderCache
+{
+
+QString cacheDirectory();
+// Whether the current context can load and save program binaries.
+bool isAvailable();
+// Installs a CachedVideoShader, it lives as long as "video". Do it before
+// the video is drawn for the first time.
+void install(QtAV::OpenGLVideo *video);
+// Links "program" from the cache or from the sources, binding the
+// attributes in "attributes" (null terminated) to their index. Needs a
+// current context. A program that fails to link is left empty.
+bool link(QOpenGLShaderProgram *program, const QByteArray &vertexShader, const QByteArray &fragmentShader,
+          char const *const *attributes);
+QVariantHash statistics();
+
+}
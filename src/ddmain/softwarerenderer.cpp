@@ -0,0 +1,164 @@
+#include "softwarerenderer.h"
+
+#include <QBackingStore>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QtAV/VideoFrame.h>
+
+#include <functional>
+
+// Don't bother other threads with less than this many rows each.
+const int kMinRowsPerBand = 64;
+
+const QtAV::VideoRendererId SoftwareRenderer::rendererId = ('D' << 24) | ('D' << 16) | ('S' << 8) | 'W';
+
+// One band of rows, converted on a thread of the renderer's pool.
+class ConvertBand : public QRunnable
+{
+public:
+    ConvertBand(const std::function<void(int, int, int)> &convert, int band, int first, int last, QSemaphore *done)
+        : convert(convert), band(band), first(first), last(last), done(done) {}
+
+    void run() override
+    {
+        convert(band, first, last);
+        done->release();
+    }
+
+private:
+    const std::function<void(int, int, int)> &convert;
+    const int band;
+    const int first;
+    const int last;
+    QSemaphore *done;
+};
+
+SoftwareRenderer::SoftwareRenderer(QWidget *parent) : QtAV::WidgetRenderer(parent)
+{
+    instructions = YuvConverter::bestInstructions();
+    // The painting thread converts a band itself.
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+    scratch.resize(pool.maxThreadCount() + 1);
+}
+
+QtAV::VideoRendererId SoftwareRenderer::id() const
+{
+    return rendererId;
+}
+
+bool SoftwareRenderer::isSupported(QtAV::VideoFormat::PixelFormat pixfmt) const
+{
+    // Everything else is converted to RGB32 by QtAV in a single swscale pass.
+    return (pixfmt == QtAV::VideoFormat::Format_YUV420P)
+            || (pixfmt == QtAV::VideoFormat::Format_NV12)
+            || QtAV::WidgetRenderer::isSupported(pixfmt);
+}
+
+bool SoftwareRenderer::receiveFrame(const QtAV::VideoFrame &frame)
+{
+    const QtAV::VideoFormat::PixelFormat pixfmt = frame.pixelFormat();
+    const bool yuv = frame.isValid() && frame.constBits(0)
+            && ((pixfmt == QtAV::VideoFormat::Format_YUV420P) || (pixfmt == QtAV::VideoFormat::Format_NV12));
+    {
+        QMutexLocker locker(&frameMutex);
+        yuvFrame = yuv ? frame : QtAV::VideoFrame();
+    }
+    // QtAV keeps the frame for the overlays and schedules the repaint. It
+    // can't make a pixmap of YUV, drawFrame() below does the drawing.
+    return QtAV::WidgetRenderer::receiveFrame(frame);
+}
+
+void SoftwareRenderer::paintEvent(QPaintEvent *event)
+{
+    paintRegion = event->region();
+    QtAV::WidgetRenderer::paintEvent(event);
+}
+
+void SoftwareRenderer::drawFrame()
+{
+    QtAV::VideoFrame frame;
+    {
+        QMutexLocker locker(&frameMutex);
+        frame = yuvFrame;
+    }
+    if (!frame.isValid())
+    {
+        QtAV::WidgetRenderer::drawFrame();
+        return;
+    }
+    const QRect target = videoRect();
+    if (target.isEmpty() || convertIntoBackingStore(frame, target))
+        return;
+    const qreal ratio = devicePixelRatioF();
+    const QSize size = (QSizeF(target.size()) * ratio).toSize();
+    if (image.size() != size)
+        image = QImage(size, QImage::Format_RGB32);
+    convert(frame, image.bits(), image.bytesPerLine(), size);
+    image.setDevicePixelRatio(ratio);
+    painter()->drawImage(target.topLeft(), image);
+}
+
+bool SoftwareRenderer::convertIntoBackingStore(const QtAV::VideoFrame &frame, const QRect &target)
+{
+    // Only what this paint event is allowed to touch, siblings on top of
+    // the video keep their pixels.
+    if (!QRegion(target).subtracted(paintRegion).isEmpty())
+        return false;
+    QBackingStore *store = backingStore();
+    QPaintDevice *device = store ? store->paintDevice() : nullptr;
+    if (!device || (device->devType() != QInternal::Image))
+        return false;
+    QImage *surface = static_cast<QImage *>(device);
+    if ((surface->format() != QImage::Format_RGB32) && (surface->format() != QImage::Format_ARGB32_Premultiplied))
+        return false;
+    const qreal ratio = surface->devicePixelRatio();
+    const QRect physical(((target.topLeft() + mapTo(window(), QPoint())) * ratio), (QSizeF(target.size()) * ratio).toSize());
+    if (!surface->rect().contains(physical))
+        return false;
+    convert(frame, surface->bits() + physical.top() * surface->bytesPerLine() + physical.left() * 4,
+            surface->bytesPerLine(), physical.size());
+    return true;
+}
+
+void SoftwareRenderer::convert(const QtAV::VideoFrame &frame, uchar *bits, int stride, const QSize &size)
+{
+    const bool nv12 = frame.pixelFormat() == QtAV::VideoFormat::Format_NV12;
+    YuvConverter::Source source;
+    source.y = frame.constBits(0);
+    source.u = frame.constBits(1);
+    source.v = nv12 ? source.u + 1 : frame.constBits(2);
+    source.yStride = frame.bytesPerLine(0);
+    source.uvStride = frame.bytesPerLine(1);
+    source.uvStep = nv12 ? 2 : 1;
+    source.width = frame.width();
+    source.height = frame.height();
+    const YuvConverter::Coefficients coefficients = YuvConverter::coefficients(
+                (frame.colorSpace() == QtAV::ColorSpace_BT709)
+                || ((frame.colorSpace() != QtAV::ColorSpace_BT601) && (frame.height() > 576)),
+                frame.colorRange() == QtAV::ColorRange_Full);
+    const int width = size.width();
+    const int height = size.height();
+    const bool halfOrLess = (width * 2 <= source.width) || (height * 2 <= source.height);
+    const YuvConverter::Filter filter = (halfOrLess && (quality() != QtAV::VideoRenderer::QualityFastest))
+            ? YuvConverter::Area : YuvConverter::Bilinear;
+    if ((scaling.filter != filter) || (scaling.sourceWidth != source.width) || (scaling.sourceHeight != source.height)
+            || (scaling.width != width) || (scaling.height != height))
+        scaling = YuvConverter::makeScaling(filter, source.width, source.height, width, height);
+    const YuvConverter::Instructions kernels = instructions;
+    YuvConverter::Scratch *bandScratch = scratch.data();
+    const std::function<void(int, int, int)> convertBand = [&](int band, int first, int last)
+    {
+        YuvConverter::convertScaled(source, bits + first * stride, stride, first, last, scaling, coefficients, kernels, bandScratch + band);
+    };
+    // Each band writes its own rows and has its own scratch rows, no
+    // synchronization is needed.
+    const int bandCount = qBound(1, height / kMinRowsPerBand, scratch.size());
+    QSemaphore done;
+    for (int i = 1; i < bandCount; ++i)
+        pool.start(new ConvertBand(convertBand, i, height * i / bandCount, height * (i + 1) / bandCount, &done));
+    convertBand(0, 0, height / bandCount);
+    done.acquire(bandCount - 1);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "yuvconverter.h"
+
+#include <QtAVWidgets/WidgetRenderer.h>
+#include <QImage>
+#include <QMutex>
+#include <QRegion>
+#include <QThreadPool>
+#include <QVector>
+
+// Converts YUV420P and NV12 frames to RGB on the CPU and scales them to
+// the size they are shown at in the same pass. The result is written
+// straight into the window's backing store when it is a plain image, so
+// a frame costs one pass over the screen pixels and no QPainter scaling.
+// Conversion happens while the widget is painted, split into bands of
+// rows that run on the renderer's own threads.
+class SoftwareRenderer : public QtAV::WidgetRenderer
+{
+    Q_OBJECT
+
+public:
+    static const QtAV::VideoRendererId rendererId;
+
+    explicit SoftwareRenderer(QWidget *parent = nullptr);
+
+public:
+    QtAV::VideoRendererId id() const override;
+    bool isSupported(QtAV::VideoFormat::PixelFormat pixfmt) const override;
+
+protected:
+    bool receiveFrame(const QtAV::VideoFrame &frame) override;
+    void drawFrame() override;
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    bool convertIntoBackingStore(const QtAV::VideoFrame &frame, const QRect &target);
+    void convert(const QtAV::VideoFrame &frame, uchar *bits, int stride, const QSize &size);
+
+private:
+    YuvConverter::Instructions instructions = YuvConverter::Scalar;
+    QThreadPool pool;
+    QMutex frameMutex;
+    QtAV::VideoFrame yuvFrame;
+    // Rebuilt when the frame size, the target size or the filter change.
+    YuvConverter::Scaling scaling;
+    QVector<YuvConverter::Scratch> scratch;
+    // Used when the backing store can't be written to, reallocated only
+    // when the size changes.
+    QImage image;
+    QRegion paintRegion;
+
+private:
+    Q_DISABLE_COPY(SoftwareRenderer)
+};
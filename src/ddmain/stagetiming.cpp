@@ -0,0 +1,153 @@
+#include "stagetiming.h"
+#include "histogram.h"
+#include "metrics.h"
+
+#include <QElapsedTimer>
+#include <QtAV/VideoFrame.h>
+
+// A frame that took longer than this between two stages belongs to a
+// pause or a seek, not to the playback path.
+const qint64 kMaxGap = 1000000;
+
+namespace StageTiming
+{
+
+struct StageInfo
+{
+    const char *name;
+    const char *metric;
+    const char *help;
+};
+
+const StageInfo kStages[StageCount] =
+{
+    {"demux", "dd_stage_demux_seconds", "Time of one read of the media input."},
+    {"interframe", "dd_stage_interframe_seconds", "Time the video thread spends between two frames, decoding and waiting."},
+    {"scale", "dd_stage_scale_seconds", "Time to downscale a decoded frame."},
+    {"copy", "dd_stage_copy_seconds", "Time to copy a frame into a pixel buffer."},
+    {"pace", "dd_stage_pace_seconds", "Time a frame is held back until its refresh slot."},
+    {"queue", "dd_stage_queue_seconds", "Time from the end of the filters until the frame is drawn."},
+    {"upload", "dd_stage_upload_seconds", "Time to start the texture upload of a frame."},
+    {"render", "dd_stage_render_seconds", "CPU time to draw a frame."}
+};
+
+static Histogram **histograms()
+{
+    static Histogram *stageHistograms[StageCount] = {};
+    static const bool registered = []
+    {
+        for (int i = 0; i != StageCount; ++i)
+            stageHistograms[i] = MetricsRegistry::getInstance()->summary(kStages[i].metric, kStages[i].help);
+        return true;
+    }();
+    Q_UNUSED(registered)
+    return stageHistograms;
+}
+
+static QAtomicInteger<qint64> lastFrameLeft = 0;
+static QAtomicInteger<qint64> pendingFrameLeft = 0;
+// Only touched by the GUI thread.
+static qint64 renderStart = 0;
+
+qint64 now()
+{
+    static QElapsedTimer clock;
+    static const bool started = (clock.start(), true);
+    Q_UNUSED(started)
+    return clock.nsecsElapsed() / 1000;
+}
+
+const char *name(Stage stage)
+{
+    return kStages[stage].name;
+}
+
+void record(Stage stage, qint64 microseconds)
+{
+    histograms()[stage]->record(microseconds);
+}
+
+const Histogram *histogram(Stage stage)
+{
+    return histograms()[stage];
+}
+
+void frameEntered()
+{
+    const qint64 left = lastFrameLeft.load();
+    const qint64 gap = now() - left;
+    if ((left > 0) && (gap < kMaxGap))
+        record(Interframe, gap);
+}
+
+void frameLeft()
+{
+    const qint64 time = now();
+    lastFrameLeft.store(time);
+    pendingFrameLeft.store(time);
+}
+
+void renderStarted()
+{
+    renderStart = now();
+    // Repaints without a new frame have nothing to queue.
+    const qint64 left = pendingFrameLeft.fetchAndStoreRelaxed(0);
+    if ((left > 0) && (renderStart - left < kMaxGap))
+        record(Queue, renderStart - left);
+}
+
+void renderFinished()
+{
+    if (renderStart > 0)
+        record(Render, now() - renderStart);
+    renderStart = 0;
+}
+
+QVariantHash statistics()
+{
+    QVariantHash stats;
+    for (int i = 0; i != StageCount; ++i)
+    {
+        const Histogram *histogram = histograms()[i];
+        if (histogram->count() == 0)
+            continue;
+        const QString prefix = QStringLiteral("stage.") + QLatin1String(kStages[i].name);
+        stats[prefix + QStringLiteral("P50")] = histogram->percentile(0.5);
+        stats[prefix + QStringLiteral("P99")] = histogram->percentile(0.99);
+        stats[prefix + QStringLiteral("P999")] = histogram->percentile(0.999);
+        stats[prefix + QStringLiteral("Max")] = histogram->max();
+    }
+    return stats;
+}
+
+QByteArray dump()
+{
+    QByteArray text = QByteArrayLiteral("stage          count       p50       p90       p99     p99.9       max  (ms)\n");
+    for (int i = 0; i != StageCount; ++i)
+    {
+        const Histogram *histogram = histograms()[i];
+        QByteArray line = QByteArray(kStages[i].name).leftJustified(10);
+        line += QByteArray::number(histogram->count()).rightJustified(10);
+        for (qreal fraction : {0.5, 0.9, 0.99, 0.999})
+            line += QByteArray::number(histogram->percentile(fraction) / 1000.0, 'f', 3).rightJustified(10);
+        line += QByteArray::number(histogram->max() / 1000.0, 'f', 3).rightJustified(10);
+        text += line + '\n';
+    }
+    return text;
+}
+
+Marker::Marker(Position position, QObject *parent) : QtAV::VideoFilter(parent), position(position)
+{
+}
+
+void Marker::process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame)
+{
+    Q_UNUSED(statistics)
+    if (position == Head)
+        frameEntered();
+    // Frames dropped by the pacer never reach the renderer.
+    else if (frame && frame->isValid())
+        frameLeft();
+}
+
+}
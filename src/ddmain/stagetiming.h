@@ -0,0 +1,99 @@
+#pragma once
+
+// Per-frame timing of the stages of the playback path. Every stage records
+// into its own histogram in the metrics registry, so the timings show up
+// in the statistics, the Prometheus text and "DDCtl stages". Building with
+// CONFIG+=no_stage_timing defines DD_NO_STAGE_TIMING, which turns the
+// macros below into nothing and leaves stagetiming.cpp out of the build.
+
+#ifndef DD_NO_STAGE_TIMING
+
+#include <QtAV/Filter.h>
+#include <QByteArray>
+#include <QVariantHash>
+
+class Histogram;
+
+namespace StageTiming
+{
+
+enum Stage
+{
+    // Reads of MappedFileIO and StreamCacheIO on the demux thread.
+    Demux,
+    // The video thread from letting go of a frame until it picks up the
+    // next one: waiting for a packet, decoding it and waiting for the
+    // clock. QtAV has no hook around the decoder alone.
+    Interframe,
+    Scale,
+    // Copy into a pixel buffer of PboUploader on the video thread.
+    Copy,
+    // FramePacer holding a frame back until its refresh slot.
+    Pace,
+    // From the end of the filters until the renderer starts drawing.
+    Queue,
+    // Texture upload started by PboUploader on the GUI thread.
+    Upload,
+    // CPU time of OpenGLVideo::render() on the GUI thread.
+    Render,
+    StageCount
+};
+
+// Microseconds of a monotonic clock.
+qint64 now();
+const char *name(Stage stage);
+void record(Stage stage, qint64 microseconds);
+const Histogram *histogram(Stage stage);
+void frameEntered();
+void frameLeft();
+void renderStarted();
+void renderFinished();
+QVariantHash statistics();
+QByteArray dump();
+
+class Scope
+{
+public:
+    explicit Scope(Stage stage) : stage(stage), start(now()) {}
+    ~Scope() { record(stage, now() - start); }
+
+private:
+    const Stage stage;
+    const qint64 start;
+
+private:
+    Q_DISABLE_COPY(Scope)
+};
+
+// Installed first and last in the filter chain of the player, to see
+// where the video thread picks up a frame and lets go of it.
+class Marker : public QtAV::VideoFilter
+{
+    Q_OBJECT
+
+public:
+    enum Position
+    {
+        Head,
+        Tail
+    };
+    explicit Marker(Position position, QObject *parent = nullptr);
+
+protected:
+    void process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame) override;
+
+private:
+    const Position position;
+
+private:
+    Q_DISABLE_COPY(Marker)
+};
+
+}
+
+#define DD_STAGE_SCOPE(stage) const StageTiming::Scope ddStageScope(StageTiming::stage)
+#define DD_STAGE_RECORD(stage, microseconds) StageTiming::record(StageTiming::stage, microseconds)
+#else
+#define DD_STAGE_SCOPE(stage)
+#define DD_STAGE_RECORD(stage, microseconds)
+#endif
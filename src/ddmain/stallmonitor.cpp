@@ -0,0 +1,63 @@
+#include "stallmonitor.h"
+#include "metrics.h"
+
+const int kTickInterval = 5;
+// Scrapers read the metrics every few seconds, a minute outlasts the
+// usual intervals.
+const qint64 kLease = 60000;
+
+StallMonitor::StallMonitor(QObject *parent) : QObject(parent)
+{
+    stalls = MetricsRegistry::getInstance()->summary("dd_gui_stall_seconds", "Lateness of a periodic timer on the GUI thread.");
+    timer.setTimerType(Qt::PreciseTimer);
+    timer.setInterval(kTickInterval);
+    connect(&timer, &QTimer::timeout, this, &StallMonitor::tick);
+    clock.start();
+}
+
+void StallMonitor::setWatched(bool watched)
+{
+    this->watched = watched;
+    if (watched)
+        start();
+}
+
+void StallMonitor::touch()
+{
+    lease.start();
+    start();
+}
+
+bool StallMonitor::isSampling() const
+{
+    return timer.isActive();
+}
+
+QVariantHash StallMonitor::statistics() const
+{
+    QVariantHash stats;
+    stats[QStringLiteral("gui.stallP50")] = stalls->percentile(0.5);
+    stats[QStringLiteral("gui.stallP99")] = stalls->percentile(0.99);
+    stats[QStringLiteral("gui.stallMax")] = stalls->max();
+    stats[QStringLiteral("gui.stallSampling")] = isSampling();
+    return stats;
+}
+
+void StallMonitor::tick()
+{
+    const qint64 now = clock.nsecsElapsed();
+    // Lateness beyond the timer interval, in microseconds.
+    stalls->record(qMax<qint64>(0, (now - lastTick) / 1000 - kTickInterval * 1000));
+    lastTick = now;
+    if (!watched && (!lease.isValid() || lease.hasExpired(kLease)))
+        timer.stop();
+}
+
+void StallMonitor::start()
+{
+    if (timer.isActive())
+        return;
+    // The time the timer was stopped is no stall.
+    lastTick = clock.nsecsElapsed();
+    timer.start();
+}
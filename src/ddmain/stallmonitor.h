@@ -0,0 +1,45 @@
+#pragma once
+
+#include "histogram.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <QVariantHash>
+
+// Measures how late the GUI event loop serves a short periodic timer. Long
+// texture uploads and other blocking work on the GUI thread show up as stalls.
+// The timer wakes the GUI thread two hundred times a second, so it only
+// runs while somebody looks: while the debug overlay is shown and for a
+// minute after the metrics or statistics were read.
+class StallMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StallMonitor(QObject *parent = nullptr);
+
+public:
+    void setWatched(bool watched = true);
+    // Called by every reader of the metrics or statistics.
+    void touch();
+    bool isSampling() const;
+    QVariantHash statistics() const;
+
+private slots:
+    void tick();
+
+private:
+    void start();
+
+private:
+    QTimer timer;
+    QElapsedTimer clock;
+    QElapsedTimer lease;
+    qint64 lastTick = 0;
+    bool watched = false;
+    Histogram *stalls = nullptr;
+
+private:
+    Q_DISABLE_COPY(StallMonitor)
+};
@@ -0,0 +1,516 @@
+#include "streamcache.h"
+#include "logger.h"
+#include "stagetiming.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QAtomicInteger>
+
+#include <limits>
+
+#include <Windows.h>
+#include <winioctl.h>
+#include <io.h>
+
+// Read-ahead of the fetcher, in blocks.
+const qint64 kPrefetchBlocks = 8;
+// How long a read waits for a missing block before giving up.
+const int kReadTimeout = 30000;
+// The block map is written after this many new blocks and on close.
+const int kMapSaveInterval = 16;
+const quint32 kMapMagic = 0x44445343;
+const quint32 kMapVersion = 1;
+const qint64 kDefaultCacheLimit = Q_INT64_C(2048) * 1024 * 1024;
+
+namespace
+{
+
+QAtomicInteger<quint64> cacheHits = 0;
+QAtomicInteger<quint64> cacheMisses = 0;
+QAtomicInteger<quint64> bytesRead = 0;
+QAtomicInteger<quint64> bytesFetched = 0;
+QAtomicInteger<quint64> httpRequests = 0;
+QAtomicInteger<quint64> fetchFailures = 0;
+QAtomicInteger<quint64> evictions = 0;
+QAtomicInteger<qint64> cacheLimit = kDefaultCacheLimit;
+
+}
+
+StreamFetcher::StreamFetcher(StreamCacheIO *cache) : cache(cache)
+{
+}
+
+void StreamFetcher::fetch(qint64 first, qint64 last, bool demand)
+{
+    if (!network)
+        network = new QNetworkAccessManager(this);
+    if (demand)
+    {
+        // The reader seeked away from the running download, which can be
+        // restarted later. A server without range support can't do that.
+        if (reply && rangeSupported && ((first < replyFirst) || (first > replyLast)))
+        {
+            disconnect(reply, nullptr, this, nullptr);
+            reply->abort();
+            reply->deleteLater();
+            reply = nullptr;
+        }
+        queue.prepend(qMakePair(first, last));
+    }
+    else
+        queue.append(qMakePair(first, last));
+    startNext();
+}
+
+void StreamFetcher::stop()
+{
+    queue.clear();
+    if (reply)
+    {
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+        reply = nullptr;
+    }
+    // What the server supports is found out again for the next URL.
+    rangeSupported = true;
+    headerChecked = false;
+    buffer.clear();
+}
+
+void StreamFetcher::startNext()
+{
+    while (!reply && !queue.isEmpty())
+    {
+        const QPair<qint64, qint64> range = queue.takeFirst();
+        // Only the missing blocks, one contiguous run per request.
+        qint64 first = range.first;
+        while ((first <= range.second) && cache->hasBlock(first))
+            ++first;
+        if (first > range.second)
+            continue;
+        qint64 last = first;
+        while ((last < range.second) && !cache->hasBlock(last + 1))
+            ++last;
+        if (last < range.second)
+            queue.prepend(qMakePair(last + 1, range.second));
+        QNetworkRequest request(QUrl(cache->url()));
+        request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+        if (rangeSupported)
+            request.setRawHeader("Range", "bytes=" + QByteArray::number(first * StreamCacheIO::kBlockSize) + '-'
+                                 + QByteArray::number((last + 1) * StreamCacheIO::kBlockSize - 1));
+        replyFirst = first;
+        replyLast = last;
+        replyOffset = first;
+        headerChecked = false;
+        buffer.clear();
+        reply = network->get(request);
+        httpRequests.fetchAndAddRelaxed(1);
+        connect(reply, &QNetworkReply::readyRead, this, &StreamFetcher::onReadyRead);
+        connect(reply, &QNetworkReply::finished, this, &StreamFetcher::onFinished);
+    }
+}
+
+void StreamFetcher::onReadyRead()
+{
+    if (!headerChecked)
+    {
+        headerChecked = true;
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        QByteArray validator = reply->rawHeader("ETag");
+        if (validator.isEmpty())
+            validator = reply->rawHeader("Last-Modified");
+        if (status == 206)
+        {
+            // "bytes first-last/total", the total may be "*".
+            const QByteArray contentRange = reply->rawHeader("Content-Range");
+            bool ok = false;
+            const qint64 total = contentRange.mid(contentRange.lastIndexOf('/') + 1).toLongLong(&ok);
+            cache->setStreamSize(ok ? total : -1, validator);
+        }
+        else if (status == 200)
+        {
+            // The whole stream from the start, it is cached as it arrives.
+            rangeSupported = false;
+            replyFirst = replyOffset = 0;
+            replyLast = std::numeric_limits<qint64>::max();
+            bool ok = false;
+            const qint64 total = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong(&ok);
+            cache->setStreamSize(ok ? total : -1, validator);
+        }
+    }
+    buffer.append(reply->readAll());
+    storeCompleteBlocks(false);
+}
+
+void StreamFetcher::onFinished()
+{
+    QNetworkReply *finishedReply = reply;
+    reply = nullptr;
+    finishedReply->deleteLater();
+    if (finishedReply->error() == QNetworkReply::NoError)
+    {
+        if (!headerChecked)
+        {
+            reply = finishedReply;
+            onReadyRead();
+            reply = nullptr;
+        }
+        buffer.append(finishedReply->readAll());
+        storeCompleteBlocks(true);
+    }
+    else
+    {
+        fetchFailures.fetchAndAddRelaxed(1);
+        DD_LOG_WARNING(Input, "Stream cache fetch failed: %1", finishedReply->errorString());
+        cache->setFailed();
+    }
+    startNext();
+}
+
+bool StreamFetcher::storeCompleteBlocks(bool finished)
+{
+    bool stored = false;
+    while (buffer.size() >= StreamCacheIO::kBlockSize)
+    {
+        cache->storeBlock(replyOffset++, buffer.left(StreamCacheIO::kBlockSize));
+        buffer.remove(0, StreamCacheIO::kBlockSize);
+        stored = true;
+    }
+    // A short block at the end of a complete reply is the stream's last one.
+    if (finished && !buffer.isEmpty())
+    {
+        if (!rangeSupported)
+            cache->setStreamSize(replyOffset * StreamCacheIO::kBlockSize + buffer.size(), QByteArray());
+        cache->storeBlock(replyOffset++, buffer);
+        buffer.clear();
+        stored = true;
+    }
+    return stored;
+}
+
+const qint64 StreamCacheIO::kBlockSize;
+
+StreamCacheIO::StreamCacheIO(QObject *parent) : QtAV::MediaIO(parent)
+{
+    fetcher = new StreamFetcher(this);
+    fetcher->moveToThread(&fetcherThread);
+    connect(&fetcherThread, &QThread::finished, fetcher, &QObject::deleteLater);
+    fetcherThread.start();
+}
+
+StreamCacheIO::~StreamCacheIO()
+{
+    close();
+    fetcherThread.quit();
+    fetcherThread.wait();
+}
+
+QString StreamCacheIO::name() const
+{
+    return QStringLiteral("DDStreamCache");
+}
+
+bool StreamCacheIO::isSeekable() const
+{
+    return true;
+}
+
+qint64 StreamCacheIO::read(char *data, qint64 maxSize)
+{
+    DD_STAGE_SCOPE(Demux);
+    QMutexLocker locker(&mutex);
+    if (maxSize <= 0)
+        return 0;
+    if ((streamSize >= 0) && (readPosition >= streamSize))
+        return 0;
+    const qint64 block = readPosition / kBlockSize;
+    if (isBlockCached(block))
+        cacheHits.fetchAndAddRelaxed(1);
+    else
+    {
+        cacheMisses.fetchAndAddRelaxed(1);
+        failed = false;
+        QMetaObject::invokeMethod(fetcher, "fetch", Qt::QueuedConnection, Q_ARG(qint64, block),
+                                  Q_ARG(qint64, block + kPrefetchBlocks), Q_ARG(bool, true));
+        QElapsedTimer waitTimer;
+        waitTimer.start();
+        while (!isBlockCached(block))
+        {
+            if (failed || closing || (waitTimer.elapsed() > kReadTimeout))
+                return -1;
+            blockStored.wait(&mutex, 500);
+        }
+        // The stream size may only be known now.
+        if ((streamSize >= 0) && (readPosition >= streamSize))
+            return 0;
+    }
+    prefetchFrom(block);
+    qint64 blockEnd = (block + 1) * kBlockSize;
+    if (streamSize >= 0)
+        blockEnd = qMin(blockEnd, streamSize);
+    if (!dataFile.seek(readPosition))
+        return -1;
+    const qint64 length = dataFile.read(data, qMin(maxSize, blockEnd - readPosition));
+    if (length > 0)
+    {
+        readPosition += length;
+        bytesRead.fetchAndAddRelaxed(length);
+    }
+    return length;
+}
+
+bool StreamCacheIO::seek(qint64 offset, int from)
+{
+    QMutexLocker locker(&mutex);
+    qint64 position = offset;
+    if (from == SEEK_CUR)
+        position += readPosition;
+    else if (from == SEEK_END)
+    {
+        if (streamSize < 0)
+            return false;
+        position += streamSize;
+    }
+    if ((position < 0) || ((streamSize >= 0) && (position > streamSize)))
+        return false;
+    readPosition = position;
+    return true;
+}
+
+qint64 StreamCacheIO::position() const
+{
+    QMutexLocker locker(&mutex);
+    return readPosition;
+}
+
+qint64 StreamCacheIO::size() const
+{
+    QMutexLocker locker(&mutex);
+    return qMax<qint64>(streamSize, 0);
+}
+
+bool StreamCacheIO::isComplete() const
+{
+    QMutexLocker locker(&mutex);
+    if (streamSize < 0)
+        return false;
+    const qint64 blockCount = (streamSize + kBlockSize - 1) / kBlockSize;
+    return (blocks.size() >= blockCount) && (blocks.count(true) >= blockCount);
+}
+
+QString StreamCacheIO::cacheDirectory()
+{
+    return QDir::toNativeSeparators(QDir::cleanPath(QCoreApplication::applicationDirPath() + QStringLiteral("/streams")));
+}
+
+void StreamCacheIO::setCacheLimit(qint64 bytes)
+{
+    cacheLimit.store(qMax<qint64>(bytes, 0));
+}
+
+QVariantHash StreamCacheIO::statistics()
+{
+    QVariantHash stats;
+    const quint64 hits = cacheHits.load();
+    const quint64 misses = cacheMisses.load();
+    stats[QStringLiteral("cache.hits")] = hits;
+    stats[QStringLiteral("cache.misses")] = misses;
+    stats[QStringLiteral("cache.hitRate")] = (hits + misses) > 0 ? static_cast<qreal>(hits) / (hits + misses) : 0.0;
+    stats[QStringLiteral("cache.bytesRead")] = bytesRead.load();
+    stats[QStringLiteral("cache.bytesFetched")] = bytesFetched.load();
+    stats[QStringLiteral("cache.requests")] = httpRequests.load();
+    stats[QStringLiteral("cache.failures")] = fetchFailures.load();
+    stats[QStringLiteral("cache.evictions")] = evictions.load();
+    return stats;
+}
+
+void StreamCacheIO::onUrlChanged()
+{
+    close();
+    if (!url().isEmpty())
+        open();
+}
+
+bool StreamCacheIO::hasBlock(qint64 block) const
+{
+    QMutexLocker locker(&mutex);
+    return isBlockCached(block);
+}
+
+void StreamCacheIO::setStreamSize(qint64 bytes, const QByteArray &validator)
+{
+    QMutexLocker locker(&mutex);
+    // The resource changed since it was cached.
+    const bool changed = (!validator.isEmpty() && !this->validator.isEmpty() && (validator != this->validator))
+            || ((bytes >= 0) && (streamSize >= 0) && (bytes != streamSize));
+    if (changed)
+    {
+        DD_LOG_INFO(Input, "Stream cache of %1 is stale, discarding it", url());
+        blocks.fill(false);
+    }
+    if (!validator.isEmpty())
+        this->validator = validator;
+    if (bytes >= 0)
+    {
+        streamSize = bytes;
+        blocks.resize((streamSize + kBlockSize - 1) / kBlockSize);
+        // Sparse, so this doesn't write anything.
+        dataFile.resize(streamSize);
+    }
+    blockStored.wakeAll();
+}
+
+void StreamCacheIO::storeBlock(qint64 block, const QByteArray &data)
+{
+    QMutexLocker locker(&mutex);
+    if (closing || !dataFile.isOpen())
+        return;
+    if (!dataFile.seek(block * kBlockSize) || (dataFile.write(data) != data.size()))
+        return;
+    if (block >= blocks.size())
+        blocks.resize(block + 1);
+    blocks.setBit(block);
+    bytesFetched.fetchAndAddRelaxed(data.size());
+    if (++unsavedBlocks >= kMapSaveInterval)
+        saveMap();
+    blockStored.wakeAll();
+}
+
+void StreamCacheIO::setFailed()
+{
+    QMutexLocker locker(&mutex);
+    failed = true;
+    blockStored.wakeAll();
+}
+
+void StreamCacheIO::open()
+{
+    const QString dir = cacheDirectory();
+    if (!QDir(dir).exists())
+        QDir().mkpath(dir);
+    const QString key = QString::fromLatin1(QCryptographicHash::hash(url().toUtf8(), QCryptographicHash::Sha1).toHex());
+    const QString dataFileName = dir + QDir::separator() + key + QStringLiteral(".data");
+    mapFileName = dir + QDir::separator() + key + QStringLiteral(".map");
+    evict(key);
+    QMutexLocker locker(&mutex);
+    closing = failed = false;
+    readPosition = 0;
+    prefetchedBlock = -1;
+    QFile mapFile(mapFileName);
+    if (QFileInfo::exists(dataFileName) && mapFile.open(QFile::ReadOnly))
+    {
+        QDataStream stream(&mapFile);
+        quint32 magic = 0, version = 0;
+        qint64 blockSize = 0;
+        stream >> magic >> version;
+        if ((magic == kMapMagic) && (version == kMapVersion))
+            stream >> blockSize >> streamSize >> validator >> blocks;
+        if ((stream.status() != QDataStream::Ok) || (blockSize != kBlockSize))
+        {
+            streamSize = -1;
+            validator.clear();
+            blocks.clear();
+        }
+    }
+    const bool created = !QFileInfo::exists(dataFileName);
+    dataFile.setFileName(dataFileName);
+    if (!dataFile.open(QFile::ReadWrite))
+    {
+        failed = true;
+        return;
+    }
+    if (created)
+    {
+        // Blocks arrive out of order, don't let NTFS zero-fill the gaps.
+        const auto handle = reinterpret_cast<HANDLE>(_get_osfhandle(dataFile.handle()));
+        DWORD returned = 0;
+        DeviceIoControl(handle, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr);
+    }
+    locker.unlock();
+    // Get the stream size and the first blocks in flight before the
+    // demuxer asks for them. A complete cache needs no network at all.
+    if (!isComplete())
+        QMetaObject::invokeMethod(fetcher, "fetch", Qt::QueuedConnection, Q_ARG(qint64, 0),
+                                  Q_ARG(qint64, kPrefetchBlocks - 1), Q_ARG(bool, false));
+}
+
+void StreamCacheIO::close()
+{
+    {
+        QMutexLocker locker(&mutex);
+        closing = true;
+        blockStored.wakeAll();
+    }
+    QMetaObject::invokeMethod(fetcher, "stop", Qt::BlockingQueuedConnection);
+    QMutexLocker locker(&mutex);
+    if (dataFile.isOpen())
+    {
+        saveMap();
+        dataFile.close();
+    }
+    streamSize = -1;
+    validator.clear();
+    blocks.clear();
+}
+
+void StreamCacheIO::evict(const QString &keep)
+{
+    QDir dir(cacheDirectory());
+    // Oldest first.
+    const QFileInfoList maps = dir.entryInfoList({QStringLiteral("*.map")}, QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 total = 0;
+    for (const QFileInfo &info : dir.entryInfoList({QStringLiteral("*.data"), QStringLiteral("*.map")}, QDir::Files))
+        total += info.size();
+    const qint64 limit = cacheLimit.load();
+    for (const QFileInfo &map : maps)
+    {
+        if (total <= limit)
+            break;
+        if (map.completeBaseName() == keep)
+            continue;
+        const QString dataFileName = dir.filePath(map.completeBaseName() + QStringLiteral(".data"));
+        const qint64 dataSize = QFileInfo(dataFileName).size();
+        // Still open by a stream that is about to be closed.
+        if (QFileInfo::exists(dataFileName) && !QFile::remove(dataFileName))
+            continue;
+        total -= dataSize + map.size();
+        QFile::remove(map.filePath());
+        evictions.fetchAndAddRelaxed(1);
+        DD_LOG_INFO(Input, "Stream cache evicted %1", map.completeBaseName());
+    }
+}
+
+void StreamCacheIO::saveMap()
+{
+    unsavedBlocks = 0;
+    QFile mapFile(mapFileName);
+    if (!mapFile.open(QFile::WriteOnly | QFile::Truncate))
+        return;
+    QDataStream stream(&mapFile);
+    stream << kMapMagic << kMapVersion << kBlockSize << streamSize << validator << blocks;
+}
+
+bool StreamCacheIO::isBlockCached(qint64 block) const
+{
+    // Blocks past the end count as present, there is nothing to fetch.
+    if ((streamSize >= 0) && (block * kBlockSize >= streamSize))
+        return true;
+    return (block < blocks.size()) && blocks.testBit(block);
+}
+
+void StreamCacheIO::prefetchFrom(qint64 block)
+{
+    if (block == prefetchedBlock)
+        return;
+    prefetchedBlock = block;
+    // Cheap for the fetcher to skip blocks it already has.
+    QMetaObject::invokeMethod(fetcher, "fetch", Qt::QueuedConnection, Q_ARG(qint64, block + 1),
+                              Q_ARG(qint64, block + kPrefetchBlocks), Q_ARG(bool, false));
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QtAV/MediaIO.h>
+#include <QBitArray>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QThread>
+#include <QVariantHash>
+#include <QWaitCondition>
+
+QT_FORWARD_DECLARE_CLASS(QNetworkAccessManager)
+QT_FORWARD_DECLARE_CLASS(QNetworkReply)
+
+class StreamCacheIO;
+
+// Downloads blocks of a stream with HTTP range requests. Lives in its own
+// thread, the demuxer thread only queues requests and waits for blocks.
+class StreamFetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StreamFetcher(StreamCacheIO *cache);
+
+public slots:
+    // Blocks "first" to "last" inclusive, a "demand" is served before any
+    // prefetching.
+    void fetch(qint64 first, qint64 last, bool demand);
+    void stop();
+
+private:
+    void startNext();
+    void onReadyRead();
+    void onFinished();
+    bool storeCompleteBlocks(bool finished);
+
+private:
+    StreamCacheIO *cache = nullptr;
+    QNetworkAccessManager *network = nullptr;
+    QNetworkReply *reply = nullptr;
+    QList<QPair<qint64, qint64>> queue;
+    qint64 replyFirst = 0, replyLast = 0, replyOffset = 0;
+    QByteArray buffer;
+    bool rangeSupported = true, headerChecked = false;
+
+private:
+    Q_DISABLE_COPY(StreamFetcher)
+};
+
+// Demuxer input for web URLs backed by a sparse on-disk cache file per
+// URL and a map of the blocks it holds. The map is written when a stream
+// is closed, its time tells which stream was used least recently. Blocks
+// are fetched ahead of the read position, so looping playback reads the
+// cache only and a fully cached stream plays without any network access.
+class StreamCacheIO : public QtAV::MediaIO
+{
+    Q_OBJECT
+
+public:
+    static const qint64 kBlockSize = 1024 * 1024;
+
+    explicit StreamCacheIO(QObject *parent = nullptr);
+    ~StreamCacheIO() override;
+
+public:
+    QString name() const override;
+    bool isSeekable() const override;
+    qint64 read(char *data, qint64 maxSize) override;
+    bool seek(qint64 offset, int from = SEEK_SET) override;
+    qint64 position() const override;
+    qint64 size() const override;
+    bool isComplete() const;
+    static QString cacheDirectory();
+    // Opening a stream evicts the least recently used other streams
+    // until the directory fits into the limit.
+    static void setCacheLimit(qint64 bytes);
+    // Counters of all instances.
+    static QVariantHash statistics();
+
+protected:
+    void onUrlChanged() override;
+
+private:
+    friend class StreamFetcher;
+
+    // Called by the fetcher thread.
+    bool hasBlock(qint64 block) const;
+    void setStreamSize(qint64 bytes, const QByteArray &validator);
+    void storeBlock(qint64 block, const QByteArray &data);
+    void setFailed();
+
+    void open();
+    void close();
+    static void evict(const QString &keep);
+    void saveMap();
+    bool isBlockCached(qint64 block) const;
+    void prefetchFrom(qint64 block);
+
+private:
+    mutable QMutex mutex;
+    QWaitCondition blockStored;
+    QFile dataFile;
+    QString mapFileName;
+    QBitArray blocks;
+    QByteArray validator;
+    qint64 streamSize = -1, readPosition = 0, prefetchedBlock = -1;
+    int unsavedBlocks = 0;
+    bool failed = false, closing = false;
+    QThread fetcherThread;
+    StreamFetcher *fetcher = nullptr;
+
+private:
+    Q_DISABLE_COPY(StreamCacheIO)
+};
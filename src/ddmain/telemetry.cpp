@@ -0,0 +1,174 @@
+#include "telemetry.h"
+#include "metrics.h"
+
+#include <QEvent>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QWindow>
+
+const int kDefaultRefreshInterval = 16;
+const qint64 kMinute = 60000;
+// Before, every position update emitted the position and its text.
+const int kLegacySignalsPerUpdate = 2;
+
+MediaTracks toMediaTracks(const QVariantList &tracks)
+{
+    MediaTracks result;
+    result.reserve(tracks.count());
+    for (const auto &track : tracks)
+    {
+        const QVariantMap trackData = track.toMap();
+        MediaTrack mediaTrack;
+        mediaTrack.id = trackData.value(QStringLiteral("id"));
+        mediaTrack.title = trackData.value(QStringLiteral("title")).toString();
+        mediaTrack.language = trackData.value(QStringLiteral("language")).toString();
+        mediaTrack.file = trackData.value(QStringLiteral("file")).toString();
+        result.append(mediaTrack);
+    }
+    return result;
+}
+
+TelemetryPublisher::TelemetryPublisher(QObject *parent) : QObject(parent)
+{
+    MetricsRegistry *registry = MetricsRegistry::getInstance();
+    updateCounter = registry->counter("dd_ui_position_updates_total", "Position updates of the player handed to the telemetry publisher.");
+    signalCounter = registry->counter("dd_ui_telemetry_signals_total", "Telemetry signals emitted to the views.");
+    timer.setSingleShot(true);
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &TelemetryPublisher::publish);
+    minuteClock.start();
+}
+
+void TelemetryPublisher::addView(QWidget *view)
+{
+    if (!view || views.contains(view))
+        return;
+    views.append(view);
+    view->installEventFilter(this);
+    if (view->isVisible())
+        schedule();
+}
+
+void TelemetryPublisher::setPosition(qint64 position, quint64 updates)
+{
+    rollMinute();
+    minuteUpdates += updates;
+    updateCounter->add(updates);
+    if (current.position == position)
+        return;
+    current.position = position;
+    schedule();
+}
+
+void TelemetryPublisher::setDuration(qint64 duration)
+{
+    if (current.duration == duration)
+        return;
+    current.duration = duration;
+    schedule();
+}
+
+void TelemetryPublisher::setPlaying(bool playing)
+{
+    if (current.playing == playing)
+        return;
+    current.playing = playing;
+    schedule();
+}
+
+const PlaybackTelemetry &TelemetryPublisher::telemetry() const
+{
+    return current;
+}
+
+QVariantHash TelemetryPublisher::statistics() const
+{
+    rollMinute();
+    QVariantHash stats;
+    // The running minute is extrapolated until the first one is complete.
+    const qint64 elapsed = qMax<qint64>(1, minuteClock.elapsed());
+    const qint64 updates = lastMinuteUpdates >= 0 ? lastMinuteUpdates : static_cast<qint64>(minuteUpdates) * kMinute / elapsed;
+    const qint64 signalCount = lastMinuteSignals >= 0 ? lastMinuteSignals : static_cast<qint64>(minuteSignals) * kMinute / elapsed;
+    stats[QStringLiteral("telemetry.updatesPerMinute")] = updates;
+    stats[QStringLiteral("telemetry.legacySignalsPerMinute")] = updates * kLegacySignalsPerUpdate;
+    stats[QStringLiteral("telemetry.signalsPerMinute")] = signalCount;
+    stats[QStringLiteral("telemetry.observed")] = isObserved();
+    return stats;
+}
+
+bool TelemetryPublisher::eventFilter(QObject *watched, QEvent *event)
+{
+    switch (event->type())
+    {
+    case QEvent::Show:
+    case QEvent::WindowStateChange:
+        // Bring the view up to date before it's painted.
+        if (dirty && isObserved())
+            publish();
+        break;
+    case QEvent::Hide:
+        if (!isObserved())
+            timer.stop();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void TelemetryPublisher::publish()
+{
+    timer.stop();
+    if (!dirty || !isObserved())
+        return;
+    dirty = false;
+    rollMinute();
+    ++minuteSignals;
+    signalCounter->add();
+    emit telemetryChanged(current);
+}
+
+void TelemetryPublisher::schedule()
+{
+    dirty = true;
+    // Hidden views catch up once they're shown again.
+    if (!timer.isActive() && isObserved())
+        timer.start(refreshInterval());
+}
+
+bool TelemetryPublisher::isObserved() const
+{
+    for (const auto &view : views)
+        if (view && view->isVisible() && !view->isMinimized())
+            return true;
+    return false;
+}
+
+int TelemetryPublisher::refreshInterval() const
+{
+    const QScreen *screen = QGuiApplication::primaryScreen();
+    for (const auto &view : views)
+        if (view && view->isVisible() && view->windowHandle() && view->windowHandle()->screen())
+        {
+            screen = view->windowHandle()->screen();
+            break;
+        }
+    if (screen && (screen->refreshRate() > 1.0))
+        return qMax(1, qRound(1000.0 / screen->refreshRate()));
+    return kDefaultRefreshInterval;
+}
+
+void TelemetryPublisher::rollMinute() const
+{
+    const qint64 elapsed = minuteClock.elapsed();
+    if (elapsed < kMinute)
+        return;
+    // Nothing rolled the counts for more than a minute after they were
+    // complete, so the last complete minute was an idle one.
+    const bool idle = elapsed >= 2 * kMinute;
+    lastMinuteUpdates = idle ? 0 : static_cast<qint64>(minuteUpdates);
+    lastMinuteSignals = idle ? 0 : static_cast<qint64>(minuteSignals);
+    minuteUpdates = 0;
+    minuteSignals = 0;
+    minuteClock.restart();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVariant>
+#include <QVariantHash>
+#include <QVector>
+#include <QWidget>
+
+class MetricCounter;
+
+// What views show about the running media. Views format it themselves,
+// and only the parts that actually changed.
+struct PlaybackTelemetry
+{
+    qint64 position = 0;
+    qint64 duration = 0;
+    bool playing = false;
+};
+
+struct MediaTrack
+{
+    // A stream index, or the file name for external subtitles.
+    QVariant id;
+    QString title;
+    QString language;
+    QString file;
+};
+
+using MediaTracks = QVector<MediaTrack>;
+
+// Converts the track lists of QtAV::AVPlayer.
+MediaTracks toMediaTracks(const QVariantList &tracks);
+
+// Publishes the playback telemetry to the views that show it. Changes are
+// folded together and sent at most once per refresh of the display, and
+// not at all while none of the views is visible: a view that shows up
+// gets the latest state right away. Counts the position updates it gets
+// and the signals it emits, so that statistics() can compare them with
+// the two signals per update that were emitted before.
+class TelemetryPublisher : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void telemetryChanged(const PlaybackTelemetry &);
+
+public:
+    explicit TelemetryPublisher(QObject *parent = nullptr);
+
+public:
+    // The view is watched until it's destroyed.
+    void addView(QWidget *view);
+    // The updates are the position notifications of the player that were
+    // folded into this call.
+    void setPosition(qint64 position, quint64 updates = 1);
+    void setDuration(qint64 duration);
+    void setPlaying(bool playing);
+    const PlaybackTelemetry &telemetry() const;
+    QVariantHash statistics() const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void publish();
+
+private:
+    void schedule();
+    bool isObserved() const;
+    int refreshInterval() const;
+    void rollMinute() const;
+
+private:
+    QTimer timer;
+    QVector<QPointer<QWidget>> views;
+    PlaybackTelemetry current;
+    bool dirty = false;
+    MetricCounter *updateCounter = nullptr;
+    MetricCounter *signalCounter = nullptr;
+    // Counts of the running and of the last complete minute.
+    mutable QElapsedTimer minuteClock;
+    mutable quint64 minuteUpdates = 0, minuteSignals = 0;
+    mutable qint64 lastMinuteUpdates = -1, lastMinuteSignals = -1;
+
+private:
+    Q_DISABLE_COPY(TelemetryPublisher)
+};
@@ -0,0 +1,189 @@
+#include "thumbnailmanager.h"
+#include "utils.h"
+
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDesktopWidget>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QtAV>
+
+const QSize kThumbnailSize(160, 90);
+const int kThumbnailCacheCost = 16 * 1024;
+const int kJpegQuality = 85;
+const qint64 kPosterPosition = 2000;
+// A precision this coarse makes the extractor stop at the first
+// decodable frame after seeking, which is always a key frame.
+const int kKeyFramePrecision = 60000;
+
+class ThumbnailJob : public QRunnable
+{
+public:
+    explicit ThumbnailJob(QObject *receiver, const QString &url, const QString &thumbnailPath, const QString &posterPath, const QSize &posterSize)
+        : receiver(receiver), url(url), thumbnailPath(thumbnailPath), posterPath(posterPath), posterSize(posterSize)
+    {
+    }
+
+    void run() override
+    {
+        QImage thumbnail;
+        if (QFileInfo::exists(thumbnailPath) && QFileInfo::exists(posterPath))
+            thumbnail.load(thumbnailPath, "JPG");
+        if (thumbnail.isNull())
+        {
+            QImage poster;
+            if (Utils::isPicture(url))
+                poster = readPicture();
+            else
+            {
+                poster = extractFrame(kPosterPosition);
+                if (poster.isNull())
+                    poster = extractFrame(0);
+            }
+            if (!poster.isNull())
+            {
+                poster.save(posterPath, "JPG", kJpegQuality);
+                thumbnail = poster.scaled(kThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+                thumbnail.save(thumbnailPath, "JPG", kJpegQuality);
+            }
+        }
+        QMetaObject::invokeMethod(receiver, "onJobFinished", Qt::QueuedConnection, Q_ARG(QString, url), Q_ARG(QImage, thumbnail));
+    }
+
+private:
+    QSize fitSize(const QSize &sourceSize) const
+    {
+        if ((sourceSize.width() <= posterSize.width()) && (sourceSize.height() <= posterSize.height()))
+            return sourceSize;
+        return sourceSize.scaled(posterSize, Qt::KeepAspectRatio);
+    }
+
+    QImage readPicture() const
+    {
+        QImageReader reader(url);
+        if (reader.size().isValid())
+            reader.setScaledSize(fitSize(reader.size()));
+        return reader.read();
+    }
+
+    QImage extractFrame(qint64 position) const
+    {
+        QImage image;
+        QtAV::VideoFrameExtractor extractor;
+        extractor.setAsync(false);
+        extractor.setAutoExtract(false);
+        extractor.setPrecision(kKeyFramePrecision);
+        extractor.setSource(url);
+        extractor.setPosition(position);
+        QObject::connect(&extractor, &QtAV::VideoFrameExtractor::frameExtracted, [=, &image](const QtAV::VideoFrame &frame)
+        {
+            // Let swscale do the color conversion and the downscaling in a single pass.
+            image = frame.toImage(QImage::Format_RGB32, fitSize(frame.size()));
+        });
+        extractor.extract();
+        return image;
+    }
+
+private:
+    QObject *receiver = nullptr;
+    QString url;
+    QString thumbnailPath;
+    QString posterPath;
+    QSize posterSize;
+};
+
+ThumbnailManager *ThumbnailManager::getInstance()
+{
+    static ThumbnailManager thumbnailManager;
+    return &thumbnailManager;
+}
+
+QSize ThumbnailManager::thumbnailSize() const
+{
+    return kThumbnailSize;
+}
+
+QImage ThumbnailManager::thumbnail(const QString &url)
+{
+    QImage *image = memoryCache.object(url);
+    if (image)
+        return *image;
+    return QImage();
+}
+
+QImage ThumbnailManager::posterFrame(const QString &url) const
+{
+    const QString key = cacheKey(url);
+    if (key.isEmpty())
+        return QImage();
+    const QString posterPath = cacheDir() + QLatin1Char('/') + key + QStringLiteral("_poster.jpg");
+    if (!QFileInfo::exists(posterPath))
+        return QImage();
+    return QImage(posterPath, "JPG");
+}
+
+void ThumbnailManager::requestThumbnail(const QString &url)
+{
+    if (url.isEmpty() || pendingUrls.contains(url) || memoryCache.contains(url))
+        return;
+    const QString key = cacheKey(url);
+    if (key.isEmpty())
+        return;
+    const QString dir = cacheDir();
+    if (!QFileInfo::exists(dir))
+        QDir().mkpath(dir);
+    const QString thumbnailPath = dir + QLatin1Char('/') + key + QStringLiteral("_thumb.jpg");
+    const QString posterPath = dir + QLatin1Char('/') + key + QStringLiteral("_poster.jpg");
+    const QSize posterSize = QApplication::desktop()->screenGeometry().size() * qApp->devicePixelRatio();
+    pendingUrls.insert(url);
+    pool->start(new ThumbnailJob(this, url, thumbnailPath, posterPath, posterSize));
+}
+
+void ThumbnailManager::onJobFinished(const QString &url, const QImage &image)
+{
+    pendingUrls.remove(url);
+    if (image.isNull())
+        return;
+    memoryCache.insert(url, new QImage(image), qMax(1, image.byteCount() / 1024));
+    emit thumbnailReady(url, image);
+}
+
+QString ThumbnailManager::cacheDir() const
+{
+    return QDir::toNativeSeparators(QDir::cleanPath(QCoreApplication::applicationDirPath() + QStringLiteral("/thumbnails")));
+}
+
+QString ThumbnailManager::cacheKey(const QString &url) const
+{
+    const QFileInfo fileInfo(url);
+    if (!fileInfo.exists() || !fileInfo.isFile())
+        return QString();
+    const QString identity = QStringLiteral("%0|%1|%2")
+            .arg(fileInfo.absoluteFilePath().toLower())
+            .arg(fileInfo.size())
+            .arg(fileInfo.lastModified().toMSecsSinceEpoch());
+    return QString::fromLatin1(QCryptographicHash::hash(identity.toUtf8(), QCryptographicHash::Md5).toHex());
+}
+
+ThumbnailManager::ThumbnailManager(QObject *parent) : QObject(parent)
+{
+    memoryCache.setMaxCost(kThumbnailCacheCost);
+    pool = new QThreadPool(this);
+    pool->setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+    connect(qApp, &QCoreApplication::aboutToQuit, this, [=]
+    {
+        pool->clear();
+        pool->waitForDone();
+    });
+}
+
+ThumbnailManager::~ThumbnailManager()
+{
+    pool->clear();
+    pool->waitForDone();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QObject>
+#include <QCache>
+#include <QImage>
+#include <QSet>
+
+QT_FORWARD_DECLARE_CLASS(QThreadPool)
+
+class ThumbnailManager : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void thumbnailReady(const QString &, const QImage &);
+
+public:
+    static ThumbnailManager *getInstance();
+
+public:
+    QSize thumbnailSize() const;
+    QImage thumbnail(const QString &url);
+    // Reads the cache on disk only, safe to call from any thread.
+    QImage posterFrame(const QString &url) const;
+    void requestThumbnail(const QString &url);
+
+private slots:
+    void onJobFinished(const QString &url, const QImage &image);
+
+private:
+    explicit ThumbnailManager(QObject *parent = nullptr);
+    ~ThumbnailManager() override;
+
+private:
+    QString cacheDir() const;
+    QString cacheKey(const QString &url) const;
+
+private:
+    QThreadPool *pool = nullptr;
+    QCache<QString, QImage> memoryCache;
+    QSet<QString> pendingUrls;
+
+private:
+    Q_DISABLE_COPY(ThumbnailManager)
+};
@@ -0,0 +1,79 @@
+#include "tonemapping.h"
+
+#include <QtAV/VideoFrame.h>
+#include <QFileInfo>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavutil/mastering_display_metadata.h>
+}
+
+// Enough to parse the parameter sets of the first video packets.
+const int64_t kProbeSize = 1024 * 1024;
+
+namespace ToneMapping
+{
+
+StreamColor probe(const QString &url)
+{
+    StreamColor color;
+    const QByteArray path = QFileInfo::exists(url) ? QFileInfo(url).absoluteFilePath().toUtf8() : url.toUtf8();
+    AVFormatContext *context = nullptr;
+    AVDictionary *options = nullptr;
+    av_dict_set_int(&options, "probesize", kProbeSize, 0);
+    if (avformat_open_input(&context, path.constData(), nullptr, &options) < 0)
+    {
+        av_dict_free(&options);
+        return color;
+    }
+    av_dict_free(&options);
+    if (avformat_find_stream_info(context, nullptr) >= 0)
+    {
+        const int index = av_find_best_stream(context, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (index >= 0)
+        {
+            const AVStream *stream = context->streams[index];
+            const AVCodecParameters *parameters = stream->codecpar;
+            if (parameters->color_trc == AVCOL_TRC_SMPTE2084)
+                color.transfer = PQ;
+            else if (parameters->color_trc == AVCOL_TRC_ARIB_STD_B67)
+                color.transfer = HLG;
+            color.bt2020 = (parameters->color_primaries == AVCOL_PRI_BT2020) || (parameters->color_space == AVCOL_SPC_BT2020_NCL);
+            // HLG is scene referred and always graded for a 1000 nit display.
+            if (color.transfer == PQ)
+            {
+                int size = 0;
+                const auto lightLevel = reinterpret_cast<const AVContentLightMetadata *>(
+                            av_stream_get_side_data(stream, AV_PKT_DATA_CONTENT_LIGHT_LEVEL, &size));
+                const auto masteringDisplay = reinterpret_cast<const AVMasteringDisplayMetadata *>(
+                            av_stream_get_side_data(stream, AV_PKT_DATA_MASTERING_DISPLAY_METADATA, &size));
+                if (lightLevel && (lightLevel->MaxCLL > 0))
+                    color.peakLuminance = lightLevel->MaxCLL;
+                else if (masteringDisplay && masteringDisplay->has_luminance)
+                    color.peakLuminance = av_q2d(masteringDisplay->max_luminance);
+            }
+        }
+    }
+    avformat_close_input(&context);
+    return color;
+}
+
+}
+
+ToneMapFilter::ToneMapFilter(QObject *parent) : QtAV::VideoFilter(parent)
+{
+}
+
+void ToneMapFilter::setStreamColor(const ToneMapping::StreamColor &color)
+{
+    hdr.store(color.transfer != ToneMapping::SDR ? 1 : 0);
+}
+
+void ToneMapFilter::process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame)
+{
+    Q_UNUSED(statistics)
+    if (!frame || !hdr.load())
+        return;
+    frame->setColorSpace(QtAV::ColorSpace_BT709);
+}
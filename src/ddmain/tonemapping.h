@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QtAV/Filter.h>
+#include <QAtomicInt>
+
+namespace ToneMapping
+{
+
+enum Transfer
+{
+    SDR,
+    PQ,
+    HLG
+};
+
+struct StreamColor
+{
+    Transfer transfer = SDR;
+    bool bt2020 = false;
+    // Brightest pixel of the content in nits, from the stream's content
+    // light level or mastering display metadata.
+    qreal peakLuminance = 1000.0;
+};
+
+// Reads the transfer characteristics of the first video stream. Opens
+// the file, so don't call this on the GUI thread.
+StreamColor probe(const QString &url);
+
+}
+
+// QtAV has no BT.2020 YUV matrix. HDR frames are tagged as BT.709 so the
+// renderer always applies a known matrix, which the tone mapping shader
+// then corrects.
+class ToneMapFilter : public QtAV::VideoFilter
+{
+    Q_OBJECT
+
+public:
+    explicit ToneMapFilter(QObject *parent = nullptr);
+
+public:
+    void setStreamColor(const ToneMapping::StreamColor &color);
+
+protected:
+    void process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame) override;
+
+private:
+    QAtomicInt hdr = 0;
+
+private:
+    Q_DISABLE_COPY(ToneMapFilter)
+};
@@ -1,4 +1,6 @@
 #include "utils.h"
+#include "framesinkrenderer.h"
+#include "softwarerenderer.h"
 #include <Win32Utils>
 
 #include <QApplication>
@@ -12,6 +14,8 @@
 #include <QtWin>
 #endif
 
+#include <Psapi.h>
+
 namespace Utils
 {
 
@@ -168,6 +172,12 @@ int getVideoRendererId(const VideoRendererId vid)
     case VideoRendererId::Direct2D:
         id = QtAV::VideoRendererId_Direct2D;
         break;
+    case VideoRendererId::Software:
+        id = SoftwareRenderer::rendererId;
+        break;
+    case VideoRendererId::FrameSink:
+        id = FrameSinkRenderer::rendererId;
+        break;
     default:
         id = QtAV::VideoRendererId_GLWidget2;
         break;
@@ -175,6 +185,16 @@ int getVideoRendererId(const VideoRendererId vid)
     return static_cast<int>(id);
 }
 
+QtAV::VideoRenderer *createVideoRenderer(int id)
+{
+    // Our own renderers are not registered in QtAV's factory.
+    if (id == SoftwareRenderer::rendererId)
+        return new SoftwareRenderer();
+    if (id == FrameSinkRenderer::rendererId)
+        return new FrameSinkRenderer();
+    return QtAV::VideoRenderer::create(static_cast<QtAV::VideoRendererId>(id));
+}
+
 void activateWindow(QObject *window, bool moveCenter)
 {
     if (!window)
@@ -229,4 +249,52 @@ bool enableBlurBehindWindow(QObject *window)
     return true;
 }
 
+qint64 getProcessCpuTime()
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return 0;
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    // FILETIME counts in units of 100 nanoseconds.
+    return static_cast<qint64>((kernel.QuadPart + user.QuadPart) / 10000);
+}
+
+quint64 getProcessPageFaults()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PageFaultCount;
+}
+
+quint64 getProcessWorkingSet()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.WorkingSetSize;
+}
+
+qint64 getThreadCpuTime(quint32 threadId)
+{
+    HANDLE thread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, threadId);
+    if (thread == nullptr)
+        return 0;
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    const BOOL result = GetThreadTimes(thread, &creationTime, &exitTime, &kernelTime, &userTime);
+    CloseHandle(thread);
+    if (!result)
+        return 0;
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    return static_cast<qint64>((kernel.QuadPart + user.QuadPart) / 10000);
+}
+
 }
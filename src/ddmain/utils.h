@@ -4,6 +4,11 @@
 
 QT_FORWARD_DECLARE_CLASS(QFileInfo)
 
+namespace QtAV
+{
+    QT_FORWARD_DECLARE_CLASS(VideoRenderer)
+}
+
 namespace Utils
 {
 
@@ -13,7 +18,9 @@ enum VideoRendererId
     GLWidget2,
     Widget,
     GDI,
-    Direct2D
+    Direct2D,
+    Software,
+    FrameSink
 };
 
 QStringList externalFilesToLoad(const QFileInfo &originalMediaFile, const QString &fileType);
@@ -23,7 +30,12 @@ bool isVideo(const QString &fileName);
 bool isAudio(const QString &fileName);
 bool isPicture(const QString &fileName);
 int getVideoRendererId(const VideoRendererId vid);
+QtAV::VideoRenderer *createVideoRenderer(int id);
 void activateWindow(QObject *window, bool moveCenter = true);
 bool enableBlurBehindWindow(QObject *window);
+qint64 getProcessCpuTime();
+quint64 getProcessPageFaults();
+quint64 getProcessWorkingSet();
+qint64 getThreadCpuTime(quint32 threadId);
 
 }
@@ -0,0 +1,298 @@
+#include "videoeffects.h"
+#include "metrics.h"
+#include "shadercache.h"
+
+#include <QGenericMatrix>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTimerQuery>
+#include <QtAV/OpenGLVideo.h>
+
+// Blur tap distance at full strength, relative to the frame width. With
+// the frame decoded at a quarter of the screen size this is about two
+// texels, so the bilinear taps below still overlap.
+const qreal kMaxBlurStep = 0.004;
+// SDR reference white in nits (ITU-R BT.2408).
+const qreal kReferenceWhite = 203.0;
+const float kBt2020ToBt709[] =
+{
+     1.6605f, -0.5876f, -0.0728f,
+    -0.1246f,  1.1329f, -0.0083f,
+    -0.0182f, -0.1006f,  1.1187f
+};
+
+static QMatrix3x3 yuvToRgb(float kr, float kb)
+{
+    const float kg = 1.0f - kr - kb;
+    const float values[] =
+    {
+        1.0f, 0.0f, 2.0f * (1.0f - kr),
+        1.0f, -2.0f * kb * (1.0f - kb) / kg, -2.0f * kr * (1.0f - kr) / kg,
+        1.0f, 2.0f * (1.0f - kb), 0.0f
+    };
+    return QMatrix3x3(values);
+}
+
+static QMatrix3x3 rgbToYuv(float kr, float kb)
+{
+    const float kg = 1.0f - kr - kb;
+    const float values[] =
+    {
+        kr, kg, kb,
+        -kr / (2.0f * (1.0f - kb)), -kg / (2.0f * (1.0f - kb)), 0.5f,
+        0.5f, -kg / (2.0f * (1.0f - kr)), -kb / (2.0f * (1.0f - kr))
+    };
+    return QMatrix3x3(values);
+}
+
+class VideoEffectsShader : public CachedVideoShader
+{
+public:
+    qreal dim = 0.0, blur = 0.0, vignette = 0.0;
+    ToneMapping::StreamColor streamColor;
+
+protected:
+    const char *userShaderHeader(QOpenGLShader::ShaderType shaderType) const override
+    {
+        if (shaderType != QOpenGLShader::Fragment)
+            return nullptr;
+        return "uniform float u_ddDim;\n"
+               "uniform float u_ddBlur;\n"
+               "uniform vec2 u_ddBlurStep;\n"
+               "uniform float u_ddVignette;\n"
+               "uniform vec2 u_ddViewport;\n"
+               "uniform float u_ddTransfer;\n"
+               "uniform float u_ddWhite;\n"
+               "uniform mat3 u_ddYuvCorrection;\n"
+               "uniform mat3 u_ddGamut;\n";
+    }
+
+    // 3x3 binomial kernel, a separable gaussian approximation. Every tap
+    // sits between texels, so bilinear filtering averages four of them.
+    const char *userSample() const override
+    {
+        return "vec4 sample2d(sampler2D tex, vec2 pos, int plane)\n"
+               "{\n"
+               "    vec4 center = texture(tex, pos);\n"
+               "    if (u_ddBlur <= 0.0)\n"
+               "        return center;\n"
+               "    vec2 dx = vec2(u_ddBlurStep.x, 0.0);\n"
+               "    vec2 dy = vec2(0.0, u_ddBlurStep.y);\n"
+               "    vec4 edges = texture(tex, pos - dx) + texture(tex, pos + dx) + texture(tex, pos - dy) + texture(tex, pos + dy);\n"
+               "    vec4 corners = texture(tex, pos - dx - dy) + texture(tex, pos + dx - dy) + texture(tex, pos - dx + dy) + texture(tex, pos + dx + dy);\n"
+               "    return center * 0.25 + edges * 0.125 + corners * 0.0625;\n"
+               "}\n";
+    }
+
+    // Tone mapping: undo QtAV's BT.709 matrix in favour of BT.2020, PQ or
+    // HLG to linear light relative to SDR white, BT.2020 to BT.709 gamut,
+    // extended Reinhard on luminance (peak maps to 1.0), gamma 2.2.
+    const char *userPostProcess() const override
+    {
+        return "if (u_ddTransfer > 0.0)\n"
+               "{\n"
+               "    vec3 ddColor = clamp(u_ddYuvCorrection * gl_FragColor.rgb, 0.0, 1.0);\n"
+               "    if (u_ddTransfer < 1.5)\n"
+               "    {\n"
+               "        vec3 ddPower = pow(ddColor, vec3(1.0 / 78.84375));\n"
+               "        ddColor = pow(max(ddPower - 0.8359375, 0.0) / (18.8515625 - 18.6875 * ddPower), vec3(1.0 / 0.1593017578125)) * (10000.0 / 203.0);\n"
+               "    }\n"
+               "    else\n"
+               "    {\n"
+               "        ddColor = mix(ddColor * ddColor / 3.0, (exp((ddColor - 0.55991073) / 0.17883277) + 0.28466892) / 12.0, step(0.5, ddColor));\n"
+               "        ddColor *= pow(max(dot(ddColor, vec3(0.2627, 0.6780, 0.0593)), 0.000001), 0.2) * (1000.0 / 203.0);\n"
+               "    }\n"
+               "    ddColor = max(u_ddGamut * ddColor, 0.0);\n"
+               "    float ddLuma = dot(ddColor, vec3(0.2126, 0.7152, 0.0722));\n"
+               "    float ddMapped = ddLuma * (1.0 + ddLuma * u_ddWhite) / (1.0 + ddLuma);\n"
+               "    ddColor = min(ddColor * (ddMapped / max(ddLuma, 0.000001)), 1.0);\n"
+               "    gl_FragColor.rgb = pow(ddColor, vec3(1.0 / 2.2));\n"
+               "}\n"
+               "vec2 ddOffset = gl_FragCoord.xy / u_ddViewport - vec2(0.5);\n"
+               "float ddShade = (1.0 - u_ddDim) * (1.0 - u_ddVignette * smoothstep(0.15, 0.5, dot(ddOffset, ddOffset)));\n"
+               "gl_FragColor.rgb *= ddShade;\n";
+    }
+
+    // Called once per frame right before the video is drawn.
+    bool setUserUniformValues() override
+    {
+        QOpenGLShaderProgram *shaderProgram = program();
+        QOpenGLContext *context = QOpenGLContext::currentContext();
+        if (!shaderProgram || !context)
+            return false;
+        GLint viewport[4] = {0, 0, 1, 1};
+        context->functions()->glGetIntegerv(GL_VIEWPORT, viewport);
+        const GLfloat width = qMax(1, viewport[2]);
+        const GLfloat height = qMax(1, viewport[3]);
+        const GLfloat step = blur * kMaxBlurStep;
+        shaderProgram->setUniformValue("u_ddDim", static_cast<GLfloat>(dim));
+        shaderProgram->setUniformValue("u_ddBlur", static_cast<GLfloat>(blur));
+        shaderProgram->setUniformValue("u_ddBlurStep", step, step * width / height);
+        shaderProgram->setUniformValue("u_ddVignette", static_cast<GLfloat>(vignette));
+        shaderProgram->setUniformValue("u_ddViewport", width, height);
+        shaderProgram->setUniformValue("u_ddTransfer", static_cast<GLfloat>(streamColor.transfer));
+        const qreal peak = qMax(streamColor.peakLuminance, kReferenceWhite) / kReferenceWhite;
+        shaderProgram->setUniformValue("u_ddWhite", static_cast<GLfloat>(1.0 / (peak * peak)));
+        shaderProgram->setUniformValue("u_ddYuvCorrection", yuvCorrection);
+        shaderProgram->setUniformValue("u_ddGamut", gamut);
+        return true;
+    }
+
+public:
+    void updateMatrices()
+    {
+        yuvCorrection.setToIdentity();
+        gamut.setToIdentity();
+        if (!streamColor.bt2020)
+            return;
+        yuvCorrection = yuvToRgb(0.2627f, 0.0593f) * rgbToYuv(0.2126f, 0.0722f);
+        gamut = QMatrix3x3(kBt2020ToBt709);
+    }
+
+private:
+    QMatrix3x3 yuvCorrection, gamut;
+};
+
+VideoEffects::VideoEffects(QObject *parent) : QObject(parent)
+{
+    passTime = MetricsRegistry::getInstance()->summary("dd_effects_pass_seconds", "GPU time of the video effects shader pass.");
+}
+
+VideoEffects::~VideoEffects()
+{
+    detach();
+}
+
+void VideoEffects::setReadability(quint32 dim, quint32 blur, quint32 vignette)
+{
+    this->dim = qMin<quint32>(dim, 100) / 100.0;
+    this->blur = qMin<quint32>(blur, 100) / 100.0;
+    this->vignette = qMin<quint32>(vignette, 100) / 100.0;
+    updateShader();
+}
+
+void VideoEffects::setStreamColor(const ToneMapping::StreamColor &color)
+{
+    streamColor = color;
+    updateShader();
+}
+
+bool VideoEffects::isActive() const
+{
+    return (dim > 0.0) || (blur > 0.0) || (vignette > 0.0) || (streamColor.transfer != ToneMapping::SDR);
+}
+
+qreal VideoEffects::preferredScaleFactor() const
+{
+    if (blur <= 0.0)
+        return 1.0;
+    return blur < 0.5 ? 0.5 : 0.25;
+}
+
+void VideoEffects::setOpenGLVideo(QtAV::OpenGLVideo *video)
+{
+    if (openGLVideo == video)
+        return;
+    // Shader programs and queries belong to the old renderer's context.
+    detach();
+    openGLVideo = video;
+    updateShader();
+}
+
+QVariantHash VideoEffects::statistics() const
+{
+    QVariantHash stats;
+    stats[QStringLiteral("effects.active")] = shader != nullptr;
+    stats[QStringLiteral("effects.toneMapping")] = static_cast<int>(streamColor.transfer);
+    if (shader && timingSupported)
+    {
+        stats[QStringLiteral("effects.passTimeP50")] = passTime->percentile(0.5);
+        stats[QStringLiteral("effects.passTimeP99")] = passTime->percentile(0.99);
+    }
+    return stats;
+}
+
+void VideoEffects::beginFrame()
+{
+    if (!timerQueries[0])
+    {
+        QOpenGLContext *context = QOpenGLContext::currentContext();
+        timingSupported = context && !context->isOpenGLES()
+                && ((context->format().version() >= qMakePair(3, 3)) || context->hasExtension(QByteArrayLiteral("GL_ARB_timer_query")));
+        if (!timingSupported)
+            return;
+        for (auto &query : timerQueries)
+        {
+            query = new QOpenGLTimerQuery(this);
+            query->create();
+        }
+    }
+    QOpenGLTimerQuery *query = timerQueries[currentQuery];
+    // The oldest query finished frames ago, its result is ready by now.
+    if ((issuedQueries >= 3) && query->isResultAvailable())
+        passTime->record(query->waitForResult() / 1000);
+    query->begin();
+}
+
+void VideoEffects::endFrame()
+{
+    if (!timingSupported || !timerQueries[0])
+        return;
+    timerQueries[currentQuery]->end();
+    currentQuery = (currentQuery + 1) % 3;
+    ++issuedQueries;
+}
+
+void VideoEffects::updateShader()
+{
+    if (!isActive())
+    {
+        detach();
+        return;
+    }
+    if (!shader)
+        attach();
+    if (shader)
+    {
+        shader->dim = dim;
+        shader->blur = blur;
+        shader->vignette = vignette;
+        shader->streamColor = streamColor;
+        shader->updateMatrices();
+    }
+}
+
+void VideoEffects::attach()
+{
+    if (!openGLVideo)
+        return;
+    shader = new VideoEffectsShader();
+    passTime->reset();
+    // Put back once the effects are turned off.
+    defaultShader = openGLVideo->userShader();
+    openGLVideo->setUserShader(shader);
+    connect(openGLVideo, &QtAV::OpenGLVideo::beforeRendering, this, &VideoEffects::beginFrame, Qt::DirectConnection);
+    connect(openGLVideo, &QtAV::OpenGLVideo::afterRendering, this, &VideoEffects::endFrame, Qt::DirectConnection);
+}
+
+void VideoEffects::detach()
+{
+    if (openGLVideo)
+    {
+        disconnect(openGLVideo, nullptr, this, nullptr);
+        if (shader)
+            openGLVideo->setUserShader(defaultShader);
+    }
+    defaultShader = nullptr;
+    for (auto &query : timerQueries)
+    {
+        delete query;
+        query = nullptr;
+    }
+    currentQuery = 0;
+    issuedQueries = 0;
+    timingSupported = false;
+    delete shader;
+    shader = nullptr;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "histogram.h"
+#include "tonemapping.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QVariantHash>
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLTimerQuery)
+
+namespace QtAV
+{
+    QT_FORWARD_DECLARE_CLASS(OpenGLVideo)
+    QT_FORWARD_DECLARE_CLASS(VideoShader)
+}
+
+class VideoEffectsShader;
+
+// Per-pixel work done in the OpenGL renderers' fragment shader: HDR to
+// SDR tone mapping and the readability effects (dimming, blur and
+// vignette) that keep desktop icon labels legible. Everything is
+// composited in the video's own pass without any CPU work. Blurred frames
+// are decoded at reduced resolution (see preferredScaleFactor()), the GPU
+// magnification then does most of the blurring. When no effect is needed
+// the shader is not installed at all and the renderer keeps the one it
+// had. Both build their programs through ShaderCache.
+class VideoEffects : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VideoEffects(QObject *parent = nullptr);
+    ~VideoEffects() override;
+
+public:
+    // All values are percentages, 0 disables the effect.
+    void setReadability(quint32 dim, quint32 blur, quint32 vignette);
+    void setStreamColor(const ToneMapping::StreamColor &color);
+    bool isActive() const;
+    qreal preferredScaleFactor() const;
+    void setOpenGLVideo(QtAV::OpenGLVideo *video);
+    QVariantHash statistics() const;
+
+private slots:
+    void beginFrame();
+    void endFrame();
+
+private:
+    void updateShader();
+    void attach();
+    void detach();
+
+private:
+    QPointer<QtAV::OpenGLVideo> openGLVideo;
+    VideoEffectsShader *shader = nullptr;
+    QtAV::VideoShader *defaultShader = nullptr;
+    qreal dim = 0.0, blur = 0.0, vignette = 0.0;
+    ToneMapping::StreamColor streamColor;
+    // A few queries in flight, so that reading a result never stalls.
+    QOpenGLTimerQuery *timerQueries[3] = {};
+    int currentQuery = 0, issuedQueries = 0;
+    bool timingSupported = false;
+    Histogram *passTime = nullptr;
+
+private:
+    Q_DISABLE_COPY(VideoEffects)
+};
@@ -0,0 +1,656 @@
+#include "yuvconverter.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define DD_YUV_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#define DD_YUV_AVX2
+#define DD_TARGET_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__GNUC__)
+#define DD_YUV_AVX2
+#define DD_TARGET_AVX2 __attribute__((target("avx2")))
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM) || defined(_M_ARM64)
+#define DD_YUV_NEON
+#include <arm_neon.h>
+#endif
+
+namespace YuvConverter
+{
+
+static inline qint16 saturate16(int value)
+{
+    return static_cast<qint16>(qBound(-32768, value, 32767));
+}
+
+static inline uchar clampByte(qint16 value)
+{
+    // Arithmetic shift, like the SIMD kernels.
+    return static_cast<uchar>(qBound(0, value >> 6, 255));
+}
+
+static inline quint32 load32(const uchar *data)
+{
+    quint32 value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static void convertRowScalar(const uchar *y, const uchar *u, const uchar *v, int uvStep, uchar *bgra, int from, int width, const Coefficients &c)
+{
+    for (int x = from; x < width; ++x)
+    {
+        const int chroma = (x >> 1) * uvStep;
+        // Every step is saturated to 16 bits exactly like the
+        // saturating SIMD instructions do.
+        const qint16 luma = static_cast<qint16>((y[x] - c.yOffset) * c.yScale + 32);
+        const qint16 cb = static_cast<qint16>(u[chroma] - 128);
+        const qint16 cr = static_cast<qint16>(v[chroma] - 128);
+        const qint16 r = saturate16(luma + cr * c.rv);
+        const qint16 g = saturate16(saturate16(luma - cb * c.gu) - cr * c.gv);
+        const qint16 b = saturate16(luma + cb * c.bu);
+        uchar *pixel = bgra + x * 4;
+        pixel[0] = clampByte(b);
+        pixel[1] = clampByte(g);
+        pixel[2] = clampByte(r);
+        pixel[3] = 0xff;
+    }
+}
+
+#ifdef DD_YUV_SSE2
+static int convertRowSse2(const uchar *y, const uchar *u, const uchar *v, int uvStep, uchar *bgra, int width, const Coefficients &c)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowByte = _mm_set1_epi16(0xff);
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xff));
+    const __m128i rounding = _mm_set1_epi16(32);
+    const __m128i chromaOffset = _mm_set1_epi16(128);
+    const __m128i yOffset = _mm_set1_epi16(c.yOffset);
+    const __m128i yScale = _mm_set1_epi16(c.yScale);
+    const __m128i rv = _mm_set1_epi16(c.rv);
+    const __m128i gu = _mm_set1_epi16(c.gu);
+    const __m128i gv = _mm_set1_epi16(c.gv);
+    const __m128i bu = _mm_set1_epi16(c.bu);
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i luma = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + x)), zero);
+        __m128i cb, cr;
+        if (uvStep == 1)
+        {
+            const __m128i ub = _mm_cvtsi32_si128(static_cast<int>(load32(u + x / 2)));
+            const __m128i vb = _mm_cvtsi32_si128(static_cast<int>(load32(v + x / 2)));
+            cb = _mm_unpacklo_epi8(_mm_unpacklo_epi8(ub, ub), zero);
+            cr = _mm_unpacklo_epi8(_mm_unpacklo_epi8(vb, vb), zero);
+        }
+        else
+        {
+            const __m128i uv = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x));
+            const __m128i pairs = _mm_unpacklo_epi16(uv, uv);
+            cb = _mm_and_si128(pairs, lowByte);
+            cr = _mm_srli_epi16(pairs, 8);
+        }
+        luma = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(luma, yOffset), yScale), rounding);
+        cb = _mm_sub_epi16(cb, chromaOffset);
+        cr = _mm_sub_epi16(cr, chromaOffset);
+        const __m128i r = _mm_srai_epi16(_mm_adds_epi16(luma, _mm_mullo_epi16(cr, rv)), 6);
+        const __m128i g = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(luma, _mm_mullo_epi16(cb, gu)), _mm_mullo_epi16(cr, gv)), 6);
+        const __m128i b = _mm_srai_epi16(_mm_adds_epi16(luma, _mm_mullo_epi16(cb, bu)), 6);
+        const __m128i bg = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_packus_epi16(g, g));
+        const __m128i ra = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bgra + x * 4), _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bgra + x * 4 + 16), _mm_unpackhi_epi16(bg, ra));
+    }
+    return x;
+}
+#endif
+
+#ifdef DD_YUV_AVX2
+DD_TARGET_AVX2 static int convertRowAvx2(const uchar *y, const uchar *u, const uchar *v, int uvStep, uchar *bgra, int width, const Coefficients &c)
+{
+    const __m256i lowByte = _mm256_set1_epi16(0xff);
+    const __m256i alpha = _mm256_set1_epi8(static_cast<char>(0xff));
+    const __m256i rounding = _mm256_set1_epi16(32);
+    const __m256i chromaOffset = _mm256_set1_epi16(128);
+    const __m256i yOffset = _mm256_set1_epi16(c.yOffset);
+    const __m256i yScale = _mm256_set1_epi16(c.yScale);
+    const __m256i rv = _mm256_set1_epi16(c.rv);
+    const __m256i gu = _mm256_set1_epi16(c.gu);
+    const __m256i gv = _mm256_set1_epi16(c.gv);
+    const __m256i bu = _mm256_set1_epi16(c.bu);
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i luma = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x)));
+        __m256i cb, cr;
+        if (uvStep == 1)
+        {
+            const __m128i ub = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2));
+            const __m128i vb = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2));
+            cb = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(ub, ub));
+            cr = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(vb, vb));
+        }
+        else
+        {
+            const __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(u + x));
+            const __m256i pairs = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(uv, uv)), _mm_unpackhi_epi16(uv, uv), 1);
+            cb = _mm256_and_si256(pairs, lowByte);
+            cr = _mm256_srli_epi16(pairs, 8);
+        }
+        luma = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(luma, yOffset), yScale), rounding);
+        cb = _mm256_sub_epi16(cb, chromaOffset);
+        cr = _mm256_sub_epi16(cr, chromaOffset);
+        const __m256i r = _mm256_srai_epi16(_mm256_adds_epi16(luma, _mm256_mullo_epi16(cr, rv)), 6);
+        const __m256i g = _mm256_srai_epi16(_mm256_subs_epi16(_mm256_subs_epi16(luma, _mm256_mullo_epi16(cb, gu)), _mm256_mullo_epi16(cr, gv)), 6);
+        const __m256i b = _mm256_srai_epi16(_mm256_adds_epi16(luma, _mm256_mullo_epi16(cb, bu)), 6);
+        // Packing and unpacking work per 128-bit lane: the low lane ends
+        // up with pixels 0-3 and 4-7, the high lane with 8-11 and 12-15.
+        const __m256i bg = _mm256_unpacklo_epi8(_mm256_packus_epi16(b, b), _mm256_packus_epi16(g, g));
+        const __m256i ra = _mm256_unpacklo_epi8(_mm256_packus_epi16(r, r), alpha);
+        const __m256i low = _mm256_unpacklo_epi16(bg, ra);
+        const __m256i high = _mm256_unpackhi_epi16(bg, ra);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(bgra + x * 4), _mm256_permute2x128_si256(low, high, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(bgra + x * 4 + 32), _mm256_permute2x128_si256(low, high, 0x31));
+    }
+    return x;
+}
+#endif
+
+#ifdef DD_YUV_NEON
+static int convertRowNeon(const uchar *y, const uchar *u, const uchar *v, int uvStep, uchar *bgra, int width, const Coefficients &c)
+{
+    const int16x8_t rounding = vdupq_n_s16(32);
+    const int16x8_t chromaOffset = vdupq_n_s16(128);
+    const int16x8_t yOffset = vdupq_n_s16(c.yOffset);
+    const int16x8_t yScale = vdupq_n_s16(c.yScale);
+    const int16x8_t rv = vdupq_n_s16(c.rv);
+    const int16x8_t gu = vdupq_n_s16(c.gu);
+    const int16x8_t gv = vdupq_n_s16(c.gv);
+    const int16x8_t bu = vdupq_n_s16(c.bu);
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        int16x8_t luma = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + x)));
+        int16x8_t cb, cr;
+        if (uvStep == 1)
+        {
+            const uint8x8_t ub = vreinterpret_u8_u32(vdup_n_u32(load32(u + x / 2)));
+            const uint8x8_t vb = vreinterpret_u8_u32(vdup_n_u32(load32(v + x / 2)));
+            cb = vreinterpretq_s16_u16(vmovl_u8(vzip_u8(ub, ub).val[0]));
+            cr = vreinterpretq_s16_u16(vmovl_u8(vzip_u8(vb, vb).val[0]));
+        }
+        else
+        {
+            const uint16x4_t uv = vreinterpret_u16_u8(vld1_u8(u + x));
+            const uint16x4x2_t pairs = vzip_u16(uv, uv);
+            const uint16x8_t words = vcombine_u16(pairs.val[0], pairs.val[1]);
+            cb = vreinterpretq_s16_u16(vandq_u16(words, vdupq_n_u16(0xff)));
+            cr = vreinterpretq_s16_u16(vshrq_n_u16(words, 8));
+        }
+        luma = vaddq_s16(vmulq_s16(vsubq_s16(luma, yOffset), yScale), rounding);
+        cb = vsubq_s16(cb, chromaOffset);
+        cr = vsubq_s16(cr, chromaOffset);
+        uint8x8x4_t pixels;
+        pixels.val[0] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(luma, vmulq_s16(cb, bu)), 6));
+        pixels.val[1] = vqmovun_s16(vshrq_n_s16(vqsubq_s16(vqsubq_s16(luma, vmulq_s16(cb, gu)), vmulq_s16(cr, gv)), 6));
+        pixels.val[2] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(luma, vmulq_s16(cr, rv)), 6));
+        pixels.val[3] = vdup_n_u8(0xff);
+        vst4_u8(bgra + x * 4, pixels);
+    }
+    return x;
+}
+#endif
+
+#ifdef DD_YUV_AVX2
+static bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || ((_xgetbv(0) & 0x6) != 0x6))
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    if (!(ecx & (1u << 27)) || !(ecx & (1u << 28)))
+        return false;
+    unsigned int xcr0 = 0, xcr0High = 0;
+    __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+    if ((xcr0 & 0x6) != 0x6)
+        return false;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ebx & (1u << 5)) != 0;
+#endif
+}
+#endif
+
+static Instructions detectInstructions()
+{
+#ifdef DD_YUV_AVX2
+    if (cpuHasAvx2())
+        return AVX2;
+#endif
+#if defined(DD_YUV_SSE2)
+    return SSE2;
+#elif defined(DD_YUV_NEON)
+    return NEON;
+#else
+    return Scalar;
+#endif
+}
+
+static Taps makeTaps(Filter filter, int from, int to)
+{
+    Taps taps;
+    taps.first.resize(to);
+    taps.second.resize(to);
+    taps.weights.fill(0, 2 * to);
+    for (int i = 0; i < to; ++i)
+    {
+        if (filter == Area)
+        {
+            // When scaling up every output sample covers one input sample.
+            const int first = static_cast<int>(static_cast<qint64>(i) * from / to);
+            taps.first[i] = first;
+            taps.second[i] = qMax(first + 1, static_cast<int>(static_cast<qint64>(i + 1) * from / to));
+            continue;
+        }
+        // Sample centers line up, in 1/256 of an input sample. The last
+        // sample is only ever reached with a weight of 0 for the next one.
+        const qint64 position = qBound(static_cast<qint64>(0),
+                                       (static_cast<qint64>(2 * i + 1) * from * 256) / (2 * to) - 128,
+                                       static_cast<qint64>(from - 1) * 256);
+        const int weight = static_cast<int>(position & 0xff);
+        taps.first[i] = static_cast<int>(position >> 8);
+        taps.second[i] = qMin(taps.first.at(i) + 1, from - 1);
+        taps.weights[2 * i] = static_cast<qint16>(256 - weight);
+        taps.weights[2 * i + 1] = static_cast<qint16>(weight);
+    }
+    return taps;
+}
+
+static inline quint32 loadPair(const quint16 *row, int index)
+{
+    quint32 value;
+    memcpy(&value, row + index, sizeof(value));
+    return value;
+}
+
+// The vertical pass of bilinear blends two rows into 16 bits, 8.6 fixed
+// point with rounding so that it stays within signed 16 bits.
+static void blendRowsScalar(const uchar *top, const uchar *bottom, int step, int weight, quint16 *blended, int from, int to)
+{
+    for (int x = from; x < to; ++x)
+        blended[x] = static_cast<quint16>((top[x * step] * (256 - weight) + bottom[x * step] * weight + 2) >> 2);
+}
+
+static void blendColumnsScalar(const quint16 *blended, const int *first, const qint16 *weights, uchar *out, int from, int to)
+{
+    for (int x = from; x < to; ++x)
+    {
+        const quint16 *pair = blended + first[x];
+        out[x] = static_cast<uchar>((pair[0] * weights[2 * x] + pair[1] * weights[2 * x + 1] + 8192) >> 14);
+    }
+}
+
+// The SIMD kernels of the vertical pass read interleaved rows 16 bytes at
+// a time, they stop early enough to stay within the row of "v".
+#ifdef DD_YUV_SSE2
+static int blendRowsSse2(const uchar *top, const uchar *bottom, int step, int weight, quint16 *blended, int from)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowByte = _mm_set1_epi16(0xff);
+    const __m128i rounding = _mm_set1_epi16(2);
+    const __m128i topWeight = _mm_set1_epi16(static_cast<short>(256 - weight));
+    const __m128i bottomWeight = _mm_set1_epi16(static_cast<short>(weight));
+    int x = 0;
+    for (; x + 8 + (step - 1) <= from; x += 8)
+    {
+        __m128i upper, lower;
+        if (step == 1)
+        {
+            upper = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(top + x)), zero);
+            lower = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(bottom + x)), zero);
+        }
+        else
+        {
+            upper = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(top + 2 * x)), lowByte);
+            lower = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + 2 * x)), lowByte);
+        }
+        // The sum stays below 65536, 16-bit products are exact.
+        const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(upper, topWeight), _mm_mullo_epi16(lower, bottomWeight));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(blended + x), _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2));
+    }
+    return x;
+}
+
+static int blendColumnsSse2(const quint16 *blended, const int *first, const qint16 *weights, uchar *out, int width)
+{
+    const __m128i rounding = _mm_set1_epi32(8192);
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m128i low = _mm_setr_epi32(static_cast<int>(loadPair(blended, first[x])), static_cast<int>(loadPair(blended, first[x + 1])),
+                                           static_cast<int>(loadPair(blended, first[x + 2])), static_cast<int>(loadPair(blended, first[x + 3])));
+        const __m128i high = _mm_setr_epi32(static_cast<int>(loadPair(blended, first[x + 4])), static_cast<int>(loadPair(blended, first[x + 5])),
+                                            static_cast<int>(loadPair(blended, first[x + 6])), static_cast<int>(loadPair(blended, first[x + 7])));
+        const __m128i lowSum = _mm_madd_epi16(low, _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + 2 * x)));
+        const __m128i highSum = _mm_madd_epi16(high, _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + 2 * x + 8)));
+        const __m128i words = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(lowSum, rounding), 14),
+                                              _mm_srai_epi32(_mm_add_epi32(highSum, rounding), 14));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(words, words));
+    }
+    return x;
+}
+#endif
+
+#ifdef DD_YUV_AVX2
+DD_TARGET_AVX2 static int blendRowsAvx2(const uchar *top, const uchar *bottom, int step, int weight, quint16 *blended, int from)
+{
+    const __m256i lowByte = _mm256_set1_epi16(0xff);
+    const __m256i rounding = _mm256_set1_epi16(2);
+    const __m256i topWeight = _mm256_set1_epi16(static_cast<short>(256 - weight));
+    const __m256i bottomWeight = _mm256_set1_epi16(static_cast<short>(weight));
+    int x = 0;
+    for (; x + 16 + (step - 1) <= from; x += 16)
+    {
+        __m256i upper, lower;
+        if (step == 1)
+        {
+            upper = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(top + x)));
+            lower = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + x)));
+        }
+        else
+        {
+            upper = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(top + 2 * x)), lowByte);
+            lower = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(bottom + 2 * x)), lowByte);
+        }
+        const __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(upper, topWeight), _mm256_mullo_epi16(lower, bottomWeight));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(blended + x), _mm256_srli_epi16(_mm256_add_epi16(sum, rounding), 2));
+    }
+    return x;
+}
+
+DD_TARGET_AVX2 static int blendColumnsAvx2(const quint16 *blended, const int *first, const qint16 *weights, uchar *out, int width)
+{
+    const __m256i rounding = _mm256_set1_epi32(8192);
+    const int *base = reinterpret_cast<const int *>(blended);
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        // Each gather reads a sample and the next one, 2 bytes per index.
+        const __m256i low = _mm256_i32gather_epi32(base, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + x)), 2);
+        const __m256i high = _mm256_i32gather_epi32(base, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + x + 8)), 2);
+        const __m256i lowSum = _mm256_madd_epi16(low, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + 2 * x)));
+        const __m256i highSum = _mm256_madd_epi16(high, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + 2 * x + 16)));
+        // Packing works per 128-bit lane, the permute puts the pixels back
+        // in order.
+        const __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(lowSum, rounding), 14),
+                                                                          _mm256_srai_epi32(_mm256_add_epi32(highSum, rounding), 14)), 0xd8);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x),
+                         _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1)));
+    }
+    return x;
+}
+#endif
+
+#ifdef DD_YUV_NEON
+static int blendRowsNeon(const uchar *top, const uchar *bottom, int step, int weight, quint16 *blended, int from)
+{
+    const uint16x8_t rounding = vdupq_n_u16(2);
+    const uint16x8_t topWeight = vdupq_n_u16(static_cast<quint16>(256 - weight));
+    const uint16x8_t bottomWeight = vdupq_n_u16(static_cast<quint16>(weight));
+    int x = 0;
+    for (; x + 8 + (step - 1) <= from; x += 8)
+    {
+        const uint8x8_t upper = step == 1 ? vld1_u8(top + x) : vld2_u8(top + 2 * x).val[0];
+        const uint8x8_t lower = step == 1 ? vld1_u8(bottom + x) : vld2_u8(bottom + 2 * x).val[0];
+        const uint16x8_t sum = vmlaq_u16(vmulq_u16(vmovl_u8(upper), topWeight), vmovl_u8(lower), bottomWeight);
+        vst1q_u16(blended + x, vshrq_n_u16(vaddq_u16(sum, rounding), 2));
+    }
+    return x;
+}
+
+static int blendColumnsNeon(const quint16 *blended, const int *first, const qint16 *weights, uchar *out, int width)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        // No gather, the samples are collected one by one.
+        qint16 left[8], right[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            left[i] = static_cast<qint16>(blended[first[x + i]]);
+            right[i] = static_cast<qint16>(blended[first[x + i] + 1]);
+        }
+        const int16x8x2_t weight = vld2q_s16(weights + 2 * x);
+        const int16x8_t leftSamples = vld1q_s16(left);
+        const int16x8_t rightSamples = vld1q_s16(right);
+        const int32x4_t lowSum = vmlal_s16(vmull_s16(vget_low_s16(leftSamples), vget_low_s16(weight.val[0])),
+                                           vget_low_s16(rightSamples), vget_low_s16(weight.val[1]));
+        const int32x4_t highSum = vmlal_s16(vmull_s16(vget_high_s16(leftSamples), vget_high_s16(weight.val[0])),
+                                            vget_high_s16(rightSamples), vget_high_s16(weight.val[1]));
+        const uint16x8_t words = vcombine_u16(vqmovun_s32(vrshrq_n_s32(lowSum, 14)), vqmovun_s32(vrshrq_n_s32(highSum, 14)));
+        vst1_u8(out + x, vqmovn_u16(words));
+    }
+    return x;
+}
+#endif
+
+static void scaleRowArea(const uchar *plane, int stride, int step, int from, const Taps &columns, const Taps &rows, int row,
+                         uchar *out, int width, Scratch *scratch)
+{
+    const int firstRow = rows.first.at(row);
+    const int rowCount = rows.second.at(row) - firstRow;
+    scratch->sums.fill(0, from);
+    quint32 *sums = scratch->sums.data();
+    for (int y = firstRow; y < firstRow + rowCount; ++y)
+    {
+        const uchar *line = plane + y * stride;
+        for (int x = 0; x < from; ++x)
+            sums[x] += line[x * step];
+    }
+    const int *first = columns.first.constData();
+    const int *second = columns.second.constData();
+    for (int x = 0; x < width; ++x)
+    {
+        quint32 sum = 0;
+        for (int column = first[x]; column < second[x]; ++column)
+            sum += sums[column];
+        const quint32 count = static_cast<quint32>(rowCount * (second[x] - first[x]));
+        out[x] = static_cast<uchar>((sum + count / 2) / count);
+    }
+}
+
+Coefficients coefficients(bool bt709, bool fullRange)
+{
+    // Y'CbCr to R'G'B' matrices multiplied by 64.
+    if (fullRange)
+        return bt709 ? Coefficients{0, 64, 101, 12, 30, 119} : Coefficients{0, 64, 90, 22, 46, 113};
+    return bt709 ? Coefficients{16, 75, 115, 14, 34, 135} : Coefficients{16, 75, 102, 25, 52, 129};
+}
+
+Instructions bestInstructions()
+{
+    static const Instructions instructions = detectInstructions();
+    return instructions;
+}
+
+bool isAvailable(Instructions instructions)
+{
+    switch (instructions)
+    {
+#ifdef DD_YUV_SSE2
+    case SSE2:
+        return true;
+#endif
+#ifdef DD_YUV_AVX2
+    case AVX2:
+        return bestInstructions() == AVX2;
+#endif
+#ifdef DD_YUV_NEON
+    case NEON:
+        return true;
+#endif
+    case Scalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void convertRow(const uchar *y, const uchar *u, const uchar *v, int uvStep, uchar *bgra, int width, const Coefficients &c, Instructions instructions)
+{
+    int x = 0;
+    switch (instructions)
+    {
+#ifdef DD_YUV_AVX2
+    case AVX2:
+        x = convertRowAvx2(y, u, v, uvStep, bgra, width, c);
+        break;
+#endif
+#ifdef DD_YUV_SSE2
+    case SSE2:
+        x = convertRowSse2(y, u, v, uvStep, bgra, width, c);
+        break;
+#endif
+#ifdef DD_YUV_NEON
+    case NEON:
+        x = convertRowNeon(y, u, v, uvStep, bgra, width, c);
+        break;
+#endif
+    default:
+        break;
+    }
+    convertRowScalar(y, u, v, uvStep, bgra, x, width, c);
+}
+
+
+Scaling makeScaling(Filter filter, int sourceWidth, int sourceHeight, int width, int height)
+{
+    Scaling scaling;
+    scaling.filter = filter;
+    scaling.sourceWidth = sourceWidth;
+    scaling.sourceHeight = sourceHeight;
+    scaling.width = width;
+    scaling.height = height;
+    // Frames that keep their size are only converted.
+    if ((width == sourceWidth) && (height == sourceHeight))
+        return scaling;
+    scaling.lumaColumns = makeTaps(filter, sourceWidth, width);
+    scaling.lumaRows = makeTaps(filter, sourceHeight, height);
+    scaling.chromaColumns = makeTaps(filter, (sourceWidth + 1) / 2, (width + 1) / 2);
+    scaling.chromaRows = makeTaps(filter, (sourceHeight + 1) / 2, (height + 1) / 2);
+    return scaling;
+}
+
+void scaleRow(const uchar *plane, int stride, int step, int from, const Taps &columns, const Taps &rows, int row,
+              Filter filter, uchar *out, int width, Scratch *scratch, Instructions instructions)
+{
+    if (filter == Area)
+    {
+        scaleRowArea(plane, stride, step, from, columns, rows, row, out, width, scratch);
+        return;
+    }
+    // One more sample, the horizontal pass always reads a pair.
+    if (scratch->blended.size() < from + 1)
+        scratch->blended.resize(from + 1);
+    quint16 *blended = scratch->blended.data();
+    const uchar *top = plane + rows.first.at(row) * stride;
+    const uchar *bottom = plane + rows.second.at(row) * stride;
+    const int weight = rows.weights.at(2 * row + 1);
+    const int *first = columns.first.constData();
+    const qint16 *weights = columns.weights.constData();
+    int blendedRows = 0;
+    int blendedColumns = 0;
+    switch (instructions)
+    {
+#ifdef DD_YUV_AVX2
+    case AVX2:
+        blendedRows = blendRowsAvx2(top, bottom, step, weight, blended, from);
+        blendRowsScalar(top, bottom, step, weight, blended, blendedRows, from);
+        blendedColumns = blendColumnsAvx2(blended, first, weights, out, width);
+        break;
+#endif
+#ifdef DD_YUV_SSE2
+    case SSE2:
+        blendedRows = blendRowsSse2(top, bottom, step, weight, blended, from);
+        blendRowsScalar(top, bottom, step, weight, blended, blendedRows, from);
+        blendedColumns = blendColumnsSse2(blended, first, weights, out, width);
+        break;
+#endif
+#ifdef DD_YUV_NEON
+    case NEON:
+        blendedRows = blendRowsNeon(top, bottom, step, weight, blended, from);
+        blendRowsScalar(top, bottom, step, weight, blended, blendedRows, from);
+        blendedColumns = blendColumnsNeon(blended, first, weights, out, width);
+        break;
+#endif
+    default:
+        blendRowsScalar(top, bottom, step, weight, blended, 0, from);
+        break;
+    }
+    blendColumnsScalar(blended, first, weights, out, blendedColumns, width);
+}
+
+void convertScaled(const Source &source, uchar *bgra, int stride, int first, int last, const Scaling &scaling,
+                   const Coefficients &c, Instructions instructions, Scratch *scratch)
+{
+    const int width = scaling.width;
+    if ((width == source.width) && (scaling.height == source.height))
+    {
+        for (int row = first; row < last; ++row)
+        {
+            const int chromaOffset = (row / 2) * source.uvStride;
+            convertRow(source.y + row * source.yStride, source.u + chromaOffset, source.v + chromaOffset, source.uvStep,
+                       bgra + (row - first) * stride, width, c, instructions);
+        }
+        return;
+    }
+    const int chromaFrom = (source.width + 1) / 2;
+    const int chromaWidth = (width + 1) / 2;
+    if (scratch->luma.size() < width)
+        scratch->luma.resize(width);
+    if (scratch->cb.size() < chromaWidth)
+    {
+        scratch->cb.resize(chromaWidth);
+        scratch->cr.resize(chromaWidth);
+    }
+    uchar *luma = scratch->luma.data();
+    uchar *cb = scratch->cb.data();
+    uchar *cr = scratch->cr.data();
+    int chromaRow = -1;
+    for (int row = first; row < last; ++row)
+    {
+        scaleRow(source.y, source.yStride, 1, source.width, scaling.lumaColumns, scaling.lumaRows, row, scaling.filter,
+                 luma, width, scratch, instructions);
+        if ((row / 2) != chromaRow)
+        {
+            chromaRow = row / 2;
+            scaleRow(source.u, source.uvStride, source.uvStep, chromaFrom, scaling.chromaColumns, scaling.chromaRows, chromaRow,
+                     scaling.filter, cb, chromaWidth, scratch, instructions);
+            scaleRow(source.v, source.uvStride, source.uvStep, chromaFrom, scaling.chromaColumns, scaling.chromaRows, chromaRow,
+                     scaling.filter, cr, chromaWidth, scratch, instructions);
+        }
+        convertRow(luma, cb, cr, 1, bgra + (row - first) * stride, width, c, instructions);
+    }
+}
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QVector>
+
+namespace YuvConverter
+{
+
+enum Instructions
+{
+    Scalar,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+enum Filter
+{
+    // Weighs the two nearest samples in each direction, for scaling up
+    // and by less than half.
+    Bilinear,
+    // Averages every sample an output pixel covers, for scaling down by
+    // half or more where bilinear would skip samples and alias.
+    Area
+};
+
+// Fixed point YUV to RGB matrix with 6 fractional bits. All intermediate
+// values fit into signed 16 bits, so the scalar code and every SIMD kernel
+// produce bit-exact identical results.
+struct Coefficients
+{
+    qint16 yOffset;
+    qint16 yScale;
+    qint16 rv;
+    qint16 gu;
+    qint16 gv;
+    qint16 bu;
+};
+
+// A 4:2:0 frame. "uvStep" is 1 for planar chroma (YUV420P) and 2 for
+// interleaved chroma (NV12, "v" one byte after "u").
+struct Source
+{
+    const uchar *y;
+    const uchar *u;
+    const uchar *v;
+    int yStride;
+    int uvStride;
+    int uvStep;
+    int width;
+    int height;
+};
+
+// Where the samples of one output row or column come from. Bilinear
+// blends "first" and "first + 1" by "weights", which holds the weights of
+// both side by side in 1/256. Area averages "first" up to but not
+// including "second".
+struct Taps
+{
+    QVector<int> first;
+    QVector<int> second;
+    QVector<qint16> weights;
+};
+
+// The taps of every plane for scaling frames of one size to another.
+// Building them costs more than converting a frame, keep them as long as
+// the sizes and the filter stay the same.
+struct Scaling
+{
+    Filter filter = Bilinear;
+    int sourceWidth = 0;
+    int sourceHeight = 0;
+    int width = 0;
+    int height = 0;
+    Taps lumaColumns;
+    Taps lumaRows;
+    Taps chromaColumns;
+    Taps chromaRows;
+};
+
+// Rows to work in, one per thread. They grow to the largest frame and
+// are reused from then on.
+struct Scratch
+{
+    QVector<quint16> blended;
+    QVector<quint32> sums;
+    QVector<uchar> luma;
+    QVector<uchar> cb;
+    QVector<uchar> cr;
+};
+
+Coefficients coefficients(bool bt709, bool fullRange);
+Instructions bestInstructions();
+// Whether this build and this CPU can run the kernels of "instructions".
+bool isAvailable(Instructions instructions);
+
+// Converts one row of 4:2:0 or 4:2:2 video into 32-bit BGRA (QImage::Format_RGB32).
+// "uvStep" is 1 for planar chroma (YUV420P) and 2 for interleaved chroma
+// (NV12, pass the same row with "v" one byte after "u").
+void convertRow(const uchar *y, const uchar *u, const uchar *v, int uvStep, uchar *bgra, int width, const Coefficients &c, Instructions instructions);
+
+Scaling makeScaling(Filter filter, int sourceWidth, int sourceHeight, int width, int height);
+
+// Scales output row "row" of an 8-bit plane whose samples are "step"
+// bytes apart and whose rows are "from" samples wide. Bilinear runs as a
+// vertical pass into 16 bits and a horizontal pass, both have SIMD
+// kernels with results identical to the scalar code.
+void scaleRow(const uchar *plane, int stride, int step, int from, const Taps &columns, const Taps &rows, int row,
+              Filter filter, uchar *out, int width, Scratch *scratch, Instructions instructions);
+
+// Converts the rows "first" to "last" (exclusive) of "source" scaled as
+// "scaling" says, which must have been made for the size of "source".
+// "bgra" points to row "first", the rows are "stride" bytes apart. Every
+// plane is scaled on its own in fixed point, an output row doesn't depend
+// on how the frame is split into bands.
+void convertScaled(const Source &source, uchar *bgra, int stride, int first, int last, const Scaling &scaling,
+                   const Coefficients &c, Instructions instructions, Scratch *scratch);
+
+}
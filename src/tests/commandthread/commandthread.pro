@@ -0,0 +1,11 @@
+TARGET = tst_commandthread
+QT = core
+TEMPLATE = app
+include(../tests.pri)
+HEADERS *= \
+    ../../ddmain/commandthread.h \
+    ../../ddmain/histogram.h
+SOURCES *= \
+    tst_commandthread.cpp \
+    ../../ddmain/commandthread.cpp \
+    ../../ddmain/histogram.cpp
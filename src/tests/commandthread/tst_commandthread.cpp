@@ -0,0 +1,279 @@
+#include "commandthread.h"
+#include "histogram.h"
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QSemaphore>
+#include <QTimer>
+#include <QVector>
+#include <QtTest>
+
+// How long the GUI thread is kept busy, as if it filled a dialog or
+// applied a style sheet.
+const int kStall = 200;
+const unsigned long kCommandInterval = 5;
+const int kProducers = 4;
+const int kCommandsPerProducer = 10000;
+const int kBurst = 1000;
+const int kTimeout = 10000;
+
+static qint64 now()
+{
+    static QElapsedTimer clock;
+    static const bool started = (clock.start(), true);
+    Q_UNUSED(started)
+    return clock.nsecsElapsed() / 1000;
+}
+
+static bool waitForCommands(CommandThread *commands)
+{
+    QSemaphore done;
+    commands->post([&done]
+    {
+        done.release();
+    });
+    return done.tryAcquire(1, kTimeout);
+}
+
+// Stands in for a slot of the GUI thread that is called through a queued
+// connection, the way commands reached the player before.
+class GuiReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit GuiReceiver(Histogram *latency) : latency(latency) {}
+
+public slots:
+    void receive(qint64 sent)
+    {
+        latency->record(now() - sent);
+    }
+
+private:
+    Histogram *latency;
+};
+
+// Sends a command every few milliseconds, both to the command thread and
+// to the GUI thread, like the control channel does from its own thread.
+class ChannelThread : public QThread
+{
+public:
+    ChannelThread(CommandThread *commands, GuiReceiver *receiver, Histogram *latency, int duration)
+        : commands(commands), receiver(receiver), latency(latency), duration(duration) {}
+
+protected:
+    void run() override
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < duration)
+        {
+            const qint64 sent = now();
+            Histogram *commandLatency = latency;
+            commands->post([commandLatency, sent]
+            {
+                commandLatency->record(now() - sent);
+            });
+            QMetaObject::invokeMethod(receiver, "receive", Qt::QueuedConnection, Q_ARG(qint64, sent));
+            QThread::msleep(kCommandInterval);
+        }
+    }
+
+private:
+    CommandThread *commands;
+    GuiReceiver *receiver;
+    Histogram *latency;
+    const int duration;
+};
+
+class Producer : public QThread
+{
+public:
+    Producer(CommandThread *commands, int id, QVector<int> *last, bool *ordered)
+        : commands(commands), id(id), last(last), ordered(ordered) {}
+
+protected:
+    void run() override
+    {
+        // The vector and the flag are only touched on the command thread.
+        QVector<int> *lastCommand = last;
+        bool *inOrder = ordered;
+        const int producer = id;
+        for (int i = 0; i < kCommandsPerProducer; ++i)
+            commands->post([lastCommand, inOrder, producer, i]
+            {
+                if ((*lastCommand)[producer] != i - 1)
+                    *inOrder = false;
+                (*lastCommand)[producer] = i;
+            });
+    }
+
+private:
+    CommandThread *commands;
+    const int id;
+    QVector<int> *last;
+    bool *ordered;
+};
+
+class QueuedCounter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QueuedCounter(QSemaphore *done) : done(done) {}
+
+public slots:
+    void count()
+    {
+        if (++calls % kBurst == 0)
+            done->release();
+    }
+
+private:
+    QSemaphore *done;
+    int calls = 0;
+};
+
+class tst_CommandThread : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void runsPostedFunctionsInOrder();
+    void runsFunctionsPostedBeforeStart();
+    void recyclesNodes();
+    void keepsCommandsMovingWhileGuiStalls();
+    void benchmarkPost();
+    void benchmarkQueuedCall();
+};
+
+void tst_CommandThread::runsPostedFunctionsInOrder()
+{
+    CommandThread commands;
+    commands.start();
+    QVector<int> last(kProducers, -1);
+    bool ordered = true;
+    QVector<Producer *> producers;
+    for (int i = 0; i < kProducers; ++i)
+        producers.append(new Producer(&commands, i, &last, &ordered));
+    for (Producer *producer : qAsConst(producers))
+        producer->start();
+    for (Producer *producer : qAsConst(producers))
+        producer->wait();
+    qDeleteAll(producers);
+    QVERIFY(waitForCommands(&commands));
+    QVERIFY(ordered);
+    for (int i = 0; i < kProducers; ++i)
+        QCOMPARE(last.at(i), kCommandsPerProducer - 1);
+    QCOMPARE(commands.executed(), static_cast<quint64>(kProducers * kCommandsPerProducer + 1));
+}
+
+void tst_CommandThread::runsFunctionsPostedBeforeStart()
+{
+    CommandThread commands;
+    int count = 0;
+    // More than the pool holds, the rest gets nodes of its own.
+    for (int i = 0; i < kBurst; ++i)
+        commands.post([&count]
+        {
+            ++count;
+        });
+    QVERIFY(commands.overflows() > 0);
+    commands.start();
+    QVERIFY(waitForCommands(&commands));
+    QCOMPARE(count, kBurst);
+}
+
+void tst_CommandThread::recyclesNodes()
+{
+    CommandThread commands;
+    commands.start();
+    // Bursts that fit into the pool never allocate, no matter how many
+    // commands are sent in total.
+    for (int round = 0; round < 100; ++round)
+    {
+        for (int i = 0; i < 100; ++i)
+            commands.post([] {});
+        QVERIFY(waitForCommands(&commands));
+    }
+    QCOMPARE(commands.overflows(), static_cast<quint64>(0));
+    QCOMPARE(commands.executed(), static_cast<quint64>(100 * 101));
+}
+
+void tst_CommandThread::keepsCommandsMovingWhileGuiStalls()
+{
+    CommandThread commands;
+    commands.start();
+    Histogram commandLatency, guiLatency;
+    GuiReceiver receiver(&guiLatency);
+    ChannelThread channel(&commands, &receiver, &commandLatency, kStall * 2);
+    QAtomicInteger<qint64> uiCommandRan = 0;
+    qint64 stallEnd = 0;
+    // Like the tray menu's pause action: a slot of the GUI thread queues a
+    // command and then keeps the thread busy.
+    QTimer::singleShot(kStall / 2, [&]
+    {
+        commands.post([&uiCommandRan]
+        {
+            uiCommandRan.store(now());
+        });
+        QElapsedTimer stall;
+        stall.start();
+        while (stall.elapsed() < kStall)
+            ;
+        stallEnd = now();
+    });
+    QEventLoop loop;
+    // Queued behind the channel's last call to the receiver.
+    connect(&channel, &QThread::finished, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+    channel.start();
+    loop.exec();
+    QVERIFY(waitForCommands(&commands));
+    qInfo("Command latency p50 %lld us, p99 %lld us, max %lld us",
+          commandLatency.percentile(0.5), commandLatency.percentile(0.99), commandLatency.max());
+    qInfo("Queued call latency p50 %lld us, p99 %lld us, max %lld us",
+          guiLatency.percentile(0.5), guiLatency.percentile(0.99), guiLatency.max());
+    QVERIFY(commandLatency.count() > 0);
+    QCOMPARE(commandLatency.count(), guiLatency.count());
+    // The stall really held up the GUI thread...
+    QVERIFY(guiLatency.max() >= kStall * 1000 / 2);
+    // ...but neither the command of the stalled slot nor the ones of the
+    // channel waited for it.
+    QVERIFY(uiCommandRan.load() != 0);
+    QVERIFY(uiCommandRan.load() < stallEnd);
+    QVERIFY(commandLatency.percentile(0.99) < kStall * 1000 / 4);
+}
+
+void tst_CommandThread::benchmarkPost()
+{
+    CommandThread commands;
+    commands.start();
+    QBENCHMARK
+    {
+        for (int i = 0; i < kBurst; ++i)
+            commands.post([] {});
+        QVERIFY(waitForCommands(&commands));
+    }
+}
+
+void tst_CommandThread::benchmarkQueuedCall()
+{
+    QThread thread;
+    QSemaphore done;
+    QueuedCounter counter(&done);
+    counter.moveToThread(&thread);
+    thread.start();
+    QBENCHMARK
+    {
+        for (int i = 0; i < kBurst; ++i)
+            QMetaObject::invokeMethod(&counter, "count", Qt::QueuedConnection);
+        QVERIFY(done.tryAcquire(1, kTimeout));
+    }
+    thread.quit();
+    thread.wait();
+}
+
+QTEST_GUILESS_MAIN(tst_CommandThread)
+
+#include "tst_commandthread.moc"
@@ -0,0 +1,8 @@
+TARGET = tst_controlprotocol
+QT = core
+TEMPLATE = app
+include(../tests.pri)
+HEADERS *= ../../ddmain/controlprotocol.h
+SOURCES *= \
+    tst_controlprotocol.cpp \
+    ../../ddmain/controlprotocol.cpp
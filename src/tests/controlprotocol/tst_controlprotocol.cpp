@@ -0,0 +1,185 @@
+#include "controlprotocol.h"
+
+#include <QtTest>
+
+Q_DECLARE_METATYPE(ControlProtocol::Message)
+
+static ControlProtocol::Message makeMessage(quint8 command, quint32 id, const QVariant &value = QVariant())
+{
+    ControlProtocol::Message message;
+    message.command = command;
+    message.id = id;
+    message.value = value;
+    return message;
+}
+
+class tst_ControlProtocol : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void responseCarriesStatus();
+    void rejectsForeignPayloads();
+    void rejectsTruncatedValues();
+    void waitsForWholeFrames();
+    void readsHeaderOfNewerVersion();
+    void keepsOrderOfPipelinedIds();
+    void benchmarkRequest();
+    void benchmarkPipeline();
+};
+
+void tst_ControlProtocol::roundTrip_data()
+{
+    QTest::addColumn<ControlProtocol::Message>("message");
+    QTest::newRow("no argument") << makeMessage(ControlProtocol::Play, 1);
+    QTest::newRow("position") << makeMessage(ControlProtocol::Seek, 2, Q_INT64_C(90000000000));
+    QTest::newRow("url") << makeMessage(ControlProtocol::SetUrl, 3, QStringLiteral("C:/Videos/Fj") + QChar(0x00E4) + QStringLiteral("rd 4K.mp4"));
+    QTest::newRow("toggle") << makeMessage(ControlProtocol::DebugOverlay, 4, true);
+    QVariantHash stats;
+    stats[QStringLiteral("quality.level")] = 2;
+    stats[QStringLiteral("quality.lastDecision")] = QStringLiteral("0 -> 1");
+    QTest::newRow("statistics") << makeMessage(ControlProtocol::Stats, 0xFFFFFFFFu, stats);
+}
+
+void tst_ControlProtocol::roundTrip()
+{
+    QFETCH(ControlProtocol::Message, message);
+    ControlProtocol::Message decoded;
+    QVERIFY(ControlProtocol::decodeRequest(ControlProtocol::encodeRequest(message), &decoded));
+    QCOMPARE(decoded.version, ControlProtocol::kVersion);
+    QCOMPARE(decoded.command, message.command);
+    QCOMPARE(decoded.id, message.id);
+    QCOMPARE(decoded.status, static_cast<quint8>(ControlProtocol::Ok));
+    QCOMPARE(decoded.value, message.value);
+    QVERIFY(ControlProtocol::decodeResponse(ControlProtocol::encodeResponse(message), &decoded));
+    QCOMPARE(decoded.id, message.id);
+    QCOMPARE(decoded.value, message.value);
+}
+
+void tst_ControlProtocol::responseCarriesStatus()
+{
+    ControlProtocol::Message response = makeMessage(ControlProtocol::Seek, 7);
+    response.status = ControlProtocol::BadRequest;
+    ControlProtocol::Message decoded;
+    QVERIFY(ControlProtocol::decodeResponse(ControlProtocol::encodeResponse(response), &decoded));
+    QCOMPARE(decoded.status, static_cast<quint8>(ControlProtocol::BadRequest));
+    QVERIFY(!decoded.value.isValid());
+}
+
+void tst_ControlProtocol::rejectsForeignPayloads()
+{
+    ControlProtocol::Message decoded;
+    // What QtSingleApplication sends for a second instance.
+    QVERIFY(!ControlProtocol::decodeRequest(QByteArrayLiteral("C:/Videos/wallpaper.mp4"), &decoded));
+    QVERIFY(!ControlProtocol::decodeRequest(QByteArray(), &decoded));
+    QVERIFY(!ControlProtocol::decodeRequest(ControlProtocol::magic(), &decoded));
+    // A request is one byte too short for a response.
+    QVERIFY(!ControlProtocol::decodeResponse(ControlProtocol::encodeRequest(makeMessage(ControlProtocol::Ping, 1)), &decoded));
+    QVERIFY(!ControlProtocol::decodeRequest(ControlProtocol::encodeRequest(makeMessage(ControlProtocol::Ping, 1)), nullptr));
+}
+
+void tst_ControlProtocol::rejectsTruncatedValues()
+{
+    const QByteArray payload = ControlProtocol::encodeRequest(makeMessage(ControlProtocol::SetUrl, 1, QStringLiteral("C:/Videos/wallpaper.mp4")));
+    const QByteArray header = ControlProtocol::encodeRequest(makeMessage(ControlProtocol::SetUrl, 1));
+    ControlProtocol::Message decoded;
+    // Only the header on its own is a request, one without an argument.
+    for (int size = 0; size < payload.size(); ++size)
+        if ((size != header.size()) && ControlProtocol::decodeRequest(payload.left(size), &decoded))
+            QFAIL(qPrintable(QStringLiteral("Accepted the first %1 of %2 bytes").arg(size).arg(payload.size())));
+    QVERIFY(ControlProtocol::decodeRequest(payload.left(header.size()), &decoded));
+    QVERIFY(!decoded.value.isValid());
+    QVERIFY(ControlProtocol::decodeRequest(payload, &decoded));
+}
+
+void tst_ControlProtocol::waitsForWholeFrames()
+{
+    const QByteArray payload = ControlProtocol::encodeRequest(makeMessage(ControlProtocol::Seek, 5, Q_INT64_C(1000)));
+    const QByteArray framed = ControlProtocol::frame(payload);
+    QCOMPARE(framed.size(), payload.size() + 4);
+    // Arriving a byte at a time, like from a slow socket.
+    QByteArray buffer, taken;
+    for (int i = 0; i < framed.size() - 1; ++i)
+    {
+        buffer.append(framed.at(i));
+        QVERIFY(!ControlProtocol::takeFrame(&buffer, &taken));
+        QCOMPARE(buffer.size(), i + 1);
+    }
+    buffer.append(framed.at(framed.size() - 1));
+    QVERIFY(ControlProtocol::takeFrame(&buffer, &taken));
+    QCOMPARE(taken, payload);
+    QVERIFY(buffer.isEmpty());
+    QVERIFY(!ControlProtocol::takeFrame(&buffer, &taken));
+}
+
+void tst_ControlProtocol::readsHeaderOfNewerVersion()
+{
+    // A future version may serialize its argument in a way this one
+    // can't read, the header is still enough to answer it.
+    QByteArray payload = ControlProtocol::encodeRequest(makeMessage(ControlProtocol::Seek, 9));
+    payload[4] = static_cast<char>(ControlProtocol::kVersion + 1);
+    payload.append("\xFF\xFE garbage", 10);
+    ControlProtocol::Message decoded;
+    QVERIFY(ControlProtocol::decodeRequest(payload, &decoded));
+    QCOMPARE(decoded.version, static_cast<quint8>(ControlProtocol::kVersion + 1));
+    QCOMPARE(decoded.command, static_cast<quint8>(ControlProtocol::Seek));
+    QCOMPARE(decoded.id, static_cast<quint32>(9));
+    QVERIFY(!decoded.value.isValid());
+    // The same bytes under the current version are an error.
+    payload[4] = static_cast<char>(ControlProtocol::kVersion);
+    QVERIFY(!ControlProtocol::decodeRequest(payload, &decoded));
+}
+
+void tst_ControlProtocol::keepsOrderOfPipelinedIds()
+{
+    QByteArray buffer;
+    for (quint32 id = 0; id < 100; ++id)
+        buffer += ControlProtocol::frame(ControlProtocol::encodeRequest(makeMessage(ControlProtocol::Ping, 1000 + id, id)));
+    // The last request is still on its way.
+    buffer.chop(1);
+    QByteArray payload;
+    ControlProtocol::Message decoded;
+    for (quint32 id = 0; id < 99; ++id)
+    {
+        QVERIFY(ControlProtocol::takeFrame(&buffer, &payload));
+        QVERIFY(ControlProtocol::decodeRequest(payload, &decoded));
+        QCOMPARE(decoded.id, 1000 + id);
+        QCOMPARE(decoded.value.toUInt(), id);
+    }
+    QVERIFY(!ControlProtocol::takeFrame(&buffer, &payload));
+}
+
+void tst_ControlProtocol::benchmarkRequest()
+{
+    const ControlProtocol::Message request = makeMessage(ControlProtocol::Seek, 1, Q_INT64_C(90000));
+    ControlProtocol::Message decoded;
+    QByteArray buffer, payload;
+    QBENCHMARK
+    {
+        buffer += ControlProtocol::frame(ControlProtocol::encodeRequest(request));
+        ControlProtocol::takeFrame(&buffer, &payload);
+        ControlProtocol::decodeRequest(payload, &decoded);
+    }
+}
+
+void tst_ControlProtocol::benchmarkPipeline()
+{
+    // A client that queues a thousand requests before reading anything.
+    QByteArray requests;
+    for (quint32 id = 0; id < 1000; ++id)
+        requests += ControlProtocol::frame(ControlProtocol::encodeRequest(makeMessage(ControlProtocol::Ping, id, id)));
+    ControlProtocol::Message decoded;
+    QByteArray payload;
+    QBENCHMARK
+    {
+        QByteArray buffer = requests;
+        while (ControlProtocol::takeFrame(&buffer, &payload))
+            ControlProtocol::decodeRequest(payload, &decoded);
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_ControlProtocol)
+
+#include "tst_controlprotocol.moc"
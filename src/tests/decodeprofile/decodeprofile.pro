@@ -0,0 +1,13 @@
+TARGET = tst_decodeprofile
+QT = core gui
+TEMPLATE = app
+include(../tests.pri)
+include(../../3rdparty/qtav/av.pri)
+LIBS *= \
+    -lavformat \
+    -lavcodec \
+    -lavutil
+HEADERS *= ../../ddmain/decodeprofile.h
+SOURCES *= \
+    tst_decodeprofile.cpp \
+    ../../ddmain/decodeprofile.cpp
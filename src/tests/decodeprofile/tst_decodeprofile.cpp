@@ -0,0 +1,253 @@
+#include "decodeprofile.h"
+
+#include <QMap>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QtAV/AVDemuxer.h>
+#include <QtAV/Packet.h>
+#include <QtAV/VideoDecoder.h>
+#include <QtAV/VideoFrame.h>
+#include <QtTest>
+
+#include <cmath>
+#include <limits>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+const int kWidth = 640;
+const int kHeight = 360;
+const int kFrameRate = 30;
+const int kFrameCount = 90;
+// Eco frames may look a little worse than fully decoded ones, not like
+// different pictures. Without the loop filter errors add up until the
+// next key frame, single frames may drift further than the average.
+const double kMinMeanPsnr = 30.0;
+const double kMinPsnr = 25.0;
+
+// Moving gradients and a square, with enough detail that the encoder
+// has to quantize and deblock.
+static void drawFrame(AVFrame *frame, int index)
+{
+    for (int y = 0; y < kHeight; ++y)
+        for (int x = 0; x < kWidth; ++x)
+        {
+            const bool square = (qAbs(x - index * 4 - 100) < 40) && (qAbs(y - 180) < 40);
+            const int texture = ((x * 7 + y * 13 + index * 3) % 23) * 2;
+            frame->data[0][y * frame->linesize[0] + x] = static_cast<uint8_t>(square ? 235 : (x + y + index * 2) % 200 + texture);
+        }
+    for (int y = 0; y < kHeight / 2; ++y)
+        for (int x = 0; x < kWidth / 2; ++x)
+        {
+            frame->data[1][y * frame->linesize[1] + x] = static_cast<uint8_t>(128 + (x - index) % 64 - 32);
+            frame->data[2][y * frame->linesize[2] + x] = static_cast<uint8_t>(128 + (y + index) % 64 - 32);
+        }
+}
+
+static bool writePackets(AVFormatContext *format, AVCodecContext *context, AVStream *stream, const AVFrame *frame)
+{
+    if (avcodec_send_frame(context, frame) < 0)
+        return false;
+    AVPacket *packet = av_packet_alloc();
+    bool ok = true;
+    while (ok && (avcodec_receive_packet(context, packet) == 0))
+    {
+        av_packet_rescale_ts(packet, context->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        ok = av_interleaved_write_frame(format, packet) >= 0;
+    }
+    av_packet_free(&packet);
+    return ok;
+}
+
+// H.264 with B-frames when FFmpeg was built with x264, MPEG-4 part 2
+// otherwise. The latter has no loop filter, but its B-frames are never
+// referenced.
+static bool encodeClip(const QByteArray &fileName)
+{
+    const AVCodec *codec = avcodec_find_encoder_by_name("libx264");
+    if (!codec)
+        codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    AVFormatContext *format = nullptr;
+    if (!codec || (avformat_alloc_output_context2(&format, nullptr, "matroska", fileName.constData()) < 0))
+        return false;
+    AVStream *stream = avformat_new_stream(format, nullptr);
+    AVCodecContext *context = avcodec_alloc_context3(codec);
+    context->width = kWidth;
+    context->height = kHeight;
+    context->time_base = AVRational{1, kFrameRate};
+    context->framerate = AVRational{kFrameRate, 1};
+    context->pix_fmt = AV_PIX_FMT_YUV420P;
+    context->gop_size = kFrameRate;
+    context->max_b_frames = 2;
+    context->bit_rate = 1000000;
+    if (format->oformat->flags & AVFMT_GLOBALHEADER)
+        context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    AVFrame *frame = av_frame_alloc();
+    frame->format = context->pix_fmt;
+    frame->width = kWidth;
+    frame->height = kHeight;
+    bool ok = (avcodec_open2(context, codec, nullptr) >= 0)
+            && (avcodec_parameters_from_context(stream->codecpar, context) >= 0)
+            && (av_frame_get_buffer(frame, 32) >= 0)
+            && (avio_open(&format->pb, fileName.constData(), AVIO_FLAG_WRITE) >= 0);
+    stream->time_base = context->time_base;
+    ok = ok && (avformat_write_header(format, nullptr) >= 0);
+    for (int i = 0; ok && (i < kFrameCount); ++i)
+    {
+        ok = av_frame_make_writable(frame) >= 0;
+        drawFrame(frame, i);
+        frame->pts = i;
+        ok = ok && writePackets(format, context, stream, frame);
+    }
+    ok = ok && writePackets(format, context, stream, nullptr) && (av_write_trailer(format) >= 0);
+    av_frame_free(&frame);
+    avcodec_free_context(&context);
+    if (format->pb)
+        avio_closep(&format->pb);
+    avformat_free_context(format);
+    return ok;
+}
+
+// Luma planes by timestamp in milliseconds.
+using Pictures = QMap<qint64, QByteArray>;
+
+static void keepPicture(const QtAV::VideoFrame &frame, Pictures *pictures)
+{
+    if (!frame.isValid())
+        return;
+    QByteArray luma(frame.width() * frame.height(), Qt::Uninitialized);
+    for (int y = 0; y < frame.height(); ++y)
+        memcpy(luma.data() + y * frame.width(), frame.constBits(0) + y * frame.bytesPerLine(0), static_cast<size_t>(frame.width()));
+    pictures->insert(qRound64(frame.timestamp() * 1000.0), luma);
+}
+
+// Decodes the whole file like the player's FFmpeg decoder does with the
+// given profile.
+static Pictures decodeClip(const QString &fileName, bool eco)
+{
+    Pictures pictures;
+    QtAV::AVDemuxer demuxer;
+    demuxer.setMedia(fileName);
+    if (!demuxer.load())
+        return pictures;
+    QScopedPointer<QtAV::VideoDecoder> decoder(QtAV::VideoDecoder::create(QtAV::VideoDecoderId_FFmpeg));
+    QVariantHash options;
+    DecodeProfile::addOptions(&options, eco);
+    decoder->setCodecContext(demuxer.videoCodecContext());
+    decoder->setOptions(options);
+    if (!decoder->open())
+        return pictures;
+    DecodeProfile::apply(decoder.data(), eco);
+    while (!demuxer.atEnd())
+    {
+        if (!demuxer.readFrame() || (demuxer.stream() != demuxer.videoStream()))
+            continue;
+        if (decoder->decode(demuxer.packet()))
+            keepPicture(decoder->frame(), &pictures);
+    }
+    // Frames the decoder held back for reordering.
+    while (decoder->decode(QtAV::Packet::createEOF()))
+    {
+        const QtAV::VideoFrame frame = decoder->frame();
+        if (!frame.isValid())
+            break;
+        keepPicture(frame, &pictures);
+    }
+    return pictures;
+}
+
+static double psnr(const QByteArray &expected, const QByteArray &actual)
+{
+    double squares = 0.0;
+    for (int i = 0; i < expected.size(); ++i)
+    {
+        const double difference = static_cast<uchar>(expected.at(i)) - static_cast<uchar>(actual.at(i));
+        squares += difference * difference;
+    }
+    if (squares == 0.0)
+        return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(255.0 * 255.0 * expected.size() / squares);
+}
+
+class tst_DecodeProfile : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void defaultAddsNothing();
+    void ecoLooksLikeFullDecode();
+    void benchmarkDecode_data();
+    void benchmarkDecode();
+
+private:
+    QTemporaryDir dir;
+    QString fileName;
+};
+
+void tst_DecodeProfile::initTestCase()
+{
+    QVERIFY(dir.isValid());
+    fileName = dir.filePath(QStringLiteral("clip.mkv"));
+    if (!encodeClip(QFile::encodeName(fileName)))
+        QSKIP("This FFmpeg build can't encode a test clip");
+}
+
+void tst_DecodeProfile::defaultAddsNothing()
+{
+    QVariantHash options;
+    options[QStringLiteral("CUDA")] = QVariantHash();
+    DecodeProfile::addOptions(&options, false);
+    QCOMPARE(options.count(), 1);
+    DecodeProfile::addOptions(&options, true);
+    QCOMPARE(options.count(), 3);
+    QVERIFY(options.contains(QStringLiteral("CUDA")));
+}
+
+void tst_DecodeProfile::ecoLooksLikeFullDecode()
+{
+    const Pictures full = decodeClip(fileName, false);
+    const Pictures eco = decodeClip(fileName, true);
+    QCOMPARE(full.count(), kFrameCount);
+    // Non-reference frames are left out, everything else is there.
+    QVERIFY(!eco.isEmpty());
+    QVERIFY2(eco.count() < full.count(), qPrintable(QStringLiteral("%1 of %2 frames decoded").arg(eco.count()).arg(full.count())));
+    double lowest = std::numeric_limits<double>::infinity();
+    double sum = 0.0;
+    for (auto it = eco.cbegin(); it != eco.cend(); ++it)
+    {
+        QVERIFY2(full.contains(it.key()), qPrintable(QStringLiteral("No frame at %1 ms").arg(it.key())));
+        // Identical frames count as 100 dB.
+        const double value = qMin(psnr(full.value(it.key()), it.value()), 100.0);
+        lowest = qMin(lowest, value);
+        sum += value;
+    }
+    const double mean = sum / eco.count();
+    qDebug("%d of %d frames decoded, PSNR %.1f dB on average, %.1f dB at the lowest", eco.count(), full.count(), mean, lowest);
+    QVERIFY2(mean >= kMinMeanPsnr, qPrintable(QStringLiteral("Average PSNR of %1 dB").arg(mean, 0, 'f', 1)));
+    QVERIFY2(lowest >= kMinPsnr, qPrintable(QStringLiteral("PSNR of %1 dB").arg(lowest, 0, 'f', 1)));
+}
+
+void tst_DecodeProfile::benchmarkDecode_data()
+{
+    QTest::addColumn<bool>("eco");
+    QTest::newRow("default") << false;
+    QTest::newRow("eco") << true;
+}
+
+void tst_DecodeProfile::benchmarkDecode()
+{
+    QFETCH(bool, eco);
+    QBENCHMARK
+    {
+        decodeClip(fileName, eco);
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_DecodeProfile)
+
+#include "tst_decodeprofile.moc"
@@ -0,0 +1,17 @@
+TARGET = tst_framepacer
+QT = core gui
+TEMPLATE = app
+CONFIG *= dd_test_metrics
+DEFINES *= \
+    DD_NO_LOGGING \
+    DD_NO_STAGE_TIMING
+include(../tests.pri)
+include(../../3rdparty/qtav/av.pri)
+LIBS *= \
+    -lUser32 \
+    -lDwmapi \
+    -lWinmm
+HEADERS *= ../../ddmain/framepacer.h
+SOURCES *= \
+    tst_framepacer.cpp \
+    ../../ddmain/framepacer.cpp
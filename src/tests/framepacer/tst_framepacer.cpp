@@ -0,0 +1,239 @@
+#include "framepacer.h"
+#include "metrics.h"
+
+#include <QImage>
+#include <QVector>
+#include <QtAV/VideoFrame.h>
+#include <QtTest>
+
+const qint64 kSecond = 1000000000;
+const qint64 kMillisecond = 1000000;
+const qint64 kRefresh60 = kSecond / 60;
+// The audio clock hands frames to the video thread a little early.
+const qint64 kLead = 2 * kMillisecond;
+
+// A display whose time only moves when the test or the pacer moves it.
+class SimulatedClock : public RefreshClock
+{
+public:
+    explicit SimulatedClock(qint64 interval, qint64 phase = 0) : interval(interval), phase(phase) {}
+
+    qint64 now() const override
+    {
+        return time;
+    }
+
+    qint64 refreshInterval() const override
+    {
+        return interval;
+    }
+
+    qint64 lastVsync() const override
+    {
+        return time - ((time - phase) % interval + interval) % interval;
+    }
+
+    void sleepUntil(qint64 target) override
+    {
+        // A sleep that wakes up late by a constant amount, like the timer
+        // of an idle machine.
+        time = qMax(time, target + oversleep);
+        ++sleeps;
+    }
+
+    void advanceTo(qint64 target)
+    {
+        time = qMax(time, target);
+    }
+
+public:
+    qint64 time = kSecond;
+    const qint64 interval;
+    const qint64 phase;
+    qint64 oversleep = 0;
+    int sleeps = 0;
+};
+
+static QtAV::VideoFrame makeFrame(qreal timestamp)
+{
+    QImage image(16, 16, QImage::Format_RGB32);
+    image.fill(Qt::gray);
+    QtAV::VideoFrame frame(image);
+    frame.setTimestamp(timestamp);
+    return frame;
+}
+
+class tst_FramePacer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void alternatesCadenceOf24On60();
+    void presentsOnVsync();
+    void dropsSupersededFrames();
+    void countsLateFrames();
+    void reanchorsAfterSeek();
+    void measuresJitterAtPresentation();
+    void ignoresRepaintsWithoutFrame();
+};
+
+void tst_FramePacer::init()
+{
+    MetricsRegistry::getInstance()->summary("dd_present_jitter_seconds", "")->reset();
+}
+
+void tst_FramePacer::alternatesCadenceOf24On60()
+{
+    SimulatedClock *clock = new SimulatedClock(kRefresh60);
+    FramePacer pacer(clock);
+    const qint64 start = clock->time;
+    QVector<qint64> presentations;
+    for (int i = 0; i < 48; ++i)
+    {
+        const qint64 pts = i * kSecond / 24;
+        clock->advanceTo(start + pts - kLead);
+        QCOMPARE(pacer.pace(pts / qreal(kSecond)), FramePacer::Presented);
+        presentations.append(clock->time);
+    }
+    quint64 repeats = 0;
+    for (int i = 1; i < presentations.count(); ++i)
+    {
+        const qint64 refreshes = (presentations.at(i) - presentations.at(i - 1) + kRefresh60 / 2) / kRefresh60;
+        // 3:2 pulldown, the same every time.
+        QCOMPARE(refreshes, static_cast<qint64>(i % 2 ? 3 : 2));
+        repeats += refreshes - 1;
+    }
+    const QVariantHash stats = pacer.statistics();
+    QCOMPARE(stats.value(QStringLiteral("pacing.repeated")).toULongLong(), repeats);
+    QCOMPARE(stats.value(QStringLiteral("pacing.anchors")).toULongLong(), static_cast<quint64>(1));
+    QCOMPARE(stats.value(QStringLiteral("pacing.late")).toULongLong(), static_cast<quint64>(0));
+}
+
+void tst_FramePacer::presentsOnVsync()
+{
+    const qint64 phase = 7 * kMillisecond;
+    SimulatedClock *clock = new SimulatedClock(kRefresh60, phase);
+    FramePacer pacer(clock);
+    const qint64 start = clock->time;
+    for (int i = 0; i < 30; ++i)
+    {
+        const qint64 pts = i * kSecond / 30;
+        clock->advanceTo(start + pts);
+        QCOMPARE(pacer.pace(pts / qreal(kSecond)), FramePacer::Presented);
+        QCOMPARE((clock->time - phase) % kRefresh60, static_cast<qint64>(0));
+    }
+    QVERIFY(clock->sleeps > 0);
+}
+
+void tst_FramePacer::dropsSupersededFrames()
+{
+    SimulatedClock *clock = new SimulatedClock(kRefresh60);
+    FramePacer pacer(clock);
+    const qint64 start = clock->time;
+    int delivered = 0;
+    // 120 fps on a 60 Hz display, every other frame would be drawn over
+    // before it is scanned out.
+    for (int i = 0; i < 120; ++i)
+    {
+        const qint64 pts = i * kSecond / 120;
+        clock->advanceTo(start + pts - kLead);
+        QtAV::VideoFrame frame = makeFrame(pts / qreal(kSecond));
+        pacer.apply(nullptr, &frame);
+        if (frame.isValid())
+            ++delivered;
+    }
+    // The first frame has slot 0 to itself, every later slot gets the
+    // frame rounded up into it and drops the one after.
+    const QVariantHash stats = pacer.statistics();
+    QCOMPARE(delivered, 61);
+    QCOMPARE(stats.value(QStringLiteral("pacing.presented")).toInt(), 61);
+    QCOMPARE(stats.value(QStringLiteral("pacing.superseded")).toInt(), 59);
+}
+
+void tst_FramePacer::countsLateFrames()
+{
+    SimulatedClock *clock = new SimulatedClock(kRefresh60);
+    FramePacer pacer(clock);
+    const qint64 start = clock->time;
+    for (int i = 0; i < 10; ++i)
+    {
+        const qint64 pts = i * kSecond / 30;
+        // The fifth frame arrives a refresh and a half after its slot, not
+        // late enough to lose the anchor.
+        clock->advanceTo(start + pts + (i == 5 ? kRefresh60 * 5 / 2 : 0));
+        pacer.pace(pts / qreal(kSecond));
+    }
+    const QVariantHash stats = pacer.statistics();
+    QCOMPARE(stats.value(QStringLiteral("pacing.late")).toInt(), 1);
+    QCOMPARE(stats.value(QStringLiteral("pacing.anchors")).toInt(), 1);
+}
+
+void tst_FramePacer::reanchorsAfterSeek()
+{
+    SimulatedClock *clock = new SimulatedClock(kRefresh60);
+    FramePacer pacer(clock);
+    const qint64 start = clock->time;
+    for (int i = 0; i < 5; ++i)
+    {
+        const qint64 pts = i * kSecond / 30;
+        clock->advanceTo(start + pts);
+        pacer.pace(pts / qreal(kSecond));
+    }
+    // Backwards, the first frame after the seek is presented right away.
+    QCOMPARE(pacer.pace(0.0), FramePacer::Presented);
+    QCOMPARE(pacer.statistics().value(QStringLiteral("pacing.anchors")).toInt(), 2);
+    // Far ahead.
+    QCOMPARE(pacer.pace(60.0), FramePacer::Presented);
+    QCOMPARE(pacer.statistics().value(QStringLiteral("pacing.anchors")).toInt(), 3);
+}
+
+void tst_FramePacer::measuresJitterAtPresentation()
+{
+    SimulatedClock *clock = new SimulatedClock(kRefresh60);
+    // Waking up late doesn't matter as long as every frame reaches the
+    // screen the same time after its slot.
+    clock->oversleep = 3 * kMillisecond;
+    FramePacer pacer(clock);
+    Histogram *jitter = MetricsRegistry::getInstance()->summary("dd_present_jitter_seconds", "");
+    const qint64 start = clock->time;
+    for (int i = 0; i < 60; ++i)
+    {
+        const qint64 pts = i * kSecond / 30;
+        clock->advanceTo(start + pts - kLead);
+        pacer.pace(pts / qreal(kSecond));
+        // The renderer needs 4 ms, frame 40 misses its vblank.
+        clock->time += 4 * kMillisecond + (i == 40 ? kRefresh60 : 0);
+        pacer.presented();
+    }
+    QCOMPARE(jitter->count(), static_cast<quint64>(59));
+    // Upper bounds of the histogram's buckets, zero reads as 1 us.
+    QVERIFY(jitter->percentile(0.5) <= 1);
+    // The late frame and the one after it are both a refresh off.
+    QVERIFY(jitter->max() >= kRefresh60 / 1000 - 1);
+    QVERIFY(jitter->percentile(0.95) < 1000);
+}
+
+void tst_FramePacer::ignoresRepaintsWithoutFrame()
+{
+    SimulatedClock *clock = new SimulatedClock(kRefresh60);
+    FramePacer pacer(clock);
+    Histogram *jitter = MetricsRegistry::getInstance()->summary("dd_present_jitter_seconds", "");
+    const qint64 start = clock->time;
+    for (int i = 0; i < 10; ++i)
+    {
+        const qint64 pts = i * kSecond / 30;
+        clock->advanceTo(start + pts);
+        pacer.pace(pts / qreal(kSecond));
+        pacer.presented();
+        // A resize repaints the same frame.
+        clock->time += kMillisecond;
+        pacer.presented();
+    }
+    QCOMPARE(jitter->count(), static_cast<quint64>(9));
+    QCOMPARE(jitter->max(), static_cast<qint64>(0));
+}
+
+QTEST_GUILESS_MAIN(tst_FramePacer)
+
+#include "tst_framepacer.moc"
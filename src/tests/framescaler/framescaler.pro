@@ -0,0 +1,15 @@
+TARGET = tst_framescaler
+QT = core gui
+TEMPLATE = app
+DEFINES *= \
+    DD_NO_LOGGING \
+    DD_NO_STAGE_TIMING
+include(../tests.pri)
+include(../../3rdparty/qtav/av.pri)
+LIBS *= \
+    -lavutil \
+    -lswscale
+HEADERS *= ../../ddmain/framescaler.h
+SOURCES *= \
+    tst_framescaler.cpp \
+    ../../ddmain/framescaler.cpp
@@ -0,0 +1,157 @@
+#include "framescaler.h"
+
+#include <QtTest>
+
+#include <cstring>
+
+// A flat YUV420P frame, the way software decoders hand them out.
+static QtAV::VideoFrame makeFrame(int width, int height, uchar luma = 0x80, uchar chroma = 0x80)
+{
+    const int lumaSize = width * height;
+    const int chromaSize = (width / 2) * (height / 2);
+    QByteArray data(lumaSize + 2 * chromaSize, Qt::Uninitialized);
+    uchar *bits = reinterpret_cast<uchar *>(data.data());
+    std::memset(bits, luma, lumaSize);
+    std::memset(bits + lumaSize, chroma, 2 * chromaSize);
+    // Before the frame shares the data, data() would detach afterwards.
+    uchar *planes[3] = {bits, bits + lumaSize, bits + lumaSize + chromaSize};
+    int lineSizes[3] = {width, width / 2, width / 2};
+    QtAV::VideoFrame frame(width, height, QtAV::VideoFormat(QtAV::VideoFormat::Format_YUV420P), data);
+    frame.setBits(planes);
+    frame.setBytesPerLine(lineSizes);
+    frame.setTimestamp(1.5);
+    frame.setColorSpace(QtAV::ColorSpace_BT709);
+    frame.setColorRange(QtAV::ColorRange_Limited);
+    return frame;
+}
+
+class tst_FrameScaler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void packsTargetSize();
+    void downscalesToCoverTarget();
+    void keepsFramesAtOrBelowTarget();
+    void setsUpContextOnlyOnChange();
+    void keepsPlaneContent();
+    void benchmarkScale();
+    void benchmarkVideoFrameTo();
+};
+
+void tst_FrameScaler::packsTargetSize()
+{
+    FrameScaler scaler;
+    scaler.setTargetSize(QSize(5120, 2880));
+    QCOMPARE(scaler.targetSize(), QSize(5120, 2880));
+    scaler.setTargetSize(QSize());
+    QVERIFY(scaler.targetSize().isEmpty());
+}
+
+void tst_FrameScaler::downscalesToCoverTarget()
+{
+    FrameScaler scaler;
+    scaler.setTargetSize(QSize(1920, 1080));
+    QtAV::VideoFrame frame = makeFrame(3840, 2160);
+    scaler.apply(nullptr, &frame);
+    QCOMPARE(frame.size(), QSize(1920, 1080));
+    QCOMPARE(frame.pixelFormat(), QtAV::VideoFormat::Format_YUV420P);
+    QCOMPARE(frame.timestamp(), 1.5);
+    QCOMPARE(frame.colorSpace(), QtAV::ColorSpace_BT709);
+    QCOMPARE(frame.colorRange(), QtAV::ColorRange_Limited);
+    QCOMPARE(scaler.lastFrame().size(), QSize(1920, 1080));
+    // A 21:9 window is covered, the renderer crops the rest.
+    scaler.setTargetSize(QSize(2560, 1080));
+    frame = makeFrame(3840, 2160);
+    scaler.apply(nullptr, &frame);
+    QCOMPARE(frame.size(), QSize(2560, 1440));
+}
+
+void tst_FrameScaler::keepsFramesAtOrBelowTarget()
+{
+    FrameScaler scaler;
+    scaler.setTargetSize(QSize(1920, 1080));
+    QtAV::VideoFrame frame = makeFrame(1280, 720);
+    const uchar *bits = frame.constBits(0);
+    scaler.apply(nullptr, &frame);
+    QCOMPARE(frame.size(), QSize(1280, 720));
+    QCOMPARE(frame.constBits(0), bits);
+    QCOMPARE(scaler.scalerSetups(), static_cast<quint64>(0));
+}
+
+void tst_FrameScaler::setsUpContextOnlyOnChange()
+{
+    FrameScaler scaler;
+    scaler.setTargetSize(QSize(1920, 1080));
+    for (int i = 0; i < 10; ++i)
+    {
+        QtAV::VideoFrame frame = makeFrame(3840, 2160);
+        scaler.apply(nullptr, &frame);
+        QCOMPARE(frame.size(), QSize(1920, 1080));
+    }
+    QCOMPARE(scaler.scalerSetups(), static_cast<quint64>(1));
+    // The window was resized.
+    scaler.setTargetSize(QSize(1280, 720));
+    for (int i = 0; i < 10; ++i)
+    {
+        QtAV::VideoFrame frame = makeFrame(3840, 2160);
+        scaler.apply(nullptr, &frame);
+    }
+    QCOMPARE(scaler.scalerSetups(), static_cast<quint64>(2));
+    // A new file with another resolution.
+    QtAV::VideoFrame frame = makeFrame(2560, 1440);
+    scaler.apply(nullptr, &frame);
+    QCOMPARE(frame.size(), QSize(1280, 720));
+    QCOMPARE(scaler.scalerSetups(), static_cast<quint64>(3));
+}
+
+void tst_FrameScaler::keepsPlaneContent()
+{
+    FrameScaler scaler;
+    scaler.setTargetSize(QSize(640, 360));
+    QtAV::VideoFrame frame = makeFrame(1920, 1080, 0x40, 0xC0);
+    scaler.apply(nullptr, &frame);
+    QCOMPARE(frame.size(), QSize(640, 360));
+    // Flat planes stay flat, whatever the filter, as long as every plane
+    // is read from and written to where it belongs.
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        const uchar expected = plane == 0 ? 0x40 : 0xC0;
+        const int width = plane == 0 ? 640 : 320;
+        const int height = plane == 0 ? 360 : 180;
+        for (int y = 0; y < height; ++y)
+        {
+            const uchar *line = frame.constBits(plane) + y * frame.bytesPerLine(plane);
+            for (int x = 0; x < width; ++x)
+                if (qAbs(line[x] - expected) > 1)
+                    QFAIL(qPrintable(QStringLiteral("Plane %1 is %2 at %3,%4").arg(plane).arg(line[x]).arg(x).arg(y)));
+        }
+    }
+}
+
+void tst_FrameScaler::benchmarkScale()
+{
+    FrameScaler scaler;
+    scaler.setTargetSize(QSize(1920, 1080));
+    const QtAV::VideoFrame source = makeFrame(3840, 2160);
+    QBENCHMARK
+    {
+        QtAV::VideoFrame frame = source;
+        scaler.apply(nullptr, &frame);
+    }
+}
+
+void tst_FrameScaler::benchmarkVideoFrameTo()
+{
+    // What the scaler did before, for comparison.
+    const QtAV::VideoFrame source = makeFrame(3840, 2160);
+    QBENCHMARK
+    {
+        const QtAV::VideoFrame frame = source.to(source.format(), QSize(1920, 1080));
+        Q_UNUSED(frame)
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_FrameScaler)
+
+#include "tst_framescaler.moc"
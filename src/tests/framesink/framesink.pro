@@ -0,0 +1,9 @@
+TARGET = tst_framesink
+QT = core gui
+TEMPLATE = app
+include(../tests.pri)
+include(../../3rdparty/qtav/av.pri)
+HEADERS *= ../../ddmain/framesinkrenderer.h
+SOURCES *= \
+    tst_framesink.cpp \
+    ../../ddmain/framesinkrenderer.cpp
@@ -0,0 +1,124 @@
+#include "framesinkrenderer.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+// A YUV420P frame whose lines are "stride" bytes apart, only the first
+// "width" bytes of a line are picture.
+static QtAV::VideoFrame makeFrame(int width, int height, int stride, uchar seed, qreal timestamp = 0.0)
+{
+    const int lumaSize = stride * height;
+    const int chromaSize = (stride / 2) * (height / 2);
+    QByteArray data(lumaSize + 2 * chromaSize, Qt::Uninitialized);
+    uchar *bits = reinterpret_cast<uchar *>(data.data());
+    for (int i = 0; i < data.size(); ++i)
+        bits[i] = 0xEE;
+    const int widths[3] = {width, width / 2, width / 2};
+    const int heights[3] = {height, height / 2, height / 2};
+    uchar *planes[3] = {bits, bits + lumaSize, bits + lumaSize + chromaSize};
+    int lineSizes[3] = {stride, stride / 2, stride / 2};
+    for (int plane = 0; plane < 3; ++plane)
+        for (int y = 0; y < heights[plane]; ++y)
+            for (int x = 0; x < widths[plane]; ++x)
+                planes[plane][y * lineSizes[plane] + x] = static_cast<uchar>(seed + plane * 31 + y * 7 + x);
+    QtAV::VideoFrame frame(width, height, QtAV::VideoFormat(QtAV::VideoFormat::Format_YUV420P), data);
+    frame.setBits(planes);
+    frame.setBytesPerLine(lineSizes);
+    frame.setTimestamp(timestamp);
+    return frame;
+}
+
+static QStringList readLines(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+        return QStringList();
+    return QString::fromLatin1(file.readAll()).split(QLatin1Char('\n'), QString::SkipEmptyParts);
+}
+
+class tst_FrameSink : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void rendererNeedsNoDisplay();
+    void hashIgnoresLinePadding();
+    void writesRecordsWhileRunning();
+    void recordsNothingWhenClosed();
+};
+
+void tst_FrameSink::rendererNeedsNoDisplay()
+{
+    // A console application, there is no screen to create a widget on.
+    FrameSinkRenderer renderer;
+    QVERIFY(renderer.widget() == nullptr);
+    QCOMPARE(renderer.id(), FrameSinkRenderer::rendererId);
+    QVERIFY(renderer.isSupported(QtAV::VideoFormat::Format_YUV420P));
+    QVERIFY(renderer.isSupported(QtAV::VideoFormat::Format_YUV420P10LE));
+    QVERIFY(!renderer.isSupported(QtAV::VideoFormat::Format_Invalid));
+    for (int i = 0; i < 5; ++i)
+        QVERIFY(renderer.receive(makeFrame(64, 32, 64, 1)));
+    QCOMPARE(renderer.frameCount(), static_cast<quint64>(5));
+}
+
+void tst_FrameSink::hashIgnoresLinePadding()
+{
+    const QByteArray tight = FrameSinkRecorder::hashFrame(makeFrame(64, 32, 64, 1));
+    const QByteArray padded = FrameSinkRecorder::hashFrame(makeFrame(64, 32, 96, 1));
+    const QByteArray other = FrameSinkRecorder::hashFrame(makeFrame(64, 32, 64, 2));
+    QVERIFY(!tight.isEmpty());
+    QCOMPARE(padded, tight);
+    QVERIFY(other != tight);
+}
+
+void tst_FrameSink::writesRecordsWhileRunning()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("frames.csv"));
+    FrameSinkRecorder recorder;
+    recorder.setHashing();
+    QVERIFY(recorder.open(fileName));
+    for (int i = 0; i < 3; ++i)
+    {
+        QtAV::VideoFrame frame = makeFrame(64, 32, 64, static_cast<uchar>(i), i / 30.0);
+        recorder.apply(nullptr, &frame);
+    }
+    // The next frame after the flush interval writes out everything so far.
+    QTest::qSleep(1100);
+    QtAV::VideoFrame frame = makeFrame(64, 32, 64, 3, 0.1);
+    recorder.apply(nullptr, &frame);
+    const QStringList lines = readLines(fileName);
+    QCOMPARE(lines.count(), 5);
+    QCOMPARE(lines.at(0), QStringLiteral("frame,timestamp,received_ms,hash"));
+    const QStringList first = lines.at(1).split(QLatin1Char(','));
+    QCOMPARE(first.count(), 4);
+    QCOMPARE(first.at(0), QStringLiteral("0"));
+    QCOMPARE(first.at(1), QStringLiteral("0.000000"));
+    QCOMPARE(first.at(3), QString::fromLatin1(FrameSinkRecorder::hashFrame(makeFrame(64, 32, 64, 0)).toHex()));
+    QCOMPARE(lines.at(4).section(QLatin1Char(','), 0, 0), QStringLiteral("3"));
+    QCOMPARE(recorder.frameCount(), static_cast<quint64>(4));
+}
+
+void tst_FrameSink::recordsNothingWhenClosed()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("frames.csv"));
+    FrameSinkRecorder recorder;
+    QtAV::VideoFrame frame = makeFrame(64, 32, 64, 1);
+    recorder.apply(nullptr, &frame);
+    QCOMPARE(recorder.frameCount(), static_cast<quint64>(0));
+    QVERIFY(recorder.open(fileName));
+    recorder.apply(nullptr, &frame);
+    recorder.close();
+    recorder.apply(nullptr, &frame);
+    const QStringList lines = readLines(fileName);
+    QCOMPARE(lines.count(), 2);
+    // Without hashing the last column stays empty.
+    QVERIFY(lines.at(1).endsWith(QLatin1Char(',')));
+}
+
+QTEST_GUILESS_MAIN(tst_FrameSink)
+
+#include "tst_framesink.moc"
@@ -0,0 +1,8 @@
+TARGET = tst_histogram
+QT = core
+TEMPLATE = app
+include(../tests.pri)
+HEADERS *= ../../ddmain/histogram.h
+SOURCES *= \
+    tst_histogram.cpp \
+    ../../ddmain/histogram.cpp
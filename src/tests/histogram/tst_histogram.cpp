@@ -0,0 +1,99 @@
+#include "histogram.h"
+
+#include <QThread>
+#include <QVector>
+#include <QtTest>
+
+const int kThreads = 4;
+const int kValuesPerThread = 100000;
+
+class Recorder : public QThread
+{
+public:
+    Recorder(Histogram *histogram, int id) : histogram(histogram), id(id) {}
+
+protected:
+    void run() override
+    {
+        // Every thread records the same values in another order, the
+        // largest one exactly once overall.
+        for (int i = 0; i < kValuesPerThread; ++i)
+            histogram->record((i * (id + 1)) % kValuesPerThread);
+        if (id == 0)
+            histogram->record(1234567);
+    }
+
+private:
+    Histogram *histogram;
+    const int id;
+};
+
+class tst_Histogram : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void tracksExactMaximum();
+    void resetClearsMaximum();
+    void keepsMaximumUnderContention();
+    void boundsPercentiles();
+};
+
+void tst_Histogram::tracksExactMaximum()
+{
+    Histogram histogram;
+    QCOMPARE(histogram.max(), static_cast<qint64>(0));
+    histogram.record(5);
+    histogram.record(1000003);
+    histogram.record(70);
+    // The bucket of a million is 1/16 of a power of two wide.
+    QCOMPARE(histogram.max(), static_cast<qint64>(1000003));
+    QVERIFY(histogram.percentile(1.0) > 1000003);
+    // Negative values count as zero.
+    histogram.record(-10);
+    QCOMPARE(histogram.max(), static_cast<qint64>(1000003));
+    QCOMPARE(histogram.count(), static_cast<quint64>(4));
+}
+
+void tst_Histogram::resetClearsMaximum()
+{
+    Histogram histogram;
+    histogram.record(500);
+    histogram.reset();
+    QCOMPARE(histogram.max(), static_cast<qint64>(0));
+    QCOMPARE(histogram.count(), static_cast<quint64>(0));
+    histogram.record(20);
+    QCOMPARE(histogram.max(), static_cast<qint64>(20));
+}
+
+void tst_Histogram::keepsMaximumUnderContention()
+{
+    Histogram histogram;
+    QVector<Recorder *> recorders;
+    for (int i = 0; i < kThreads; ++i)
+        recorders.append(new Recorder(&histogram, i));
+    for (Recorder *recorder : qAsConst(recorders))
+        recorder->start();
+    for (Recorder *recorder : qAsConst(recorders))
+        recorder->wait();
+    qDeleteAll(recorders);
+    QCOMPARE(histogram.count(), static_cast<quint64>(kThreads * kValuesPerThread + 1));
+    QCOMPARE(histogram.max(), static_cast<qint64>(1234567));
+}
+
+void tst_Histogram::boundsPercentiles()
+{
+    Histogram histogram;
+    for (int i = 1; i <= 1000; ++i)
+        histogram.record(i);
+    // Within a sub-bucket of the exact value.
+    QVERIFY(histogram.percentile(0.5) >= 500);
+    QVERIFY(histogram.percentile(0.5) <= 500 * 17 / 16);
+    QVERIFY(histogram.percentile(0.99) >= 990);
+    QVERIFY(histogram.percentile(0.99) <= 990 * 17 / 16);
+    QCOMPARE(histogram.max(), static_cast<qint64>(1000));
+}
+
+QTEST_GUILESS_MAIN(tst_Histogram)
+
+#include "tst_histogram.moc"
@@ -0,0 +1,12 @@
+TARGET = tst_mappedfileio
+QT = core
+TEMPLATE = app
+DEFINES *= \
+    DD_NO_LOGGING \
+    DD_NO_STAGE_TIMING
+include(../tests.pri)
+include(../../3rdparty/qtav/av.pri)
+HEADERS *= ../../ddmain/mappedfileio.h
+SOURCES *= \
+    tst_mappedfileio.cpp \
+    ../../ddmain/mappedfileio.cpp
@@ -0,0 +1,138 @@
+#include "mappedfileio.h"
+#include "utils.h"
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+// Larger than the prefetch window of the first pass.
+const qint64 kFileSize = 48 * 1024 * 1024;
+const qint64 kReadSize = 32 * 1024;
+
+static quint64 faultSamples = 0;
+
+// Every sample of the counter looks like one more page fault, so the
+// statistics tell how often it was sampled.
+namespace Utils
+{
+
+quint64 getProcessPageFaults()
+{
+    return ++faultSamples;
+}
+
+}
+
+static quint64 statistic(const char *name)
+{
+    return MappedFileIO::statistics().value(QLatin1String(name)).toULongLong();
+}
+
+class tst_MappedFileIO : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void readsWholeFile();
+    void samplesFaultsPerWindow();
+    void seeksWithinFile();
+    void emptyFileIsNotMapped();
+
+private:
+    QTemporaryDir dir;
+    QString fileName;
+    QByteArray content;
+};
+
+void tst_MappedFileIO::initTestCase()
+{
+    QVERIFY(dir.isValid());
+    content.resize(kFileSize);
+    quint32 state = 1;
+    for (int i = 0; i < content.size(); ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        content[i] = static_cast<char>(state >> 24);
+    }
+    fileName = dir.filePath(QStringLiteral("video.bin"));
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::WriteOnly));
+    QCOMPARE(file.write(content), kFileSize);
+}
+
+void tst_MappedFileIO::readsWholeFile()
+{
+    MappedFileIO io;
+    io.setUrl(fileName);
+    QVERIFY(io.isMapped());
+    QCOMPARE(io.size(), kFileSize);
+    QByteArray data(kFileSize, Qt::Uninitialized);
+    qint64 position = 0;
+    // Odd sizes, so that reads straddle pages.
+    while (position < kFileSize)
+    {
+        const qint64 length = io.read(data.data() + position, 4093);
+        QVERIFY(length > 0);
+        position += length;
+        QCOMPARE(io.position(), position);
+    }
+    QCOMPARE(io.read(data.data(), 4093), static_cast<qint64>(0));
+    QVERIFY(data == content);
+}
+
+void tst_MappedFileIO::samplesFaultsPerWindow()
+{
+    const quint64 faultsBefore = statistic("io.pageFaults");
+    const quint64 readsBefore = statistic("io.reads");
+    MappedFileIO io;
+    io.setUrl(fileName);
+    QVERIFY(io.isMapped());
+    QByteArray data(kReadSize, Qt::Uninitialized);
+    while (io.read(data.data(), kReadSize) > 0) {}
+    QCOMPARE(statistic("io.reads") - readsBefore, static_cast<quint64>(kFileSize / kReadSize));
+    // Once when mapped, once per prefetch and once at the end of the
+    // first pass, instead of twice per read.
+    const quint64 firstPass = statistic("io.pageFaults") - faultsBefore;
+    QVERIFY(firstPass > 0);
+    QVERIFY(firstPass < 5);
+    // The second pass is served from memory and not sampled at all.
+    QVERIFY(io.seek(0));
+    while (io.read(data.data(), kReadSize) > 0) {}
+    QCOMPARE(statistic("io.pageFaults") - faultsBefore, firstPass);
+    QCOMPARE(statistic("io.readErrors"), static_cast<quint64>(0));
+}
+
+void tst_MappedFileIO::seeksWithinFile()
+{
+    MappedFileIO io;
+    io.setUrl(fileName);
+    QVERIFY(io.isMapped());
+    char data[16];
+    QVERIFY(io.seek(-16, SEEK_END));
+    QCOMPARE(io.read(data, 64), static_cast<qint64>(16));
+    QCOMPARE(QByteArray(data, 16), content.right(16));
+    QVERIFY(io.seek(1000));
+    QVERIFY(io.seek(24, SEEK_CUR));
+    QCOMPARE(io.read(data, 16), static_cast<qint64>(16));
+    QCOMPARE(QByteArray(data, 16), content.mid(1024, 16));
+    QVERIFY(!io.seek(-1));
+    QVERIFY(!io.seek(1, SEEK_END));
+    QCOMPARE(io.position(), static_cast<qint64>(1040));
+}
+
+void tst_MappedFileIO::emptyFileIsNotMapped()
+{
+    const QString emptyName = dir.filePath(QStringLiteral("empty.bin"));
+    QFile file(emptyName);
+    QVERIFY(file.open(QFile::WriteOnly));
+    file.close();
+    MappedFileIO io;
+    io.setUrl(emptyName);
+    QVERIFY(!io.isMapped());
+    char data[16];
+    QCOMPARE(io.read(data, 16), static_cast<qint64>(-1));
+}
+
+QTEST_GUILESS_MAIN(tst_MappedFileIO)
+
+#include "tst_mappedfileio.moc"
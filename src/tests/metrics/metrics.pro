@@ -0,0 +1,10 @@
+TARGET = tst_metrics
+QT = core network
+TEMPLATE = app
+CONFIG *= dd_test_metrics
+DEFINES *= DD_NO_LOGGING
+include(../tests.pri)
+HEADERS *= ../../ddmain/metricsserver.h
+SOURCES *= \
+    tst_metrics.cpp \
+    ../../ddmain/metricsserver.cpp
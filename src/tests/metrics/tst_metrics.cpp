@@ -0,0 +1,106 @@
+#include "metrics.h"
+#include "metricsserver.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtTest>
+
+// The names of metrics that are not registered are logged as pointers.
+static QList<QByteArray> names;
+
+static const char *makeName(int index)
+{
+    names.append("dd_test_filler_" + QByteArray::number(index));
+    return names.last().constData();
+}
+
+static quint16 freePort()
+{
+    QTcpServer server;
+    if (!server.listen(QHostAddress::LocalHost))
+        return 0;
+    return server.serverPort();
+}
+
+class tst_Metrics : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void servesMetrics();
+    void dropsIdleClients();
+    void rejectsOtherTypes();
+    void survivesFullRegistry();
+};
+
+void tst_Metrics::servesMetrics()
+{
+    MetricsRegistry::getInstance()->counter("dd_test_served_total", "Served.")->set(42);
+    MetricsServer server;
+    const quint16 port = freePort();
+    QVERIFY(server.listen(port));
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, port);
+    QVERIFY(socket.waitForConnected());
+    socket.write("GET /metrics HTTP/1.0\r\n\r\n");
+    QByteArray response;
+    QTRY_VERIFY((response += socket.readAll()).contains("dd_test_served_total 42"));
+    QVERIFY(response.startsWith("HTTP/1.0 200 OK\r\n"));
+    QTRY_COMPARE(socket.state(), QAbstractSocket::UnconnectedState);
+}
+
+void tst_Metrics::dropsIdleClients()
+{
+    MetricsServer server;
+    const quint16 port = freePort();
+    QVERIFY(server.listen(port));
+    QTcpSocket silent, talking;
+    silent.connectToHost(QHostAddress::LocalHost, port);
+    talking.connectToHost(QHostAddress::LocalHost, port);
+    QVERIFY(silent.waitForConnected());
+    QVERIFY(talking.waitForConnected());
+    // Half a request, then nothing.
+    talking.write("GET /metrics HTTP/1.0\r\n");
+    QTest::qWait(3000);
+    QCOMPARE(silent.state(), QAbstractSocket::ConnectedState);
+    QTRY_COMPARE_WITH_TIMEOUT(silent.state(), QAbstractSocket::UnconnectedState, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(talking.state(), QAbstractSocket::UnconnectedState, 5000);
+}
+
+void tst_Metrics::rejectsOtherTypes()
+{
+    MetricsRegistry *registry = MetricsRegistry::getInstance();
+    MetricCounter *counter = registry->counter("dd_test_clash", "A counter.");
+    MetricGauge *gauge = registry->gauge("dd_test_clash", "A gauge of the same name.");
+    QVERIFY(gauge != nullptr);
+    QVERIFY(static_cast<void *>(gauge) != static_cast<void *>(counter));
+    gauge->set(1.5);
+    counter->add(3);
+    QCOMPARE(registry->counter("dd_test_clash", "")->value(), static_cast<quint64>(3));
+    QVERIFY(registry->prometheusText().contains("dd_test_clash 3\n"));
+}
+
+void tst_Metrics::survivesFullRegistry()
+{
+    MetricsRegistry *registry = MetricsRegistry::getInstance();
+    // Far more than the registry holds.
+    QList<MetricCounter *> counters;
+    for (int i = 0; i < 200; ++i)
+        counters.append(registry->counter(makeName(i), "Filler."));
+    for (MetricCounter *counter : qAsConst(counters))
+    {
+        QVERIFY(counter != nullptr);
+        counter->add();
+    }
+    Histogram *summary = registry->summary("dd_test_overflow_seconds", "Not registered.");
+    QVERIFY(summary != nullptr);
+    summary->record(10);
+    const QByteArray text = registry->prometheusText();
+    QVERIFY(text.contains("dd_test_filler_0 1\n"));
+    QVERIFY(!text.contains("dd_test_filler_199"));
+    QVERIFY(!text.contains("dd_test_overflow_seconds"));
+}
+
+QTEST_GUILESS_MAIN(tst_Metrics)
+
+#include "tst_metrics.moc"
@@ -0,0 +1,10 @@
+TARGET = tst_qtlocalpeer
+QT = core network
+TEMPLATE = app
+include(../tests.pri)
+INCLUDEPATH *= ../../3rdparty/qtsingleapplication
+DEPENDPATH *= ../../3rdparty/qtsingleapplication
+HEADERS *= ../../3rdparty/qtsingleapplication/qtlocalpeer.h
+SOURCES *= \
+    tst_qtlocalpeer.cpp \
+    ../../3rdparty/qtsingleapplication/qtlocalpeer.cpp
@@ -0,0 +1,192 @@
+#include "qtlocalpeer.h"
+
+#include <QDataStream>
+#include <QLocalSocket>
+#include <QThread>
+#include <QTimer>
+#include <QtTest>
+
+const int kClients = 1000;
+const int kSilentClients = 50;
+// The longest the event loop of the peer may be held up by the clients,
+// a blocking read of a single silent client would take seconds.
+const qint64 kMaxStall = 100;
+
+// Connects many clients from another thread, like as many instances of
+// the application started at once, plus some that never say anything.
+class Flood : public QThread
+{
+public:
+    Flood(const QString &serverName, int clients, int silentClients)
+        : serverName(serverName), clients(clients), silentClients(silentClients) {}
+
+    QAtomicInt connected = 0;
+    QAtomicInt acknowledged = 0;
+
+protected:
+    void run() override
+    {
+        QList<QLocalSocket *> silent, talking;
+        for (int i = 0; i < silentClients + clients; ++i)
+        {
+            auto socket = new QLocalSocket;
+            socket->connectToServer(serverName);
+            if (!socket->waitForConnected(5000))
+            {
+                delete socket;
+                continue;
+            }
+            connected.ref();
+            if (i < silentClients)
+            {
+                silent.append(socket);
+                continue;
+            }
+            QDataStream stream(socket);
+            const QByteArray message = "flood " + QByteArray::number(i);
+            stream.writeBytes(message.constData(), static_cast<uint>(message.size()));
+            socket->flush();
+            talking.append(socket);
+        }
+        for (QLocalSocket *socket : qAsConst(talking))
+        {
+            while ((socket->bytesAvailable() < 3) && socket->waitForReadyRead(10000)) {}
+            if (socket->read(3) == "ack")
+                acknowledged.ref();
+        }
+        qDeleteAll(talking);
+        qDeleteAll(silent);
+    }
+
+private:
+    const QString serverName;
+    const int clients;
+    const int silentClients;
+};
+
+// The longest time between two turns of the event loop.
+class StallMeter : public QObject
+{
+public:
+    StallMeter()
+    {
+        ticker.setTimerType(Qt::PreciseTimer);
+        ticker.setInterval(1);
+        connect(&ticker, &QTimer::timeout, this, [this]
+        {
+            const qint64 now = clock.elapsed();
+            maxStall = qMax(maxStall, now - last);
+            last = now;
+        });
+        clock.start();
+        ticker.start();
+    }
+
+    qint64 maxStall = 0;
+
+private:
+    QTimer ticker;
+    QElapsedTimer clock;
+    qint64 last = 0;
+};
+
+class tst_QtLocalPeer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void floodDoesntStallEventLoop();
+    void dropsUnfinishedMessages();
+    void clientIdsAreNotReused();
+
+private:
+    static QString peerId(const char *name);
+};
+
+QString tst_QtLocalPeer::peerId(const char *name)
+{
+    return QStringLiteral("tst-qtlocalpeer-%1-%2").arg(QLatin1String(name)).arg(QCoreApplication::applicationPid());
+}
+
+void tst_QtLocalPeer::floodDoesntStallEventLoop()
+{
+    QtLocalPeer peer(nullptr, peerId("flood"));
+    QVERIFY(!peer.isClient());
+    int received = 0;
+    connect(&peer, &QtLocalPeer::messageReceived, this, [&received](const QString &message)
+    {
+        if (message.startsWith(QLatin1String("flood ")))
+            ++received;
+    });
+    StallMeter meter;
+    Flood flood(peer.serverName(), kClients, kSilentClients);
+    flood.start();
+    QTRY_VERIFY_WITH_TIMEOUT(flood.isFinished(), 120000);
+    QCOMPARE(flood.connected.load(), kClients + kSilentClients);
+    QCOMPARE(flood.acknowledged.load(), kClients);
+    QCOMPARE(received, kClients);
+    qDebug("Longest event loop stall: %lld ms", meter.maxStall);
+    QVERIFY2(meter.maxStall < kMaxStall, qPrintable(QStringLiteral("Event loop stalled for %1 ms").arg(meter.maxStall)));
+}
+
+void tst_QtLocalPeer::dropsUnfinishedMessages()
+{
+    QtLocalPeer peer(nullptr, peerId("unfinished"));
+    QVERIFY(!peer.isClient());
+    QLocalSocket socket;
+    socket.connectToServer(peer.serverName());
+    QVERIFY(socket.waitForConnected(5000));
+    // Announces 100 bytes and sends 10.
+    QDataStream stream(&socket);
+    stream << static_cast<quint32>(100);
+    socket.write(QByteArray(10, 'x'));
+    socket.flush();
+    QTest::qWait(2000);
+    QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+    QTRY_COMPARE_WITH_TIMEOUT(socket.state(), QLocalSocket::UnconnectedState, 6000);
+}
+
+void tst_QtLocalPeer::clientIdsAreNotReused()
+{
+    QtLocalPeer peer(nullptr, peerId("ids"));
+    QVERIFY(!peer.isClient());
+    peer.setFramePrefix("FRM");
+    QList<quint64> received, disconnected;
+    connect(&peer, &QtLocalPeer::frameReceived, this, [&received](quint64 client, const QByteArray &frame)
+    {
+        if (frame == "FRM request")
+            received.append(client);
+    });
+    connect(&peer, &QtLocalPeer::clientDisconnected, this, [&disconnected](quint64 client)
+    {
+        disconnected.append(client);
+    });
+    const QByteArray request = "FRM request";
+    // Each client goes away before the next one connects, so that its
+    // socket is deleted and the next one may get the same address.
+    for (int i = 0; i < 20; ++i)
+    {
+        QLocalSocket socket;
+        socket.connectToServer(peer.serverName());
+        QVERIFY(socket.waitForConnected(5000));
+        QDataStream stream(&socket);
+        stream.writeBytes(request.constData(), static_cast<uint>(request.size()));
+        socket.flush();
+        QTRY_COMPARE(received.count(), i + 1);
+        const quint64 client = received.constLast();
+        if (i > 0)
+            QVERIFY(client != received.at(i - 1));
+        QVERIFY(peer.sendFrame(client, "FRM response"));
+        QTRY_VERIFY(socket.bytesAvailable() >= 4);
+        socket.disconnectFromServer();
+        QTRY_COMPARE(disconnected.count(), i + 1);
+        QCOMPARE(disconnected.constLast(), client);
+        // A late response for a client that is gone goes nowhere.
+        QVERIFY(!peer.sendFrame(client, "FRM late"));
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_QtLocalPeer)
+
+#include "tst_qtlocalpeer.moc"
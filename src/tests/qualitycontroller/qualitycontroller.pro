@@ -0,0 +1,9 @@
+TARGET = tst_qualitycontroller
+QT = core
+TEMPLATE = app
+DEFINES *= DD_NO_LOGGING
+include(../tests.pri)
+HEADERS *= ../../ddmain/qualitycontroller.h
+SOURCES *= \
+    tst_qualitycontroller.cpp \
+    ../../ddmain/qualitycontroller.cpp
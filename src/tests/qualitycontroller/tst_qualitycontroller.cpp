@@ -0,0 +1,163 @@
+#include "qualitycontroller.h"
+
+#include <QSignalSpy>
+#include <QThread>
+#include <QtTest>
+
+// Plays a 30 fps video, one second per step, with the given cost of a
+// frame and CPU usage of the process.
+class Playback
+{
+public:
+    explicit Playback(QualityController *controller) : controller(controller)
+    {
+        sample.playing = true;
+        sample.frameRate = 30.0;
+        sample.displayFrameRate = 30.0;
+    }
+
+    void play(int seconds, qint64 decodeTime, qint64 renderTime, qreal cpu, quint64 frames = 30)
+    {
+        for (int i = 0; i < seconds; ++i)
+        {
+            sample.time += 1000;
+            sample.frames += frames;
+            sample.decodeTime += decodeTime * static_cast<qint64>(frames);
+            // The widget is repainted twice as often as there are frames.
+            sample.renders += 2 * frames;
+            sample.renderTime += 2 * renderTime * static_cast<qint64>(frames);
+            sample.processCpuTime += static_cast<qint64>(cpu * 10.0 * qMax(1, QThread::idealThreadCount()));
+            controller->update(sample);
+        }
+    }
+
+    void pause()
+    {
+        QualityController::Sample paused = sample;
+        paused.playing = false;
+        controller->update(paused);
+    }
+
+public:
+    QualityController::Sample sample;
+
+private:
+    QualityController *controller;
+};
+
+class tst_QualityController : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void keepsLevelWithinBudget();
+    void stepsDownWhenFramesDontFit();
+    void stepsDownOverCpuBudget();
+    void stepsUpReluctantly();
+    void pauseForgetsHistory();
+    void ecoDecodingStretchesInterval();
+    void disablingRestoresFullQuality();
+};
+
+void tst_QualityController::keepsLevelWithinBudget()
+{
+    QualityController controller;
+    controller.setBudget(10);
+    Playback playback(&controller);
+    // 10 ms of a 33 ms frame, 5% CPU.
+    playback.play(30, 8000, 1000, 5.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FullQuality));
+    const QVariantHash stats = controller.statistics();
+    QCOMPARE(stats.value(QStringLiteral("quality.frameCost")).toReal(), 9000.0);
+    QVERIFY(qAbs(stats.value(QStringLiteral("quality.cpu")).toReal() - 5.0) < 0.01);
+}
+
+void tst_QualityController::stepsDownWhenFramesDontFit()
+{
+    QualityController controller;
+    controller.setBudget(25);
+    QSignalSpy spy(&controller, &QualityController::levelChanged);
+    Playback playback(&controller);
+    // 30 ms of a 33 ms frame, while the CPU share of the whole machine
+    // looks harmless.
+    playback.play(3, 28000, 1000, 2.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FullQuality));
+    playback.play(1, 28000, 1000, 2.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FastRendering));
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(controller.statistics().value(QStringLiteral("quality.lastDecision")).toString().contains(QStringLiteral("frame")));
+    playback.play(3, 28000, 1000, 2.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::EcoDecoding));
+}
+
+void tst_QualityController::stepsDownOverCpuBudget()
+{
+    QualityController controller;
+    controller.setBudget(5);
+    Playback playback(&controller);
+    playback.play(4, 4000, 1000, 12.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FastRendering));
+    QVERIFY(controller.statistics().value(QStringLiteral("quality.lastDecision")).toString().contains(QStringLiteral("CPU")));
+}
+
+void tst_QualityController::stepsUpReluctantly()
+{
+    QualityController controller;
+    controller.setBudget(10);
+    Playback playback(&controller);
+    playback.play(4, 28000, 1000, 5.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FastRendering));
+    // Below the limit, but not by enough.
+    playback.play(20, 20000, 1000, 5.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FastRendering));
+    playback.play(9, 5000, 1000, 5.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FastRendering));
+    playback.play(1, 5000, 1000, 5.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FullQuality));
+}
+
+void tst_QualityController::pauseForgetsHistory()
+{
+    QualityController controller;
+    controller.setBudget(10);
+    Playback playback(&controller);
+    playback.play(3, 28000, 1000, 5.0);
+    playback.pause();
+    // Time and CPU spent while paused don't count, and neither do the
+    // overloaded samples before it.
+    playback.sample.time += 60000;
+    playback.sample.processCpuTime += 60000;
+    playback.play(3, 28000, 1000, 5.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FullQuality));
+    playback.play(1, 28000, 1000, 5.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FastRendering));
+}
+
+void tst_QualityController::ecoDecodingStretchesInterval()
+{
+    QualityController controller;
+    controller.setBudget(25);
+    Playback playback(&controller);
+    playback.play(7, 28000, 1000, 2.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::EcoDecoding));
+    // Every other frame is left out, the rest have two intervals each. A
+    // frame longer than one interval is no reason to step down further.
+    playback.play(20, 40000, 1000, 2.0, 15);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::EcoDecoding));
+    QVERIFY(qAbs(controller.statistics().value(QStringLiteral("quality.frameLoad")).toReal() - 41000.0 / 66666.7) < 0.001);
+}
+
+void tst_QualityController::disablingRestoresFullQuality()
+{
+    QualityController controller;
+    controller.setBudget(10);
+    Playback playback(&controller);
+    playback.play(4, 28000, 1000, 5.0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FastRendering));
+    controller.setBudget(0);
+    QCOMPARE(controller.level(), static_cast<int>(QualityController::FullQuality));
+}
+
+QTEST_GUILESS_MAIN(tst_QualityController)
+
+#include "tst_qualitycontroller.moc"
@@ -0,0 +1,10 @@
+TARGET = tst_rendererwarmup
+QT = core gui widgets opengl
+TEMPLATE = app
+include(../tests.pri)
+include(../../3rdparty/qtav/av.pri)
+include(../../3rdparty/qtav/avwidgets.pri)
+HEADERS *= ../../ddmain/rendererwarmup.h
+SOURCES *= \
+    tst_rendererwarmup.cpp \
+    ../../ddmain/rendererwarmup.cpp
@@ -0,0 +1,134 @@
+#include "rendererwarmup.h"
+
+#include <QApplication>
+#include <QImage>
+#include <QtAV/Filter.h>
+#include <QtAVWidgets/WidgetRenderer.h>
+#include <QtTest>
+
+static QtAV::VideoFrame makeFrame(const QColor &color)
+{
+    QImage image(320, 180, QImage::Format_RGB32);
+    image.fill(color);
+    return QtAV::VideoFrame(image);
+}
+
+static QColor centerColor(QWidget *widget)
+{
+    const QImage image = widget->grab().toImage();
+    return image.pixelColor(image.width() / 2, image.height() / 2);
+}
+
+class Overlay : public QtAV::VideoFilter
+{
+protected:
+    void process(QtAV::Statistics *statistics, QtAV::VideoFrame *frame) override
+    {
+        Q_UNUSED(statistics)
+        Q_UNUSED(frame)
+    }
+};
+
+// A window with a renderer that shows a frame, like the player window
+// before a renderer switch.
+class Window
+{
+public:
+    Window()
+    {
+        container.resize(640, 360);
+        oldRenderer.widget()->setParent(&container);
+        oldRenderer.widget()->setGeometry(container.rect());
+        container.show();
+    }
+
+public:
+    QWidget container;
+    QtAV::WidgetRenderer oldRenderer;
+};
+
+class tst_RendererWarmUp : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void prefersLastDecodedFrame();
+    void grabsOldRendererWithoutFrame();
+    void restoresOverlays();
+    void swapsWithoutBlackFrame();
+    void swapsWhilePaused();
+};
+
+void tst_RendererWarmUp::prefersLastDecodedFrame()
+{
+    Window window;
+    const QtAV::VideoFrame frame = makeFrame(Qt::red);
+    const QtAV::VideoFrame picture = RendererWarmUp::currentPicture(frame, window.oldRenderer.widget(), {});
+    QCOMPARE(picture.constBits(0), frame.constBits(0));
+}
+
+void tst_RendererWarmUp::grabsOldRendererWithoutFrame()
+{
+    // Zero-copy hardware frames are never kept, the old renderer is the
+    // only one that knows what is on screen.
+    Window window;
+    window.oldRenderer.receive(makeFrame(Qt::red));
+    const QtAV::VideoFrame picture = RendererWarmUp::currentPicture(QtAV::VideoFrame(), window.oldRenderer.widget(), {});
+    QVERIFY(picture.isValid());
+    const QImage image = picture.toImage();
+    QCOMPARE(image.pixelColor(image.width() / 2, image.height() / 2), QColor(Qt::red));
+    // Nothing to grab from a hidden renderer.
+    window.container.hide();
+    QVERIFY(!RendererWarmUp::currentPicture(QtAV::VideoFrame(), window.oldRenderer.widget(), {}).isValid());
+}
+
+void tst_RendererWarmUp::restoresOverlays()
+{
+    Window window;
+    window.oldRenderer.receive(makeFrame(Qt::red));
+    Overlay subtitles, debugOverlay;
+    debugOverlay.setEnabled(false);
+    RendererWarmUp::currentPicture(QtAV::VideoFrame(), window.oldRenderer.widget(), {&subtitles, &debugOverlay});
+    QVERIFY(subtitles.isEnabled());
+    QVERIFY(!debugOverlay.isEnabled());
+}
+
+void tst_RendererWarmUp::swapsWithoutBlackFrame()
+{
+    Window window;
+    window.oldRenderer.receive(makeFrame(Qt::red));
+    QtAV::WidgetRenderer newRenderer;
+    RendererWarmUp::warmUp(&newRenderer, window.oldRenderer.widget(), makeFrame(Qt::blue));
+    QCOMPARE(newRenderer.widget()->parentWidget(), &window.container);
+    QCOMPARE(newRenderer.widget()->geometry(), window.oldRenderer.widget()->geometry());
+    QVERIFY(newRenderer.widget()->isVisible());
+    // Still behind the old renderer.
+    QCOMPARE(centerColor(&window.container), QColor(Qt::red));
+    window.oldRenderer.widget()->hide();
+    QCOMPARE(centerColor(&window.container), QColor(Qt::blue));
+}
+
+void tst_RendererWarmUp::swapsWhilePaused()
+{
+    // No new frame arrives, the new renderer has to show the old picture
+    // on its own.
+    Window window;
+    window.oldRenderer.receive(makeFrame(Qt::green));
+    QtAV::WidgetRenderer newRenderer;
+    const QtAV::VideoFrame picture = RendererWarmUp::currentPicture(QtAV::VideoFrame(), window.oldRenderer.widget(), {});
+    RendererWarmUp::warmUp(&newRenderer, window.oldRenderer.widget(), picture);
+    window.oldRenderer.widget()->hide();
+    QCOMPARE(centerColor(&window.container), QColor(Qt::green));
+}
+
+int main(int argc, char *argv[])
+{
+    // The swap is tested without a display.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    tst_RendererWarmUp test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_rendererwarmup.moc"
@@ -0,0 +1,10 @@
+TARGET = tst_shadercache
+QT = core gui
+TEMPLATE = app
+DEFINES *= DD_NO_LOGGING
+include(../tests.pri)
+include(../../3rdparty/qtav/av.pri)
+HEADERS *= ../../ddmain/shadercache.h
+SOURCES *= \
+    tst_shadercache.cpp \
+    ../../ddmain/shadercache.cpp
@@ -0,0 +1,166 @@
+#include "shadercache.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QScopedPointer>
+#include <QtAV/OpenGLVideo.h>
+#include <QtAV/VideoFrame.h>
+#include <QtTest>
+
+const QSize kFrameSize(64, 32);
+
+Q_DECLARE_METATYPE(QtAV::VideoFormat::PixelFormat)
+
+// A flat mid grey frame, limited range.
+static QtAV::VideoFrame makeFrame(QtAV::VideoFormat::PixelFormat format)
+{
+    const int width = kFrameSize.width();
+    const int height = kFrameSize.height();
+    QByteArray data(width * height * 3 / 2, static_cast<char>(128));
+    memset(data.data(), 126, static_cast<size_t>(width * height));
+    uchar *luma = reinterpret_cast<uchar *>(data.data());
+    uchar *chroma = luma + width * height;
+    QtAV::VideoFrame frame(width, height, QtAV::VideoFormat(format), data);
+    if (format == QtAV::VideoFormat::Format_NV12)
+    {
+        uchar *planes[2] = {luma, chroma};
+        int lineSizes[2] = {width, width};
+        frame.setBits(planes);
+        frame.setBytesPerLine(lineSizes);
+    }
+    else
+    {
+        uchar *planes[3] = {luma, chroma, chroma + width * height / 4};
+        int lineSizes[3] = {width, width / 2, width / 2};
+        frame.setBits(planes);
+        frame.setBytesPerLine(lineSizes);
+    }
+    frame.setColorSpace(QtAV::ColorSpace_BT709);
+    frame.setColorRange(QtAV::ColorRange_Limited);
+    return frame;
+}
+
+static quint64 statistic(const char *name)
+{
+    return ShaderCache::statistics().value(QLatin1String(name)).toULongLong();
+}
+
+class tst_ShaderCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void secondRendererLoadsFromCache_data();
+    void secondRendererLoadsFromCache();
+
+private:
+    // Draws a frame the way a newly created renderer does: its own
+    // context, its own OpenGLVideo and a shader built from scratch.
+    bool render(QtAV::VideoFormat::PixelFormat format, qint64 *time);
+
+private:
+    QOffscreenSurface surface;
+};
+
+void tst_ShaderCache::initTestCase()
+{
+    QDir(ShaderCache::cacheDirectory()).removeRecursively();
+    surface.create();
+    QOpenGLContext context;
+    if (!context.create() || !context.makeCurrent(&surface))
+        QSKIP("No OpenGL context");
+    qDebug("Rendering with %s", reinterpret_cast<const char *>(context.functions()->glGetString(GL_RENDERER)));
+    const bool available = ShaderCache::isAvailable();
+    context.doneCurrent();
+    if (!available)
+        QSKIP("The driver can't hand out program binaries");
+}
+
+void tst_ShaderCache::cleanupTestCase()
+{
+    QDir(ShaderCache::cacheDirectory()).removeRecursively();
+}
+
+bool tst_ShaderCache::render(QtAV::VideoFormat::PixelFormat format, qint64 *time)
+{
+    QOpenGLContext context;
+    if (!context.create() || !context.makeCurrent(&surface))
+        return false;
+    bool drawn = false;
+    {
+        QOpenGLFramebufferObject framebuffer(kFrameSize);
+        framebuffer.bind();
+        context.functions()->glViewport(0, 0, kFrameSize.width(), kFrameSize.height());
+        QElapsedTimer timer;
+        timer.start();
+        QScopedPointer<QtAV::OpenGLVideo> video(new QtAV::OpenGLVideo);
+        video->setOpenGLContext(&context);
+        video->setViewport(QRectF(QPointF(), kFrameSize));
+        ShaderCache::install(video.data());
+        video->setCurrentFrame(makeFrame(format));
+        video->render();
+        context.functions()->glFinish();
+        *time = timer.nsecsElapsed() / 1000;
+        // Limited range 126 is about 128 on screen.
+        const QRgb pixel = framebuffer.toImage().pixel(kFrameSize.width() / 2, kFrameSize.height() / 2);
+        drawn = (qAbs(qGreen(pixel) - 128) <= 3) && (qAbs(qRed(pixel) - 128) <= 3) && (qAbs(qBlue(pixel) - 128) <= 3);
+        framebuffer.release();
+        // The shader and its program go with the video, while the
+        // context is still current.
+        video.reset();
+    }
+    context.doneCurrent();
+    return drawn;
+}
+
+void tst_ShaderCache::secondRendererLoadsFromCache_data()
+{
+    QTest::addColumn<QtAV::VideoFormat::PixelFormat>("format");
+    QTest::newRow("YUV420P") << QtAV::VideoFormat::Format_YUV420P;
+    QTest::newRow("NV12") << QtAV::VideoFormat::Format_NV12;
+}
+
+void tst_ShaderCache::secondRendererLoadsFromCache()
+{
+    QFETCH(QtAV::VideoFormat::PixelFormat, format);
+    const quint64 hits = statistic("shaders.cacheHits");
+    const quint64 misses = statistic("shaders.cacheMisses");
+    const quint64 buildTime = statistic("shaders.buildTime");
+    const quint64 loadTime = statistic("shaders.loadTime");
+    qint64 firstTime = 0, secondTime = 0;
+    QVERIFY(render(format, &firstTime));
+    // Each pixel format has a program of its own, the first renderer
+    // compiles and links it.
+    QCOMPARE(statistic("shaders.cacheHits"), hits);
+    QVERIFY(statistic("shaders.cacheMisses") > misses);
+    const quint64 built = statistic("shaders.cacheMisses") - misses;
+    QVERIFY(!QDir(ShaderCache::cacheDirectory()).entryList(QDir::Files).isEmpty());
+    QVERIFY(render(format, &secondTime));
+    QCOMPARE(statistic("shaders.cacheMisses") - misses, built);
+    QCOMPARE(statistic("shaders.cacheHits") - hits, built);
+    QCOMPARE(statistic("shaders.rejectedBinaries"), static_cast<quint64>(0));
+    const quint64 building = statistic("shaders.buildTime") - buildTime;
+    const quint64 loading = statistic("shaders.loadTime") - loadTime;
+    qDebug("Programs built in %llu us, loaded in %llu us, first frame in %lld us, then in %lld us",
+           building, loading, firstTime, secondTime);
+    QVERIFY2(loading < building, qPrintable(QStringLiteral("Loading took %1 us, building %2 us").arg(loading).arg(building)));
+}
+
+int main(int argc, char *argv[])
+{
+    // Runs on machines without a GPU, with the llvmpipe build of Mesa that
+    // Qt ships as opengl32sw.dll.
+    QCoreApplication::setAttribute(Qt::AA_UseSoftwareOpenGL);
+    QGuiApplication app(argc, argv);
+    tst_ShaderCache test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_shadercache.moc"
@@ -0,0 +1,17 @@
+#include "utils.h"
+
+// Only what the metrics registry asks for when collecting.
+namespace Utils
+{
+
+qint64 getProcessCpuTime()
+{
+    return 0;
+}
+
+quint64 getProcessWorkingSet()
+{
+    return 0;
+}
+
+}
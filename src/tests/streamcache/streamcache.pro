@@ -0,0 +1,12 @@
+TARGET = tst_streamcache
+QT = core network
+TEMPLATE = app
+DEFINES *= \
+    DD_NO_LOGGING \
+    DD_NO_STAGE_TIMING
+include(../tests.pri)
+include(../../3rdparty/qtav/av.pri)
+HEADERS *= ../../ddmain/streamcache.h
+SOURCES *= \
+    tst_streamcache.cpp \
+    ../../ddmain/streamcache.cpp
@@ -0,0 +1,267 @@
+#include "streamcache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QHash>
+#include <QSemaphore>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtTest>
+
+const qint64 kMegabyte = 1024 * 1024;
+const int kChunkSize = 64 * 1024;
+
+static QByteArray makeContent(qint64 size, quint32 seed)
+{
+    QByteArray content(static_cast<int>(size), Qt::Uninitialized);
+    quint32 state = seed;
+    for (int i = 0; i < content.size(); ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        content[i] = static_cast<char>(state >> 24);
+    }
+    return content;
+}
+
+static QByteArray readAll(StreamCacheIO *io, int *reads = nullptr)
+{
+    QByteArray data;
+    QByteArray chunk(kChunkSize, Qt::Uninitialized);
+    for (;;)
+    {
+        const qint64 length = io->read(chunk.data(), chunk.size());
+        if (length <= 0)
+            break;
+        data.append(chunk.constData(), static_cast<int>(length));
+        if (reads)
+            ++*reads;
+    }
+    return data;
+}
+
+static quint64 counter(const char *name)
+{
+    return StreamCacheIO::statistics().value(QLatin1String(name)).toULongLong();
+}
+
+static QString cacheKey(const QString &url)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+// Serves the same content under every path. With ranges disabled it
+// answers every request with the whole content, like a server that
+// ignores the Range header. Runs in its own thread, reads of the cache
+// block the test's thread while they wait for the network.
+class HttpServer : public QThread
+{
+public:
+    HttpServer(const QByteArray &content, bool ranges) : content(content), ranges(ranges)
+    {
+        start();
+        ready.acquire();
+    }
+
+    ~HttpServer() override
+    {
+        quit();
+        wait();
+    }
+
+    QString url(const QString &path) const
+    {
+        return QStringLiteral("http://127.0.0.1:%1/%2").arg(serverPort.load()).arg(path);
+    }
+
+public:
+    QAtomicInteger<quint64> requests = 0;
+    QAtomicInteger<quint64> rangeRequests = 0;
+    QAtomicInteger<quint64> bytesServed = 0;
+
+protected:
+    void run() override
+    {
+        // Outlives the server, whose sockets still report their
+        // disconnection while it is destroyed.
+        QHash<QTcpSocket *, QByteArray> pending;
+        QTcpServer server;
+        server.listen(QHostAddress::LocalHost);
+        serverPort.store(server.serverPort());
+        connect(&server, &QTcpServer::newConnection, [&]
+        {
+            while (QTcpSocket *socket = server.nextPendingConnection())
+            {
+                connect(socket, &QTcpSocket::readyRead, [&, socket]
+                {
+                    pending[socket] += socket->readAll();
+                    serve(socket, &pending[socket]);
+                });
+                connect(socket, &QTcpSocket::disconnected, [&, socket]
+                {
+                    pending.remove(socket);
+                    socket->deleteLater();
+                });
+            }
+        });
+        ready.release();
+        exec();
+    }
+
+private:
+    void serve(QTcpSocket *socket, QByteArray *buffer)
+    {
+        int end = 0;
+        while ((end = buffer->indexOf("\r\n\r\n")) >= 0)
+        {
+            const QByteArray head = buffer->left(end);
+            buffer->remove(0, end + 4);
+            requests.fetchAndAddRelaxed(1);
+            const qint64 size = content.size();
+            qint64 first = 0, last = size - 1;
+            bool partial = false;
+            for (const QByteArray &line : head.split('\n'))
+            {
+                const QByteArray field = line.trimmed();
+                if (!field.toLower().startsWith("range: bytes="))
+                    continue;
+                rangeRequests.fetchAndAddRelaxed(1);
+                if (!ranges)
+                    continue;
+                const QByteArray range = field.mid(13);
+                const int dash = range.indexOf('-');
+                first = range.left(dash).toLongLong();
+                if (dash + 1 < range.size())
+                    last = qMin(last, range.mid(dash + 1).toLongLong());
+                partial = true;
+            }
+            if (first >= size)
+            {
+                socket->write("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\n\r\n");
+                continue;
+            }
+            const qint64 length = last - first + 1;
+            QByteArray response = partial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+            if (partial)
+                response += "Content-Range: bytes " + QByteArray::number(first) + '-' + QByteArray::number(last)
+                        + '/' + QByteArray::number(size) + "\r\n";
+            response += "Content-Length: " + QByteArray::number(length) + "\r\nETag: \"1\"\r\n\r\n";
+            socket->write(response);
+            socket->write(content.mid(static_cast<int>(first), static_cast<int>(length)));
+            bytesServed.fetchAndAddRelaxed(static_cast<quint64>(length));
+        }
+    }
+
+private:
+    const QByteArray content;
+    const bool ranges;
+    QSemaphore ready;
+    QAtomicInt serverPort = 0;
+};
+
+class tst_StreamCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanupTestCase();
+    void fetchesEveryByteOnce();
+    void replaysFromDisk();
+    void checksRangeSupportPerUrl();
+    void evictsLeastRecentlyUsed();
+};
+
+void tst_StreamCache::init()
+{
+    QDir(StreamCacheIO::cacheDirectory()).removeRecursively();
+    StreamCacheIO::setCacheLimit(1024 * kMegabyte);
+}
+
+void tst_StreamCache::cleanupTestCase()
+{
+    QDir(StreamCacheIO::cacheDirectory()).removeRecursively();
+}
+
+void tst_StreamCache::fetchesEveryByteOnce()
+{
+    // Not a whole number of blocks, the last one is short.
+    const QByteArray content = makeContent(5 * StreamCacheIO::kBlockSize + StreamCacheIO::kBlockSize / 2, 1);
+    HttpServer server(content, true);
+    const quint64 fetched = counter("cache.bytesFetched");
+    StreamCacheIO io;
+    io.setUrl(server.url(QStringLiteral("video.mp4")));
+    QCOMPARE(readAll(&io), content);
+    QVERIFY(io.isComplete());
+    QCOMPARE(io.size(), static_cast<qint64>(content.size()));
+    QCOMPARE(counter("cache.bytesFetched") - fetched, static_cast<quint64>(content.size()));
+    QCOMPARE(server.bytesServed.load(), static_cast<quint64>(content.size()));
+    QVERIFY(server.rangeRequests.load() > 0);
+}
+
+void tst_StreamCache::replaysFromDisk()
+{
+    const QByteArray content = makeContent(3 * StreamCacheIO::kBlockSize, 2);
+    HttpServer server(content, true);
+    const QString url = server.url(QStringLiteral("loop.mp4"));
+    {
+        StreamCacheIO io;
+        io.setUrl(url);
+        QCOMPARE(readAll(&io), content);
+    }
+    const quint64 requests = server.requests.load();
+    const quint64 hits = counter("cache.hits");
+    const quint64 misses = counter("cache.misses");
+    const quint64 fetched = counter("cache.bytesFetched");
+    // The next loop of the wallpaper.
+    StreamCacheIO io;
+    io.setUrl(url);
+    int reads = 0;
+    QCOMPARE(readAll(&io, &reads), content);
+    QCOMPARE(counter("cache.hits") - hits, static_cast<quint64>(reads));
+    QCOMPARE(counter("cache.misses") - misses, static_cast<quint64>(0));
+    QCOMPARE(counter("cache.bytesFetched") - fetched, static_cast<quint64>(0));
+    QCOMPARE(server.requests.load(), requests);
+}
+
+void tst_StreamCache::checksRangeSupportPerUrl()
+{
+    const QByteArray content = makeContent(2 * StreamCacheIO::kBlockSize, 3);
+    HttpServer plainServer(content, false);
+    HttpServer rangeServer(content, true);
+    StreamCacheIO io;
+    io.setUrl(plainServer.url(QStringLiteral("plain.mp4")));
+    QCOMPARE(readAll(&io), content);
+    // The first server ignored the range, the second one must still be
+    // asked for ranges.
+    io.setUrl(rangeServer.url(QStringLiteral("ranged.mp4")));
+    QCOMPARE(readAll(&io), content);
+    QVERIFY(rangeServer.requests.load() > 0);
+    QCOMPARE(rangeServer.rangeRequests.load(), rangeServer.requests.load());
+}
+
+void tst_StreamCache::evictsLeastRecentlyUsed()
+{
+    const QByteArray content = makeContent(2 * StreamCacheIO::kBlockSize, 4);
+    HttpServer server(content, true);
+    StreamCacheIO::setCacheLimit(3 * kMegabyte);
+    const quint64 evictions = counter("cache.evictions");
+    const QStringList urls = {server.url(QStringLiteral("a.mp4")), server.url(QStringLiteral("b.mp4")), server.url(QStringLiteral("c.mp4"))};
+    for (const QString &url : urls)
+    {
+        StreamCacheIO io;
+        io.setUrl(url);
+        QCOMPARE(readAll(&io), content);
+        // Apart in time even on file systems with coarse timestamps.
+        QTest::qSleep(1100);
+    }
+    const QDir dir(StreamCacheIO::cacheDirectory());
+    QVERIFY(!dir.exists(cacheKey(urls.at(0)) + QStringLiteral(".data")));
+    QVERIFY(!dir.exists(cacheKey(urls.at(0)) + QStringLiteral(".map")));
+    QVERIFY(dir.exists(cacheKey(urls.at(1)) + QStringLiteral(".data")));
+    QVERIFY(dir.exists(cacheKey(urls.at(2)) + QStringLiteral(".data")));
+    QCOMPARE(counter("cache.evictions") - evictions, static_cast<quint64>(1));
+}
+
+QTEST_GUILESS_MAIN(tst_StreamCache)
+
+#include "tst_streamcache.moc"
@@ -0,0 +1,22 @@
+# Shared by the unit tests. Set TEMPLATE before including it, the tested
+# sources are taken from ddmain as they are.
+QT *= testlib
+CONFIG *= \
+    console \
+    testcase
+include(../common.pri)
+INCLUDEPATH *= \
+    $$PWD/shared \
+    $$PWD/../ddmain
+DEPENDPATH *= $$PWD/../ddmain
+CONFIG(dd_test_metrics) {
+    # The process metrics of the registry come from a stub, the rest of
+    # Utils would pull in the whole application.
+    HEADERS *= \
+        $$PWD/../ddmain/histogram.h \
+        $$PWD/../ddmain/metrics.h
+    SOURCES *= \
+        $$PWD/shared/utilsstub.cpp \
+        $$PWD/../ddmain/histogram.cpp \
+        $$PWD/../ddmain/metrics.cpp
+}
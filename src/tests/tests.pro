@@ -0,0 +1,19 @@
+TEMPLATE = subdirs
+CONFIG -= ordered
+SUBDIRS *= \
+    commandthread \
+    controlprotocol \
+    decodeprofile \
+    framepacer \
+    framescaler \
+    framesink \
+    histogram \
+    mappedfileio \
+    metrics \
+    qtlocalpeer \
+    qualitycontroller \
+    rendererwarmup \
+    shadercache \
+    streamcache \
+    tonemapping \
+    yuvconverter
@@ -0,0 +1,14 @@
+TARGET = tst_tonemapping
+QT = core gui
+TEMPLATE = app
+CONFIG *= dd_test_metrics
+DEFINES *= DD_NO_LOGGING
+include(../tests.pri)
+include(../../3rdparty/qtav/av.pri)
+HEADERS *= \
+    ../../ddmain/shadercache.h \
+    ../../ddmain/videoeffects.h
+SOURCES *= \
+    tst_tonemapping.cpp \
+    ../../ddmain/shadercache.cpp \
+    ../../ddmain/videoeffects.cpp
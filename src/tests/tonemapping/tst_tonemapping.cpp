@@ -0,0 +1,172 @@
+#include "videoeffects.h"
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QtEndian>
+#include <QtAV/OpenGLVideo.h>
+#include <QtAV/VideoFrame.h>
+#include <QtTest>
+
+// Every patch is a square of one color, its center pixel is compared.
+const int kPatchSize = 16;
+// Differences of the GPU's float math and of the 10-bit texture upload.
+const int kTolerance = 3;
+
+// A limited range 10-bit BT.2020 color and what it looks like on an SDR
+// screen. The expected values were worked out from the formulas in the
+// shader's comment in double precision: PQ or HLG to linear light over
+// 203 nits, BT.2020 to BT.709, extended Reinhard on luminance, gamma 2.2.
+struct Patch
+{
+    quint16 y, cb, cr;
+    QRgb expected;
+};
+using Patches = QVector<Patch>;
+
+Q_DECLARE_METATYPE(ToneMapping::StreamColor)
+Q_DECLARE_METATYPE(Patches)
+
+static ToneMapping::StreamColor makeColor(ToneMapping::Transfer transfer, qreal peakLuminance)
+{
+    ToneMapping::StreamColor color;
+    color.transfer = transfer;
+    color.bt2020 = true;
+    color.peakLuminance = peakLuminance;
+    return color;
+}
+
+// A YUV420P10LE frame with the patches side by side, tagged BT.709 the
+// way ToneMapFilter tags HDR frames.
+static QtAV::VideoFrame makeFrame(const Patches &patches)
+{
+    const int width = patches.count() * kPatchSize;
+    const int height = kPatchSize;
+    const int chromaWidth = width / 2;
+    const int chromaHeight = height / 2;
+    QByteArray data((width * height + 2 * chromaWidth * chromaHeight) * 2, Qt::Uninitialized);
+    quint16 *luma = reinterpret_cast<quint16 *>(data.data());
+    quint16 *cb = luma + width * height;
+    quint16 *cr = cb + chromaWidth * chromaHeight;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            luma[y * width + x] = qToLittleEndian(patches.at(x / kPatchSize).y);
+    for (int y = 0; y < chromaHeight; ++y)
+        for (int x = 0; x < chromaWidth; ++x)
+        {
+            const Patch &patch = patches.at(x * 2 / kPatchSize);
+            cb[y * chromaWidth + x] = qToLittleEndian(patch.cb);
+            cr[y * chromaWidth + x] = qToLittleEndian(patch.cr);
+        }
+    QtAV::VideoFrame frame(width, height, QtAV::VideoFormat(QtAV::VideoFormat::Format_YUV420P10LE), data);
+    uchar *planes[3] = {reinterpret_cast<uchar *>(luma), reinterpret_cast<uchar *>(cb), reinterpret_cast<uchar *>(cr)};
+    int lineSizes[3] = {width * 2, chromaWidth * 2, chromaWidth * 2};
+    frame.setBits(planes);
+    frame.setBytesPerLine(lineSizes);
+    frame.setColorSpace(QtAV::ColorSpace_BT709);
+    frame.setColorRange(QtAV::ColorRange_Limited);
+    return frame;
+}
+
+class tst_ToneMapping : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void matchesGoldenValues_data();
+    void matchesGoldenValues();
+
+private:
+    QOffscreenSurface surface;
+    QOpenGLContext context;
+};
+
+void tst_ToneMapping::initTestCase()
+{
+    surface.create();
+    if (!context.create() || !context.makeCurrent(&surface))
+        QSKIP("No OpenGL context");
+    qDebug("Rendering with %s", reinterpret_cast<const char *>(context.functions()->glGetString(GL_RENDERER)));
+}
+
+void tst_ToneMapping::cleanupTestCase()
+{
+    context.doneCurrent();
+}
+
+void tst_ToneMapping::matchesGoldenValues_data()
+{
+    QTest::addColumn<ToneMapping::StreamColor>("color");
+    QTest::addColumn<Patches>("patches");
+    // Black, 100, 203 (SDR white) and 1000 nits grey, then three colors.
+    QTest::newRow("PQ 1000 nits") << makeColor(ToneMapping::PQ, 1000.0) << Patches
+    {
+        {64, 512, 512, qRgb(0, 0, 0)},
+        {509, 512, 512, qRgb(155, 155, 155)},
+        {573, 512, 512, qRgb(190, 190, 190)},
+        {723, 512, 512, qRgb(255, 255, 255)},
+        {557, 462, 548, qRgb(255, 159, 99)},
+        {554, 477, 492, qRgb(126, 199, 119)},
+        {462, 571, 490, qRgb(71, 132, 233)}
+    };
+    // Brighter content leaves headroom above 1000 nits.
+    QTest::newRow("PQ 4000 nits") << makeColor(ToneMapping::PQ, 4000.0) << Patches
+    {
+        {573, 512, 512, qRgb(190, 190, 190)},
+        {723, 512, 512, qRgb(236, 236, 236)}
+    };
+    // HLG reference white lands where PQ's 203 nits do.
+    QTest::newRow("HLG") << makeColor(ToneMapping::HLG, 1000.0) << Patches
+    {
+        {64, 512, 512, qRgb(0, 0, 0)},
+        {721, 512, 512, qRgb(190, 190, 190)}
+    };
+}
+
+void tst_ToneMapping::matchesGoldenValues()
+{
+    QFETCH(ToneMapping::StreamColor, color);
+    QFETCH(Patches, patches);
+    const QSize size(patches.count() * kPatchSize, kPatchSize);
+    QOpenGLFramebufferObject framebuffer(size);
+    QVERIFY(framebuffer.bind());
+    context.functions()->glViewport(0, 0, size.width(), size.height());
+    QtAV::OpenGLVideo video;
+    video.setOpenGLContext(&context);
+    video.setViewport(QRectF(QPointF(), size));
+    VideoEffects effects;
+    effects.setOpenGLVideo(&video);
+    effects.setStreamColor(color);
+    QVERIFY(effects.isActive());
+    video.setCurrentFrame(makeFrame(patches));
+    video.render();
+    const QImage image = framebuffer.toImage();
+    framebuffer.release();
+    for (int i = 0; i < patches.count(); ++i)
+    {
+        const QRgb actual = image.pixel(i * kPatchSize + kPatchSize / 2, kPatchSize / 2);
+        const QRgb expected = patches.at(i).expected;
+        const bool matches = (qAbs(qRed(actual) - qRed(expected)) <= kTolerance)
+                && (qAbs(qGreen(actual) - qGreen(expected)) <= kTolerance)
+                && (qAbs(qBlue(actual) - qBlue(expected)) <= kTolerance);
+        if (!matches)
+            QFAIL(qPrintable(QStringLiteral("Patch %1 is %2, expected %3").arg(i)
+                             .arg(QColor(actual).name(), QColor(expected).name())));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Golden values have to hold on machines without a GPU, rendered by
+    // the llvmpipe build of Mesa that Qt ships as opengl32sw.dll.
+    QCoreApplication::setAttribute(Qt::AA_UseSoftwareOpenGL);
+    QGuiApplication app(argc, argv);
+    tst_ToneMapping test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_tonemapping.moc"
@@ -0,0 +1,307 @@
+#include "yuvconverter.h"
+
+#include <QVector>
+#include <QtTest>
+
+#include <cstring>
+
+Q_DECLARE_METATYPE(YuvConverter::Instructions)
+Q_DECLARE_METATYPE(YuvConverter::Filter)
+
+static QByteArray makeNoise(int size, quint32 seed)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    quint32 state = seed;
+    for (int i = 0; i < data.size(); ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        data[i] = static_cast<char>(state >> 24);
+    }
+    return data;
+}
+
+// The planes of a 4:2:0 frame, in one buffer.
+class Frame
+{
+public:
+    Frame(int width, int height, bool nv12, quint32 seed)
+    {
+        const int chromaWidth = (width + 1) / 2;
+        const int chromaHeight = (height + 1) / 2;
+        // Padded lines, like the frames of most decoders.
+        const int lumaStride = width + 16;
+        const int chromaStride = (nv12 ? 2 * chromaWidth : chromaWidth) + 16;
+        data = makeNoise(lumaStride * height + chromaStride * chromaHeight * (nv12 ? 1 : 2), seed);
+        const uchar *bits = reinterpret_cast<const uchar *>(data.constData());
+        source.y = bits;
+        source.u = bits + lumaStride * height;
+        source.v = nv12 ? source.u + 1 : source.u + chromaStride * chromaHeight;
+        source.yStride = lumaStride;
+        source.uvStride = chromaStride;
+        source.uvStep = nv12 ? 2 : 1;
+        source.width = width;
+        source.height = height;
+    }
+
+    void fill(uchar luma, uchar cb, uchar cr)
+    {
+        uchar *bits = reinterpret_cast<uchar *>(data.data());
+        const int chromaStart = source.yStride * source.height;
+        memset(bits, luma, static_cast<size_t>(chromaStart));
+        if (source.uvStep == 1)
+        {
+            const int crStart = static_cast<int>(source.v - source.y);
+            memset(bits + chromaStart, cb, static_cast<size_t>(crStart - chromaStart));
+            memset(bits + crStart, cr, static_cast<size_t>(data.size() - crStart));
+            return;
+        }
+        // The lines are an even number of bytes long.
+        for (int i = chromaStart; i < data.size(); ++i)
+            bits[i] = ((i - chromaStart) % 2) ? cr : cb;
+    }
+
+public:
+    QByteArray data;
+    YuvConverter::Source source;
+};
+
+static QByteArray convert(const YuvConverter::Source &source, int width, int height, YuvConverter::Filter filter,
+                          YuvConverter::Instructions instructions, int bands = 1)
+{
+    QByteArray bgra(width * height * 4, Qt::Uninitialized);
+    uchar *bits = reinterpret_cast<uchar *>(bgra.data());
+    const YuvConverter::Coefficients coefficients = YuvConverter::coefficients(true, false);
+    const YuvConverter::Scaling scaling = YuvConverter::makeScaling(filter, source.width, source.height, width, height);
+    // Shared by the bands, like a thread converting several in a row.
+    YuvConverter::Scratch scratch;
+    for (int i = 0; i < bands; ++i)
+    {
+        const int first = height * i / bands;
+        YuvConverter::convertScaled(source, bits + first * width * 4, width * 4, first, height * (i + 1) / bands,
+                                    scaling, coefficients, instructions, &scratch);
+    }
+    return bgra;
+}
+
+class tst_YuvConverter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void simdMatchesScalar_data();
+    void simdMatchesScalar();
+    void simdScalesLikeScalar_data();
+    void simdScalesLikeScalar();
+    void keepsFlatColors_data();
+    void keepsFlatColors();
+    void averagesCoveredSamples();
+    void blendsNeighbours();
+    void bandsDontChangeResult_data();
+    void bandsDontChangeResult();
+    void benchmarkConvert_data();
+    void benchmarkConvert();
+    void benchmarkScale_data();
+    void benchmarkScale();
+};
+
+void tst_YuvConverter::simdMatchesScalar_data()
+{
+    QTest::addColumn<YuvConverter::Instructions>("instructions");
+    QTest::addColumn<bool>("nv12");
+    QTest::newRow("SSE2 planar") << YuvConverter::SSE2 << false;
+    QTest::newRow("SSE2 NV12") << YuvConverter::SSE2 << true;
+    QTest::newRow("AVX2 planar") << YuvConverter::AVX2 << false;
+    QTest::newRow("AVX2 NV12") << YuvConverter::AVX2 << true;
+    QTest::newRow("NEON planar") << YuvConverter::NEON << false;
+    QTest::newRow("NEON NV12") << YuvConverter::NEON << true;
+}
+
+void tst_YuvConverter::simdMatchesScalar()
+{
+    QFETCH(YuvConverter::Instructions, instructions);
+    QFETCH(bool, nv12);
+    if (!YuvConverter::isAvailable(instructions))
+        QSKIP("Not supported by this build or CPU");
+    // Every width up to a few vectors, so that each kernel hands a
+    // different remainder to the scalar code.
+    for (int width = 1; width <= 80; ++width)
+    {
+        const Frame frame(width, 2, nv12, static_cast<quint32>(width));
+        for (int matrix = 0; matrix < 4; ++matrix)
+        {
+            const YuvConverter::Coefficients coefficients = YuvConverter::coefficients(matrix & 1, matrix & 2);
+            QByteArray expected(width * 4, Qt::Uninitialized), actual(width * 4, Qt::Uninitialized);
+            YuvConverter::convertRow(frame.source.y, frame.source.u, frame.source.v, frame.source.uvStep,
+                                     reinterpret_cast<uchar *>(expected.data()), width, coefficients, YuvConverter::Scalar);
+            YuvConverter::convertRow(frame.source.y, frame.source.u, frame.source.v, frame.source.uvStep,
+                                     reinterpret_cast<uchar *>(actual.data()), width, coefficients, instructions);
+            if (actual != expected)
+                QFAIL(qPrintable(QStringLiteral("Differs at width %1 with matrix %2").arg(width).arg(matrix)));
+        }
+    }
+}
+
+void tst_YuvConverter::simdScalesLikeScalar_data()
+{
+    simdMatchesScalar_data();
+}
+
+void tst_YuvConverter::simdScalesLikeScalar()
+{
+    QFETCH(YuvConverter::Instructions, instructions);
+    QFETCH(bool, nv12);
+    if (!YuvConverter::isAvailable(instructions))
+        QSKIP("Not supported by this build or CPU");
+    // Up and down, from widths that leave every remainder to the scalar
+    // code of the vertical pass, to widths that do the same for the
+    // horizontal pass.
+    for (int from = 1; from <= 70; ++from)
+    {
+        const Frame frame(2 * from, 6, nv12, static_cast<quint32>(from));
+        for (int width = 1; width <= 90; width += (width < 40) ? 1 : 7)
+        {
+            const YuvConverter::Scaling scaling = YuvConverter::makeScaling(YuvConverter::Bilinear, 2 * from, 6, 2 * width, 9);
+            YuvConverter::Scratch expectedScratch, actualScratch;
+            QByteArray expected(width, Qt::Uninitialized), actual(width, Qt::Uninitialized);
+            for (int row = 0; row < 5; ++row)
+            {
+                // The chroma planes, for the interleaved rows of NV12.
+                const uchar *planes[] = {frame.source.u, frame.source.v};
+                for (const uchar *plane : planes)
+                {
+                    YuvConverter::scaleRow(plane, frame.source.uvStride, frame.source.uvStep, from, scaling.chromaColumns,
+                                           scaling.chromaRows, row, YuvConverter::Bilinear, reinterpret_cast<uchar *>(expected.data()),
+                                           width, &expectedScratch, YuvConverter::Scalar);
+                    YuvConverter::scaleRow(plane, frame.source.uvStride, frame.source.uvStep, from, scaling.chromaColumns,
+                                           scaling.chromaRows, row, YuvConverter::Bilinear, reinterpret_cast<uchar *>(actual.data()),
+                                           width, &actualScratch, instructions);
+                    if (actual != expected)
+                        QFAIL(qPrintable(QStringLiteral("Differs from %1 to %2 samples in row %3").arg(from).arg(width).arg(row)));
+                }
+            }
+        }
+    }
+}
+
+void tst_YuvConverter::keepsFlatColors_data()
+{
+    QTest::addColumn<YuvConverter::Filter>("filter");
+    QTest::addColumn<bool>("nv12");
+    QTest::addColumn<QSize>("size");
+    QTest::newRow("bilinear down") << YuvConverter::Bilinear << false << QSize(427, 240);
+    QTest::newRow("bilinear up") << YuvConverter::Bilinear << true << QSize(1280, 721);
+    QTest::newRow("area down") << YuvConverter::Area << false << QSize(213, 119);
+    QTest::newRow("area down NV12") << YuvConverter::Area << true << QSize(320, 180);
+    QTest::newRow("area up") << YuvConverter::Area << false << QSize(1000, 600);
+}
+
+void tst_YuvConverter::keepsFlatColors()
+{
+    QFETCH(YuvConverter::Filter, filter);
+    QFETCH(bool, nv12);
+    QFETCH(QSize, size);
+    Frame frame(853, 480, nv12, 1);
+    frame.fill(100, 90, 160);
+    const QByteArray bgra = convert(frame.source, size.width(), size.height(), filter, YuvConverter::bestInstructions());
+    uchar expected[4];
+    const uchar luma = 100, cb = 90, cr = 160;
+    YuvConverter::convertRow(&luma, &cb, &cr, 1, expected, 1, YuvConverter::coefficients(true, false), YuvConverter::Scalar);
+    for (int i = 0; i < bgra.size(); i += 4)
+        if (memcmp(bgra.constData() + i, expected, 4) != 0)
+            QFAIL(qPrintable(QStringLiteral("Pixel %1 changed color").arg(i / 4)));
+}
+
+void tst_YuvConverter::averagesCoveredSamples()
+{
+    // Neutral chroma and full range, the output is the luma itself.
+    const uchar luma[] = {10, 20, 30, 40, 50, 60, 70, 80};
+    const uchar chroma[] = {128, 128};
+    const YuvConverter::Source source = {luma, chroma, chroma, 4, 2, 1, 4, 2};
+    uchar bgra[8];
+    YuvConverter::Scratch scratch;
+    YuvConverter::convertScaled(source, bgra, 8, 0, 1, YuvConverter::makeScaling(YuvConverter::Area, 4, 2, 2, 1),
+                                YuvConverter::coefficients(false, true), YuvConverter::Scalar, &scratch);
+    QCOMPARE(static_cast<int>(bgra[0]), (10 + 20 + 50 + 60) / 4);
+    QCOMPARE(static_cast<int>(bgra[4]), (30 + 40 + 70 + 80) / 4);
+    QCOMPARE(static_cast<int>(bgra[7]), 0xff);
+}
+
+void tst_YuvConverter::blendsNeighbours()
+{
+    const uchar luma[] = {0, 100, 200, 0};
+    const uchar chroma[] = {128, 128};
+    const YuvConverter::Source source = {luma, chroma, chroma, 4, 2, 1, 4, 1};
+    // Twice as wide, the inner samples sit a quarter of the way between
+    // their neighbours.
+    uchar bgra[32];
+    YuvConverter::Scratch scratch;
+    YuvConverter::convertScaled(source, bgra, 32, 0, 1, YuvConverter::makeScaling(YuvConverter::Bilinear, 4, 1, 8, 1),
+                                YuvConverter::coefficients(false, true), YuvConverter::Scalar, &scratch);
+    const int expected[] = {0, 25, 75, 125, 175, 150, 50, 0};
+    for (int x = 0; x < 8; ++x)
+        QCOMPARE(static_cast<int>(bgra[x * 4]), expected[x]);
+}
+
+void tst_YuvConverter::bandsDontChangeResult_data()
+{
+    QTest::addColumn<YuvConverter::Filter>("filter");
+    QTest::newRow("bilinear") << YuvConverter::Bilinear;
+    QTest::newRow("area") << YuvConverter::Area;
+}
+
+void tst_YuvConverter::bandsDontChangeResult()
+{
+    QFETCH(YuvConverter::Filter, filter);
+    const Frame frame(1280, 720, false, 2);
+    // Odd band borders, so that some bands start on the second row of a
+    // chroma pair.
+    const QByteArray whole = convert(frame.source, 853, 479, filter, YuvConverter::bestInstructions());
+    QCOMPARE(convert(frame.source, 853, 479, filter, YuvConverter::bestInstructions(), 7), whole);
+    QCOMPARE(convert(frame.source, 853, 479, filter, YuvConverter::Scalar, 3), whole);
+}
+
+void tst_YuvConverter::benchmarkConvert_data()
+{
+    QTest::addColumn<YuvConverter::Instructions>("instructions");
+    QTest::newRow("Scalar") << YuvConverter::Scalar;
+    QTest::newRow("SSE2") << YuvConverter::SSE2;
+    QTest::newRow("AVX2") << YuvConverter::AVX2;
+    QTest::newRow("NEON") << YuvConverter::NEON;
+}
+
+void tst_YuvConverter::benchmarkConvert()
+{
+    QFETCH(YuvConverter::Instructions, instructions);
+    if (!YuvConverter::isAvailable(instructions))
+        QSKIP("Not supported by this build or CPU");
+    const Frame frame(1920, 1080, false, 3);
+    QBENCHMARK
+    {
+        convert(frame.source, 1920, 1080, YuvConverter::Bilinear, instructions);
+    }
+}
+
+void tst_YuvConverter::benchmarkScale_data()
+{
+    QTest::addColumn<YuvConverter::Filter>("filter");
+    QTest::addColumn<QSize>("size");
+    QTest::newRow("bilinear 2160p to 1440p") << YuvConverter::Bilinear << QSize(2560, 1440);
+    QTest::newRow("area 2160p to 1080p") << YuvConverter::Area << QSize(1920, 1080);
+    QTest::newRow("bilinear 1080p to 2160p") << YuvConverter::Bilinear << QSize(3840, 2160);
+}
+
+void tst_YuvConverter::benchmarkScale()
+{
+    QFETCH(YuvConverter::Filter, filter);
+    QFETCH(QSize, size);
+    const bool up = size.width() > 1920;
+    const Frame frame(up ? 1920 : 3840, up ? 1080 : 2160, false, 4);
+    QBENCHMARK
+    {
+        convert(frame.source, size.width(), size.height(), filter, YuvConverter::bestInstructions());
+    }
+}
+
+QTEST_GUILESS_MAIN(tst_YuvConverter)
+
+#include "tst_yuvconverter.moc"
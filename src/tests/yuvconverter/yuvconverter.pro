@@ -0,0 +1,8 @@
+TARGET = tst_yuvconverter
+QT = core
+TEMPLATE = app
+include(../tests.pri)
+HEADERS *= ../../ddmain/yuvconverter.h
+SOURCES *= \
+    tst_yuvconverter.cpp \
+    ../../ddmain/yuvconverter.cpp